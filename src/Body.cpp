@@ -10,8 +10,8 @@
 #include "SpaceStation.h"
 #include "Ship.h"
 #include "Player.h"
-#include "Projectile.h"
 #include "Missile.h"
+#include "Projectile.h"
 #include "HyperspaceCloud.h"
 #include "Pi.h"
 #include "Space.h"
@@ -22,6 +22,7 @@ Body::Body() : PropertiedObject(Lua::manager)
 	, m_flags(0)
 	, m_interpPos(0.0)
 	, m_interpOrient(matrix3x3d::Identity())
+	, m_registrySlot(~Uint32(0))
 	, m_pos(0.0)
 	, m_orient(matrix3x3d::Identity())
 	, m_frame(0)
@@ -73,7 +74,6 @@ void Body::Serialize(Serializer::Writer &_wr, Space *space)
 		case Object::PLAYER:
 		case Object::MISSILE:
 		case Object::CARGOBODY:
-		case Object::PROJECTILE:
 		case Object::HYPERSPACECLOUD:
 			Save(wr, space);
 			break;
@@ -106,9 +106,6 @@ Body *Body::Unserialize(Serializer::Reader &_rd, Space *space)
             break;
 		case Object::MISSILE:
 			b = new Missile(); 
-            break;
-		case Object::PROJECTILE:
-			b = new Projectile(); 
             break;
 		case Object::CARGOBODY:
 			b = new CargoBody(); 
@@ -117,6 +114,11 @@ Body *Body::Unserialize(Serializer::Reader &_rd, Space *space)
 			// This should detect and create permanent clouds
             b = space->CreateHyperspaceCloud(); 
             break;
+		case Object::PROJECTILE:
+			// Save game upgrade: 81 -> 82. No body, the bolt goes in its frame
+			assert(Game::s_loadedGameVersion < 82);
+			Projectile::UnserializeBody(rd, space);
+			return 0;
 		default:
 			assert(0);
 	}
@@ -126,18 +128,48 @@ Body *Body::Unserialize(Serializer::Reader &_rd, Space *space)
 
 vector3d Body::GetPositionRelTo(const Frame *relTo) const
 {
-	vector3d fpos = m_frame->GetPositionRelTo(relTo);
-	matrix3x3d forient = m_frame->GetOrientRelTo(relTo);
+	matrix3x3d forient;
+	vector3d fpos;
+	m_frame->GetTransformRelTo(relTo, forient, fpos);
 	return forient * GetPosition() + fpos;
 }
 
 vector3d Body::GetInterpPositionRelTo(const Frame *relTo) const
 {
-	vector3d fpos = m_frame->GetInterpPositionRelTo(relTo);
-	matrix3x3d forient = m_frame->GetInterpOrientRelTo(relTo);
+	matrix3x3d forient;
+	vector3d fpos;
+	m_frame->GetInterpTransformRelTo(relTo, forient, fpos);
 	return forient * GetInterpPosition() + fpos;
 }
 
+void Body::GetInterpPositionsRelTo(const Frame *relTo, const Body *const *bodies, size_t count, vector3d *positions)
+{
+	// the bodies of a space are in a handful of frames but in no particular
+	// order (removing one moves the last into its place), so each frame's
+	// transform is fetched the first time it comes up and kept for the rest
+	struct FrameTransform {
+		const Frame *frame;
+		matrix3x3d orient;
+		vector3d pos;
+	};
+	std::vector<FrameTransform> transforms;
+	size_t last = 0;
+	for (size_t i = 0; i < count; i++) {
+		const Body *b = bodies[i];
+		if (transforms.empty() || transforms[last].frame != b->m_frame) {
+			last = 0;
+			while (last < transforms.size() && transforms[last].frame != b->m_frame)
+				last++;
+			if (last == transforms.size()) {
+				transforms.push_back(FrameTransform());
+				transforms[last].frame = b->m_frame;
+				b->m_frame->GetInterpTransformRelTo(relTo, transforms[last].orient, transforms[last].pos);
+			}
+		}
+		positions[i] = transforms[last].orient * b->m_interpPos + transforms[last].pos;
+	}
+}
+
 vector3d Body::GetPositionRelTo(const Body *relTo) const
 {
 	return GetPositionRelTo(relTo->m_frame) - relTo->GetPosition();
@@ -162,7 +194,7 @@ matrix3x3d Body::GetInterpOrientRelTo(const Frame *relTo) const
 
 vector3d Body::GetVelocityRelTo(const Frame *relTo) const
 {
-	matrix3x3d forient = m_frame->GetOrientRelTo(relTo);
+	const matrix3x3d forient = m_frame->GetOrientRelTo(relTo);
 	vector3d vel = GetVelocity();
 	if (m_frame != relTo) vel -= m_frame->GetStasisVelocity(GetPosition());
 	return forient * vel + m_frame->GetVelocityRelTo(relTo);
@@ -185,8 +217,9 @@ void Body::OrientOnSurface(double radius, double latitude, double longitude)
 void Body::SwitchToFrame(Frame *newFrame)
 {
 	vector3d vel = GetVelocityRelTo(newFrame);		// do this first because it uses position
-	vector3d fpos = m_frame->GetPositionRelTo(newFrame);
-	matrix3x3d forient = m_frame->GetOrientRelTo(newFrame);
+	matrix3x3d forient;
+	vector3d fpos;
+	m_frame->GetTransformRelTo(newFrame, forient, fpos);
 	SetPosition(forient * GetPosition() + fpos);
 	SetOrient(forient * GetOrient());
 	SetVelocity(vel + newFrame->GetStasisVelocity(GetPosition()));
@@ -14,6 +14,7 @@
 
 class ObjMesh;
 class Space;
+template <typename T> class BodyRegistry;
 class Camera;
 namespace Graphics { class Renderer; }
 struct CollisionContact;
@@ -44,11 +45,24 @@ public:
 	virtual bool OnCollision(Object *o, Uint32 flags, double relVel) { return false; }
 	// Attacker may be null
 	virtual bool OnDamage(Object *attacker, float kgDamage, const CollisionContact& contactData) { return false; }
-	// Override to clear any pointers you hold to the body
+	// Override to clear any pointers you hold to the body. Only bodies that
+	// ObservesAllRemovals() hear about every body; others must subscribe to
+	// the ones they point at with Space::SubscribeRemoval()
 	virtual void NotifyRemoved(const Body* const removedBody) {}
+	virtual bool ObservesAllRemovals() const { return false; }
+	// false if nothing points at this body without subscribing to it
+	virtual bool IsReferenceable() const { return true; }
+	// bodies that ObservesAdditions() get NotifyAdded() for every body in the
+	// space with them, including the ones that were there first
+	virtual void NotifyAdded(Body *addedBody) {}
+	virtual bool ObservesAdditions() const { return false; }
+	// when this body is put in a space (after everything loaded with it has
+	// had PostLoadFixup()), and when it's taken out again
+	virtual void NotifyEnteredSpace(Space *space) {}
+	virtual void NotifyLeftSpace() {}
 
 	// before all bodies have had TimeStepUpdate (their moving step),
-	// StaticUpdate() is called. Good for special collision testing (Projectiles)
+	// StaticUpdate() is called. Good for special collision testing (Missiles)
 	// as you can't test for collisions if different objects are on different 'steps'
 	virtual void StaticUpdate(const float timeStep) {}
 	virtual void TimeStepUpdate(const float timeStep) {}
@@ -86,6 +100,9 @@ public:
 	vector3d GetInterpPositionRelTo(const Frame *relTo) const;
 	vector3d GetInterpPositionRelTo(const Body *relTo) const;
 	matrix3x3d GetInterpOrientRelTo(const Frame *relTo) const;
+	// GetInterpPositionRelTo() for a lot of bodies at once, for the
+	// renderer and the scanner. Each frame's transform is worked out once
+	static void GetInterpPositionsRelTo(const Frame *relTo, const Body *const *bodies, size_t count, vector3d *positions);
 
 	// should set m_interpolatedTransform to the smoothly interpolated value
 	// (interpolated by 0 <= alpha <=1) between the previous and current physics tick
@@ -110,6 +127,9 @@ protected:
 	vector3d m_interpPos;
 	matrix3x3d m_interpOrient;
 private:
+	template <typename T> friend class BodyRegistry;
+	Uint32 m_registrySlot;		// owned by the Space's BodyRegistry
+
 	vector3d m_pos;
 	matrix3x3d m_orient;
 	Frame *m_frame;				// frame of reference
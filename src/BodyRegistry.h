@@ -0,0 +1,222 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _BODYREGISTRY_H
+#define _BODYREGISTRY_H
+
+#include "libs.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+// Dense store of the bodies in a Space, with O(1) add and remove.
+//
+// Bodies live in one contiguous array. Removing one moves the last body into
+// its place, so the order changes on removal. Each body also owns a slot,
+// which keeps track of where in the array it is. A Handle is a slot plus a
+// generation count. Once the body is removed the handle resolves to null,
+// even if the slot has been reused.
+//
+// Removal notifications only go to bodies that might care:
+//  - bodies that can point at any other body (ObservesAllRemovals(), eg
+//    ships with AI targets, stations with docking ships) hear about every
+//    removed body that IsReferenceable()
+//  - any other body that points at something subscribes to it
+//
+// Bodies that ObservesAdditions() hear about every body added (and every one
+// already there when they're added). Every body gets NotifyLeftSpace() when
+// it's removed itself.
+//
+// T needs:
+//   Uint32 m_registrySlot (BodyRegistry is expected to be a friend)
+//   bool ObservesAllRemovals() const
+//   bool ObservesAdditions() const
+//   bool IsReferenceable() const
+//   void NotifyRemoved(const T *)
+//   void NotifyAdded(T *)
+//   void NotifyLeftSpace()
+template <typename T>
+class BodyRegistry {
+public:
+	static const Uint32 INVALID_SLOT = ~Uint32(0);
+
+	struct Handle {
+		Handle() : slot(INVALID_SLOT), generation(0) {}
+		Handle(Uint32 slot_, Uint32 generation_) : slot(slot_), generation(generation_) {}
+		Uint32 slot;
+		Uint32 generation;
+	};
+
+	BodyRegistry() : m_freeSlot(INVALID_SLOT) {}
+
+	std::vector<T*> &GetAll() { return m_bodies; }
+	const std::vector<T*> &GetAll() const { return m_bodies; }
+	size_t Size() const { return m_bodies.size(); }
+
+	bool Contains(const T *b) const { return b->m_registrySlot != INVALID_SLOT; }
+
+	void Add(T *b) {
+		assert(!Contains(b));
+
+		Uint32 slot;
+		if (m_freeSlot != INVALID_SLOT) {
+			slot = m_freeSlot;
+			m_freeSlot = m_slots[slot].index;
+		} else {
+			slot = m_slots.size();
+			m_slots.push_back(Slot());
+		}
+
+		Slot &s = m_slots[slot];
+		s.index = m_bodies.size();
+		s.observerIndex = INVALID_SLOT;
+		s.addObserverIndex = INVALID_SLOT;
+		m_bodies.push_back(b);
+		b->m_registrySlot = slot;
+
+		if (b->ObservesAllRemovals()) {
+			s.observerIndex = m_observers.size();
+			m_observers.push_back(b);
+		}
+
+		for (size_t i = 0; i < m_addObservers.size(); i++)
+			m_addObservers[i]->NotifyAdded(b);
+
+		if (b->ObservesAdditions()) {
+			m_slots[slot].addObserverIndex = m_addObservers.size();
+			m_addObservers.push_back(b);
+			for (size_t i = 0; i + 1 < m_bodies.size(); i++)
+				b->NotifyAdded(m_bodies[i]);
+		}
+	}
+
+	// take b out of the registry, and tell everyone that needs to know
+	void Remove(T *b) {
+		if (!Contains(b)) return;
+
+		const Uint32 slot = b->m_registrySlot;
+		Slot &s = m_slots[slot];
+
+		SwapRemove(m_bodies, s.index, &Slot::index);
+		if (s.observerIndex != INVALID_SLOT)
+			SwapRemove(m_observers, s.observerIndex, &Slot::observerIndex);
+		if (s.addObserverIndex != INVALID_SLOT)
+			SwapRemove(m_addObservers, s.addObserverIndex, &Slot::addObserverIndex);
+
+		++s.generation;
+		s.index = m_freeSlot;
+		s.observerIndex = INVALID_SLOT;
+		s.addObserverIndex = INVALID_SLOT;
+		m_freeSlot = slot;
+		b->m_registrySlot = INVALID_SLOT;
+
+		// it's gone, so it doesn't need to hear about anything anymore
+		auto subs = m_subscriptions.find(b);
+		if (subs != m_subscriptions.end()) {
+			for (const T *subject : subs->second) {
+				auto it = m_subscribers.find(subject);
+				if (it != m_subscribers.end()) {
+					it->second.erase(b);
+					if (it->second.empty()) m_subscribers.erase(it);
+				}
+			}
+			m_subscriptions.erase(subs);
+		}
+
+		auto it = m_subscribers.find(b);
+		if (it != m_subscribers.end()) {
+			// take the set, NotifyRemoved may unsubscribe
+			std::unordered_set<T*> subscribers;
+			subscribers.swap(it->second);
+			m_subscribers.erase(it);
+			for (T *observer : subscribers) {
+				auto s = m_subscriptions.find(observer);
+				if (s != m_subscriptions.end()) {
+					for (size_t i = 0; i < s->second.size(); i++) {
+						if (s->second[i] == b) {
+							s->second[i] = s->second.back();
+							s->second.pop_back();
+							break;
+						}
+					}
+					if (s->second.empty()) m_subscriptions.erase(s);
+				}
+				if (!b->IsReferenceable() || !observer->ObservesAllRemovals())
+					observer->NotifyRemoved(b);
+			}
+		}
+
+		if (b->IsReferenceable()) {
+			for (size_t i = 0; i < m_observers.size(); i++)
+				m_observers[i]->NotifyRemoved(b);
+		}
+		b->NotifyLeftSpace();
+	}
+
+	Handle GetHandle(const T *b) const {
+		if (!Contains(b)) return Handle();
+		return Handle(b->m_registrySlot, m_slots[b->m_registrySlot].generation);
+	}
+
+	// null if the body has been removed since the handle was taken
+	T *Get(const Handle &h) const {
+		if (h.slot >= m_slots.size()) return 0;
+		const Slot &s = m_slots[h.slot];
+		if (s.generation != h.generation) return 0;
+		return m_bodies[s.index];
+	}
+
+	// observer gets NotifyRemoved(subject) when subject is removed. both
+	// have to be in the registry already, or there'd be nothing to tidy up
+	// the subscription when they go
+	void Subscribe(T *observer, const T *subject) {
+		if (!Contains(observer) || !Contains(subject)) return;
+		if (!m_subscribers[subject].insert(observer).second) return;
+		m_subscriptions[observer].push_back(subject);
+	}
+
+	void Unsubscribe(T *observer, const T *subject) {
+		auto it = m_subscribers.find(subject);
+		if (it == m_subscribers.end() || !it->second.erase(observer)) return;
+		if (it->second.empty()) m_subscribers.erase(it);
+
+		auto s = m_subscriptions.find(observer);
+		for (size_t i = 0; i < s->second.size(); i++) {
+			if (s->second[i] == subject) {
+				s->second[i] = s->second.back();
+				s->second.pop_back();
+				break;
+			}
+		}
+		if (s->second.empty()) m_subscriptions.erase(s);
+	}
+
+private:
+	struct Slot {
+		Slot() : index(INVALID_SLOT), observerIndex(INVALID_SLOT), addObserverIndex(INVALID_SLOT), generation(0) {}
+		Uint32 index;			// in m_bodies, or next free slot
+		Uint32 observerIndex;	// in m_observers
+		Uint32 addObserverIndex;	// in m_addObservers
+		Uint32 generation;
+	};
+
+	// move the last element into v[idx], and fix up its slot
+	void SwapRemove(std::vector<T*> &v, Uint32 idx, Uint32 Slot::*field) {
+		T *last = v.back();
+		v[idx] = last;
+		m_slots[last->m_registrySlot].*field = idx;
+		v.pop_back();
+	}
+
+	std::vector<T*> m_bodies;
+	std::vector<T*> m_observers;
+	std::vector<T*> m_addObservers;
+	std::vector<Slot> m_slots;
+	Uint32 m_freeSlot;
+
+	// subject -> bodies that want to hear about it going, and the reverse
+	std::unordered_map<const T*, std::unordered_set<T*> > m_subscribers;
+	std::unordered_map<const T*, std::vector<const T*> > m_subscriptions;
+};
+
+#endif
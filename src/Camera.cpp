@@ -10,6 +10,7 @@
 #include "Player.h"
 #include "Pi.h"
 #include "Sfx.h"
+#include "Projectile.h"
 #include "Game.h"
 #include "Planet.h"
 #include "graphics/Graphics.h"
@@ -17,6 +18,7 @@
 #include "graphics/VertexArray.h"
 #include "graphics/Material.h"
 #include "graphics/TextureBuilder.h"
+#include "scenegraph/Impostor.h"
 #include "MainMaterial.h"
 
 #include <SDL_stdinc.h>
@@ -249,7 +251,8 @@ void Camera::BeginDraw(const Body *excludeBody)
 		m_renderer->SetLights(rendererLights.size(), &rendererLights[0]);
 	}
 
-	// Body Drawing
+	// Body Drawing, small models batched up as impostors till the end
+	SceneGraph::Impostor::BeginBatch();
 	for (std::list<BodyAttrs>::iterator i = m_sortedBodies.begin(); i != m_sortedBodies.end(); ++i) {
 		BodyAttrs *attrs = &(*i);
 
@@ -268,6 +271,10 @@ void Camera::BeginDraw(const Body *excludeBody)
 			attrs->body->Render(m_renderer, this, attrs->viewCoords, attrs->viewTransform);
 		}
 	}
+	SceneGraph::Impostor::EndBatch(m_renderer);
+
+	// Laser bolts, all in one go
+	Projectile::RenderAll(m_renderer, m_context->GetFrustum(), Pi::game->GetSpace()->GetRootFrame(), camFrame);
 
 	// Effects drawing (smoke, explosions, etc)
 	Sfx::RenderAll(m_renderer, Pi::game->GetSpace()->GetRootFrame(), camFrame);
@@ -182,6 +182,7 @@ static void lookupBuildingListModels(citybuildinglist_t *list)
 			it != filenames.end(); ++it)
 		{
 			Model *model = Pi::modelCache->FindModel(*it);
+			model->EnableImpostor();
 			models.push_back(model);
 		}
 	}
@@ -193,7 +194,7 @@ static void lookupBuildingListModels(citybuildinglist_t *list)
 	int i = 0;
 	for (std::vector<Model*>::iterator m = models.begin(); m != models.end(); ++m, i++) {
 		list->buildings[i].resolvedModel = *m;
-		list->buildings[i].collMesh = (*m)->CreateCollisionMesh();
+		list->buildings[i].collMesh = (*m)->GetCollisionMesh();
 		const Aabb &aabb = list->buildings[i].collMesh->GetAabb();
 		const double maxx = std::max(fabs(aabb.max.x), fabs(aabb.min.x));
 		const double maxy = std::max(fabs(aabb.max.z), fabs(aabb.min.z));
@@ -0,0 +1,41 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "CollMesh.h"
+
+CollMesh::CollMesh(Serializer::Reader &rd)
+: m_geomTree(0)
+, m_totalTris(0)
+{
+	m_aabb.min = rd.Vector3d();
+	m_aabb.max = rd.Vector3d();
+	m_aabb.radius = rd.Double();
+	m_totalTris = rd.Int32();
+
+	try {
+		m_geomTree = new GeomTree(rd);
+		for (Uint32 numDyn = rd.Int32(); numDyn > 0; numDyn--)
+			m_dynGeomTrees.push_back(new GeomTree(rd));
+	} catch (...) {
+		// no destructor for a half built mesh
+		for (GeomTree *t : m_dynGeomTrees)
+			delete t;
+		delete m_geomTree;
+		throw;
+	}
+}
+
+void CollMesh::Save(Serializer::Writer &wr) const
+{
+	assert(m_geomTree);
+
+	wr.Vector3d(m_aabb.min);
+	wr.Vector3d(m_aabb.max);
+	wr.Double(m_aabb.radius);
+	wr.Int32(m_totalTris);
+
+	m_geomTree->Save(wr);
+	wr.Int32(m_dynGeomTrees.size());
+	for (const GeomTree *t : m_dynGeomTrees)
+		t->Save(wr);
+}
@@ -6,6 +6,7 @@
 #include "RefCounted.h"
 #include "Aabb.h"
 #include "collider/GeomTree.h"
+#include "Serializer.h"
 
 //This simply stores the collision GeomTrees
 //and AABB.
@@ -15,6 +16,8 @@ public:
 	: m_geomTree(0)
 	, m_totalTris(0)
 	{ }
+	// a mesh written by Save(), with its trees as they were built
+	CollMesh(Serializer::Reader &rd);
 	virtual ~CollMesh() {
 		for (auto it = m_dynGeomTrees.begin(); it != m_dynGeomTrees.end(); ++it)
 			delete *it;
@@ -40,6 +43,8 @@ public:
 		m_dynGeomTrees.push_back(t);
 	}
 
+	void Save(Serializer::Writer &wr) const;
+
 	//for statistics
 	unsigned int GetNumTriangles() const { return m_totalTris; }
 	void SetNumTriangles(unsigned int i) { m_totalTris = i; }
@@ -29,6 +29,8 @@ DynamicBody::DynamicBody(): ModelBody()
 	m_externalForce = vector3d(0.0);		// do external forces calc instead?
 	m_lastForce = vector3d(0.0);
 	m_lastTorque = vector3d(0.0);
+	m_subSteps = 1;
+	m_stepSize = float(1.0 / PHYSICS_HZ);
 }
 
 void DynamicBody::SetForce(const vector3d &f)
@@ -192,6 +194,13 @@ void DynamicBody::TimeStepUpdate(const float timeStep)
 	ModelBody::TimeStepUpdate(timeStep);
 }
 
+vector3d DynamicBody::GetStepMotion(const float timeStep) const
+{
+	if (!m_isMoving) return vector3d(0.0);
+	const vector3d vel = m_vel + double(timeStep) * (m_force + m_externalForce) * (1.0 / m_mass);
+	return vel * double(timeStep);
+}
+
 void DynamicBody::UpdateInterpTransform(double alpha)
 {
 	m_interpPos = alpha*GetPosition() + (1.0-alpha)*m_oldPos;
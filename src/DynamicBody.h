@@ -9,6 +9,7 @@
 #include "vector3.h"
 #include "matrix4x4.h"
 #include "Orbit.h"
+#include "TerrainHeightCache.h"
 
 class DynamicBody: public ModelBody {
 public:
@@ -29,6 +30,15 @@ public:
 	bool IsMoving() const { return m_isMoving; }
 	virtual double GetMass() const { return m_mass; }	// XXX don't override this
 	virtual void TimeStepUpdate(const float timeStep);
+	// how far TimeStepUpdate() will move it, given the forces so far
+	vector3d GetStepMotion(const float timeStep) const;
+	// how many pieces Space cuts this step into for us, more than one when
+	// we're too close to something for the whole step in one go, and how
+	// long each piece is. Anything sizing thrust or rates to a step (the AI,
+	// fly-by-wire) wants GetStepSize(), not the game's base step
+	int GetSubSteps() const { return m_subSteps; }
+	float GetStepSize() const { return m_stepSize; }
+	void SetSubSteps(float tickStep, int subSteps) { m_subSteps = subSteps; m_stepSize = tickStep / subSteps; }
 	virtual void CalcExternalForce();
 	void UndoTimestep();
 
@@ -44,6 +54,9 @@ public:
 	virtual void PostLoadFixup(Space *space);
 
 	Orbit ComputeOrbit() const;
+
+	// for TerrainBody::GetTerrainHeightApprox() about the ground under us
+	TerrainHeightCache &GetTerrainHeightCache() { return m_terrainHeightCache; }
 protected:
 	virtual void Save(Serializer::Writer &wr, Space *space);
 	virtual void Load(Serializer::Reader &rd, Space *space);
@@ -71,6 +84,11 @@ protected:
 	// for time accel reduction fudge
 	vector3d m_lastForce;
 	vector3d m_lastTorque;
+
+	int m_subSteps;
+	float m_stepSize;
+
+	TerrainHeightCache m_terrainHeightCache;
 };
 
 #endif /* _DYNAMICBODY_H */
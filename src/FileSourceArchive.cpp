@@ -0,0 +1,305 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "FileSourceArchive.h"
+#include "utils.h"
+#include "jenkins/lookup3.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+
+extern "C" {
+#include "miniz/miniz.h"
+}
+
+#undef FT_FILE // TODO FileInfo::FT_FILE is conflicting with a FreeType def; undefine it for now
+
+namespace FileSystem {
+
+// Layout: header, entries, hash buckets, paths, then each file's data
+// starting on a page boundary. Everything is little endian, and read in
+// place, so a big endian machine rejects the version and uses the data
+// directory instead.
+//
+// Entry 0 is the root directory. A directory's children are the entries
+// from offset to offset+size, so a directory lists without a search.
+static const char ARCHIVE_MAGIC[4] = { 'P', 'G', 'A', 'R' };
+static const Uint32 ARCHIVE_VERSION = 2;
+static const Uint64 PAGE_SIZE = 4096;
+
+enum EntryFlags {
+	ENTRY_DIR     = 1,
+	ENTRY_DEFLATE = 2
+};
+
+struct ArchiveHeader {
+	char magic[4];
+	Uint32 version;
+	Uint32 numEntries;
+	Uint32 numBuckets; // a power of two
+	Uint64 entriesOffset;
+	Uint64 bucketsOffset;
+	Uint64 namesOffset;
+	Uint64 namesSize;
+	Uint64 sourceTime; // NewestModTime of what was packed
+};
+
+struct FileSourceArchive::Entry {
+	Uint64 offset;     // of the data, or a directory's first child
+	Uint64 size;       // unpacked, or a directory's number of children
+	Uint64 storedSize; // in the archive
+	Uint32 hash;       // of the path
+	Uint32 nameOffset; // the path, in the names
+	Uint32 nameLength;
+	Uint32 flags;
+};
+
+static Uint32 HashPath(const std::string &path)
+{
+	return lookup3_hashlittle(path.c_str(), path.size(), 0);
+}
+
+class FileDataMapped : public FileData {
+public:
+	FileDataMapped(const FileInfo &info, size_t size, const char *data, MappedFile *file):
+		FileData(info, size, const_cast<char*>(data)), m_file(file) {}
+private:
+	RefCountedPtr<MappedFile> m_file;
+};
+
+FileSourceArchive::FileSourceArchive(const std::string &archivePath, bool trusted) :
+	FileSource(archivePath, trusted),
+	m_entries(0),
+	m_buckets(0),
+	m_names(0),
+	m_numEntries(0),
+	m_numBuckets(0),
+	m_sourceTime(0)
+{
+	RefCountedPtr<MappedFile> file(MappedFile::Open(archivePath));
+	if (!file) return;
+
+	const char *data = file->GetData();
+	const Uint64 size = file->GetSize();
+	if (size < sizeof(ArchiveHeader)) {
+		Output("FileSourceArchive: '%s' is too short\n", archivePath.c_str());
+		return;
+	}
+
+	ArchiveHeader header;
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 || header.version != ARCHIVE_VERSION) {
+		Output("FileSourceArchive: '%s' is not a version %u archive\n", archivePath.c_str(), ARCHIVE_VERSION);
+		return;
+	}
+	if (header.numEntries == 0 || header.numBuckets == 0 || (header.numBuckets & (header.numBuckets - 1)) ||
+		header.entriesOffset % 8 || header.bucketsOffset % 4 ||
+		header.entriesOffset + Uint64(header.numEntries) * sizeof(Entry) > size ||
+		header.bucketsOffset + Uint64(header.numBuckets) * sizeof(Uint32) > size ||
+		header.namesOffset + header.namesSize > size) {
+		Output("FileSourceArchive: '%s' is damaged\n", archivePath.c_str());
+		return;
+	}
+
+	m_entries = reinterpret_cast<const Entry*>(data + header.entriesOffset);
+	m_buckets = reinterpret_cast<const Uint32*>(data + header.bucketsOffset);
+	m_names = data + header.namesOffset;
+	m_numEntries = header.numEntries;
+	m_numBuckets = header.numBuckets;
+	m_sourceTime = header.sourceTime;
+
+	for (Uint32 i = 0; i < m_numEntries; i++) {
+		const Entry &e = m_entries[i];
+		const bool bad = (Uint64(e.nameOffset) + e.nameLength > header.namesSize) ||
+			((e.flags & ENTRY_DIR) ? (e.offset + e.size > m_numEntries) : (e.offset + e.storedSize > size));
+		if (bad) {
+			Output("FileSourceArchive: '%s' is damaged\n", archivePath.c_str());
+			m_entries = 0;
+			return;
+		}
+	}
+
+	m_file = file;
+}
+
+FileSourceArchive::~FileSourceArchive()
+{
+}
+
+const FileSourceArchive::Entry *FileSourceArchive::FindEntry(const std::string &path) const
+{
+	if (!m_file) return 0;
+	const std::string normPath = NormalisePath(path);
+	const Uint32 hash = HashPath(normPath);
+	for (Uint32 b = hash & (m_numBuckets - 1); m_buckets[b]; b = (b + 1) & (m_numBuckets - 1)) {
+		const Entry &e = m_entries[m_buckets[b] - 1];
+		if (e.hash == hash && e.nameLength == normPath.size() &&
+			memcmp(m_names + e.nameOffset, normPath.c_str(), e.nameLength) == 0)
+			return &e;
+	}
+	return 0;
+}
+
+std::string FileSourceArchive::EntryPath(const Entry &e) const
+{
+	return std::string(m_names + e.nameOffset, e.nameLength);
+}
+
+FileInfo FileSourceArchive::EntryInfo(const Entry &e)
+{
+	return MakeFileInfo(EntryPath(e), (e.flags & ENTRY_DIR) ? FileInfo::FT_DIR : FileInfo::FT_FILE);
+}
+
+FileInfo FileSourceArchive::Lookup(const std::string &path)
+{
+	const Entry *e = FindEntry(path);
+	if (!e) return MakeFileInfo(path, FileInfo::FT_NON_EXISTENT);
+	return EntryInfo(*e);
+}
+
+RefCountedPtr<FileData> FileSourceArchive::ReadFile(const std::string &path)
+{
+	const Entry *e = FindEntry(path);
+	if (!e || (e->flags & ENTRY_DIR))
+		return RefCountedPtr<FileData>();
+
+	const char *stored = m_file->GetData() + e->offset;
+	if (!(e->flags & ENTRY_DEFLATE))
+		return RefCountedPtr<FileData>(new FileDataMapped(EntryInfo(*e), e->size, stored, m_file.Get()));
+
+	char *data = static_cast<char*>(std::malloc(e->size));
+	if (tinfl_decompress_mem_to_mem(data, e->size, stored, e->storedSize, 0) != e->size) {
+		Output("FileSourceArchive::ReadFile: couldn't inflate '%s'\n", path.c_str());
+		std::free(data);
+		return RefCountedPtr<FileData>();
+	}
+	return RefCountedPtr<FileData>(new FileDataMalloc(EntryInfo(*e), e->size, data));
+}
+
+bool FileSourceArchive::ReadDirectory(const std::string &path, std::vector<FileInfo> &output)
+{
+	const Entry *e = FindEntry(path);
+	if (!e || !(e->flags & ENTRY_DIR))
+		return false;
+
+	for (Uint64 i = e->offset; i < e->offset + e->size; i++)
+		output.push_back(EntryInfo(m_entries[i]));
+	return true;
+}
+
+static Uint64 AlignUp(Uint64 x, Uint64 align)
+{
+	return (x + align - 1) / align * align;
+}
+
+static bool WriteAt(FILE *out, Uint64 pos, const void *data, size_t size)
+{
+	return fseek(out, long(pos), SEEK_SET) == 0 && (size == 0 || fwrite(data, size, 1, out) == 1);
+}
+
+bool PackArchive(FileSource &source, FILE *out, Uint64 sourceTime, bool compress)
+{
+	typedef FileSourceArchive::Entry Entry;
+
+	// directories breadth first, each one's children together
+	std::vector<FileInfo> infos;
+	std::vector<Entry> entries;
+	std::string names;
+	{
+		Entry root;
+		memset(&root, 0, sizeof(root));
+		root.flags = ENTRY_DIR;
+		root.hash = HashPath("");
+		entries.push_back(root);
+		infos.push_back(FileInfo());
+	}
+	std::deque<std::pair<Uint32, std::string> > dirs;
+	dirs.push_back(std::make_pair(0u, std::string()));
+	while (!dirs.empty()) {
+		const Uint32 parent = dirs.front().first;
+		std::vector<FileInfo> children;
+		source.ReadDirectory(dirs.front().second, children);
+		dirs.pop_front();
+		std::sort(children.begin(), children.end());
+
+		entries[parent].offset = entries.size();
+		for (std::vector<FileInfo>::const_iterator it = children.begin(); it != children.end(); ++it) {
+			if (!it->IsDir() && !it->IsFile()) continue;
+			Entry e;
+			memset(&e, 0, sizeof(e));
+			e.flags = it->IsDir() ? ENTRY_DIR : 0;
+			e.hash = HashPath(it->GetPath());
+			e.nameOffset = names.size();
+			e.nameLength = it->GetPath().size();
+			names += it->GetPath();
+			if (it->IsDir())
+				dirs.push_back(std::make_pair(Uint32(entries.size()), it->GetPath()));
+			entries.push_back(e);
+			infos.push_back(*it);
+		}
+		entries[parent].size = entries.size() - entries[parent].offset;
+	}
+
+	Uint32 numBuckets = 1;
+	while (numBuckets < entries.size() * 2) numBuckets <<= 1;
+	std::vector<Uint32> buckets(numBuckets, 0);
+	for (Uint32 i = 0; i < entries.size(); i++) {
+		Uint32 b = entries[i].hash & (numBuckets - 1);
+		while (buckets[b]) b = (b + 1) & (numBuckets - 1);
+		buckets[b] = i + 1;
+	}
+
+	ArchiveHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+	header.version = ARCHIVE_VERSION;
+	header.numEntries = entries.size();
+	header.numBuckets = numBuckets;
+	header.entriesOffset = AlignUp(sizeof(header), 8);
+	header.bucketsOffset = header.entriesOffset + entries.size() * sizeof(Entry);
+	header.namesOffset = header.bucketsOffset + buckets.size() * sizeof(Uint32);
+	header.namesSize = names.size();
+	header.sourceTime = sourceTime;
+
+	// the files, then the index once their places are known
+	Uint64 pos = AlignUp(header.namesOffset + header.namesSize, PAGE_SIZE);
+	std::vector<char> packed;
+	for (Uint32 i = 0; i < entries.size(); i++) {
+		Entry &e = entries[i];
+		if (e.flags & ENTRY_DIR) continue;
+
+		RefCountedPtr<FileData> data = source.ReadFile(infos[i].GetPath());
+		if (!data) {
+			Output("PackArchive: couldn't read '%s'\n", infos[i].GetPath().c_str());
+			return false;
+		}
+		const char *stored = data->GetData();
+		e.size = e.storedSize = data->GetSize();
+		if (compress && e.size > 0) {
+			// only if it saves at least a quarter
+			packed.resize(e.size * 3 / 4 + 1);
+			const size_t packedSize = tdefl_compress_mem_to_mem(&packed[0], packed.size(), stored, e.size, TDEFL_DEFAULT_MAX_PROBES);
+			if (packedSize > 0) {
+				e.flags |= ENTRY_DEFLATE;
+				e.storedSize = packedSize;
+				stored = &packed[0];
+			}
+		}
+
+		e.offset = pos;
+		if (!WriteAt(out, pos, stored, e.storedSize)) return false;
+		pos = AlignUp(pos + e.storedSize, PAGE_SIZE);
+	}
+	// pad the last one out, so the file is a whole number of pages
+	if (fseek(out, long(pos - 1), SEEK_SET) != 0 || fputc(0, out) == EOF) return false;
+
+	return WriteAt(out, 0, &header, sizeof(header)) &&
+		WriteAt(out, header.entriesOffset, &entries[0], entries.size() * sizeof(Entry)) &&
+		WriteAt(out, header.bucketsOffset, &buckets[0], buckets.size() * sizeof(Uint32)) &&
+		WriteAt(out, header.namesOffset, names.data(), names.size()) &&
+		fflush(out) == 0;
+}
+
+}
@@ -0,0 +1,89 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _FILESOURCEARCHIVE_H
+#define _FILESOURCEARCHIVE_H
+
+#include "FileSystem.h"
+#include <SDL_stdinc.h>
+#include <cstdio>
+#include <string>
+
+/*
+ * A game data archive: every file under a source packed into one, with a
+ * hash table of the paths. The file is mapped into memory, and files
+ * stored uncompressed are read straight out of the mapping with no copy.
+ * Text compresses well, so by default files that deflate to three
+ * quarters of their size or less are stored that way and inflated as
+ * they're read.
+ *
+ * Built with "paragon -packdata" (or "make packdata"), which packs the
+ * data directory into data.pak next to it. If that's there it's used in
+ * place of the data directory; files in the user's data directory still
+ * take priority over both. Anything in the data directory changed since it
+ * was packed makes it out of date, and the directory is used instead.
+ */
+
+namespace FileSystem {
+
+	// a whole file mapped read only, kept for as long as anything read from
+	// it is. In FileSystem{Posix,Win32}.cpp
+	class MappedFile : public RefCounted {
+	public:
+		static MappedFile *Open(const std::string &path); //0 if it can't be
+		~MappedFile();
+
+		const char *GetData() const { return m_data; }
+		size_t GetSize() const { return m_size; }
+
+	private:
+		MappedFile(const char *data, size_t size, void *handle): m_data(data), m_size(size), m_handle(handle) {}
+
+		const char *m_data;
+		size_t m_size;
+		void *m_handle;
+	};
+
+	// the last time anything at or under path changed, in seconds since
+	// 1970, or 0 if it isn't there. In FileSystem{Posix,Win32}.cpp
+	Uint64 NewestModTime(const std::string &path);
+
+	// packs everything under source into out, noting sourceTime (from
+	// NewestModTime, taken before packing) as when it was packed from.
+	// Returns false if a file couldn't be read or out couldn't be written
+	bool PackArchive(FileSource &source, FILE *out, Uint64 sourceTime, bool compress = true);
+
+	class FileSourceArchive : public FileSource {
+	public:
+		// trusted as the data it's packed from would be
+		explicit FileSourceArchive(const std::string &archivePath, bool trusted = false);
+		virtual ~FileSourceArchive();
+
+		bool IsOpen() const { return m_file.Valid(); }
+		// what it was packed from was last changed then. If what's there
+		// now was changed since, the archive is out of date
+		Uint64 GetSourceTime() const { return m_sourceTime; }
+
+		virtual FileInfo Lookup(const std::string &path);
+		virtual RefCountedPtr<FileData> ReadFile(const std::string &path);
+		virtual bool ReadDirectory(const std::string &path, std::vector<FileInfo> &output);
+
+	private:
+		friend bool PackArchive(FileSource &source, FILE *out, Uint64 sourceTime, bool compress);
+		struct Entry;
+		const Entry *FindEntry(const std::string &path) const;
+		std::string EntryPath(const Entry &e) const;
+		FileInfo EntryInfo(const Entry &e);
+
+		RefCountedPtr<MappedFile> m_file;
+		const Entry *m_entries;
+		const Uint32 *m_buckets;
+		const char *m_names;
+		Uint32 m_numEntries;
+		Uint32 m_numBuckets;
+		Uint64 m_sourceTime;
+	};
+
+} // namespace FileSystem
+
+#endif
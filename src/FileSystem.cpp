@@ -3,6 +3,8 @@
 
 #include "libs.h"
 #include "FileSystem.h"
+#include "FileSourceArchive.h"
+#include "utils.h"
 #include "StringRange.h"
 #include <cassert>
 #include <sstream>
@@ -16,6 +18,7 @@ namespace FileSystem {
 
 	static FileSourceFS dataFilesApp(GetDataDir(), true);
 	static FileSourceFS dataFilesUser(JoinPath(GetUserDir(), "data"));
+	static std::unique_ptr<FileSourceArchive> dataArchive;
 	FileSourceUnion gameDataFiles;
 	FileSourceFS userFiles(GetUserDir());
 
@@ -124,11 +127,33 @@ namespace FileSystem {
 	void Init()
 	{
 		gameDataFiles.AppendSource(&dataFilesUser);
-		gameDataFiles.AppendSource(&dataFilesApp);
+		// the packed data, if it's been built, stands in for the data dir
+		// unless anything in there has changed since
+		dataArchive.reset(new FileSourceArchive(GetDataDir() + ".pak", dataFilesApp.IsTrusted()));
+		if (!dataArchive->IsOpen()) {
+			dataArchive.reset();
+		} else {
+			const Uint64 dataTime = NewestModTime(GetDataDir());
+			if (dataTime && dataTime != dataArchive->GetSourceTime()) {
+				Output("'%s' is out of date, using '%s' instead. Rebuild it with \"paragon -packdata\"\n",
+					dataArchive->GetRoot().c_str(), GetDataDir().c_str());
+				dataArchive.reset();
+			}
+		}
+
+		if (dataArchive) {
+			Output("Using packed game data from '%s'\n", dataArchive->GetRoot().c_str());
+			gameDataFiles.AppendSource(dataArchive.get());
+		} else
+			gameDataFiles.AppendSource(&dataFilesApp);
 	}
 
 	void Uninit()
 	{
+		if (dataArchive) {
+			gameDataFiles.RemoveSource(dataArchive.get());
+			dataArchive.reset();
+		}
 	}
 
 	FileInfo::FileInfo(FileSource *source, const std::string &path, FileType type):
@@ -6,10 +6,72 @@
 #include "Space.h"
 #include "collider/collider.h"
 #include "Sfx.h"
+#include "Projectile.h"
 #include "galaxy/StarSystem.h"
 #include "Pi.h"
 #include "Game.h"
 #include <algorithm>
+#include <atomic>
+
+// Frame to frame transforms get asked for over and over for the same few
+// pairs of frames (bodies' frames and the camera's, a ship's and its
+// target's), so they're kept in a small table until the frames next move.
+// The AI thinks on job threads, so entries are seqlocked: a hit writes
+// nothing and a miss only fills its entry if no one else is right then.
+namespace {
+	static const int TRANSFORM_CACHE_BITS = 8;
+
+	struct TransformCacheEntry {
+		std::atomic<Uint32> seq;	// odd while being written
+		const Frame *from;
+		const Frame *to;
+		Uint32 epoch;
+		matrix3x3d orient;
+		vector3d pos;
+	};
+
+	struct TransformCache {
+		TransformCacheEntry entries[1 << TRANSFORM_CACHE_BITS];
+		// moved on whenever any frame does, which makes every entry stale
+		std::atomic<Uint32> epoch;
+
+		TransformCacheEntry &Entry(const Frame *from, const Frame *to) {
+			const Uint32 a = Uint32(reinterpret_cast<uintptr_t>(from) >> 4);
+			const Uint32 b = Uint32(reinterpret_cast<uintptr_t>(to) >> 4);
+			return entries[((a * 2654435761u) ^ (b * 40503u)) >> (32 - TRANSFORM_CACHE_BITS)];
+		}
+
+		bool Lookup(const Frame *from, const Frame *to, matrix3x3d &orient, vector3d &pos) {
+			TransformCacheEntry &e = Entry(from, to);
+			const Uint32 seq = e.seq.load(std::memory_order_acquire);
+			if (seq & 1) return false;
+			const bool match = e.from == from && e.to == to && e.epoch == epoch.load(std::memory_order_relaxed);
+			orient = e.orient;
+			pos = e.pos;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			return match && e.seq.load(std::memory_order_relaxed) == seq;
+		}
+
+		void Store(const Frame *from, const Frame *to, const matrix3x3d &orient, const vector3d &pos) {
+			TransformCacheEntry &e = Entry(from, to);
+			Uint32 seq = e.seq.load(std::memory_order_relaxed);
+			if ((seq & 1) || !e.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) return;
+			std::atomic_thread_fence(std::memory_order_release);
+			e.from = from;
+			e.to = to;
+			e.epoch = epoch.load(std::memory_order_relaxed);
+			e.orient = orient;
+			e.pos = pos;
+			e.seq.store(seq + 2, std::memory_order_release);
+		}
+
+		void Invalidate() { epoch.fetch_add(1, std::memory_order_relaxed); }
+	};
+
+	// static storage, so the seqs and epoch start at zero
+	static TransformCache s_transformCache;
+	static TransformCache s_interpTransformCache;
+}
 
 Frame::Frame()
 {
@@ -40,6 +102,7 @@ void Frame::Serialize(Serializer::Writer &wr, Frame *f, Space *space)
 	for (Frame* kid : f->GetChildren())
 		Serialize(wr, kid, space);
 	Sfx::Serialize(wr, f);
+	Projectile::Serialize(wr, f, space);
 }
 
 Frame *Frame::Unserialize(Serializer::Reader &rd, Space *space, Frame *parent, double at_time)
@@ -61,6 +124,8 @@ Frame *Frame::Unserialize(Serializer::Reader &rd, Space *space, Frame *parent, d
 		f->m_children.push_back(Unserialize(rd, space, f, at_time));
 	}
 	Sfx::Unserialize(rd, f);
+	if (Game::s_loadedGameVersion >= 82)
+		Projectile::Unserialize(rd, f);
 
 	f->ClearMovement();
 	return f;
@@ -70,6 +135,7 @@ void Frame::PostUnserializeFixup(Frame *f, Space *space)
 {
 	f->UpdateRootRelativeVars();
 	f->m_astroBody = space->GetBodyByIndex(f->m_astroBodyIndex);
+	Projectile::PostUnserializeFixup(f, space);
 	for (Frame* kid : f->GetChildren())
 		PostUnserializeFixup(kid, space);
 }
@@ -77,6 +143,7 @@ void Frame::PostUnserializeFixup(Frame *f, Space *space)
 void Frame::Init(Frame *parent, const char *label, unsigned int flags)
 {
 	m_sfx = 0;
+	m_projectiles = 0;
 	m_sbody = 0;
 	m_astroBody = 0;
 	m_parent = parent;
@@ -95,7 +162,11 @@ void Frame::Init(Frame *parent, const char *label, unsigned int flags)
 
 Frame::~Frame()
 {
-	if (m_sfx) delete [] m_sfx;
+	// another frame could turn up at the same address
+	s_transformCache.Invalidate();
+	s_interpTransformCache.Invalidate();
+	delete m_sfx;
+	delete m_projectiles;
 	delete m_collisionSpace;
 	for (Frame* kid : m_children)
 		delete kid;
@@ -157,13 +228,19 @@ vector3d Frame::GetInterpPositionRelTo(const Frame *relTo) const
 matrix3x3d Frame::GetOrientRelTo(const Frame *relTo) const
 {
 	if (this == relTo) return matrix3x3d::Identity();
-	return relTo->m_rootOrient.Transpose() * m_rootOrient;
+	matrix3x3d orient;
+	vector3d pos;
+	GetTransformRelTo(relTo, orient, pos);
+	return orient;
 }
 
 matrix3x3d Frame::GetInterpOrientRelTo(const Frame *relTo) const
 {
 	if (this == relTo) return matrix3x3d::Identity();
-	return relTo->m_rootInterpOrient.Transpose() * m_rootInterpOrient;
+	matrix3x3d orient;
+	vector3d pos;
+	GetInterpTransformRelTo(relTo, orient, pos);
+	return orient;
 /*	if (IsRotFrame()) {
 		if (relTo->IsRotFrame()) return m_interpOrient * relTo->m_interpOrient.Transpose();
 		else return m_interpOrient;
@@ -173,9 +250,46 @@ matrix3x3d Frame::GetInterpOrientRelTo(const Frame *relTo) const
 */
 }
 
+void Frame::CalcTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const
+{
+	orient = relTo->m_rootOrient.Transpose() * m_rootOrient;
+	pos = GetPositionRelTo(relTo);
+}
+
+void Frame::CalcInterpTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const
+{
+	orient = relTo->m_rootInterpOrient.Transpose() * m_rootInterpOrient;
+	pos = GetInterpPositionRelTo(relTo);
+}
+
+void Frame::GetTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const
+{
+	if (this == relTo) {
+		orient = matrix3x3d::Identity();
+		pos = vector3d(0.0);
+		return;
+	}
+	if (s_transformCache.Lookup(this, relTo, orient, pos)) return;
+	CalcTransformRelTo(relTo, orient, pos);
+	s_transformCache.Store(this, relTo, orient, pos);
+}
+
+void Frame::GetInterpTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const
+{
+	if (this == relTo) {
+		orient = matrix3x3d::Identity();
+		pos = vector3d(0.0);
+		return;
+	}
+	if (s_interpTransformCache.Lookup(this, relTo, orient, pos)) return;
+	CalcInterpTransformRelTo(relTo, orient, pos);
+	s_interpTransformCache.Store(this, relTo, orient, pos);
+}
+
 void Frame::UpdateInterpTransform(double alpha)
 {
 	PROFILE_SCOPED()
+	s_interpTransformCache.Invalidate();
 	m_interpPos = alpha*m_pos + (1.0-alpha)*m_oldPos;
 
 	double len = m_oldAngDisplacement * (1.0-alpha);
@@ -198,8 +312,9 @@ void Frame::UpdateInterpTransform(double alpha)
 
 void Frame::GetFrameTransform(const Frame *fFrom, const Frame *fTo, matrix4x4d &m)
 {
-	matrix3x3d forient = fFrom->GetOrientRelTo(fTo);
-	vector3d fpos = fFrom->GetPositionRelTo(fTo);
+	matrix3x3d forient;
+	vector3d fpos;
+	fFrom->GetTransformRelTo(fTo, forient, fpos);
 	m = forient; m.SetTranslate(fpos);
 }
 
@@ -217,6 +332,7 @@ void Frame::ClearMovement()
 	m_oldPos = m_interpPos = m_pos;
 	m_interpOrient = m_orient;
 	m_oldAngDisplacement = 0.0;
+	s_interpTransformCache.Invalidate();
 }
 
 void Frame::UpdateOrbitRails(double time, double timestep)
@@ -269,6 +385,7 @@ void Frame::SetOrient(const matrix3x3d &m, double time) {
 
 void Frame::UpdateRootRelativeVars()
 {
+	s_transformCache.Invalidate();
 	// update pos & vel relative to parent frame
 	if (!m_parent) {
 		m_rootPos = m_rootVel = vector3d(0,0,0);
@@ -14,7 +14,8 @@ class Body;
 class CollisionSpace;
 class Geom;
 class SystemBody;
-class Sfx;
+struct SfxPool;
+struct ProjectilePool;
 class Space;
 
 // Frame of reference.
@@ -89,14 +90,22 @@ public:
 	vector3d GetInterpPositionRelTo(const Frame *relTo) const;
 	matrix3x3d GetInterpOrientRelTo(const Frame *relTo) const;
 
+	// Orientation and position relative to relTo together. Kept from one
+	// call to the next until the frames move, and safe from any thread
+	void GetTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const;
+	void GetInterpTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const;
+
 	static void GetFrameTransform(const Frame *fFrom, const Frame *fTo, matrix4x4d &m);
 	static void GetRotFrameTransform(const Frame *fFrom, const Frame *fTo, matrix4x4d &m);
 
-	Sfx *m_sfx;			// the last survivor. actually m_children is pretty grim too.
+	SfxPool *m_sfx;		// the last survivor. actually m_children is pretty grim too.
+	ProjectilePool *m_projectiles;	// laser bolts in flight, see Projectile.h
 
 private:
 	void Init(Frame *parent, const char *label, unsigned int flags);
 	void UpdateRootRelativeVars();
+	void CalcTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const;
+	void CalcInterpTransformRelTo(const Frame *relTo, matrix3x3d &orient, vector3d &pos) const;
 
 	Frame *m_parent;				// if parent is null then frame position is absolute
 	std::vector<Frame*> m_children;	// child frames, first may be rotating
@@ -369,8 +369,10 @@ bool Game::UpdateTimeAccel()
 				double dist = toBody.Length();
 				double rad = b->GetPhysRadius();
 
+				// swept collisions stop long steps going through things,
+				// so close by only needs to be slow enough to fly
 				if (dist < 1000.0) {
-					newTimeAccel = std::min(newTimeAccel, Game::TIMEACCEL_1X);
+					newTimeAccel = std::min(newTimeAccel, Game::TIMEACCEL_10X);
 				} else if (dist < std::min(rad+0.0001*AU, rad*1.1)) {
 					newTimeAccel = std::min(newTimeAccel, Game::TIMEACCEL_10X);
 				} else if (dist < std::min(rad+0.001*AU, rad*5.0)) {
@@ -13,11 +13,14 @@ GameConfig::GameConfig(const std::map<std::string,std::string> &override_)
 	map["Lang"] = "en";
 	map["DisableEclipse"] = "0";
 	map["DisableSound"] = "0";
+	map["MaxDecodedSoundMB"] = "32";
+	map["CacheDecodedSound"] = "1";
 	map["StartFullscreen"] = "0";
 	map["ScrWidth"] = "1280";
 	map["ScrHeight"] = "720";
 	map["DetailCities"] = "1";
 	map["DetailPlanets"] = "1";
+	map["ImpostorPixelRadius"] = "12";
 	map["SfxVolume"] = "0.8";
 	map["EnableJoystick"] = "1";
 	map["InvertMouseY"] = "0";
@@ -32,6 +35,7 @@ GameConfig::GameConfig(const std::map<std::string,std::string> &override_)
 	map["SectorViewZRotation"] = "0";
 	map["SectorViewZoom"] = "2.0";
 	map["MaxPhysicsCyclesPerRender"] = "4";
+	map["MaxPhysicsStepsPerCycle"] = "16";
 	map["AntiAliasingMode"] = "2";
 	map["JoystickDeadzone"] = "0.1";
 	map["DefaultLowThrustPower"] = "0.25";
@@ -15,6 +15,7 @@
 #include "graphics/Graphics.h"
 #include "graphics/VertexArray.h"
 #include "MathUtil.h"
+#include "TerrainHeightCache.h"
 #include "vcacheopt/vcacheopt.h"
 #include <deque>
 #include <algorithm>
@@ -27,7 +28,7 @@ GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
 	const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_,
 	const int depth, const GeoPatchID &ID_)
 	: ctx(ctx_), v0(v0_), v1(v1_), v2(v2_), v3(v3_),
-	heights(nullptr), normals(nullptr), colors(nullptr),
+	heights(nullptr), vertices(nullptr),
 	parent(nullptr), geosphere(gs),
 	m_depth(depth), mPatchID(ID_),
 	mHasJobRequest(false)
@@ -43,6 +44,7 @@ GeoPatch::GeoPatch(const RefCountedPtr<GeoPatchContext> &ctx_, GeoSphere *gs,
 	clipRadius = std::max(clipRadius, (v1-clipCentroid).Length());
 	clipRadius = std::max(clipRadius, (v2-clipCentroid).Length());
 	clipRadius = std::max(clipRadius, (v3-clipCentroid).Length());
+	heightError = 0.0;
 	double distMult;
 	if (geosphere->m_sbody->GetType() < SystemBody::TYPE_PLANET_ASTEROID) {
  		distMult = 10.0 / Clamp(depth, 1, 10);
@@ -63,8 +65,7 @@ GeoPatch::~GeoPatch() {
 		kids[i].reset();
 	}
 	heights.reset();
-	normals.reset();
-	colors.reset();
+	vertices.reset();
 }
 
 void GeoPatch::_UpdateVBOs(Graphics::Renderer *renderer) 
@@ -76,9 +77,9 @@ void GeoPatch::_UpdateVBOs(Graphics::Renderer *renderer)
 		//create buffer and upload data
 		Graphics::VertexBufferDesc vbd;
 		vbd.attrib[0].semantic = Graphics::ATTRIB_POSITION;
-		vbd.attrib[0].format   = Graphics::ATTRIB_FORMAT_FLOAT4;
+		vbd.attrib[0].format   = Graphics::ATTRIB_FORMAT_SHORT4;
 		vbd.attrib[1].semantic = Graphics::ATTRIB_NORMAL;
-		vbd.attrib[1].format   = Graphics::ATTRIB_FORMAT_FLOAT4;
+		vbd.attrib[1].format   = Graphics::ATTRIB_FORMAT_BYTE4;
 		vbd.attrib[2].semantic = Graphics::ATTRIB_DIFFUSE;
 		vbd.attrib[2].format   = Graphics::ATTRIB_FORMAT_UBYTE4;
 		vbd.numVertices = ctx->NUMVERTICES();
@@ -95,36 +96,8 @@ void GeoPatch::_UpdateVBOs(Graphics::Renderer *renderer)
 			return;
 		}
 
-		const Sint32 edgeLen = ctx->edgeLen;
-		const double frac = ctx->frac;
-		const double *pHts = heights.get();
-		const vector3f *pNorm = normals.get();
-		const Color3ub *pColr = colors.get();
-		for (Sint32 y=0; y<edgeLen; y++) {
-			for (Sint32 x=0; x<edgeLen; x++) {
-				const double height = *pHts;
-				const double xFrac = double(x)*frac;
-				const double yFrac = double(y)*frac;
-				const vector3d p((GetSpherePoint(xFrac, yFrac) * (height + 1.0)) - clipCentroid);
-				clipRadius = std::max(clipRadius, p.Length());
-				vtxPtr->pos = vector3f(p);
-				vtxPtr->pos.w = 1.0f;
-				++pHts;	// next height
-
-				const vector3f norma(pNorm->Normalized());
-				vtxPtr->norm = norma;
-				vtxPtr->norm.w = 0.0f;
-				++pNorm; // next normal
-
-				vtxPtr->col[0] = pColr->r;
-				vtxPtr->col[1] = pColr->g;
-				vtxPtr->col[2] = pColr->b;
-				vtxPtr->col[3] = 255;
-				++pColr; // next colour
-
-				++vtxPtr; // next vertex
-			}
-		}
+		// the split job packed them already
+		memcpy(vtxPtr, vertices.get(), sizeof(GeoPatchContext::VBOVertex) * ctx->NUMVERTICES());
 		m_vertexBuffer->Unmap();
 	}
 }
@@ -142,7 +115,9 @@ void GeoPatch::Render(Graphics::Renderer *renderer, const vector3d &campos, cons
 		Graphics::RenderState *rs = geosphere->m_surfRenderState;
 
 		const vector3d relpos = clipCentroid - campos;
-		renderer->SetTransform(modelView * matrix4x4d::Translation(relpos));
+		// vertex positions are in steps of clipRadius/VBO_POS_RANGE
+		const double posScale = clipRadius / double(GeoPatchContext::VBO_POS_RANGE);
+		renderer->SetTransform(modelView * matrix4x4d::Translation(relpos) * matrix4x4d::ScaleMatrix(posScale));
 
 		Pi::statSceneTris += 2*(ctx->edgeLen-1)*(ctx->edgeLen-1);
 
@@ -203,6 +178,30 @@ void GeoPatch::LODUpdate(const vector3d &campos) {
 	}
 }
 
+bool GeoPatch::SampleHeight(const vector3d &dir, double maxError, double &height) const
+{
+	double x, y;
+	if (!TerrainHeights::PatchCoords(v0, v1, v2, v3, dir, x, y))
+		return false;
+
+	if (kids[0]) {
+		// the kid for the quarter it's in, unless it's right on the edge
+		// between them, and kids split off the surface coords near enough
+		const int guess = (y < 0.5) ? (x < 0.5 ? 0 : 1) : (x < 0.5 ? 3 : 2);
+		if (kids[guess]->SampleHeight(dir, maxError, height))
+			return true;
+		for (int i=0; i<NUM_KIDS; i++) {
+			if (i != guess && kids[i]->SampleHeight(dir, maxError, height))
+				return true;
+		}
+	}
+
+	if (!heights || heightError > maxError)
+		return false;
+	height = TerrainHeights::Sample(heights.get(), ctx->edgeLen, x, y);
+	return true;
+}
+
 void GeoPatch::RequestSinglePatch()
 {
 	if( !heights ) {
@@ -264,8 +263,9 @@ void GeoPatch::ReceiveHeightmaps(SQuadSplitResult *psr)
 		{
 			const SQuadSplitResult::SSplitResultData& data = psr->data(i);
 			kids[i]->heights.reset(data.heights);
-			kids[i]->normals.reset(data.normals);
-			kids[i]->colors.reset(data.colors);
+			kids[i]->vertices.reset(data.vertices);
+			kids[i]->clipRadius = data.clipRadius;
+			kids[i]->heightError = data.heightError;
 		}
 		for (int i=0; i<NUM_EDGES; i++) { if(edgeFriend[i]) edgeFriend[i]->NotifyEdgeFriendSplit(this); }
 		for (int i=0; i<NUM_KIDS; i++) {
@@ -283,8 +283,9 @@ void GeoPatch::ReceiveHeightmap(const SSingleSplitResult *psr)
 	{
 		const SSingleSplitResult::SSplitResultData& data = psr->data();
 		heights.reset(data.heights);
-		normals.reset(data.normals);
-		colors.reset(data.colors);
+		vertices.reset(data.vertices);
+		clipRadius = data.clipRadius;
+		heightError = data.heightError;
 	}
 	mHasJobRequest = false;
 }
@@ -12,6 +12,7 @@
 #include "graphics/Material.h"
 #include "terrain/Terrain.h"
 #include "GeoPatchID.h"
+#include "GeoPatchContext.h"
 #include "JobQueue.h"
 
 #include <deque>
@@ -32,8 +33,7 @@ public:
 	RefCountedPtr<GeoPatchContext> ctx;
 	const vector3d v0, v1, v2, v3;
 	std::unique_ptr<double[]> heights;
-	std::unique_ptr<vector3f[]> normals;
-	std::unique_ptr<Color3ub[]> colors;
+	std::unique_ptr<GeoPatchContext::VBOVertex[]> vertices;	// packed by the split job
 	std::unique_ptr<Graphics::VertexBuffer> m_vertexBuffer;
 	std::unique_ptr<GeoPatch> kids[NUM_KIDS];
 	GeoPatch *parent;
@@ -42,6 +42,7 @@ public:
 	double m_roughLength;
 	vector3d clipCentroid, centroid;
 	double clipRadius;
+	double heightError;		// how far heights may be off between samples, in planet radii
 	Sint32 m_depth;
 	bool m_needUpdateVBOs;
 
@@ -133,6 +134,11 @@ public:
 
 	void LODUpdate(const vector3d &campos);
 
+	// Height (in planet radii) in direction dir from the finest heightmap
+	// under it that's within maxError of the real terrain. false if dir
+	// isn't on this patch or nothing generated so far is good enough
+	bool SampleHeight(const vector3d &dir, double maxError, double &height) const;
+
 	void RequestSinglePatch();
 	void ReceiveHeightmaps(SQuadSplitResult *psr);
 	void ReceiveHeightmap(const SSingleSplitResult *psr);
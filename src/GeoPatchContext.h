@@ -28,14 +28,18 @@ class GeoSphere;
 
 class GeoPatchContext : public RefCounted {
 public:
+	// 16 bytes a vertex. Position is relative to the patch's clipCentroid, in
+	// steps of clipRadius/VBO_POS_RANGE; GeoPatch::Render puts that scale in
+	// the modelview, so shaders see ordinary patch space coordinates.
 	#pragma pack(push, 4)
 	struct VBOVertex
 	{
-		vector4f pos;
-		vector4f norm;
+		Sint16 pos[4];	// xyz, w is always 1
+		Sint8 norm[4];	// xyz of the unit normal, * 127
 		Color4ub col;
 	};
 	#pragma pack(pop)
+	static const int VBO_POS_RANGE = 32767;
 
 	int edgeLen;
 
@@ -8,6 +8,7 @@
 #include "perlin.h"
 #include "Pi.h"
 #include "RefCounted.h"
+#include "TerrainHeightCache.h"
 
 inline void setColour(Color3ub &r, const vector3d &v) { 
 	r.r=static_cast<unsigned char>(Clamp(v.x*255.0, 0.0, 255.0)); 
@@ -82,6 +83,63 @@ void BasePatchJob::GenerateMesh(double *heights, vector3f *normals, Color3ub *co
 	assert(col==&colors[edgeLen*edgeLen]);
 }
 
+// Packs a generated mesh into the patch vertex buffer layout
+double BasePatchJob::PackVertices(GeoPatchContext::VBOVertex *vertices, const vector3f *normals, const Color3ub *colors,
+								const vector3d *borderVertexs,
+								const vector3d &v0,
+								const vector3d &v1,
+								const vector3d &v2,
+								const vector3d &v3,
+								const int edgeLen) const
+{
+	const int borderedEdgeLen = edgeLen+2;
+
+	// same centre and starting radius as GeoPatch works out for itself
+	const vector3d clipCentroid = (v0+v1+v2+v3) * 0.25;
+	double clipRadius = 0.0;
+	clipRadius = std::max(clipRadius, (v0-clipCentroid).Length());
+	clipRadius = std::max(clipRadius, (v1-clipCentroid).Length());
+	clipRadius = std::max(clipRadius, (v2-clipCentroid).Length());
+	clipRadius = std::max(clipRadius, (v3-clipCentroid).Length());
+
+	// the non-border vertices are the patch's own
+	for (int y=1; y<borderedEdgeLen-1; y++) {
+		for (int x=1; x<borderedEdgeLen-1; x++) {
+			const vector3d p = borderVertexs[x + y*borderedEdgeLen] - clipCentroid;
+			clipRadius = std::max(clipRadius, p.Length());
+		}
+	}
+
+	const double posScale = double(GeoPatchContext::VBO_POS_RANGE) / clipRadius;
+	GeoPatchContext::VBOVertex *vtx = vertices;
+	for (int y=1; y<borderedEdgeLen-1; y++) {
+		for (int x=1; x<borderedEdgeLen-1; x++) {
+			const vector3d p = (borderVertexs[x + y*borderedEdgeLen] - clipCentroid) * posScale;
+			vtx->pos[0] = Sint16(Clamp(floor(p.x + 0.5), -32767.0, 32767.0));
+			vtx->pos[1] = Sint16(Clamp(floor(p.y + 0.5), -32767.0, 32767.0));
+			vtx->pos[2] = Sint16(Clamp(floor(p.z + 0.5), -32767.0, 32767.0));
+			vtx->pos[3] = 1;
+
+			const vector3f n = normals->Normalized() * 127.0f;
+			vtx->norm[0] = Sint8(floor(n.x + 0.5f));
+			vtx->norm[1] = Sint8(floor(n.y + 0.5f));
+			vtx->norm[2] = Sint8(floor(n.z + 0.5f));
+			vtx->norm[3] = 0;
+			++normals;
+
+			vtx->col[0] = colors->r;
+			vtx->col[1] = colors->g;
+			vtx->col[2] = colors->b;
+			vtx->col[3] = 255;
+			++colors;
+
+			++vtx;
+		}
+	}
+	assert(vtx==&vertices[edgeLen*edgeLen]);
+	return clipRadius;
+}
+
 // ********************************************************************************
 // Overloaded PureJob class to handle generating the mesh for each patch
 // ********************************************************************************
@@ -99,12 +157,15 @@ void SinglePatchJob::OnRun()    // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	const SSingleSplitRequest &srd = *mData;
 
 	// fill out the data
-	GenerateMesh(srd.heights, srd.normals, srd.colors, srd.borderHeights.get(), srd.borderVertexs.get(),
+	GenerateMesh(srd.heights, srd.normals.get(), srd.colors.get(), srd.borderHeights.get(), srd.borderVertexs.get(),
 		srd.v0, srd.v1, srd.v2, srd.v3, 
 		srd.edgeLen, srd.fracStep, srd.pTerrain.Get());
+	const double clipRadius = PackVertices(srd.vertices, srd.normals.get(), srd.colors.get(), srd.borderVertexs.get(),
+		srd.v0, srd.v1, srd.v2, srd.v3, srd.edgeLen);
+	const double heightError = TerrainHeights::EstimateError(srd.heights, srd.edgeLen);
 	// add this patches data
 	SSingleSplitResult *sr = new SSingleSplitResult(srd.patchID.GetPatchFaceIdx(), srd.depth);
-	sr->addResult(srd.heights, srd.normals, srd.colors, 
+	sr->addResult(srd.heights, srd.vertices, clipRadius, heightError, 
 		srd.v0, srd.v1, srd.v2, srd.v3, 
 		srd.patchID.NextPatchID(srd.depth+1, 0));
 	// store the result
@@ -152,11 +213,14 @@ void QuadPatchJob::OnRun()    // RUNS IN ANOTHER THREAD!! MUST BE THREAD SAFE!
 	for (int i=0; i<4; i++)
 	{
 		// fill out the data
-		GenerateMesh(srd.heights[i], srd.normals[i], srd.colors[i], srd.borderHeights[i].get(), srd.borderVertexs[i].get(),
+		GenerateMesh(srd.heights[i], srd.normals[i].get(), srd.colors[i].get(), srd.borderHeights[i].get(), srd.borderVertexs[i].get(),
 			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], 
 			srd.edgeLen, srd.fracStep, srd.pTerrain.Get());
+		const double clipRadius = PackVertices(srd.vertices[i], srd.normals[i].get(), srd.colors[i].get(), srd.borderVertexs[i].get(),
+			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], srd.edgeLen);
+		const double heightError = TerrainHeights::EstimateError(srd.heights[i], srd.edgeLen);
 		// add this patches data
-		sr->addResult(i, srd.heights[i], srd.normals[i], srd.colors[i], 
+		sr->addResult(i, srd.heights[i], srd.vertices[i], clipRadius, heightError, 
 			vecs[i][0], vecs[i][1], vecs[i][2], vecs[i][3], 
 			srd.patchID.NextPatchID(srd.depth+1, i));
 	}
@@ -11,6 +11,7 @@
 #include "galaxy/StarSystem.h"
 #include "terrain/Terrain.h"
 #include "GeoPatchID.h"
+#include "GeoPatchContext.h"
 #include "JobQueue.h"
 
 class GeoSphere;
@@ -56,20 +57,22 @@ public:
 		for( int i=0 ; i<4 ; ++i )
 		{
 			heights[i] = new double[numVerts];
-			normals[i] = new vector3f[numVerts];
-			colors[i] = new Color3ub[numVerts];
+			vertices[i] = new GeoPatchContext::VBOVertex[numVerts];
 
+			normals[i].reset(new vector3f[numVerts]);
+			colors[i].reset(new Color3ub[numVerts]);
 			borderHeights[i].reset(new double[numBorderedVerts]);
 			borderVertexs[i].reset(new vector3d[numBorderedVerts]);
 		}
 	}
 
 	// these are created with the request and are given to the resulting patches
-	vector3f *normals[4];
-	Color3ub *colors[4];
+	GeoPatchContext::VBOVertex *vertices[4];
 	double *heights[4];
 
 	// these are created with the request but are destroyed when the request is finished
+	std::unique_ptr<vector3f[]> normals[4];
+	std::unique_ptr<Color3ub[]> colors[4];
 	std::unique_ptr<double[]> borderHeights[4];
 	std::unique_ptr<vector3d[]> borderVertexs[4];
 
@@ -87,22 +90,24 @@ public:
 	{
 		const int numVerts = NUMVERTICES(edgeLen_);
 		heights = new double[numVerts];
-		normals = new vector3f[numVerts];
-		colors = new Color3ub[numVerts];
-		
+		vertices = new GeoPatchContext::VBOVertex[numVerts];
+
+		normals.reset(new vector3f[numVerts]);
+		colors.reset(new Color3ub[numVerts]);
 		const int numBorderedVerts = NUMVERTICES(edgeLen_+2);
 		borderHeights.reset(new double[numBorderedVerts]);
 		borderVertexs.reset(new vector3d[numBorderedVerts]);
 	}
 
 	// these are created with the request and are given to the resulting patches
-	vector3f *normals;
-	Color3ub *colors;
+	GeoPatchContext::VBOVertex *vertices;
 	double *heights;
 
 	// these are created with the request but are destroyed when the request is finished
-	std::unique_ptr<double> borderHeights;
-	std::unique_ptr<vector3d> borderVertexs;
+	std::unique_ptr<vector3f[]> normals;
+	std::unique_ptr<Color3ub[]> colors;
+	std::unique_ptr<double[]> borderHeights;
+	std::unique_ptr<vector3d[]> borderVertexs;
 
 protected:
 	// deliberately prevent copy constructor access
@@ -112,17 +117,18 @@ protected:
 class SBaseSplitResult {
 public:
 	struct SSplitResultData {
-		SSplitResultData() : patchID(0) {}
-		SSplitResultData(double *heights_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_) :
-			heights(heights_), normals(n_), colors(c_), v0(v0_), v1(v1_), v2(v2_), v3(v3_), patchID(patchID_)
+		SSplitResultData() : heights(nullptr), vertices(nullptr), clipRadius(0.0), heightError(0.0), patchID(0) {}
+		SSplitResultData(double *heights_, GeoPatchContext::VBOVertex *vtx_, double clipRadius_, double heightError_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_) :
+			heights(heights_), vertices(vtx_), clipRadius(clipRadius_), heightError(heightError_), v0(v0_), v1(v1_), v2(v2_), v3(v3_), patchID(patchID_)
 		{}
 		SSplitResultData(const SSplitResultData &r) : 
-			normals(r.normals), colors(r.colors), v0(r.v0), v1(r.v1), v2(r.v2), v3(r.v3), patchID(r.patchID)
+			heights(r.heights), vertices(r.vertices), clipRadius(r.clipRadius), heightError(r.heightError), v0(r.v0), v1(r.v1), v2(r.v2), v3(r.v3), patchID(r.patchID)
 		{}
 
 		double *heights;
-		vector3f *normals;
-		Color3ub *colors;
+		GeoPatchContext::VBOVertex *vertices;	// ready to copy into the vertex buffer
+		double clipRadius;						// that the vertices were packed with
+		double heightError;						// see TerrainHeights::EstimateError
 		vector3d v0, v1, v2, v3;
 		GeoPatchID patchID;
 	};
@@ -150,10 +156,10 @@ public:
 	{
 	}
 
-	void addResult(const int kidIdx, double *h_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
+	void addResult(const int kidIdx, double *h_, GeoPatchContext::VBOVertex *vtx_, double clipRadius_, double heightError_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
 	{
 		assert(kidIdx>=0 && kidIdx<NUM_RESULT_DATA);
-		mData[kidIdx] = (SSplitResultData(h_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
+		mData[kidIdx] = (SSplitResultData(h_, vtx_, clipRadius_, heightError_, v0_, v1_, v2_, v3_, patchID_));
 	}
 
 	inline const SSplitResultData& data(const int32_t idx) const { return mData[idx]; }
@@ -162,8 +168,7 @@ public:
 	{
 		for( int i=0; i<NUM_RESULT_DATA; ++i ) {
 			if( mData[i].heights ) {delete [] mData[i].heights;		mData[i].heights = NULL;}
-			if( mData[i].normals ) {delete [] mData[i].normals;		mData[i].normals = NULL;}
-			if( mData[i].colors ) {delete [] mData[i].colors;		mData[i].colors = NULL;}
+			if( mData[i].vertices ) {delete [] mData[i].vertices;	mData[i].vertices = NULL;}
 		}
 	}
 
@@ -180,9 +185,9 @@ public:
 	{
 	}
 
-	void addResult(double *h_, vector3f *n_, Color3ub *c_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
+	void addResult(double *h_, GeoPatchContext::VBOVertex *vtx_, double clipRadius_, double heightError_, const vector3d &v0_, const vector3d &v1_, const vector3d &v2_, const vector3d &v3_, const GeoPatchID &patchID_)
 	{
-		mData = (SSplitResultData(h_, n_, c_, v0_, v1_, v2_, v3_, patchID_));
+		mData = (SSplitResultData(h_, vtx_, clipRadius_, heightError_, v0_, v1_, v2_, v3_, patchID_));
 	}
 
 	inline const SSplitResultData& data() const { return mData; }
@@ -191,8 +196,7 @@ public:
 	{
 		{
 			if( mData.heights ) {delete [] mData.heights;	mData.heights = NULL;}
-			if( mData.normals ) {delete [] mData.normals;	mData.normals = NULL;}
-			if( mData.colors ) {delete [] mData.colors;		mData.colors = NULL;}
+			if( mData.vertices ) {delete [] mData.vertices;	mData.vertices = NULL;}
 		}
 	}
 
@@ -226,6 +230,12 @@ protected:
 	void GenerateMesh(double *heights, vector3f *normals, Color3ub *colors, double *borderHeights, vector3d *borderVertexs,
 		const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
 		const int edgeLen, const double fracStep, const Terrain *pTerrain) const;
+
+	// Packs a generated mesh into the patch vertex buffer layout, so the main
+	// thread only has to copy it. Returns the clip radius it was packed with.
+	double PackVertices(GeoPatchContext::VBOVertex *vertices, const vector3f *normals, const Color3ub *colors,
+		const vector3d *borderVertexs, const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
+		const int edgeLen) const;
 };
 
 // ********************************************************************************
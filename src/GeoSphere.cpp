@@ -20,6 +20,7 @@
 #include <algorithm>
 
 int GeoSphere::s_vtxGenCount = 0;
+int GeoSphere::s_generatedHeightCount = 0;
 RefCountedPtr<GeoPatchContext> GeoSphere::s_patchContext;
 
 // must be odd numbers
@@ -272,6 +273,17 @@ void GeoSphere::ProcessSplitResults()
 	}
 }
 
+bool GeoSphere::GetGeneratedHeight(const vector3d &p, double maxError, double &height) const
+{
+	for (int i=0; i<NUM_PATCHES; i++) {
+		if (m_patches[i] && m_patches[i]->SampleHeight(p, maxError, height)) {
+			s_generatedHeightCount++;
+			return true;
+		}
+	}
+	return false;
+}
+
 void GeoSphere::BuildFirstPatches()
 {
 	assert(!m_patches[0]);
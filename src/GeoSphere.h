@@ -51,6 +51,10 @@ public:
 #endif /* DEBUG */
 		return h;
 	}
+	// As GetHeight(), but from the heightmaps already generated for
+	// rendering, if there's one under p within maxError (both in sbody radii).
+	// false if there isn't. Reads the patch tree, so not while it's changing
+	bool GetGeneratedHeight(const vector3d &p, double maxError, double &height) const;
 	friend class GeoPatch;
 	static void Init();
 	static void Uninit();
@@ -62,6 +66,8 @@ public:
 	double GetMaxFeatureHeight() const { return m_terrain->GetMaxHeight(); }
 	static int GetVtxGenCount() { return s_vtxGenCount; }
 	static void ClearVtxGenCount() { s_vtxGenCount = 0; }
+	static int GetGeneratedHeightCount() { return s_generatedHeightCount; }
+	static void ClearGeneratedHeightCount() { s_generatedHeightCount = 0; }
 
 	struct MaterialParameters {
 		SystemBody::AtmosphereParameters atmosphere;
@@ -97,6 +103,7 @@ private:
 	}
 
 	static int s_vtxGenCount;
+	static int s_generatedHeightCount;
 
 	static RefCountedPtr<GeoPatchContext> s_patchContext;
 
@@ -3,6 +3,8 @@
 
 #include "JobQueue.h"
 #include "StringF.h"
+#include "RefCounted.h"
+#include <atomic>
 
 void Job::UnlinkHandle()
 {
@@ -134,8 +136,11 @@ void JobHandle::Unlink()
 
 JobHandle::JobHandle(JobHandle&& other) : m_job(other.m_job), m_queue(other.m_queue), m_client(other.m_client)
 {
-	assert(m_job->GetHandle() == &other);
-	m_job->SetHandle(this);
+	// empty once its job has finished
+	if (m_job) {
+		assert(m_job->GetHandle() == &other);
+		m_job->SetHandle(this);
+	}
 	other.m_job = nullptr;
 	other.m_queue = nullptr;
 	other.m_client = nullptr;
@@ -148,8 +153,11 @@ JobHandle& JobHandle::operator=(JobHandle&& other)
 	m_job = other.m_job;
 	m_queue = other.m_queue;
 	m_client = other.m_client;
-	assert(m_job->GetHandle() == &other);
-	m_job->SetHandle(this);
+	// empty once its job has finished
+	if (m_job) {
+		assert(m_job->GetHandle() == &other);
+		m_job->SetHandle(this);
+	}
 	other.m_job = nullptr;
 	other.m_queue = nullptr;
 	other.m_client = nullptr;
@@ -351,3 +359,99 @@ unlock:
 	}
 	SDL_UnlockMutex(m_queueLock);
 }
+
+namespace {
+	// shared between the caller and the batch jobs. the jobs can outlive the
+	// ParallelFor call (they're only deleted by FinishJobs) so it's refcounted,
+	// and fn is only touched while there are batches left to claim
+	struct ParallelForState : public RefCounted {
+		ParallelForState(Uint32 count_, Uint32 batchSize_, const std::function<void(Uint32,Uint32)> *fn_) :
+			count(count_), batchSize(batchSize_), numBatches((count_ + batchSize_ - 1) / batchSize_),
+			fn(fn_), nextBatch(0), batchesDone(0)
+		{
+			doneLock = SDL_CreateMutex();
+			doneCond = SDL_CreateCond();
+		}
+		~ParallelForState() {
+			SDL_DestroyCond(doneCond);
+			SDL_DestroyMutex(doneLock);
+		}
+
+		// claim and run batches until there are none left
+		void Run() {
+			Uint32 batch;
+			while ((batch = nextBatch++) < numBatches) {
+				const Uint32 begin = batch * batchSize;
+				(*fn)(begin, std::min(begin + batchSize, count));
+				if (++batchesDone == numBatches) {
+					// under the lock, so the caller can't miss it between
+					// checking and waiting
+					SDL_LockMutex(doneLock);
+					SDL_CondSignal(doneCond);
+					SDL_UnlockMutex(doneLock);
+				}
+			}
+		}
+
+		// sleep until the last batch is done
+		void Wait() {
+			SDL_LockMutex(doneLock);
+			while (batchesDone < numBatches)
+				SDL_CondWait(doneCond, doneLock);
+			SDL_UnlockMutex(doneLock);
+		}
+
+		const Uint32 count;
+		const Uint32 batchSize;
+		const Uint32 numBatches;
+		const std::function<void(Uint32,Uint32)> *fn;
+		std::atomic<Uint32> nextBatch;
+		std::atomic<Uint32> batchesDone;
+		SDL_mutex *doneLock;
+		SDL_cond *doneCond;
+	};
+
+	class ParallelForJob : public Job {
+	public:
+		ParallelForJob(ParallelForState *state) : m_state(state) {}
+		virtual void OnRun() { m_state->Run(); }
+		virtual void OnFinish() {}
+	private:
+		RefCountedPtr<ParallelForState> m_state;
+	};
+}
+
+void JobQueue::ParallelFor(Uint32 count, Uint32 batchSize, const std::function<void(Uint32 begin, Uint32 end)> &fn)
+{
+	if (!count) return;
+	batchSize = std::max(batchSize, 1U);
+
+	// not worth waking anyone up for
+	if (count <= batchSize || m_runners.empty()) {
+		fn(0, count);
+		return;
+	}
+
+	RefCountedPtr<ParallelForState> state(new ParallelForState(count, batchSize, &fn));
+
+	// one job per runner that could usefully help; the caller is a worker too
+	const Uint32 numJobs = std::min<Uint32>(m_runners.size(), state->numBatches - 1);
+	std::vector<JobHandle> handles;
+	handles.reserve(numJobs);
+	SDL_LockMutex(m_queueLock);
+	for (Uint32 i = 0; i < numJobs; i++) {
+		Job *job = new ParallelForJob(state.Get());
+		handles.push_back(JobHandle(job, this, nullptr));
+		m_queue.push_front(job);
+	}
+	SDL_UnlockMutex(m_queueLock);
+	SDL_CondBroadcast(m_queueWaitCond);
+
+	state->Run();
+
+	// everything's been claimed. wait for runners still inside a batch
+	state->Wait();
+
+	// dropping the handles cancels any job that didn't get to run. they'll be
+	// cleaned up by the next FinishJobs
+}
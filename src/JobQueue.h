@@ -8,6 +8,7 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <functional>
 #include "SDL_thread.h"
 
 static const Uint32 MAX_THREADS = 64;
@@ -144,6 +145,16 @@ public:
 	// finished jobs (not cancelled)
 	Uint32 FinishJobs();
 
+	// call from the main thread to run fn over [0,count) in batches of
+	// batchSize, spread over the runners and the calling thread. returns
+	// once every batch is done. batches go to the front of the queue, and
+	// the caller takes any that no runner has picked up yet, so it never
+	// waits behind unrelated long-running jobs. once they're all claimed it
+	// sleeps until the runners still in one are done
+	void ParallelFor(Uint32 count, Uint32 batchSize, const std::function<void(Uint32 begin, Uint32 end)> &fn);
+
+	Uint32 GetNumRunners() const { return m_runners.size(); }
+
 private:
 	friend class JobRunner;
 	Job *GetJob();
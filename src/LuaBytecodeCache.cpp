@@ -0,0 +1,398 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "libs.h"
+#include "LuaBytecodeCache.h"
+#include "FileSystem.h"
+#include "FileSourceZip.h"
+#include "JobQueue.h"
+#include "utils.h"
+#include <cstring>
+#include <map>
+
+extern "C" {
+#include "jenkins/lookup3.h"
+}
+
+namespace LuaBytecodeCache {
+
+static const char CACHE_FILE[] = "luacache.bin";
+static const char CACHE_MAGIC[4] = { 'P', 'L', 'B', 'C' };
+static const Uint32 CACHE_VERSION = 2;
+static const size_t DUMP_HEADER_SIZE = 18; // LUAC_HEADERSIZE, for Lua 5.2
+
+struct Chunk {
+	Chunk() : hash(0), size(0), trusted(false) {}
+
+	bool SameSource(const Chunk &other) const {
+		return hash == other.hash && size == other.size && trusted == other.trusted;
+	}
+
+	Uint32 hash;
+	Uint32 size;
+	bool trusted;
+	std::string bytecode;
+};
+
+static bool s_enabled = false;
+static bool s_dirty = false;
+static std::map<std::string, Chunk> s_chunks;
+static Uint32 s_loaded = 0;
+static Uint32 s_compiled = 0;
+
+// what a script's functions are named, and so whether they're trusted (see
+// secure_trampoline in LuaObject.cpp)
+static std::string ChunkName(const std::string &path, bool trusted)
+{
+	return (trusted ? "[T] @" : "@") + path;
+}
+
+static std::string ChunkName(const FileSystem::FileInfo &info)
+{
+	return ChunkName(info.GetPath(), info.GetSource().IsTrusted());
+}
+
+// what the cached bytecode has to have been compiled from
+static Chunk Describe(const FileSystem::FileInfo &info, const StringRange &source)
+{
+	Chunk c;
+	c.hash = lookup3_hashlittle(source.begin, source.Size(), 0);
+	c.size = source.Size();
+	c.trusted = info.GetSource().IsTrusted();
+	return c;
+}
+
+static int DumpWriter(lua_State *l, const void *p, size_t size, void *ud)
+{
+	static_cast<std::string*>(ud)->append(static_cast<const char*>(p), size);
+	return 0;
+}
+
+// compiles on l and keeps the bytecode in c. Scripts with errors are left
+// for the main state to report
+static bool Compile(lua_State *l, const FileSystem::FileData &code, Chunk &c)
+{
+	const StringRange source = code.AsStringRange().StripUTF8BOM();
+	if (luaL_loadbuffer(l, source.begin, source.Size(), ChunkName(code.GetInfo()).c_str()) != LUA_OK) {
+		lua_pop(l, 1);
+		return false;
+	}
+	lua_dump(l, DumpWriter, &c.bytecode);
+	lua_pop(l, 1);
+	return true;
+}
+
+namespace {
+	// reads the cache file, failing at the first thing out of place
+	class CacheReader {
+	public:
+		CacheReader(const char *data, size_t size) : m_at(data), m_end(data + size), m_ok(true) {}
+
+		bool Ok() const { return m_ok; }
+
+		Uint32 Int32() {
+			Uint32 x = 0;
+			Bytes(&x, sizeof(x));
+			return x;
+		}
+		std::string String() {
+			const Uint32 len = Int32();
+			if (!m_ok || Uint32(m_end - m_at) < len) {
+				m_ok = false;
+				return std::string();
+			}
+			std::string s(m_at, len);
+			m_at += len;
+			return s;
+		}
+		void Bytes(void *out, size_t len) {
+			if (!m_ok || size_t(m_end - m_at) < len) {
+				m_ok = false;
+				return;
+			}
+			memcpy(out, m_at, len);
+			m_at += len;
+		}
+		void Skip(Uint64 len) {
+			if (!m_ok || Uint64(m_end - m_at) < len) {
+				m_ok = false;
+				return;
+			}
+			m_at += len;
+		}
+		void Fail() { m_ok = false; }
+		size_t Remaining() const { return m_end - m_at; }
+		bool AtEnd() const { return m_ok && m_at == m_end; }
+
+	private:
+		const char *m_at;
+		const char *m_end;
+		bool m_ok;
+	};
+
+	// Lua 5.2 keeps each function's chunk name in its bytecode, and that's
+	// what it's trusted by. This walks a chunk from the cache the way
+	// lundump.c does, checking every function in it has the name it would
+	// have been compiled with, so bytecode can't make a script any more
+	// trusted than its file
+	class DumpChecker {
+	public:
+		DumpChecker(const std::string &bytecode) : m_r(bytecode.data(), bytecode.size()) {}
+
+		bool AllNamed(const std::string &header, const std::string &name) {
+			std::string h(header.size(), '\0');
+			m_r.Bytes(&h[0], h.size());
+			if (!m_r.Ok() || h != header) return false;
+			Function(name, 0);
+			return m_r.AtEnd();
+		}
+
+	private:
+		void Function(const std::string &name, int depth) {
+			if (depth > MAX_DEPTH) {
+				m_r.Fail();
+				return;
+			}
+			m_r.Skip(2 * sizeof(int) + 3); // lines, params, vararg, stack
+			m_r.Skip(Uint64(m_r.Int32()) * sizeof(Uint32)); // code
+			const Uint32 numConstants = m_r.Int32();
+			for (Uint32 i = 0; i < numConstants && m_r.Ok(); i++) {
+				Uint8 type = 0;
+				m_r.Bytes(&type, 1);
+				switch (type) {
+					case LUA_TNIL: break;
+					case LUA_TBOOLEAN: m_r.Skip(1); break;
+					case LUA_TNUMBER: m_r.Skip(sizeof(lua_Number)); break;
+					case LUA_TSTRING: String(); break;
+					default: m_r.Fail(); break;
+				}
+			}
+			const Uint32 numProtos = m_r.Int32();
+			for (Uint32 i = 0; i < numProtos && m_r.Ok(); i++)
+				Function(name, depth + 1);
+			m_r.Skip(Uint64(m_r.Int32()) * 2); // upvalues
+
+			// debug info, starting with the name
+			if (String() != name + '\0')
+				m_r.Fail();
+			m_r.Skip(Uint64(m_r.Int32()) * sizeof(int)); // line info
+			const Uint32 numLocals = m_r.Int32();
+			for (Uint32 i = 0; i < numLocals && m_r.Ok(); i++) {
+				String();
+				m_r.Skip(2 * sizeof(int));
+			}
+			const Uint32 numUpvalueNames = m_r.Int32();
+			for (Uint32 i = 0; i < numUpvalueNames && m_r.Ok(); i++)
+				String();
+		}
+
+		// with its terminating nul, or empty for none
+		std::string String() {
+			size_t len = 0;
+			m_r.Bytes(&len, sizeof(len));
+			if (!m_r.Ok() || len > m_r.Remaining()) {
+				m_r.Fail();
+				return std::string();
+			}
+			std::string s(len, '\0');
+			if (len) m_r.Bytes(&s[0], len);
+			return s;
+		}
+
+		// as deep as the Lua parser will nest functions (LUAI_MAXCCALLS)
+		static const int MAX_DEPTH = 200;
+
+		CacheReader m_r;
+	};
+
+	// what every chunk this Lua dumps starts with
+	std::string DumpHeader() {
+		lua_State *l = luaL_newstate();
+		std::string bytecode;
+		luaL_loadstring(l, "");
+		lua_dump(l, DumpWriter, &bytecode);
+		lua_close(l);
+		return bytecode.substr(0, DUMP_HEADER_SIZE);
+	}
+
+	void WriteInt32(FILE *f, Uint32 x) { fwrite(&x, sizeof(x), 1, f); }
+	void WriteString(FILE *f, const std::string &s) {
+		WriteInt32(f, s.size());
+		fwrite(s.data(), 1, s.size(), f);
+	}
+}
+
+void Init()
+{
+	PROFILE_SCOPED()
+	s_enabled = true;
+	s_dirty = false;
+	s_chunks.clear();
+
+	RefCountedPtr<FileSystem::FileData> data = FileSystem::userFiles.ReadFile(CACHE_FILE);
+	if (!data) return;
+
+	CacheReader r(data->GetData(), data->GetSize());
+	char magic[4];
+	r.Bytes(magic, sizeof(magic));
+	const Uint32 version = r.Int32();
+	const Uint32 luaVersion = r.Int32();
+	if (!r.Ok() || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != CACHE_VERSION || luaVersion != LUA_VERSION_NUM) {
+		Output("LuaBytecodeCache: ignoring out of date %s\n", CACHE_FILE);
+		return;
+	}
+
+	// nothing's taken on trust: the bytecode has to hash to what was saved
+	// with it, and be named for the file it's used in place of
+	const std::string header = DumpHeader();
+	const Uint32 numChunks = r.Int32();
+	for (Uint32 i = 0; i < numChunks && r.Ok(); i++) {
+		const std::string path = r.String();
+		Chunk c;
+		c.hash = r.Int32();
+		c.size = r.Int32();
+		c.trusted = r.Int32() != 0;
+		const Uint32 bytecodeHash = r.Int32();
+		c.bytecode = r.String();
+		if (!r.Ok()) break;
+		if (lookup3_hashlittle(c.bytecode.data(), c.bytecode.size(), 0) != bytecodeHash ||
+			!DumpChecker(c.bytecode).AllNamed(header, ChunkName(path, c.trusted))) {
+			r.Fail();
+			break;
+		}
+		s_chunks[path] = std::move(c);
+	}
+	if (!r.Ok()) {
+		Output("LuaBytecodeCache: %s is damaged\n", CACHE_FILE);
+		s_chunks.clear();
+	}
+}
+
+void Save()
+{
+	if (!s_enabled || !s_dirty) return;
+	PROFILE_SCOPED()
+
+	// forget scripts that have gone
+	for (std::map<std::string, Chunk>::iterator it = s_chunks.begin(); it != s_chunks.end(); ) {
+		if (!FileSystem::gameDataFiles.Lookup(it->first).IsFile())
+			s_chunks.erase(it++);
+		else
+			++it;
+	}
+
+	FILE *f = FileSystem::userFiles.OpenWriteStream(CACHE_FILE);
+	if (!f) {
+		Output("LuaBytecodeCache: couldn't write %s\n", CACHE_FILE);
+		return;
+	}
+	fwrite(CACHE_MAGIC, sizeof(CACHE_MAGIC), 1, f);
+	WriteInt32(f, CACHE_VERSION);
+	WriteInt32(f, LUA_VERSION_NUM);
+	WriteInt32(f, s_chunks.size());
+	for (std::map<std::string, Chunk>::const_iterator it = s_chunks.begin(); it != s_chunks.end(); ++it) {
+		WriteString(f, it->first);
+		WriteInt32(f, it->second.hash);
+		WriteInt32(f, it->second.size);
+		WriteInt32(f, it->second.trusted ? 1 : 0);
+		WriteInt32(f, lookup3_hashlittle(it->second.bytecode.data(), it->second.bytecode.size(), 0));
+		WriteString(f, it->second.bytecode);
+	}
+	if (ferror(f))
+		Output("LuaBytecodeCache: couldn't write %s\n", CACHE_FILE);
+	fclose(f);
+	s_dirty = false;
+}
+
+void Uninit()
+{
+	Save();
+	Output("LuaBytecodeCache: %u scripts loaded from the cache, %u compiled\n", s_loaded, s_compiled);
+	s_chunks.clear();
+	s_enabled = false;
+}
+
+void Prepare(JobQueue *jobs, const std::vector<std::string> &basepaths)
+{
+	PROFILE_SCOPED()
+	if (!s_enabled) return;
+
+	struct Script {
+		FileSystem::FileInfo info;
+		RefCountedPtr<FileSystem::FileData> code;
+		Chunk chunk;
+		bool compiled;
+	};
+	std::vector<Script> scripts;
+	for (std::vector<std::string>::const_iterator it = basepaths.begin(); it != basepaths.end(); ++it) {
+		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, *it, FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
+			const FileSystem::FileInfo &info = files.Current();
+			if (!info.IsFile() || !ends_with_ci(info.GetPath(), ".lua")) continue;
+			Script s;
+			s.info = info;
+			s.compiled = false;
+			// mods' zips read through one shared stream, so not from the workers
+			if (dynamic_cast<const FileSystem::FileSourceZip*>(&info.GetSource()))
+				s.code = info.Read();
+			scripts.push_back(s);
+		}
+	}
+
+	// s_chunks is only read until they're all done
+	jobs->ParallelFor(scripts.size(), 4, [&scripts](Uint32 begin, Uint32 end) {
+		lua_State *l = 0;
+		for (Uint32 i = begin; i < end; i++) {
+			Script &s = scripts[i];
+			if (!s.code) s.code = s.info.Read();
+			if (!s.code) continue;
+			s.chunk = Describe(s.info, s.code->AsStringRange().StripUTF8BOM());
+			std::map<std::string, Chunk>::const_iterator cached = s_chunks.find(s.info.GetPath());
+			if (cached != s_chunks.end() && cached->second.SameSource(s.chunk)) continue;
+			if (!l) l = luaL_newstate();
+			s.compiled = Compile(l, *s.code, s.chunk);
+		}
+		if (l) lua_close(l);
+	});
+
+	Uint32 numCompiled = 0;
+	for (std::vector<Script>::iterator it = scripts.begin(); it != scripts.end(); ++it) {
+		if (!it->compiled) continue;
+		s_chunks[it->info.GetPath()] = std::move(it->chunk);
+		numCompiled++;
+	}
+	if (numCompiled) s_dirty = true;
+	s_compiled += numCompiled;
+	Output("LuaBytecodeCache: %u scripts, %u compiled\n", unsigned(scripts.size()), numCompiled);
+}
+
+int Load(lua_State *l, const FileSystem::FileData &code)
+{
+	const StringRange source = code.AsStringRange().StripUTF8BOM();
+	const FileSystem::FileInfo &info = code.GetInfo();
+	const std::string chunkName = ChunkName(info);
+	if (!s_enabled)
+		return luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str());
+
+	Chunk c = Describe(info, source);
+	std::map<std::string, Chunk>::const_iterator cached = s_chunks.find(info.GetPath());
+	if (cached != s_chunks.end() && cached->second.SameSource(c)) {
+		const std::string &bytecode = cached->second.bytecode;
+		if (luaL_loadbufferx(l, bytecode.data(), bytecode.size(), chunkName.c_str(), "b") == LUA_OK) {
+			s_loaded++;
+			return LUA_OK;
+		}
+		// from some other build of Lua. Compile it again
+		lua_pop(l, 1);
+	}
+
+	const int ret = luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str());
+	if (ret == LUA_OK) {
+		lua_dump(l, DumpWriter, &c.bytecode);
+		s_chunks[info.GetPath()] = c;
+		s_dirty = true;
+		s_compiled++;
+	}
+	return ret;
+}
+
+}
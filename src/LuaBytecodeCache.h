@@ -0,0 +1,47 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _LUABYTECODECACHE_H
+#define _LUABYTECODECACHE_H
+
+#include <string>
+#include <vector>
+#include "lua/lua.hpp"
+
+/*
+ * Compiled Lua, kept in the user's directory between runs so scripts that
+ * haven't changed don't need parsing again. Each file's bytecode is stored
+ * with its path, where it came from (trusted or not) and a hash of its
+ * source, and only used while all three still match. Its trust comes from
+ * the chunk name compiled into it, so on reading the cache each chunk has
+ * to hash to what was saved with it and have every function named for its
+ * file as it is now, or the whole cache is dropped.
+ *
+ * At startup Prepare reads and compiles all the scripts on the job queue,
+ * each worker with a Lua state of its own. They still run on the main Lua
+ * state, in the same order and at the same time as before.
+ */
+
+namespace FileSystem { class FileData; }
+class JobQueue;
+
+namespace LuaBytecodeCache {
+
+	// reads the cache. Until then everything is compiled from source and
+	// nothing is kept
+	void Init();
+	// writes the cache back, if anything changed
+	void Save();
+	void Uninit();
+
+	// compiles every .lua file under basepaths that isn't in the cache
+	// already, spread over jobs
+	void Prepare(JobQueue *jobs, const std::vector<std::string> &basepaths);
+
+	// loads code onto the stack as luaL_loadbuffer does, from the cache if
+	// it's there
+	int Load(lua_State *l, const FileSystem::FileData &code);
+
+}
+
+#endif
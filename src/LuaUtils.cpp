@@ -4,6 +4,7 @@
 #include "LuaUtils.h"
 #include "libs.h"
 #include "FileSystem.h"
+#include "LuaBytecodeCache.h"
 
 extern "C" {
 #ifdef ENABLE_LDB
@@ -524,12 +525,7 @@ int pi_lua_loadfile(lua_State *l, const FileSystem::FileData &code)
 {
 	assert(l);
 
-	const StringRange source = code.AsStringRange().StripUTF8BOM();
-	const std::string &path(code.GetInfo().GetPath());
-	bool trusted = code.GetInfo().GetSource().IsTrusted();
-	const std::string chunkName = (trusted ? "[T] @" : "@") + path;
-
-	return luaL_loadbuffer(l, source.begin, source.Size(), chunkName.c_str());
+	return LuaBytecodeCache::Load(l, code);
 }
 
 static void pi_lua_dofile(lua_State *l, const FileSystem::FileData &code, int nret)
@@ -22,6 +22,7 @@ Missile::Missile(ShipType::Id shipId, Body *owner, int power): Ship(shipId)
 		m_power = power;
 
 	m_owner = owner;
+	WatchOwnBodies();
 	SetLabel(Lang::MISSILE);
 	Disarm();
 }
@@ -38,6 +39,7 @@ void Missile::PostLoadFixup(Space *space)
 {
 	Ship::PostLoadFixup(space);
 	m_owner = space->GetBodyByIndex(m_ownerIndex);
+	WatchOwnBodies();
 }
 
 void Missile::Save(Serializer::Writer &wr, Space *space)
@@ -119,6 +121,7 @@ void Missile::Explode()
 
 void Missile::NotifyRemoved(const Body* const removedBody)
 {
+	Ship::NotifyRemoved(removedBody);
 	if (m_owner == removedBody) {
 		m_owner = 0;
 	}
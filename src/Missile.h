@@ -28,6 +28,7 @@ public:
 protected:
 	virtual void Save(Serializer::Writer &wr, Space *space);
 	virtual void Load(Serializer::Reader &rd, Space *space);
+	virtual void WatchOwnBodies() { if (m_owner) WatchBody(m_owner); }
 private:
 	void Explode();
 
@@ -3,6 +3,7 @@
 
 #include "ModelCache.h"
 #include "scenegraph/SceneGraph.h"
+#include "scenegraph/BinaryConverter.h"
 #include "Shields.h"
 
 ModelCache::ModelCache(Graphics::Renderer *r)
@@ -21,9 +22,29 @@ SceneGraph::Model *ModelCache::FindModel(const std::string &name)
 	ModelMap::iterator it = m_models.find(name);
 
 	if (it == m_models.end()) {
+		// a compiled model comes with its collision trees already built.
+		// If there isn't one compiled from the current source, load that
+		// and compile it for next time
+		SceneGraph::Model *m = 0;
 		try {
-			SceneGraph::Loader loader(m_renderer);
-			SceneGraph::Model *m = loader.LoadModel(name);
+			SceneGraph::BinaryConverter bc(m_renderer);
+			m = bc.Load(name);
+		} catch (SceneGraph::LoadingError &) {
+		}
+		try {
+			if (!m) {
+				SceneGraph::Loader loader(m_renderer);
+				m = loader.LoadModel(name);
+				try {
+					SceneGraph::BinaryConverter bc(m_renderer);
+					bc.Save(name, m);
+				} catch (SceneGraph::LoadingError &) {
+				} catch (CouldNotOpenFileException &) {
+					Output("ModelCache: couldn't write compiled %s\n", name.c_str());
+				} catch (CouldNotWriteToFileException &) {
+					Output("ModelCache: couldn't write compiled %s\n", name.c_str());
+				}
+			}
 			Shields::ReparentShieldNodes(m);
 			m_models[name] = m;
 			return m;
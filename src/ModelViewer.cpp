@@ -262,6 +262,7 @@ bool ModelViewer::OnToggleGuns(UI::CheckBox *w)
 		tagL->RemoveChildAt(0);
 		tagR->RemoveChildAt(0);
 	}
+	m_model->InvalidateDrawList();
 	return true;
 }
 
@@ -729,6 +730,9 @@ void ModelViewer::PollEvents()
 			case SDLK_F6:
 				SaveModelToBinary();
 				break;
+			case SDLK_F7:
+				TimeAnimations();
+				break;
 			case SDLK_F11:
 				if (event.key.keysym.mod & KMOD_SHIFT)
 					m_renderer->ReloadShaders();
@@ -851,6 +855,44 @@ void ModelViewer::SaveModelToBinary()
 	}
 }
 
+void ModelViewer::TimeAnimations()
+{
+	if (!m_model || m_model->GetAnimations().empty())
+		return AddLog("No animations to time");
+
+	// a busy starport: many instances, each playing every animation from
+	// its own starting point, interpolated every frame for 12s at 60 fps
+	const int NUM_INSTANCES = 64;
+	const int FRAMES = 60 * 12;
+	std::vector<std::unique_ptr<SceneGraph::Model> > instances;
+	for (int i = 0; i < NUM_INSTANCES; i++)
+		instances.push_back(std::unique_ptr<SceneGraph::Model>(m_model->MakeInstance()));
+
+	const std::vector<SceneGraph::Animation*> &anims = m_model->GetAnimations();
+	for (std::vector<SceneGraph::Animation*>::const_iterator anim = anims.begin(); anim != anims.end(); ++anim) {
+		const std::vector<SceneGraph::AnimationChannel> &channels = (*anim)->GetChannels();
+		unsigned int numKeys = 0;
+		for (std::vector<SceneGraph::AnimationChannel>::const_iterator chan = channels.begin(); chan != channels.end(); ++chan)
+			numKeys += chan->positionKeys.size() + chan->rotationKeys.size() + chan->scaleKeys.size();
+
+		std::vector<SceneGraph::Animation*> played;
+		for (int i = 0; i < NUM_INSTANCES; i++)
+			played.push_back(instances[i]->FindAnimation((*anim)->GetName()));
+
+		const Uint32 start = SDL_GetTicks();
+		for (int f = 0; f < FRAMES; f++) {
+			for (int i = 0; i < NUM_INSTANCES; i++) {
+				played[i]->SetProgress(fmod(double(i) / NUM_INSTANCES + double(f) / FRAMES, 1.0));
+				played[i]->Interpolate();
+			}
+		}
+		const Uint32 time = SDL_GetTicks() - start;
+
+		AddLog(stringf("Animation %0: %1 channels, %2 keys, %3 instances x %4 frames in %5ms",
+			(*anim)->GetName(), unsigned(channels.size()), numKeys, NUM_INSTANCES, FRAMES, time));
+	}
+}
+
 void ModelViewer::SetModel(const std::string &filename)
 {
 	AddLog(stringf("Loading model %0...", filename));
@@ -865,7 +907,7 @@ void ModelViewer::SetModel(const std::string &filename)
 			//binary loader expects extension-less name. Might want to change this.
 			m_modelName = filename.substr(0, filename.size()-4);
 			SceneGraph::BinaryConverter bc(m_renderer);
-			m_model = bc.Load(m_modelName);
+			m_model = bc.Load(m_modelName, "models");
 		} else {
 			m_modelName = filename;
 			SceneGraph::Loader loader(m_renderer, true);
@@ -59,6 +59,7 @@ private:
 	void SetModel(const std::string& name);
 	void SetupFilePicker();
 	void SetupUI();
+	void TimeAnimations();
 	void UpdateAnimList();
 	void UpdateCamera();
 	void UpdateLights();
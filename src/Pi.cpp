@@ -15,8 +15,10 @@
 #include "GalacticView.h"
 #include "Game.h"
 #include "GeoSphere.h"
+#include "TerrainHeightCache.h"
 #include "Intro.h"
 #include "Lang.h"
+#include "LuaBytecodeCache.h"
 #include "LuaComms.h"
 #include "LuaConsole.h"
 #include "LuaConstants.h"
@@ -60,6 +62,7 @@
 #include "StringF.h"
 #include "SystemInfoView.h"
 #include "SystemView.h"
+#include "TaskGraph.h"
 #include "Tombstone.h"
 #include "UIView.h"
 #include "WorldView.h"
@@ -301,6 +304,66 @@ static void draw_progress(UI::Gauge *gauge, UI::Label *label, float progress)
 	Pi::renderer->SwapBuffers();
 }
 
+// the background picture and the progress gauge shown while loading
+static void build_loading_screen(UI::Label *&label, UI::Gauge *&gauge)
+{
+	UI::Box *box = Pi::ui->VBox(5);
+	label = Pi::ui->Label("");
+	label->SetFont(UI::Widget::FONT_HEADING_NORMAL);
+	label->SetColor(Color::PARAGON_BLUE);
+	gauge = Pi::ui->Gauge();
+
+	// Background layer
+	UI::Layer *background_layer = Pi::ui->NewLayer();
+	// Parse all images
+	FileSystem::FileEnumerator fe(FileSystem::gameDataFiles, "images");
+	std::vector<std::string> bg_files;
+	while(!fe.Finished()) {
+		const FileSystem::FileInfo& fi = fe.Current();
+		if(static_cast<int>(fi.GetType()) == 1) {
+			const std::string& fname = fi.GetName();
+			unsigned int r = fname.rfind(".png");
+			if(r != std::string::npos && r == fname.size() - 4) {
+				bg_files.push_back(fname);
+			}
+		}
+		fe.Next();
+	}
+	if(bg_files.size() > 0) {
+		srand(time(nullptr));
+		background_layer->SetInnerWidget(
+			Pi::ui->Align(UI::Align::MIDDLE)->SetInnerWidget(
+				Pi::ui->Expand()->SetInnerWidget(
+					Pi::ui->Image("images/" + bg_files[rand() % bg_files.size()], UI::Image::PRESERVE_ASPECT)
+				)
+			)
+		);
+	}
+
+	// Gauge layer
+	UI::Layer *gauge_layer = Pi::ui->NewLayer();
+	gauge_layer->SetInnerWidget(
+		Pi::ui->Margin(10)->SetInnerWidget(
+			Pi::ui->Expand()->SetInnerWidget(
+			Pi::ui->Align(UI::Align::BOTTOM)->SetInnerWidget(
+					box->PackEnd(UI::WidgetSet(
+						label,
+						gauge
+					))
+				)
+			)
+		)
+    );
+}
+
+// where LuaInit and the data loaders run scripts from
+static const std::vector<std::string> LUA_SCRIPT_DIRS = {
+	"libs", "ui", "modules", "ships", "stations", "factions", "systems"
+};
+
+// how long each part of Pi::Init took, written to the user directory
+static const char STARTUP_PROFILE_FILE[] = "startup_profile.txt";
+
 static void LuaInit()
 {
 	LuaObject<PropertiedObject>::RegisterClass();
@@ -489,119 +552,104 @@ void Pi::Init(const std::map<std::string,std::string> &options)
 	jobQueue.reset(new JobQueue(numThreads));
 	Output("started %d worker threads\n", numThreads);
 
-	// XXX early, Lua init needs it
-	ShipType::Init();
-
-	// XXX UI requires Lua  but Pi::ui must exist before we start loading
-	// templates. so now we have crap everywhere :/
-	Lua::Init();
-
-	Pi::ui.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(), 
-		Graphics::GetScreenHeight(), Lang::GetCore().GetLangCode()));
-	Pi::console.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(),
-		Graphics::GetScreenHeight(), Lang::GetCore().GetLangCode()));
-
-	LuaInit();
-
-	Gui::Init(renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), 800, 600);
+	// the rest of startup, each stage once what it needs is done. only
+	// decoding the galaxy map can go to the workers; everything else builds
+	// GL objects, runs Lua or reads files through gameDataFiles, which mods'
+	// zips make unsafe off the main thread. main thread stages run in the
+	// order they're added here
+	TaskGraph startup(jobQueue.get());
+	UI::Label *label = 0;
+	UI::Gauge *gauge = 0;
+
+	// read first so it's decoded while everything else goes on. the worker
+	// only says whether that worked; it's up to this thread to give up
+	RefCountedPtr<FileSystem::FileData> galaxyData;
+	bool galaxyLoaded = false;
+	const TaskGraph::TaskId galaxyRead = startup.Add("GalaxyRead", TaskGraph::MAIN_THREAD, [&galaxyData] {
+		galaxyData = Galaxy::ReadBitmap();
+	});
+
+	const TaskGraph::TaskId galaxy = startup.Add("Galaxy", TaskGraph::WORKER, [&galaxyData, &galaxyLoaded] {
+		galaxyLoaded = Galaxy::Init(galaxyData);
+		galaxyData.Reset();
+	}, { galaxyRead });
+
+	// compile the scripts while nothing else is going on; they run as
+	// they're loaded below, in the same order as ever
+	const TaskGraph::TaskId luaScripts = startup.Add("LuaScripts", TaskGraph::MAIN_THREAD, [] {
+		LuaBytecodeCache::Init();
+		LuaBytecodeCache::Prepare(jobQueue.get(), LUA_SCRIPT_DIRS);
+	});
 
-	UI::Box *box = Pi::ui->VBox(5);
-	UI::Label *label = Pi::ui->Label("");
-	label->SetFont(UI::Widget::FONT_HEADING_NORMAL);
-	label->SetColor(Color::PARAGON_BLUE);
-	UI::Gauge *gauge = Pi::ui->Gauge();
-
-	// Background layer
-	UI::Layer *background_layer = Pi::ui->NewLayer();
-	// Parse all images
-	FileSystem::FileSourceFS fs(FileSystem::GetDataDir());
-	FileSystem::FileEnumerator fe(fs, "images");
-	std::vector<std::string> bg_files;
-	while(!fe.Finished()) {
-		const FileSystem::FileInfo& fi = fe.Current();
-		if(static_cast<int>(fi.GetType()) == 1) {
-			const std::string& fname = fi.GetName();
-			unsigned int r = fname.rfind(".png");
-			if(r != std::string::npos && r == fname.size() - 4) {
-				bg_files.push_back(fname);
-			}
-		}
-		fe.Next();
-	}
-	if(bg_files.size() > 0) {
-		srand(time(nullptr));
-		background_layer->SetInnerWidget(
-			Pi::ui->Align(UI::Align::MIDDLE)->SetInnerWidget(
-				Pi::ui->Expand()->SetInnerWidget(
-					Pi::ui->Image("images/" + bg_files[rand() % bg_files.size()], UI::Image::PRESERVE_ASPECT)
-				)
-			)
-		);
-	}
-
-	// Gauge layer
-	UI::Layer *gauge_layer = Pi::ui->NewLayer();
-	gauge_layer->SetInnerWidget(
-		Pi::ui->Margin(10)->SetInnerWidget(
-			Pi::ui->Expand()->SetInnerWidget(
-			Pi::ui->Align(UI::Align::BOTTOM)->SetInnerWidget(
-					box->PackEnd(UI::WidgetSet(
-						label,
-						gauge
-					))
-				)
-			)
-		)
-    );
-
-	draw_progress(gauge, label, 0.1f);
-	
-	// Beginning game loading
-	double start_game_loading = SDL_GetTicks();
-
-	Galaxy::Init();
-	draw_progress(gauge, label, 0.2f);
-
-	FaceGenManager::Init();
-	draw_progress(gauge, label, 0.25f);
-
-	Faction::Init();
-	draw_progress(gauge, label, 0.3f);
-
-	CustomSystem::Init();
-	draw_progress(gauge, label, 0.4f);
+	// XXX early, Lua init needs it
+	const TaskGraph::TaskId shipTypes = startup.Add("ShipType", TaskGraph::MAIN_THREAD, [] {
+		ShipType::Init();
+	}, { luaScripts });
+
+	const TaskGraph::TaskId lua = startup.Add("Lua", TaskGraph::MAIN_THREAD, [] {
+		// XXX UI requires Lua  but Pi::ui must exist before we start loading
+		// templates. so now we have crap everywhere :/
+		Lua::Init();
+
+		Pi::ui.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(),
+			Graphics::GetScreenHeight(), Lang::GetCore().GetLangCode()));
+		Pi::console.Reset(new UI::Context(Lua::manager, Pi::renderer, Graphics::GetScreenWidth(),
+			Graphics::GetScreenHeight(), Lang::GetCore().GetLangCode()));
+
+		LuaInit();
+		LuaBytecodeCache::Save();
+	}, { shipTypes });
+
+	startup.Add("LoadingScreen", TaskGraph::MAIN_THREAD, [&label, &gauge] {
+		Gui::Init(renderer, Graphics::GetScreenWidth(), Graphics::GetScreenHeight(), 800, 600);
+		build_loading_screen(label, gauge);
+	}, { lua });
+
+	startup.Add("FaceGen", TaskGraph::MAIN_THREAD, [] {
+		FaceGenManager::Init();
+	});
+
+	const TaskGraph::TaskId factions = startup.Add("Factions", TaskGraph::MAIN_THREAD, [&galaxyLoaded] {
+		if (!galaxyLoaded) Pi::Quit();
+		Faction::Init();
+	}, { lua, galaxy });
+
+	const TaskGraph::TaskId customSystems = startup.Add("CustomSystems", TaskGraph::MAIN_THREAD, [] {
+		CustomSystem::Init();
+	}, { factions });
 
 	// Reload home sector, they might have changed, due to custom systems
 	// Sectors might be changed in game, so have to re-create them again once we have a Game.
-	Faction::SetHomeSectors();
-	draw_progress(gauge, label, 0.45f);
-
-	modelCache = new ModelCache(Pi::renderer);
-	Shields::Init(Pi::renderer);
-	draw_progress(gauge, label, 0.5f);
-
-//unsigned int control_word;
-//_clearfp();
-//_controlfp_s(&control_word, _EM_INEXACT | _EM_UNDERFLOW | _EM_ZERODIVIDE, _MCW_EM);
-//double fpexcept = Pi::timeAccelRates[1] / Pi::timeAccelRates[0];
-
-	draw_progress(gauge, label, 0.6f);
-
-	GeoSphere::Init();
-	draw_progress(gauge, label, 0.7f);
-
-	CityOnPlanet::Init();
-	draw_progress(gauge, label, 0.8f);
-
-	SpaceStation::Init();
-	draw_progress(gauge, label, 0.9f);
-
-	NavLights::Init(Pi::renderer);
-	Sfx::Init(Pi::renderer);
-	draw_progress(gauge, label, 0.95f);
-
-	if (!config->Int("DisableSound")) {
-		Sound::Init();
+	startup.Add("HomeSectors", TaskGraph::MAIN_THREAD, [] {
+		Faction::SetHomeSectors();
+	}, { customSystems });
+
+	const TaskGraph::TaskId models = startup.Add("Models", TaskGraph::MAIN_THREAD, [] {
+		modelCache = new ModelCache(Pi::renderer);
+		Shields::Init(Pi::renderer);
+		SceneGraph::Impostor::Init(float(config->Int("ImpostorPixelRadius")));
+	});
+
+	startup.Add("GeoSphere", TaskGraph::MAIN_THREAD, [] {
+		GeoSphere::Init();
+	});
+
+	startup.Add("CityOnPlanet", TaskGraph::MAIN_THREAD, [] {
+		CityOnPlanet::Init();
+	}, { models });
+
+	startup.Add("SpaceStation", TaskGraph::MAIN_THREAD, [] {
+		SpaceStation::Init();
+	}, { models, lua });
+
+	startup.Add("Effects", TaskGraph::MAIN_THREAD, [] {
+		NavLights::Init(Pi::renderer);
+		Sfx::Init(Pi::renderer);
+	});
+
+	startup.Add("Sound", TaskGraph::MAIN_THREAD, [] {
+		if (config->Int("DisableSound")) return;
+		Sound::Init(size_t(config->Int("MaxDecodedSoundMB")) << 20, config->Int("CacheDecodedSound") != 0);
 		Sound::SetMasterVolume(config->Float("MasterVolume"));
 		Sound::SetSfxVolume(config->Float("SfxVolume"));
 		GetMusicPlayer().SetVolume(config->Float("MusicVolume"));
@@ -610,12 +658,17 @@ void Pi::Init(const std::map<std::string,std::string> &options)
 		if (config->Int("MasterMuted")) Sound::Pause(1);
 		if (config->Int("SfxMuted")) Sound::SetSfxVolume(0.f);
 		if (config->Int("MusicMuted")) GetMusicPlayer().SetEnabled(false);
-	}
-	draw_progress(gauge, label, 1.0f);
+	});
 
-	// End of game loading
-	double end_game_loading = SDL_GetTicks();
-	Output("Game loading time: %.3f seconds\n", (end_game_loading - start_game_loading) * 0.001);
+	startup.Run([&label, &gauge](float progress) {
+		if (gauge) draw_progress(gauge, label, progress);
+	});
+
+	Output("Game loading time: %.3f seconds\n", startup.GetTotalTime() * 0.001);
+	if (FILE *f = FileSystem::userFiles.OpenWriteStream(STARTUP_PROFILE_FILE, FileSystem::FileSourceFS::WRITE_TEXT)) {
+		startup.WriteProfile(f);
+		fclose(f);
+	}
 
 	Pi::ui->DropAllLayers();
 
@@ -1056,7 +1109,9 @@ void Pi::Quit()
 	Pi::ui.Reset(0);
 	Pi::console.Reset(0);
 	LuaUninit();
+	LuaBytecodeCache::Uninit();
 	Gui::Uninit();
+	SceneGraph::Impostor::Uninit();
 	delete Pi::modelCache;
 	delete Pi::renderer;
 	delete Pi::config;
@@ -1649,13 +1704,16 @@ void Pi::MainLoop()
 	Uint32 last_stats = SDL_GetTicks();
 	int frame_stat = 0;
 	int phys_stat = 0;
-	char fps_readout[256];
+	char fps_readout[512];
 	memset(fps_readout, 0, sizeof(fps_readout));
 #endif
 
 	int MAX_PHYSICS_TICKS = Pi::config->Int("MaxPhysicsCyclesPerRender");
 	if (MAX_PHYSICS_TICKS <= 0)
 		MAX_PHYSICS_TICKS = 4;
+	int MAX_STEPS_PER_TICK = Pi::config->Int("MaxPhysicsStepsPerCycle");
+	if (MAX_STEPS_PER_TICK <= 0)
+		MAX_STEPS_PER_TICK = 16;
 
 	double currentTime = 0.001 * double(SDL_GetTicks());
 	double accumulator = Pi::game->GetTimeStep();
@@ -1682,21 +1740,30 @@ void Pi::MainLoop()
 		const float step = Pi::game->GetTimeStep();
 		if (step > 0.0f) {
 			PROFILE_SCOPED_RAW("unpaused")
+			// when more steps are owed than there are ticks to take them in,
+			// the ticks get longer instead of the time being thrown away.
+			// Space cuts a long tick up for anything that can't take it whole
+			const int owed = int(accumulator / step);
+			const int stepsPerTick = Clamp((owed + MAX_PHYSICS_TICKS - 1) / MAX_PHYSICS_TICKS, 1, MAX_STEPS_PER_TICK);
 			int phys_ticks = 0;
-			while (accumulator >= step) {
-				if (++phys_ticks >= MAX_PHYSICS_TICKS) {
-					accumulator = 0.0;
-					break;
-				}
-				game->TimeStep(step);
+			double tick = step;
+			while (accumulator >= step && phys_ticks < MAX_PHYSICS_TICKS) {
+				tick = step * std::min(stepsPerTick, int(accumulator / step));
+				game->TimeStep(tick);
 				GeoSphere::UpdateAllGeoSpheres();
 
-				accumulator -= step;
+				accumulator -= tick;
+				phys_ticks++;
 			}
+			// what's left over is taken next frame, but no more than a frame
+			// of the longest ticks can clear, or a slow patch would leave us
+			// running behind for ever
+			accumulator = std::min(accumulator, double(MAX_PHYSICS_TICKS * MAX_STEPS_PER_TICK) * step);
+
 			// rendering interpolation between frames: don't use when docked
 			int pstate = Pi::game->GetPlayer()->GetFlightState();
 			if (pstate == Ship::DOCKED || pstate == Ship::DOCKING) Pi::gameTickAlpha = 1.0;
-			else Pi::gameTickAlpha = accumulator / step;
+			else Pi::gameTickAlpha = std::min(accumulator / tick, 1.0);
 
 #if WITH_DEVKEYS
 			phys_stat += phys_ticks;
@@ -1891,18 +1958,31 @@ void Pi::MainLoop()
 			int lua_memKB = int(lua_mem >> 10) % 1024;
 			int lua_memMB = int(lua_mem >> 20);
 
+			const UI::Context::FrameStats &uiStats = Pi::ui->GetFrameStats();
+
 			snprintf(
 				fps_readout, sizeof(fps_readout),
-				"%d fps (%.1f ms/f), %d phys updates, %d triangles, %.3f M tris/sec, %d terrain vtx/sec, %d glyphs/sec\n"
-				"Lua mem usage: %d MB + %d KB + %d bytes",
+				"%d fps (%.1f ms/f), %d phys updates, %d triangles, %.3f M tris/sec, %d terrain vtx/sec, %d glyphs/sec, %d/%d text runs cached/built/sec\n"
+				"Lua mem usage: %d MB + %d KB + %d bytes\n"
+				"UI widgets/frame: %d laid out, %d drawn, %d redrawn\n"
+				"Bodies: %d, ships on rails: %d, sub-stepped: %d\n"
+				"Terrain heights/sec: %d from heightmaps, %d cached",
 				frame_stat, (1000.0/frame_stat), phys_stat, Pi::statSceneTris, Pi::statSceneTris*frame_stat*1e-6,
 				GeoSphere::GetVtxGenCount(), Text::TextureFont::GetGlyphCount(),
-				lua_memMB, lua_memKB, lua_memB
+				Text::TextureFont::GetRunCacheHits(), Text::TextureFont::GetRunCacheMisses(),
+				lua_memMB, lua_memKB, lua_memB,
+				uiStats.widgetsLaidOut, uiStats.widgetsDrawn, uiStats.widgetsRedrawn,
+				Pi::game->GetSpace()->GetNumBodies(), Pi::game->GetSpace()->GetNumShipsOnRails(),
+				Pi::game->GetSpace()->GetNumSubSteppedBodies(),
+				GeoSphere::GetGeneratedHeightCount(), TerrainHeightCache::GetHitCount()
 			);
 			frame_stat = 0;
 			phys_stat = 0;
 			Text::TextureFont::ClearGlyphCount();
+			Text::TextureFont::ClearRunCacheStats();
 			GeoSphere::ClearVtxGenCount();
+			GeoSphere::ClearGeneratedHeightCount();
+			TerrainHeightCache::ClearHitCount();
 			if (SDL_GetTicks() - last_stats > 1200) last_stats = SDL_GetTicks();
 			else last_stats += 1000;
 		}
@@ -165,10 +165,25 @@ void Player::NotifyRemoved(const Body* const removedBody)
 		if (!GetNavTarget() && removedBody->IsType(Object::SHIP))
 			SetNavTarget(static_cast<const Ship*>(removedBody)->GetHyperspaceCloud());
 	}
+	if (m_sensors)
+		m_sensors->NotifyRemoved(removedBody);
 	Ship::NotifyRemoved(removedBody);
 	Tweaker::NotifyRemoved(removedBody);
 }
 
+void Player::NotifyAdded(Body *addedBody)
+{
+	if (m_sensors)
+		m_sensors->NotifyAdded(addedBody);
+}
+
+void Player::NotifyLeftSpace()
+{
+	if (m_sensors)
+		m_sensors->Clear();
+	Ship::NotifyLeftSpace();
+}
+
 //XXX ui stuff
 void Player::OnEnterHyperspace()
 {
@@ -58,6 +58,13 @@ public:
 	virtual Missile * SpawnMissile(ShipType::Id missile_type, int power=-1);
 	virtual void SetAlertState(Ship::AlertState as);
 	virtual void NotifyRemoved(const Body* const removedBody);
+	// the sensors keep track of everything in the space, and the tweaker
+	// and the targets can point at anything, so the player hears about
+	// every body coming and going
+	virtual bool ObservesAllRemovals() const { return true; }
+	virtual bool ObservesAdditions() const { return true; }
+	virtual void NotifyAdded(Body *addedBody);
+	virtual void NotifyLeftSpace();
 
 	PlayerShipController *GetPlayerController() const;
 	//XXX temporary things to avoid causing too many changes right now
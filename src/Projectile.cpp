@@ -13,9 +13,9 @@
 #include "Planet.h"
 #include "Sfx.h"
 #include "Ship.h"
-#include "Pi.h"
 #include "Game.h"
 #include "LuaEvent.h"
+#include "graphics/Frustum.h"
 #include "graphics/Graphics.h"
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
@@ -23,6 +23,8 @@
 #include "graphics/TextureBuilder.h"
 #include "MainMaterial.h"
 
+std::vector<Projectile::TemplateVert> Projectile::s_sideTemplate;
+std::vector<Projectile::TemplateVert> Projectile::s_glowTemplate;
 std::unique_ptr<Graphics::VertexArray> Projectile::s_sideVerts;
 std::unique_ptr<Graphics::VertexArray> Projectile::s_glowVerts;
 std::unique_ptr<Graphics::Material> Projectile::s_sideMat;
@@ -34,6 +36,7 @@ void Projectile::BuildModel()
 	//set up materials
 	Graphics::MaterialDescriptor desc;
 	desc.textures = 1;
+	desc.vertexColors = true;
 	if(Graphics::Hardware::GL3()) {
 		s_sideMat.reset(new MainMaterial(Pi::renderer, desc));
 		s_glowMat.reset(new MainMaterial(Pi::renderer, desc));
@@ -61,18 +64,20 @@ void Projectile::BuildModel()
 	const vector2f botLeft(0.f, 0.f);
 	const vector2f botRight(1.f, 0.f);
 
-	s_sideVerts.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0));
-	s_glowVerts.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0));
+	s_sideVerts.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0));
+	s_glowVerts.reset(new Graphics::VertexArray(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_DIFFUSE | Graphics::ATTRIB_UV0));
+	s_sideTemplate.clear();
+	s_glowTemplate.clear();
 
 	//add four intersecting planes to create a volumetric effect
 	for (int i=0; i < 4; i++) {
-		s_sideVerts->Add(one, topLeft);
-		s_sideVerts->Add(two, topRight);
-		s_sideVerts->Add(three, botRight);
+		s_sideTemplate.push_back({ one, topLeft });
+		s_sideTemplate.push_back({ two, topRight });
+		s_sideTemplate.push_back({ three, botRight });
 
-		s_sideVerts->Add(three, botRight);
-		s_sideVerts->Add(four, botLeft);
-		s_sideVerts->Add(one, topLeft);
+		s_sideTemplate.push_back({ three, botRight });
+		s_sideTemplate.push_back({ four, botLeft });
+		s_sideTemplate.push_back({ one, topLeft });
 
 		one.ArbRotate(vector3f(0.f, 0.f, 1.f), DEG2RAD(45.f));
 		two.ArbRotate(vector3f(0.f, 0.f, 1.f), DEG2RAD(45.f));
@@ -85,13 +90,13 @@ void Projectile::BuildModel()
 	float gz = -0.1f;
 
 	for (int i=0; i < 4; i++) {
-		s_glowVerts->Add(vector3f(-gw, -gw, gz), topLeft);
-		s_glowVerts->Add(vector3f(-gw, gw, gz), topRight);
-		s_glowVerts->Add(vector3f(gw, gw, gz), botRight);
+		s_glowTemplate.push_back({ vector3f(-gw, -gw, gz), topLeft });
+		s_glowTemplate.push_back({ vector3f(-gw, gw, gz), topRight });
+		s_glowTemplate.push_back({ vector3f(gw, gw, gz), botRight });
 
-		s_glowVerts->Add(vector3f(gw, gw, gz), botRight);
-		s_glowVerts->Add(vector3f(gw, -gw, gz), botLeft);
-		s_glowVerts->Add(vector3f(-gw, -gw, gz), topLeft);
+		s_glowTemplate.push_back({ vector3f(gw, gw, gz), botRight });
+		s_glowTemplate.push_back({ vector3f(gw, -gw, gz), botLeft });
+		s_glowTemplate.push_back({ vector3f(-gw, -gw, gz), topLeft });
 
 		gw -= 0.1f; // they get smaller
 		gz -= 0.2f; // as they move back
@@ -112,79 +117,125 @@ void Projectile::FreeModel()
 	s_glowVerts.reset();
 }
 
-Projectile::Projectile(): Body()
+void ProjectilePool::Push(Body *parent_, int type_, const vector3d &pos_, const vector3d &vel_, const vector3d &dirVel_)
 {
-	if (!s_sideMat) BuildModel();
-	SetOrient(matrix3x3d::Identity());
-	m_type = 1;
-	m_age = 0;
-	m_parent = 0;
-	m_flags |= FLAG_DRAW_LAST;
+	pos.push_back(pos_);
+	vel.push_back(vel_);
+	dirVel.push_back(dirVel_);
+	age.push_back(0.0f);
+	type.push_back(Uint8(type_));
+	parent.push_back(parent_);
 }
 
-Projectile::~Projectile()
+void ProjectilePool::Remove(size_t i)
 {
+	const size_t last = Size() - 1;
+	if (i != last) {
+		pos[i] = pos[last];
+		vel[i] = vel[last];
+		dirVel[i] = dirVel[last];
+		age[i] = age[last];
+		type[i] = type[last];
+		parent[i] = parent[last];
+	}
+	pos.pop_back();
+	vel.pop_back();
+	dirVel.pop_back();
+	age.pop_back();
+	type.pop_back();
+	parent.pop_back();
 }
 
-void Projectile::Save(Serializer::Writer &wr, Space *space)
+void Projectile::Serialize(Serializer::Writer &wr, const Frame *f, Space *space)
 {
-	Body::Save(wr, space);
-	wr.Vector3d(m_baseVel);
-	wr.Vector3d(m_dirVel);
-	wr.Float(m_age);
-	wr.Int32(m_type);
-	wr.Int32(space->GetIndexForBody(m_parent));
+	const ProjectilePool *p = f->m_projectiles;
+	const Uint32 count = p ? p->Size() : 0;
+	wr.Int32(count);
+	for (Uint32 i = 0; i < count; i++) {
+		wr.Vector3d(p->pos[i]);
+		wr.Vector3d(p->vel[i]);
+		wr.Vector3d(p->dirVel[i]);
+		wr.Float(p->age[i]);
+		wr.Int32(p->type[i]);
+		wr.Int32(space->GetIndexForBody(p->parent[i]));
+	}
 }
 
-void Projectile::Load(Serializer::Reader &rd, Space *space)
+void Projectile::Unserialize(Serializer::Reader &rd, Frame *f)
 {
-	Body::Load(rd, space);
-	m_baseVel = rd.Vector3d();
-	m_dirVel = rd.Vector3d();
-	m_age = rd.Float();
-	m_type = rd.Int32();
-	m_parentIndex = rd.Int32();
+	const Uint32 count = rd.Int32();
+	if (!count) return;
+
+	if (!f->m_projectiles) f->m_projectiles = new ProjectilePool;
+	ProjectilePool *p = f->m_projectiles;
+	for (Uint32 i = 0; i < count; i++) {
+		const vector3d pos = rd.Vector3d();
+		const vector3d vel = rd.Vector3d();
+		const vector3d dirVel = rd.Vector3d();
+		const float age = rd.Float();
+		const int type = rd.Int32();
+		p->Push(0, type, pos, vel, dirVel);
+		p->age.back() = age;
+		p->parentIndex.push_back(rd.Int32());
+	}
 }
 
-void Projectile::PostLoadFixup(Space *space)
+void Projectile::UnserializeBody(Serializer::Reader &rd, Space *space)
 {
-	Body::PostLoadFixup(space);
-	m_parent = space->GetBodyByIndex(m_parentIndex);
+	// Body::Load
+	Frame *f = space->GetFrameByIndex(rd.Int32());
+	rd.String();	// label
+	rd.Bool();		// dead
+	const vector3d pos = rd.Vector3d();
+	for (int i=0; i<9+2; i++) rd.Double();	// orientation, radii
+
+	const vector3d baseVel = rd.Vector3d();
+	const vector3d dirVel = rd.Vector3d();
+	const float age = rd.Float();
+	const int type = rd.Int32();
+	const int parentIndex = rd.Int32();
+	if (!f) return;
+
+	if (!f->m_projectiles) f->m_projectiles = new ProjectilePool;
+	ProjectilePool *p = f->m_projectiles;
+	p->Push(0, type, pos, baseVel + dirVel, dirVel);
+	p->age.back() = age;
+	p->parentIndex.push_back(parentIndex);
 }
 
-void Projectile::UpdateInterpTransform(double alpha)
+void Projectile::PostUnserializeFixup(Frame *f, Space *space)
 {
-	m_interpOrient = GetOrient();
-	const vector3d oldPos = GetPosition() - (m_baseVel+m_dirVel)*Pi::game->GetTimeStep();
-	m_interpPos = alpha*GetPosition() + (1.0-alpha)*oldPos;
+	ProjectilePool *p = f->m_projectiles;
+	if (!p) return;
+	for (size_t i = 0; i < p->parentIndex.size(); i++)
+		p->parent[i] = space->GetBodyByIndex(p->parentIndex[i]);
+	p->parentIndex.clear();
 }
 
-void Projectile::NotifyRemoved(const Body* const removedBody)
+void Projectile::NotifyRemovedAll(const Body *removedBody, Frame *f)
 {
-	if (m_parent == removedBody) m_parent = 0;
-}
+	ProjectilePool *p = f->m_projectiles;
+	if (p) {
+		for (size_t i = 0; i < p->Size(); i++)
+			if (p->parent[i] == removedBody) p->parent[i] = 0;
+	}
 
-void Projectile::TimeStepUpdate(const float timeStep)
-{
-	m_age += timeStep;
-	SetPosition(GetPosition() + (m_baseVel+m_dirVel) * double(timeStep));
-	if (m_age > Equip::lasers[m_type].lifespan) Pi::game->GetSpace()->KillBody(this);
+	for (Frame* kid : f->GetChildren())
+		NotifyRemovedAll(removedBody, kid);
 }
 
 /* In hull kg */
-float Projectile::GetDamage() const
+static float GetDamage(int type, float age)
 {
-	float dam = Equip::lasers[m_type].damage;
-	float lifespan = Equip::lasers[m_type].lifespan;
-	return dam * sqrt((lifespan - m_age)/lifespan);
-	// TEST
-//	return 0.01f;
+	float dam = Equip::lasers[type].damage;
+	float lifespan = Equip::lasers[type].lifespan;
+	return dam * sqrt((lifespan - age)/lifespan);
 }
 
-double Projectile::GetRadius() const
+static double GetRadius(int type)
 {
-	float length = Equip::lasers[m_type].length;
-	float width = Equip::lasers[m_type].width;
+	float length = Equip::lasers[type].length;
+	float width = Equip::lasers[type].width;
 	return sqrt(length*length + width*width);
 }
 
@@ -212,88 +263,136 @@ static void MiningLaserSpawnTastyStuff(Frame *f, const SystemBody *asteroid, con
 	Pi::game->GetSpace()->AddBody(cargo);
 }
 
-void Projectile::StaticUpdate(const float timeStep)
+// per-step scratch for StaticUpdateAll
+static std::vector<vector3d> s_rayDirs;
+static std::vector<double> s_rayLens;
+static std::vector<CollisionContact> s_contacts;
+static std::vector<size_t> s_spent;
+
+void Projectile::StaticUpdateAll(const float timeStep, Frame *f)
 {
-	CollisionContact c;
-	vector3d vel = (m_baseVel+m_dirVel) * timeStep;
-	GetFrame()->GetCollisionSpace()->TraceRay(GetPosition(), vel.Normalized(), vel.Length(), &c, 0);
+	PROFILE_SCOPED()
+	ProjectilePool *p = f->m_projectiles;
+	if (p && p->Size()) {
+		// damage can spill cargo and fire events, but never adds bolts to
+		// this frame, so the count holds
+		const size_t count = p->Size();
+
+		s_rayDirs.resize(count);
+		s_rayLens.resize(count);
+		s_contacts.assign(count, CollisionContact());
+		for (size_t i = 0; i < count; i++) {
+			const vector3d vel = p->vel[i] * double(timeStep);
+			s_rayLens[i] = vel.Length();
+			s_rayDirs[i] = vel.Normalized();
+		}
+		f->GetCollisionSpace()->TraceRays(count, &p->pos[0], &s_rayDirs[0], &s_rayLens[0], &s_contacts[0]);
 
-	if (c.userData1) {
-		Object *o = static_cast<Object*>(c.userData1);
+		Planet *planet = 0;
+		if (f->GetBody() && f->GetBody()->IsType(Object::PLANET))
+			planet = static_cast<Planet*>(f->GetBody());
 
-		if (o->IsType(Object::CITYONPLANET)) {
-			Pi::game->GetSpace()->KillBody(this);
-		}
-		else if (o->IsType(Object::BODY)) {
-			Body *hit = static_cast<Body*>(o);
-			if (hit != m_parent) {
-				hit->OnDamage(m_parent, GetDamage(), c);
-				Pi::game->GetSpace()->KillBody(this);
-				if (hit->IsType(Object::SHIP))
-					LuaEvent::Queue("onShipHit", dynamic_cast<Ship*>(hit), dynamic_cast<Body*>(m_parent));
+		s_spent.clear();
+		for (size_t i = 0; i < count; i++) {
+			const CollisionContact &c = s_contacts[i];
+			const int type = p->type[i];
+			Body *parent = p->parent[i];
+
+			if (c.userData1) {
+				Object *o = static_cast<Object*>(c.userData1);
+
+				if (o->IsType(Object::CITYONPLANET)) {
+					s_spent.push_back(i);
+					continue;
+				}
+				else if (o->IsType(Object::BODY)) {
+					Body *hit = static_cast<Body*>(o);
+					if (hit != parent) {
+						hit->OnDamage(parent, GetDamage(type, p->age[i]), c);
+						s_spent.push_back(i);
+						if (hit->IsType(Object::SHIP))
+							LuaEvent::Queue("onShipHit", dynamic_cast<Ship*>(hit), parent);
+						continue;
+					}
+				}
 			}
-		}
-	}
-	if (Equip::lasers[m_type].flags & Equip::LASER_MINING) {
-		// need to test for terrain hit
-		if (GetFrame()->GetBody() && GetFrame()->GetBody()->IsType(Object::PLANET)) {
-			Planet *const planet = static_cast<Planet*>(GetFrame()->GetBody());
-			const SystemBody *b = planet->GetSystemBody();
-			vector3d pos = GetPosition();
-			double terrainHeight = planet->GetTerrainHeight(pos.Normalized());
-			if (terrainHeight > pos.Length()) {
-				// hit the fucker
-				if (b->GetType() == SystemBody::TYPE_PLANET_ASTEROID) {
-					vector3d n = GetPosition().Normalized();
-					MiningLaserSpawnTastyStuff(planet->GetFrame(), b, n*terrainHeight + 5.0*n);
-					Sfx::Add(this, Sfx::TYPE_EXPLOSION);
+			if (planet && (Equip::lasers[type].flags & Equip::LASER_MINING)) {
+				// need to test for terrain hit
+				const SystemBody *b = planet->GetSystemBody();
+				const vector3d pos = p->pos[i];
+				double terrainHeight = planet->GetTerrainHeightApprox(pos.Normalized(), 1.0);
+				if (terrainHeight > pos.Length()) {
+					// hit the fucker
+					if (b->GetType() == SystemBody::TYPE_PLANET_ASTEROID) {
+						vector3d n = pos.Normalized();
+						MiningLaserSpawnTastyStuff(planet->GetFrame(), b, n*terrainHeight + 5.0*n);
+						Sfx::Add(f, pos, vector3d(0.0), Sfx::TYPE_EXPLOSION);
+					}
+					s_spent.push_back(i);
 				}
-				Pi::game->GetSpace()->KillBody(this);
 			}
 		}
+
+		// back to front, so the bolts swapped into place are never spent ones
+		for (std::vector<size_t>::reverse_iterator it = s_spent.rbegin(); it != s_spent.rend(); ++it)
+			p->Remove(*it);
+	}
+
+	for (Frame* kid : f->GetChildren())
+		StaticUpdateAll(timeStep, kid);
+}
+
+void Projectile::TimeStepAll(const float timeStep, Frame *f)
+{
+	PROFILE_SCOPED()
+	ProjectilePool *p = f->m_projectiles;
+	if (p) {
+		p->lastStep = timeStep;
+		for (size_t i = p->Size(); i-- > 0; ) {
+			p->age[i] += timeStep;
+			if (p->age[i] > Equip::lasers[p->type[i]].lifespan)
+				p->Remove(i);
+			else
+				p->pos[i] += p->vel[i] * double(timeStep);
+		}
 	}
+
+	for (Frame* kid : f->GetChildren())
+		TimeStepAll(timeStep, kid);
 }
 
-void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform)
+void Projectile::BatchBolt(const vector3d &viewPos, const vector3d &viewDir, int type, float age)
 {
-	vector3d _from = viewTransform * GetInterpPosition();
-	vector3d _to = viewTransform * (GetInterpPosition() + m_dirVel);
-	vector3d _dir = _to - _from;
-	vector3f from(&_from.x);
-	vector3f dir = vector3f(_dir).Normalized();
+	const vector3f from(&viewPos.x);
+	const vector3f dir = vector3f(viewDir).Normalized();
 
 	vector3f v1, v2;
-	matrix4x4f m = matrix4x4f::Identity();
 	v1.x = dir.y; v1.y = dir.z; v1.z = dir.x;
 	v2 = v1.Cross(dir).Normalized();
 	v1 = v2.Cross(dir);
-	m[0] = v1.x; m[4] = v2.x; m[8] = dir.x;
-	m[1] = v1.y; m[5] = v2.y; m[9] = dir.y;
-	m[2] = v1.z; m[6] = v2.z; m[10] = dir.z;
-
-	m[12] = from.x;
-	m[13] = from.y;
-	m[14] = from.z;
 
 	// increase visible size based on distance from camera, z is always negative
 	// allows them to be smaller while maintaining visibility for game play
-	const float dist_scale = float(viewCoords.z / -500);
-	const float length = Equip::lasers[m_type].length + dist_scale;
-	const float width = Equip::lasers[m_type].width + dist_scale;
+	const float dist_scale = float(viewPos.z / -500);
+	const float length = Equip::lasers[type].length + dist_scale;
+	const float width = Equip::lasers[type].width + dist_scale;
 
-	renderer->SetTransform(m * matrix4x4f::ScaleMatrix(width, width, length));
+	// same as transforming the template by [v1 v2 dir from] * scale(width, width, length)
+	const vector3f ax = v1 * width;
+	const vector3f ay = v2 * width;
+	const vector3f az = dir * length;
 
-	Color color = Equip::lasers[m_type].color;
+	Color color = Equip::lasers[type].color;
 	// fade them out as they age so they don't suddenly disappear
 	// this matches the damage fall-off calculation
-	const float base_alpha = sqrt(1.0f - m_age/Equip::lasers[m_type].lifespan);
+	const float base_alpha = sqrt(1.0f - age/Equip::lasers[type].lifespan);
 	// fade out side quads when viewing nearly edge on
-	vector3f view_dir = vector3f(viewCoords).Normalized();
+	vector3f view_dir = vector3f(viewPos).Normalized();
 	color.a = (base_alpha * (1.f - powf(fabs(dir.Dot(view_dir)), length))) * 255;
 
 	if (color.a > 3) {
-		s_sideMat->diffuse = color;
-		renderer->DrawTriangles(s_sideVerts.get(), s_renderState, s_sideMat.get());
+		for (const TemplateVert &v : s_sideTemplate)
+			s_sideVerts->Add(from + ax*v.pos.x + ay*v.pos.y + az*v.pos.z, color, v.uv);
 	}
 
 	// fade out glow quads when viewing nearly edge on
@@ -302,23 +401,56 @@ void Projectile::Render(Graphics::Renderer *renderer, const Camera *camera, cons
 	color.a = (base_alpha * powf(fabs(dir.Dot(view_dir)), width)) * 255;
 
 	if (color.a > 3) {
-		s_glowMat->diffuse = color;
-		renderer->DrawTriangles(s_glowVerts.get(), s_renderState, s_glowMat.get());
+		for (const TemplateVert &v : s_glowTemplate)
+			s_glowVerts->Add(from + ax*v.pos.x + ay*v.pos.y + az*v.pos.z, color, v.uv);
 	}
 }
 
+void Projectile::BatchFrame(Frame *f, const Graphics::Frustum &frustum, const Frame *camFrame)
+{
+	const ProjectilePool *p = f->m_projectiles;
+	if (p && p->Size()) {
+		matrix4x4d ftran;
+		Frame::GetFrameTransform(f, camFrame, ftran);
+
+		// draw between physics ticks, like bodies do
+		const double backStep = (1.0 - Pi::GetGameTickAlpha()) * p->lastStep;
+
+		for (size_t i = 0; i < p->Size(); i++) {
+			const int type = p->type[i];
+			const vector3d viewPos = ftran * (p->pos[i] - p->vel[i] * backStep);
+			if (!frustum.TestPointInfinite(viewPos, GetRadius(type)))
+				continue;
+			BatchBolt(viewPos, ftran.ApplyRotationOnly(p->dirVel[i]), type, p->age[i]);
+		}
+	}
+
+	for (Frame* kid : f->GetChildren())
+		BatchFrame(kid, frustum, camFrame);
+}
+
+void Projectile::RenderAll(Graphics::Renderer *renderer, const Graphics::Frustum &frustum, Frame *f, const Frame *camFrame)
+{
+	PROFILE_SCOPED()
+	if (!s_sideMat) BuildModel();
+
+	s_sideVerts->Clear();
+	s_glowVerts->Clear();
+	BatchFrame(f, frustum, camFrame);
+	if (!s_sideVerts->GetNumVerts() && !s_glowVerts->GetNumVerts()) return;
+
+	// the batches are already in camera space
+	Graphics::Renderer::MatrixTicket mt(renderer, Graphics::MatrixMode::MODELVIEW);
+	renderer->SetTransform(matrix4x4f::Identity());
+	if (s_sideVerts->GetNumVerts())
+		renderer->DrawTriangles(s_sideVerts.get(), s_renderState, s_sideMat.get());
+	if (s_glowVerts->GetNumVerts())
+		renderer->DrawTriangles(s_glowVerts.get(), s_renderState, s_glowMat.get());
+}
+
 void Projectile::Add(Body *parent, Equip::Type type, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel)
 {
-	Projectile *p = new Projectile();
-	p->m_parent = parent;
-	p->m_type = Equip::types[type].tableIndex;
-	p->SetFrame(parent->GetFrame());
-
-	p->SetOrient(parent->GetOrient());
-	p->SetPosition(pos);
-	p->m_baseVel = baseVel;
-	p->m_dirVel = dirVel;
-	p->SetClipRadius(p->GetRadius());
-	p->SetPhysRadius(p->GetRadius());
-	Pi::game->GetSpace()->AddBody(p);
+	Frame *f = parent->GetFrame();
+	if (!f->m_projectiles) f->m_projectiles = new ProjectilePool;
+	f->m_projectiles->Push(parent, Equip::types[type].tableIndex, pos, baseVel + dirVel, dirVel);
 }
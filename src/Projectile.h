@@ -5,50 +5,75 @@
 #define _PROJECTILE_H
 
 #include "libs.h"
-#include "Body.h"
 #include "EquipType.h"
+#include "Serializer.h"
 #include "graphics/Material.h"
 #include "graphics/RenderState.h"
 
+class Body;
 class Frame;
+class Space;
 namespace Graphics {
+	class Frustum;
 	class Renderer;
 	class VertexArray;
 }
 
-class Projectile: public Body {
-public:
-	OBJDEF(Projectile, Body, PROJECTILE);
+// Laser bolts in one frame. Bolts aren't bodies, a big fight has thousands
+// of them in flight, so they're kept here one array per field and updated,
+// collided and drawn a whole frame at a time. Order is not stable, removing
+// a bolt moves the last one into its place.
+struct ProjectilePool {
+	ProjectilePool() : lastStep(0.0f) {}
+
+	size_t Size() const { return pos.size(); }
+	void Push(Body *parent, int type, const vector3d &pos, const vector3d &vel, const vector3d &dirVel);
+	void Remove(size_t i);
+
+	std::vector<vector3d> pos;
+	std::vector<vector3d> vel;		// firing ship's velocity plus the bolt's own
+	std::vector<vector3d> dirVel;	// the bolt's own, points the way it's drawn
+	std::vector<float> age;
+	std::vector<Uint8> type;		// index into Equip::lasers
+	std::vector<Body*> parent;		// may be null once the ship that fired it is gone
+
+	std::vector<int> parentIndex;	// deserialisation
+
+	float lastStep;		// how far TimeStepAll last moved them, for drawing between ticks
+};
 
+class Projectile {
+public:
 	static void Add(Body *parent, Equip::Type type, const vector3d &pos, const vector3d &baseVel, const vector3d &dirVel);
 
-	Projectile();
-	virtual ~Projectile();
-	virtual void Render(Graphics::Renderer *r, const Camera *camera, const vector3d &viewCoords, const matrix4x4d &viewTransform);
-	void TimeStepUpdate(const float timeStep);
-	void StaticUpdate(const float timeStep);
-	virtual void NotifyRemoved(const Body* const removedBody);
-	virtual void UpdateInterpTransform(double alpha);
-	virtual void PostLoadFixup(Space *space);
+	// hit testing, before the bodies move
+	static void StaticUpdateAll(const float timeStep, Frame *f);
+	// flight and expiry, after the bodies move
+	static void TimeStepAll(const float timeStep, Frame *f);
+	static void RenderAll(Graphics::Renderer *r, const Graphics::Frustum &frustum, Frame *f, const Frame *camFrame);
+	static void NotifyRemovedAll(const Body *removedBody, Frame *f);
+
+	static void Serialize(Serializer::Writer &wr, const Frame *f, Space *space);
+	static void Unserialize(Serializer::Reader &rd, Frame *f);
+	static void PostUnserializeFixup(Frame *f, Space *space);
+	// a bolt saved as a body, before version 82. Goes in its frame's pool
+	static void UnserializeBody(Serializer::Reader &rd, Space *space);
 
 	static void FreeModel();
 
-protected:
-	virtual void Save(Serializer::Writer &wr, Space *space);
-	virtual void Load(Serializer::Reader &rd, Space *space);
 private:
-	float GetDamage() const;
-	double GetRadius() const;
-	Body *m_parent;
-	vector3d m_baseVel;
-	vector3d m_dirVel;
-	float m_age;
-	int m_type;
-
-	int m_parentIndex; // deserialisation
-
 	static void BuildModel();
+	static void BatchFrame(Frame *f, const Graphics::Frustum &frustum, const Frame *camFrame);
+	static void BatchBolt(const vector3d &viewPos, const vector3d &viewDir, int type, float age);
+
+	struct TemplateVert {
+		vector3f pos;
+		vector2f uv;
+	};
+	static std::vector<TemplateVert> s_sideTemplate;
+	static std::vector<TemplateVert> s_glowTemplate;
 
+	// every visible bolt, in camera space, drawn with one call per material
 	static std::unique_ptr<Graphics::VertexArray> s_sideVerts;
 	static std::unique_ptr<Graphics::VertexArray> s_glowVerts;
 	static std::unique_ptr<Graphics::Material> s_sideMat;
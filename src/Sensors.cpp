@@ -48,17 +48,28 @@ bool Sensors::ContactDistanceSort(const RadarContact &a, const RadarContact &b)
 }
 
 Sensors::Sensors(Ship *owner)
+: m_contactsSorted(true)
 {
 	m_owner = owner;
 }
 
+const Sensors::ContactList &Sensors::GetContactsByDistance()
+{
+	if (!m_contactsSorted) {
+		std::sort(m_radarContacts.begin(), m_radarContacts.end(), ContactDistanceSort);
+		RebuildIndex();
+		m_contactsSorted = true;
+	}
+	return m_radarContacts;
+}
+
 bool Sensors::ChooseTarget(TargetingCriteria crit)
 {
 	bool found = false;
 
-	m_radarContacts.sort(ContactDistanceSort);
+	const ContactList &contacts = GetContactsByDistance();
 
-	for (auto it = m_radarContacts.begin(); it != m_radarContacts.end(); ++it) {
+	for (auto it = contacts.begin(); it != contacts.end(); ++it) {
 		//match object type
 		//match iff
 		if (it->body->IsType(Object::SHIP)) {
@@ -87,62 +98,146 @@ Sensors::IFF Sensors::CheckIFF(Body* other)
 	}
 }
 
+// same range as the scanner
+static const double SENSOR_RANGE = 100000.0;
+
+// distance is the same in any frame, so rather than transforming every ship
+// into ours we put ourselves into each ship's frame. ships are nearly always
+// in one of a handful of frames
 void Sensors::Update(float time)
 {
 	if (m_owner != Pi::player) return;
 
-	PopulateStaticContacts(); //no need to do all the time
-
-	//Find nearby contacts, same range as scanner. Scanner should use these
-	//contacts, worldview labels too.
-	Space::BodyNearList nearby;
-	Pi::game->GetSpace()->GetBodiesMaybeNear(m_owner, 100000.0f, nearby);
-	for (Space::BodyNearIterator i = nearby.begin(); i != nearby.end(); ++i) {
-		if ((*i) == m_owner || !(*i)->IsType(Object::SHIP)) continue;
-		if ((*i)->IsDead()) continue;
+	std::vector< std::pair<const Frame*,vector3d> > ownerPos;
 
-		Ship* ship = static_cast<Ship*>((*i));
+	for (auto it = m_ships.begin(); it != m_ships.end(); ++it) {
+		Body *b = *it;
+		const Frame *f = b->GetFrame();
 
-		auto cit = m_radarContacts.begin();
-		while (cit != m_radarContacts.end()) {
-			if (cit->body == (*i)) break;
-			++cit;
+		auto pos = ownerPos.begin();
+		while (pos != ownerPos.end() && pos->first != f)
+			++pos;
+		if (pos == ownerPos.end()) {
+			ownerPos.push_back(std::make_pair(f, m_owner->GetPositionRelTo(f)));
+			pos = ownerPos.end()-1;
 		}
 
-		//create new contact or refresh old
-		if (cit == m_radarContacts.end()) {
-			m_radarContacts.push_back(RadarContact());
-			RadarContact &rc = m_radarContacts.back();
-			rc.body = (*i);
-			rc.ship = ship;
-			rc.iff = CheckIFF(rc.body);
-			rc.ship->ClearThrusterTrails();
-		} else {
-			cit->fresh = true;
+		const double dist = (b->GetPosition() - pos->second).Length();
+		const bool inRange = dist <= SENSOR_RANGE && !b->IsDead();
+
+		//create new contact, refresh old, or drop it once it's out of range
+		auto cit = m_contactIndex.find(b);
+		if (cit == m_contactIndex.end()) {
+			if (inRange)
+				AddContact(b, dist);
+		} else if (inRange)
+			m_radarContacts[cit->second].distance = dist;
+		else
+			RemoveContact(cit->second);
+	}
+
+	m_contactsSorted = m_radarContacts.size() < 2;
+}
+
+void Sensors::NotifyAdded(Body *addedBody)
+{
+	if (addedBody == m_owner) return;
+
+	if (addedBody->IsType(Object::SHIP)) {
+		m_shipIndex[addedBody] = m_ships.size();
+		m_ships.push_back(addedBody);
+		return;
+	}
+
+	switch (addedBody->GetType())
+	{
+		//things we know of regardless of range
+		case Object::STAR:
+		case Object::PLANET:
+		case Object::CITYONPLANET:
+		case Object::SPACESTATION:
+			m_staticContacts.push_back(RadarContact(addedBody));
+			break;
+		default:
+			break;
+	}
+}
+
+void Sensors::NotifyRemoved(const Body *removedBody)
+{
+	auto it = m_contactIndex.find(removedBody);
+	if (it != m_contactIndex.end())
+		RemoveContact(it->second);
+
+	auto sit = m_shipIndex.find(removedBody);
+	if (sit != m_shipIndex.end()) {
+		const size_t idx = sit->second;
+		m_shipIndex.erase(sit);
+		if (idx != m_ships.size()-1) {
+			m_ships[idx] = m_ships.back();
+			m_shipIndex[m_ships[idx]] = idx;
 		}
+		m_ships.pop_back();
+		return;
 	}
 
-	//update contacts and delete stale ones
-	auto it = m_radarContacts.begin();
-	while (it != m_radarContacts.end()) {
-		if (!it->fresh) {
-			m_radarContacts.erase(it++);
-		} else {
-			it->distance = m_owner->GetPositionRelTo(it->body).Length();
-			it->fresh = false;
-			++it;
+	for (auto sc = m_staticContacts.begin(); sc != m_staticContacts.end(); ++sc) {
+		if (sc->body == removedBody) {
+			m_staticContacts.erase(sc);
+			break;
 		}
 	}
 }
 
-void Sensors::UpdateIFF(Body *b)
+void Sensors::Clear()
 {
-	for (auto it = m_radarContacts.begin(); it != m_radarContacts.end(); ++it)
-	{
-		if (it->body == b) {
-			it->iff = CheckIFF(b);
-		}
+	m_radarContacts.clear();
+	m_contactIndex.clear();
+	m_contactsSorted = true;
+	m_staticContacts.clear();
+	m_ships.clear();
+	m_shipIndex.clear();
+}
+
+void Sensors::AddContact(Body *b, double distance)
+{
+	m_contactIndex[b] = m_radarContacts.size();
+
+	m_radarContacts.push_back(RadarContact(b));
+	RadarContact &rc = m_radarContacts.back();
+	rc.ship = static_cast<Ship*>(b);
+	rc.distance = distance;
+	rc.iff = CheckIFF(b);
+	rc.ship->ClearThrusterTrails();
+
+	m_contactsSorted = false;
+}
+
+// order doesn't matter until someone asks for it sorted, so the last contact
+// fills the hole
+void Sensors::RemoveContact(size_t idx)
+{
+	m_contactIndex.erase(m_radarContacts[idx].body);
+
+	if (idx != m_radarContacts.size()-1) {
+		m_radarContacts[idx] = m_radarContacts.back();
+		m_contactIndex[m_radarContacts[idx].body] = idx;
+		m_contactsSorted = false;
 	}
+	m_radarContacts.pop_back();
+}
+
+void Sensors::RebuildIndex()
+{
+	for (size_t i = 0; i < m_radarContacts.size(); i++)
+		m_contactIndex[m_radarContacts[i].body] = i;
+}
+
+void Sensors::UpdateIFF(Body *b)
+{
+	auto it = m_contactIndex.find(b);
+	if (it != m_contactIndex.end())
+		m_radarContacts[it->second].iff = CheckIFF(b);
 }
 
 void Sensors::ResetTrails()
@@ -154,24 +249,3 @@ void Sensors::ResetTrails()
 		}*/
 	}
 }
-
-void Sensors::PopulateStaticContacts()
-{
-	m_staticContacts.clear();
-
-	for (Body* b : Pi::game->GetSpace()->GetBodies()) {
-		switch (b->GetType())
-		{
-			case Object::STAR:
-			case Object::PLANET:
-			case Object::CITYONPLANET:
-			case Object::SPACESTATION:
-				break;
-			default:
-				continue;
-		}
-		m_staticContacts.push_back(RadarContact(b));
-		RadarContact &rc = m_staticContacts.back();
-		rc.fresh = true;
-	}
-}
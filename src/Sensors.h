@@ -14,6 +14,7 @@
  */
 #include "libs.h"
 #include "Body.h"
+#include <unordered_map>
 
 class Body;
 class Ship;
@@ -42,7 +43,7 @@ public:
 		bool fresh;
 	};
 
-	typedef std::list<RadarContact> ContactList;
+	typedef std::vector<RadarContact> ContactList;
 
 	static Color IFFColor(IFF);
 	static bool ContactDistanceSort(const RadarContact &a, const RadarContact &b);
@@ -50,18 +51,38 @@ public:
 	Sensors(Ship *owner);
 	bool ChooseTarget(TargetingCriteria);
 	IFF CheckIFF(Body *other);
+	// contacts in no particular order
 	const ContactList &GetContacts() { return m_radarContacts; }
+	// contacts nearest first. sorted on demand
+	const ContactList &GetContactsByDistance();
 	const ContactList &GetStaticContacts() { return m_staticContacts; }
 	void Update(float time);
 	void UpdateIFF(Body*);
 	void ResetTrails();
+	// the owner's space tells us about every body in it as it turns up, so
+	// there's no looking for them each update
+	void NotifyAdded(Body *addedBody);
+	// drop any contact for a body that is leaving the space
+	void NotifyRemoved(const Body *removedBody);
+	// forget everything, when the owner leaves the space
+	void Clear();
 
 private:
 	Ship *m_owner;
 	ContactList m_radarContacts;
 	ContactList m_staticContacts; //things we know of regardless of range
 
-	void PopulateStaticContacts();
+	// body -> index in m_radarContacts
+	std::unordered_map<const Body*, size_t> m_contactIndex;
+	bool m_contactsSorted;
+
+	// every ship in the space, in range or not, and where it is in m_ships
+	std::vector<Body*> m_ships;
+	std::unordered_map<const Body*, size_t> m_shipIndex;
+
+	void AddContact(Body *b, double distance);
+	void RemoveContact(size_t idx);
+	void RebuildIndex();
 };
 
 #endif
@@ -13,12 +13,12 @@
 #include "graphics/Material.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
+#include "graphics/VertexArray.h"
 #include "MainMaterial.h"
+#include <algorithm>
 
 using namespace Graphics;
 
-static const int MAX_SFX_PER_FRAME = 1024;
-
 Graphics::Drawables::Sphere3D *Sfx::explosionEffect = 0;
 Graphics::Material *Sfx::damageParticle = 0;
 Graphics::Material *Sfx::ecmParticle = 0;
@@ -28,193 +28,131 @@ Graphics::RenderState *Sfx::alphaState = nullptr;
 Graphics::RenderState *Sfx::additiveAlphaState = nullptr;
 Graphics::RenderState *Sfx::alphaOneState = nullptr;
 
-Sfx::Sfx()
-{
-	m_type = TYPE_NONE;
-}
-
-void Sfx::Save(Serializer::Writer &wr)
-{
-	wr.Vector3d(m_pos);
-	wr.Vector3d(m_vel);
-	wr.Float(m_age);
-	wr.Int32(m_type);
-}
+// how long each type lives, in seconds
+static const float s_lifetime[Sfx::TYPE_MAX] = { 0.0f, 3.2f, 2.0f, 8.0f };
+// sprite size when the caller doesn't have anything better
+static const float DEFAULT_SPRITE_SIZE = 100.0f;
 
-void Sfx::Load(Serializer::Reader &rd)
+void SfxPool::Batch::Push(const vector3d &pos_, const vector3d &vel_, float size_)
 {
-	m_pos = rd.Vector3d();
-	m_vel = rd.Vector3d();
-	m_age = rd.Float();
-	m_type = static_cast<Sfx::TYPE>(rd.Int32());
+	pos.push_back(pos_);
+	vel.push_back(vel_);
+	age.push_back(0.0f);
+	size.push_back(size_);
 }
 
-void Sfx::Serialize(Serializer::Writer &wr, const Frame *f)
+void SfxPool::Batch::Remove(size_t i)
 {
-	// how many sfx turds are active in frame?
-	int numActive = 0;
-	if (f->m_sfx) {
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) numActive++;
-		}
-	}
-	wr.Int32(numActive);
-
-	if (numActive) for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-		if (f->m_sfx[i].m_type != TYPE_NONE) {
-			f->m_sfx[i].Save(wr);
-		}
+	const size_t last = Size() - 1;
+	if (i != last) {
+		pos[i] = pos[last];
+		vel[i] = vel[last];
+		age[i] = age[last];
+		size[i] = size[last];
 	}
+	pos.pop_back();
+	vel.pop_back();
+	age.pop_back();
+	size.pop_back();
 }
 
-void Sfx::Unserialize(Serializer::Reader &rd, Frame *f)
+size_t SfxPool::Size() const
 {
-	int numActive = rd.Int32();
-	if (numActive) {
-		f->m_sfx = new Sfx[MAX_SFX_PER_FRAME];
-		for (int i=0; i<numActive; i++) {
-			f->m_sfx[i].Load(rd);
-		}
-	}
+	size_t count = 0;
+	for (int t = 0; t < Sfx::TYPE_MAX; t++)
+		count += batches[t].Size();
+	return count;
 }
 
-void Sfx::SetPosition(const vector3d &p)
+SfxPool *Sfx::GetPool(Frame *f)
 {
-	m_pos = p;
+	if (!f->m_sfx) f->m_sfx = new SfxPool;
+	return f->m_sfx;
 }
 
-void Sfx::TimeStepUpdate(const float timeStep)
+void Sfx::AddParticle(Frame *f, TYPE t, const vector3d &pos, const vector3d &vel, float size)
 {
-	PROFILE_SCOPED()
-	m_age += timeStep;
-	m_pos += m_vel * double(timeStep);
-
-	switch (m_type) {
-		case TYPE_EXPLOSION:
-			if (m_age > 3.2) m_type = TYPE_NONE;
-			break;
-		case TYPE_DAMAGE:
-			if (m_age > 2.0) m_type = TYPE_NONE;
-			break;
-		case TYPE_SMOKE:
-			if (m_age > 8.0)
-				m_type = TYPE_NONE;
-			break;
-		case TYPE_NONE: break;
-	}
+	if (t <= TYPE_NONE || t >= TYPE_MAX) return;
+	GetPool(f)->batches[t].Push(pos, vel, size);
 }
 
-void Sfx::Render(Renderer *renderer, const matrix4x4d &ftransform)
+void Sfx::Serialize(Serializer::Writer &wr, const Frame *f)
 {
-	PROFILE_SCOPED()
-	vector3d fpos = ftransform * GetPosition();
-	vector3f pos(&fpos.x);
-
-	switch (m_type) {
-		case TYPE_NONE: break;
-		case TYPE_EXPLOSION: {
-			/*//Explosion effect: A quick flash of three concentric coloured spheres. A bit retro.
-			const matrix4x4f trans = matrix4x4f::Translation(fpos.x, fpos.y, fpos.z);
-			RefCountedPtr<Material> exmat = Sfx::explosionEffect->GetMaterial();
-			exmat->diffuse = Color(255, 255, 128, 255);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(500*m_age));
-			Sfx::explosionEffect->Draw(renderer);
-			exmat->diffuse = Color(255, 128, 0, 168);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(750*m_age));
-			Sfx::explosionEffect->Draw(renderer);
-			exmat->diffuse = Color(255, 0, 0, 84);
-			renderer->SetTransform(trans * matrix4x4f::ScaleMatrix(1000*m_age));
-			Sfx::explosionEffect->Draw(renderer);
-			break;*/
-
-			renderer->SetTransform(matrix4x4d::Translation(fpos));
-			//explotionParticle->diffuse = Color(255, 255, 0, (1.0f-(m_age/3.5f))*255);
-			float spriteframe=m_age*20+1;
-			std::string fname="explotion/small/image"+std::to_string(static_cast<int>(spriteframe))+".png";
-			explotionParticle->texture0 = Graphics::TextureBuilder::Billboard(fname).GetOrCreateTexture(renderer, "billboard");
-			//face camera
-			matrix4x4f trans = trans.Identity();
-			renderer->SetTransform(trans);
-			renderer->DrawPointSprites(1, &pos, alphaOneState, explotionParticle, m_speed);
-			break;
-
-		} case TYPE_DAMAGE: {
-			renderer->SetTransform(matrix4x4d::Translation(fpos));
-			damageParticle->diffuse = Color(255, 255, 0, (1.0f-(m_age/2.0f))*255);
-			renderer->DrawPointSprites(1, &pos, additiveAlphaState, damageParticle, 20.f);
-			break;
-			
-		} case TYPE_SMOKE: {
-			float var = Pi::rng.Double()*0.05f; //slightly variation to trail color
-			if (m_age < 0.5)
-				//start trail
-				smokeParticle->diffuse = Color((0.75f-var)*255,
-						(0.75f-var)*255, (0.75f-var)*255, (m_age*0.5-(m_age/2.0f))*255);
-			else
-				//end trail
-				smokeParticle->diffuse = Color((0.75-var)*255,
-						(0.75f-var)*255, (0.75f-var)*255, Clamp(0.5*0.5-(m_age/16.0),0.0,1.0)*255);
-
-			renderer->SetTransform(matrix4x4d::Translation(fpos));
-
-			damageParticle->diffuse*=0.05;
-			renderer->DrawPointSprites(1, &pos, alphaState, smokeParticle, (m_speed*m_age));
-			break;
+	// how many sfx turds are active in frame?
+	const SfxPool *pool = f->m_sfx;
+	wr.Int32(pool ? pool->Size() : 0);
+	if (!pool) return;
+
+	for (int t = 0; t < TYPE_MAX; t++) {
+		const SfxPool::Batch &b = pool->batches[t];
+		for (size_t i = 0; i < b.Size(); i++) {
+			wr.Vector3d(b.pos[i]);
+			wr.Vector3d(b.vel[i]);
+			wr.Float(b.age[i]);
+			wr.Int32(t);
 		}
 	}
 }
 
-Sfx *Sfx::AllocSfxInFrame(Frame *f)
+void Sfx::Unserialize(Serializer::Reader &rd, Frame *f)
 {
-	if (!f->m_sfx) {
-		f->m_sfx = new Sfx[MAX_SFX_PER_FRAME];
+	for (int i = rd.Int32(); i > 0; --i) {
+		const vector3d pos = rd.Vector3d();
+		const vector3d vel = rd.Vector3d();
+		const float age = rd.Float();
+		const TYPE t = static_cast<Sfx::TYPE>(rd.Int32());
+		if (t <= TYPE_NONE || t >= TYPE_MAX) continue;
+		SfxPool::Batch &b = GetPool(f)->batches[t];
+		b.Push(pos, vel, DEFAULT_SPRITE_SIZE);
+		b.age.back() = age;
 	}
-
-	for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-		if (f->m_sfx[i].m_type == TYPE_NONE) {
-			return &f->m_sfx[i];
-		}
-	}
-	return 0;
 }
 
 void Sfx::Add(const Body *b, TYPE t)
 {
-	Sfx *sfx = AllocSfxInFrame(b->GetFrame());
-	if (!sfx) return;
+	Add(b->GetFrame(), b->GetPosition(), b->GetVelocity(), t);
+}
 
-	sfx->m_type = t;
-	sfx->m_age = 0;
-	sfx->SetPosition(b->GetPosition());
-	sfx->m_vel = b->GetVelocity() + 200.0*vector3d(
+void Sfx::Add(Frame *f, const vector3d &pos, const vector3d &vel, TYPE t)
+{
+	AddParticle(f, t, pos, vel + 200.0*vector3d(
 			Pi::rng.Double()-0.5,
 			Pi::rng.Double()-0.5,
-			Pi::rng.Double()-0.5);
+			Pi::rng.Double()-0.5), DEFAULT_SPRITE_SIZE);
 }
 
 void Sfx::AddExplotion(Body *b, TYPE t)
 {
-	Sfx *sfx = AllocSfxInFrame(b->GetFrame());
-	if (!sfx) return;
-
-	sfx->m_type = t;
-	sfx->m_age = 0;
-	sfx->SetPosition(b->GetPosition());
-	sfx->m_vel = b->GetVelocity();
+	float size = DEFAULT_SPRITE_SIZE;
 	if (b->IsType(Object::SHIP)) {
 		Ship *s = static_cast<Ship*>(b);
-		sfx->m_speed = s->GetAabb().radius*8.0;
+		size = s->GetAabb().radius*8.0;
 	}
+	AddParticle(b->GetFrame(), t, b->GetPosition(), b->GetVelocity(), size);
 }
 
 void Sfx::TimeStepAll(const float timeStep, Frame *f)
 {
 	PROFILE_SCOPED()
 	if (f->m_sfx) {
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) {
-				f->m_sfx[i].TimeStepUpdate(timeStep);
-			}
+		const double dt = timeStep;
+		for (int t = 0; t < TYPE_MAX; t++) {
+			SfxPool::Batch &b = f->m_sfx->batches[t];
+			const size_t count = b.Size();
+			if (!count) continue;
+
+			// plain loops over packed arrays, so the compiler can vectorise them
+			float *age = &b.age[0];
+			for (size_t i = 0; i < count; i++)
+				age[i] += timeStep;
+			vector3d *pos = &b.pos[0];
+			const vector3d *vel = &b.vel[0];
+			for (size_t i = 0; i < count; i++)
+				pos[i] += vel[i] * dt;
+
+			const float lifetime = s_lifetime[t];
+			for (size_t i = count; i-- > 0; )
+				if (b.age[i] > lifetime) b.Remove(i);
 		}
 	}
 
@@ -223,23 +161,138 @@ void Sfx::TimeStepAll(const float timeStep, Frame *f)
 	}
 }
 
-void Sfx::RenderAll(Renderer *renderer, Frame *f, const Frame *camFrame)
+namespace {
+	// one particle, ready to draw: camera space position, size and colour
+	struct Sprite {
+		vector3f pos;
+		float size;
+		Color color;
+		int spriteFrame;	// explosions only
+
+		bool operator<(const Sprite &o) const { return spriteFrame < o.spriteFrame; }
+	};
+}
+
+// everything visible this frame, by type, rebuilt by every RenderAll
+static std::vector<Sprite> s_sprites[Sfx::TYPE_MAX];
+static std::unique_ptr<VertexArray> s_batchVerts;
+static std::vector<Texture*> s_explosionTextures;
+
+void Sfx::BatchFrame(Frame *f, const Frame *camFrame)
 {
-	PROFILE_SCOPED()
-	if (f->m_sfx) {
+	if (f->m_sfx && f->m_sfx->Size()) {
 		matrix4x4d ftran;
 		Frame::GetFrameTransform(f, camFrame, ftran);
 
-		for (int i=0; i<MAX_SFX_PER_FRAME; i++) {
-			if (f->m_sfx[i].m_type != TYPE_NONE) {
-				f->m_sfx[i].Render(renderer, ftran);
+		for (int t = TYPE_NONE+1; t < TYPE_MAX; t++) {
+			const SfxPool::Batch &b = f->m_sfx->batches[t];
+			for (size_t i = 0; i < b.Size(); i++) {
+				const vector3d fpos = ftran * b.pos[i];
+				const float age = b.age[i];
+
+				Sprite sp;
+				sp.pos = vector3f(&fpos.x);
+				sp.spriteFrame = 0;
+				switch (t) {
+					case TYPE_EXPLOSION:
+						sp.size = b.size[i];
+						sp.color = Color::WHITE;
+						sp.spriteFrame = int(age*20+1);
+						break;
+					case TYPE_DAMAGE:
+						sp.size = 20.f;
+						sp.color = Color(255, 255, 0, (1.0f-(age/2.0f))*255);
+						break;
+					case TYPE_SMOKE: {
+						float var = Pi::rng.Double()*0.05f; //slightly variation to trail color
+						const Uint8 grey = (0.75f-var)*255;
+						if (age < 0.5)
+							//start trail
+							sp.color = Color(grey, grey, grey, (age*0.5-(age/2.0f))*255);
+						else
+							//end trail
+							sp.color = Color(grey, grey, grey, Clamp(0.5*0.5-(age/16.0),0.0,1.0)*255);
+						sp.size = b.size[i]*age;
+						break;
+					}
+				}
+				s_sprites[t].push_back(sp);
 			}
 		}
 	}
 
 	for (Frame* kid : f->GetChildren()) {
-		RenderAll(renderer, kid, camFrame);
+		BatchFrame(kid, camFrame);
+	}
+}
+
+// camera facing quads for a run of sprites, in one draw
+static void DrawBatch(Renderer *renderer, RenderState *rs, Material *material, const Sprite *sprites, size_t count)
+{
+	if (!count) return;
+
+	if (!s_batchVerts)
+		s_batchVerts.reset(new VertexArray(ATTRIB_POSITION | ATTRIB_DIFFUSE | ATTRIB_UV0, count * 6));
+	s_batchVerts->Clear();
+
+	for (size_t i = 0; i < count; i++) {
+		const Sprite &sp = sprites[i];
+		const float sz = 0.5f*sp.size;
+		const vector3f tl = sp.pos + vector3f(-sz, sz, 0.f);
+		const vector3f bl = sp.pos + vector3f(-sz, -sz, 0.f);
+		const vector3f tr = sp.pos + vector3f(sz, sz, 0.f);
+		const vector3f br = sp.pos + vector3f(sz, -sz, 0.f);
+
+		s_batchVerts->Add(tl, sp.color, vector2f(0.f, 0.f));
+		s_batchVerts->Add(bl, sp.color, vector2f(0.f, 1.f));
+		s_batchVerts->Add(tr, sp.color, vector2f(1.f, 0.f));
+
+		s_batchVerts->Add(tr, sp.color, vector2f(1.f, 0.f));
+		s_batchVerts->Add(bl, sp.color, vector2f(0.f, 1.f));
+		s_batchVerts->Add(br, sp.color, vector2f(1.f, 1.f));
+	}
+
+	renderer->DrawTriangles(s_batchVerts.get(), rs, material);
+}
+
+Texture *Sfx::GetExplosionTexture(Renderer *renderer, int spriteFrame)
+{
+	if (spriteFrame >= int(s_explosionTextures.size()))
+		s_explosionTextures.resize(spriteFrame+1, 0);
+	if (!s_explosionTextures[spriteFrame]) {
+		const std::string fname = "explotion/small/image"+std::to_string(spriteFrame)+".png";
+		s_explosionTextures[spriteFrame] = Graphics::TextureBuilder::Billboard(fname).GetOrCreateTexture(renderer, "billboard");
 	}
+	return s_explosionTextures[spriteFrame];
+}
+
+void Sfx::RenderAll(Renderer *renderer, Frame *f, const Frame *camFrame)
+{
+	PROFILE_SCOPED()
+	for (int t = 0; t < TYPE_MAX; t++)
+		s_sprites[t].clear();
+	BatchFrame(f, camFrame);
+	if (s_sprites[TYPE_EXPLOSION].empty() && s_sprites[TYPE_DAMAGE].empty() && s_sprites[TYPE_SMOKE].empty())
+		return;
+
+	// sprites are already in camera space
+	Graphics::Renderer::MatrixTicket mt(renderer, Graphics::MatrixMode::MODELVIEW);
+	renderer->SetTransform(matrix4x4f::Identity());
+
+	// explosions animate through a texture per sprite frame, so draw one
+	// batch for each frame in use
+	std::vector<Sprite> &explosions = s_sprites[TYPE_EXPLOSION];
+	std::sort(explosions.begin(), explosions.end());
+	for (size_t start = 0; start < explosions.size(); ) {
+		size_t end = start;
+		while (end < explosions.size() && explosions[end].spriteFrame == explosions[start].spriteFrame) ++end;
+		explotionParticle->texture0 = GetExplosionTexture(renderer, explosions[start].spriteFrame);
+		DrawBatch(renderer, alphaOneState, explotionParticle, &explosions[start], end - start);
+		start = end;
+	}
+
+	DrawBatch(renderer, additiveAlphaState, damageParticle, s_sprites[TYPE_DAMAGE].data(), s_sprites[TYPE_DAMAGE].size());
+	DrawBatch(renderer, alphaState, smokeParticle, s_sprites[TYPE_SMOKE].data(), s_sprites[TYPE_SMOKE].size());
 }
 
 void Sfx::Init(Graphics::Renderer *r)
@@ -266,13 +319,19 @@ void Sfx::Init(Graphics::Renderer *r)
 
 	desc.textures = 1;
 	if(Graphics::Hardware::GL3()) {
-		damageParticle = new MainMaterial(r, desc);
 		ecmParticle = new MainMaterial(r, desc);
+	} else {
+		ecmParticle = r->CreateMaterial(desc);
+	}
+
+	// batched effects carry their colour per vertex
+	desc.vertexColors = true;
+	if(Graphics::Hardware::GL3()) {
+		damageParticle = new MainMaterial(r, desc);
 		smokeParticle = new MainMaterial(r, desc);
 		explotionParticle = new MainMaterial(r, desc);
 	} else {
 		damageParticle = r->CreateMaterial(desc);
-		ecmParticle = r->CreateMaterial(desc);
 		smokeParticle = r->CreateMaterial(desc);
 		explotionParticle = r->CreateMaterial(desc);
 	}
@@ -289,4 +348,6 @@ void Sfx::Uninit()
 	delete ecmParticle; ecmParticle = 0;
 	delete smokeParticle; smokeParticle = 0;
 	delete explotionParticle; explotionParticle = 0;
+	s_batchVerts.reset();
+	s_explosionTextures.clear();
 }
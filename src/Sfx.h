@@ -10,8 +10,10 @@
 #include "graphics/RenderState.h"
 
 class Frame;
+struct SfxPool;
 namespace Graphics {
 	class Renderer;
+	class Texture;
 	namespace Drawables {
 		class Sphere3D;
 	}
@@ -19,19 +21,16 @@ namespace Graphics {
 
 class Sfx {
 public:
-	enum TYPE { TYPE_NONE, TYPE_EXPLOSION, TYPE_DAMAGE, TYPE_SMOKE };
+	enum TYPE { TYPE_NONE, TYPE_EXPLOSION, TYPE_DAMAGE, TYPE_SMOKE, TYPE_MAX };
 
 	static void Add(const Body *, TYPE);
+	static void Add(Frame *f, const vector3d &pos, const vector3d &vel, TYPE);
 	static void AddExplotion(Body *, TYPE);
 	static void TimeStepAll(const float timeStep, Frame *f);
 	static void RenderAll(Graphics::Renderer *r, Frame *f, const Frame *camFrame);
 	static void Serialize(Serializer::Writer &wr, const Frame *f);
 	static void Unserialize(Serializer::Reader &rd, Frame *f);
 
-	Sfx();
-	void SetPosition(const vector3d &p);
-	vector3d GetPosition() const { return m_pos; }
-
 	//create shared models
 	static void Init(Graphics::Renderer *r);
 	static void Uninit();
@@ -45,18 +44,31 @@ public:
 	static Graphics::RenderState *alphaOneState;
 
 private:
-	static Sfx *AllocSfxInFrame(Frame *f);
-
-	void Render(Graphics::Renderer *r, const matrix4x4d &transform);
-	void TimeStepUpdate(const float timeStep);
-	void Save(Serializer::Writer &wr);
-	void Load(Serializer::Reader &rd);
-
-	vector3d m_pos;
-	vector3d m_vel;
-	float m_age;
-	float m_speed;
-	enum TYPE m_type;
+	static SfxPool *GetPool(Frame *f);
+	static void AddParticle(Frame *f, TYPE t, const vector3d &pos, const vector3d &vel, float size);
+	static void BatchFrame(Frame *f, const Frame *camFrame);
+	static Graphics::Texture *GetExplosionTexture(Graphics::Renderer *r, int spriteFrame);
+};
+
+// Effects in one frame, with one batch of particles per effect type. A
+// batch is packed, one array per field. Adding a particle appends it and
+// an expired one is replaced by the last, so there is no cap and no hunting
+// for free slots, and a batch updates in straight loops over its arrays.
+struct SfxPool {
+	struct Batch {
+		size_t Size() const { return age.size(); }
+		void Push(const vector3d &pos, const vector3d &vel, float size);
+		void Remove(size_t i);
+
+		std::vector<vector3d> pos;
+		std::vector<vector3d> vel;
+		std::vector<float> age;
+		std::vector<float> size;	// sprite size
+	};
+
+	size_t Size() const;
+
+	Batch batches[Sfx::TYPE_MAX];
 };
 
 #endif /* _SFX_H */
@@ -160,6 +160,7 @@ void Shields::ReparentShieldNodes(SceneGraph::Model* model)
 			}
 
 			model->GetRoot()->AddChild(shieldGroup);
+			model->InvalidateDrawList();
 		}
 	}
 }
@@ -22,7 +22,7 @@
 void Ship::AIModelCoordsMatchAngVel(vector3d desiredAngVel, double softness)
 {
 	double angAccel = m_type->angThrust / GetAngularInertia();
-	const double softTimeStep = Pi::game->GetTimeStep() * softness;
+	const double softTimeStep = GetStepSize() * softness;
 
 	vector3d angVel = desiredAngVel - GetAngVelocity() * GetOrient();
 	vector3d thrust;
@@ -51,7 +51,7 @@ void Ship::AIAccelToModelRelativeVelocity(const vector3d v)
 {
 	vector3d difVel = v - GetVelocity() * GetOrient();		// required change in velocity
 	vector3d maxThrust = GetMaxThrust(difVel);
-	vector3d maxFrameAccel = maxThrust * (Pi::game->GetTimeStep() / GetMass());
+	vector3d maxFrameAccel = maxThrust * (GetStepSize() / GetMass());
 
 	SetThrusterState(0, difVel.x / maxFrameAccel.x);
 	SetThrusterState(1, difVel.y / maxFrameAccel.y);
@@ -59,6 +59,12 @@ void Ship::AIAccelToModelRelativeVelocity(const vector3d v)
 }
 
 
+void Ship::AIThink()
+{
+	if (m_curAICmd && m_launchLockTimeout <= 0.0 && !(m_onRails && !m_railsFullStep))
+		m_curAICmd->Think();
+}
+
 // returns true if command is complete
 bool Ship::AITimeStep(float timeStep)
 {
@@ -89,9 +95,20 @@ void Ship::AIClearInstructions()
 {
 	if (!m_curAICmd) return;
 
+	// new orders get a look at full rate before going back on rails
+	SetOnRails(false);
+
 	delete m_curAICmd;		// rely on destructor to kill children
 	m_curAICmd = 0;
 	m_decelerating = false;		// don't adjust unless AI is running
+
+	// the new orders will say what they want to watch
+	if (m_watchSpace) {
+		for (std::vector<const Body*>::const_iterator it = m_watched.begin(); it != m_watched.end(); ++it)
+			m_watchSpace->UnsubscribeRemoval(this, *it);
+	}
+	m_watched.clear();
+	WatchOwnBodies();
 }
 
 void Ship::AIGetStatusText(char *str)
@@ -220,14 +237,14 @@ void Ship::AIHoldPosition()
 // sometimes endvel is too low to catch moving objects
 // worked around with half-accel hack in dynamicbody & pi.cpp
 
-double calc_ivel(double dist, double vel, double acc)
+double calc_ivel(double dist, double vel, double acc, double timeStep)
 {
 	bool inv = false;
 	if (dist < 0) { dist = -dist; vel = -vel; inv = true; }
 	double ivel = 0.9 * sqrt(vel*vel + 2.0 * acc * dist);		// fudge hardly necessary
 
-	double endvel = ivel - (acc * Pi::game->GetTimeStep());
-	if (endvel <= 0.0) ivel = dist / Pi::game->GetTimeStep();	// last frame discrete correction
+	double endvel = ivel - (acc * timeStep);
+	if (endvel <= 0.0) ivel = dist / timeStep;	// last frame discrete correction
 	else ivel = (ivel + endvel) * 0.5;					// discrete overshoot correction
 //	else ivel = endvel + 0.5*acc/PHYSICS_HZ;			// unknown next timestep discrete overshoot correction
 
@@ -235,12 +252,12 @@ double calc_ivel(double dist, double vel, double acc)
 }
 
 // version for all-positive values
-double calc_ivel_pos(double dist, double vel, double acc)
+double calc_ivel_pos(double dist, double vel, double acc, double timeStep)
 {
 	double ivel = 0.9 * sqrt(vel*vel + 2.0 * acc * dist);		// fudge hardly necessary
 
-	double endvel = ivel - (acc * Pi::game->GetTimeStep());
-	if (endvel <= 0.0) ivel = dist / Pi::game->GetTimeStep();	// last frame discrete correction
+	double endvel = ivel - (acc * timeStep);
+	if (endvel <= 0.0) ivel = dist / timeStep;	// last frame discrete correction
 	else ivel = (ivel + endvel) * 0.5;					// discrete overshoot correction
 
 	return ivel;
@@ -267,7 +284,7 @@ bool Ship::AIChangeVelBy(const vector3d &diffvel, bool isDocking)
     }
 
 	vector3d maxThrust = GetMaxThrust(diffvel2);
-	vector3d maxFrameAccel = maxThrust * (Pi::game->GetTimeStep() / GetMass());
+	vector3d maxFrameAccel = maxThrust * (GetStepSize() / GetMass());
     vector3d thrust(diffvel2.x / maxFrameAccel.x,
 					diffvel2.y / maxFrameAccel.y,
 					diffvel2.z / maxFrameAccel.z);
@@ -283,7 +300,7 @@ vector3d Ship::AIChangeVelDir(const vector3d &reqdiffvel)
 	// get max thrust in desired direction after external force compensation
 	vector3d maxthrust = GetMaxThrust(reqdiffvel);
 	maxthrust += GetExternalForce() * GetOrient();
-	vector3d maxFA = maxthrust * (Pi::game->GetTimeStep() / GetMass());
+	vector3d maxFA = maxthrust * (GetStepSize() / GetMass());
 	maxFA.x = fabs(maxFA.x); maxFA.y = fabs(maxFA.y); maxFA.z = fabs(maxFA.z);
 
 	// crunch diffvel by relative thruster power to get acceleration in right direction
@@ -300,7 +317,7 @@ vector3d Ship::AIChangeVelDir(const vector3d &reqdiffvel)
 void Ship::AIMatchAngVelObjSpace(const vector3d &angvel)
 {
 	double maxAccel = m_type->angThrust / GetAngularInertia();
-	double invFrameAccel = 1.0 / (maxAccel * Pi::game->GetTimeStep());
+	double invFrameAccel = 1.0 / (maxAccel * GetStepSize());
 
 	vector3d diff = angvel - GetAngVelocity() * GetOrient();		// find diff between current & desired angvel
 	SetAngThrusterState(diff * invFrameAccel);
@@ -310,7 +327,7 @@ void Ship::AIMatchAngVelObjSpace(const vector3d &angvel)
 double Ship::AIFaceUpdir(const vector3d &updir, double av)
 {
 	double maxAccel = m_type->angThrust / GetAngularInertia();		// should probably be in stats anyway
-	double frameAccel = maxAccel * Pi::game->GetTimeStep();
+	double frameAccel = maxAccel * GetStepSize();
 
 	vector3d uphead = updir * GetOrient();			// create desired object-space updir
 	if (uphead.z > 0.99999) return 0;				// bail out if facing updir
@@ -320,7 +337,7 @@ double Ship::AIFaceUpdir(const vector3d &updir, double av)
 	if (uphead.y < 0.99999999)
 	{
 		ang = acos(Clamp(uphead.y, -1.0, 1.0));		// scalar angle from head to curhead
-		double iangvel = av + calc_ivel_pos(ang, 0.0, maxAccel);	// ideal angvel at current time
+		double iangvel = av + calc_ivel_pos(ang, 0.0, maxAccel, GetStepSize());	// ideal angvel at current time
 
 		dav = uphead.x > 0 ? -iangvel : iangvel;
 	}
@@ -347,7 +364,7 @@ double Ship::AIFaceDirection(const vector3d &dir, double av)
 	if (head.z > -0.99999999)
 	{
 		ang = acos (Clamp(-head.z, -1.0, 1.0));		// scalar angle from head to curhead
-		double iangvel = av + calc_ivel_pos(ang, 0.0, maxAccel);	// ideal angvel at current time
+		double iangvel = av + calc_ivel_pos(ang, 0.0, maxAccel, GetStepSize());	// ideal angvel at current time
 
 		// Normalize (head.x, head.y) to give desired angvel direction
 		if (head.z > 0.999999) head.x = 1.0;
@@ -356,7 +373,7 @@ double Ship::AIFaceDirection(const vector3d &dir, double av)
 		dav.y = -head.x * head2dnorm * iangvel;
 	}
 	vector3d cav = GetAngVelocity() * GetOrient();				// current obj-rel angvel
-	double frameAccel = maxAccel * Pi::game->GetTimeStep();
+	double frameAccel = maxAccel * GetStepSize();
 	vector3d diff = (dav - cav) / frameAccel;	// find diff between current & desired angvel
 
 	// If the player is pressing a roll key, don't override roll.
@@ -114,6 +114,7 @@ void Ship::Save(Serializer::Writer &wr, Space *space)
 	wr.Int32(int(m_aiMessage));
 	wr.Double(m_thrusterFuel);
 	wr.Double(m_reserveFuel);
+	wr.Float(m_railsElapsed);
 
 	wr.Int32(static_cast<int>(m_controller->GetType()));
 	m_controller->Save(wr, space);
@@ -178,11 +179,21 @@ void Ship::Load(Serializer::Reader &rd, Space *space)
 	m_shieldCooldown = rd.Float();
 	if(rd.Int32()) m_curAICmd = AICommand::Load(rd);
 	else m_curAICmd = 0;
+	m_onRails = false;
+	m_railsFullStep = true;
+	m_railsCountdown = 0;
+	m_railsInterval = 1;
+	m_railsElapsed = 0.0f;
+	m_railsForce = vector3d(0.0);
+	m_watchSpace = 0;
 	m_aiMessage = AIError(rd.Int32());
 	SetFuel(rd.Double());
 	m_stats.fuel_tank_mass_left = GetShipType()->fuelTankMass * GetFuel();
 	//m_stats.hydrogen_tank_left = GetShipType()->hydrogenTank;
 	m_reserveFuel = rd.Double();
+	// made up on the first full step
+	if (Game::s_loadedGameVersion >= 83)
+		m_railsElapsed = rd.Float();
 
 	m_phaseJumpMode = false;
 	m_phaseJumpRange = false;
@@ -354,6 +365,13 @@ Ship::Ship(ShipType::Id shipId): DynamicBody(),
 	m_ecmRecharge = 0;
 	m_shieldCooldown = 0.0f;
 	m_curAICmd = 0;
+	m_onRails = false;
+	m_railsFullStep = true;
+	m_railsCountdown = 0;
+	m_railsInterval = 1;
+	m_railsElapsed = 0.0f;
+	m_railsForce = vector3d(0.0);
+	m_watchSpace = 0;
 	m_juice = 20.0;
 	m_transitstate = TRANSIT_DRIVE_OFF;
 	m_aiMessage = AIERROR_NONE;
@@ -361,6 +379,7 @@ Ship::Ship(ShipType::Id shipId): DynamicBody(),
 	m_equipment.onChange.connect(sigc::mem_fun(this, &Ship::OnEquipmentChange));
 
 	SetModel(m_type->modelName.c_str());
+	GetModel()->EnableImpostor();
 	SetLabel(DEFAULT_SHIP_LABEL);
 	m_unlabeled = true;
 	m_skin.SetRandomColors(Pi::rng);
@@ -492,6 +511,9 @@ bool Ship::OnDamage(Object *attacker, float kgDamage, const CollisionContact& co
 		return true;
 	}
 
+	// someone's shooting at us, we'd better pay attention
+	SetOnRails(false);
+
 	if (!IsDead()) {
 		float dam = kgDamage*0.001f;
 		if (m_stats.shield_mass_left > 0.0f) {
@@ -1130,7 +1152,8 @@ void Ship::Blastoff()
 
 	vector3d up = GetPosition().Normalized();
 	assert(GetFrame()->GetBody()->IsType(Object::PLANET));
-	const double planetRadius = 2.0 + static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeight(up);
+	const double planetRadius = 2.0 + static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeightApprox(up,
+		TERRAIN_COLLISION_ERROR, &GetTerrainHeightCache());
 	PrivateSetVelocity(vector3d(0, 0, 0));
 	SetAngVelocity(vector3d(0, 0, 0));
 	SetFlightState(FLYING);
@@ -1149,7 +1172,8 @@ void Ship::TestLanded()
 	if (GetFrame()->GetBody()->IsType(Object::PLANET)) {
 		double speed = GetVelocity().Length();
 		vector3d up = GetPosition().Normalized();
-		const double planetRadius = static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeight(up);
+		const double planetRadius = static_cast<Planet*>(GetFrame()->GetBody())->GetTerrainHeightApprox(up,
+			TERRAIN_COLLISION_ERROR, &GetTerrainHeightCache());
 
 		if (speed < MAX_LANDING_SPEED) {
 			// check player is sortof sensibly oriented for landing
@@ -1179,7 +1203,7 @@ void Ship::SetLandedOn(Planet *p, float latitude, float longitude)
 	Frame* f = p->GetFrame()->GetRotFrame();
 	SetFrame(f);
 	vector3d up = vector3d(cos(latitude)*sin(longitude), sin(latitude), cos(latitude)*cos(longitude));
-	const double planetRadius = p->GetTerrainHeight(up);
+	const double planetRadius = p->GetTerrainHeightApprox(up, TERRAIN_COLLISION_ERROR, &GetTerrainHeightCache());
 	SetPosition(up * (planetRadius - GetAabb().min.y));
 	vector3d right = up.Cross(vector3d(0,0,1)).Normalized();
 	SetOrient(matrix3x3d::FromVectors(right, up));
@@ -1202,6 +1226,11 @@ void Ship::SetFrame(Frame *f)
 
 void Ship::TimeStepUpdate(const float timeStep)
 {
+	if (m_onRails && !m_railsFullStep) {
+		RailsTimeStepUpdate(timeStep);
+		return;
+	}
+
 	// If docked, station is responsible for updating position/orient of ship
 	// but we call this crap anyway and hope it doesn't do anything bad
 
@@ -1219,6 +1248,7 @@ void Ship::TimeStepUpdate(const float timeStep)
 
 	m_oldPos = GetPosition();
 	if (m_isMoving) {
+		m_railsForce = m_force;
 		m_force += m_externalForce;
         
         vector3d tmpVec = double(timeStep) * m_force / m_mass;
@@ -1379,7 +1409,7 @@ void Ship::FireWeapon(int num)
     //deliberately using ship's dir and not gun's dir
 	if (target && m_targetInSight && target->GetPositionRelTo(this).Length() <= MAX_AUTO_TARGET_DISTANCE) {
 
-		vector3d targaccel = (target->GetVelocity() - m_lastVel) / Pi::game->GetTimeStep();
+		vector3d targaccel = (target->GetVelocity() - m_lastVel) / GetStepSize();
 
 		const vector3d tdir = target->GetPositionRelTo(this);
 		const vector3d targvel = target->GetVelocityRelTo(this);
@@ -1542,7 +1572,98 @@ void Ship::UpdateFuel(const float timeStep, const vector3d &thrust)
 		LuaEvent::Queue("onShipFuelChanged", this, EnumStrings::GetString("ShipFuelStatus", currentState));
 }
 
-void Ship::StaticUpdate(const float timeStep)
+static int s_railsStagger = 0;
+
+void Ship::SetOnRails(bool onRails)
+{
+	if (onRails == m_onRails) return;
+	m_onRails = onRails;
+	m_railsFullStep = true;
+	// spread the full steps of a batch of ships over the interval
+	m_railsCountdown = 1 + (s_railsStagger++ % m_railsInterval);
+}
+
+void Ship::SetRailsInterval(int steps)
+{
+	m_railsInterval = std::max(steps, 1);
+	// mid-stride changes wait for the next full step
+	if (m_onRails && m_railsFullStep) m_railsCountdown = m_railsInterval;
+}
+
+bool Ship::CanGoOnRails() const
+{
+	if (m_flightState != FLYING || m_invulnerable) return false;
+	if (!m_curAICmd || m_launchLockTimeout > 0.0f || IsHyperspaceActive()) return false;
+	// rotating frames are where docking, landing and orbital stations are
+	if (GetFrame()->IsRotFrame()) return false;
+	if (GetCombatTarget()) return false;
+
+	switch (m_curAICmd->GetCommandName()) {
+		case AICommand::CMD_KILL:
+		case AICommand::CMD_KAMIKAZE:
+		case AICommand::CMD_HOLDPOSITION:
+		case AICommand::CMD_FORMATION:
+			return false;
+		default:
+			break;
+	}
+
+	if (Pi::player && (Pi::player->GetCombatTarget() == this || Pi::player->GetNavTarget() == this))
+		return false;
+
+	return true;
+}
+
+bool Ship::NeedsFineSteps() const
+{
+	if (m_flightState != FLYING) return false;
+	if (m_launchLockTimeout > 0.0f || GetCombatTarget()) return true;
+	// docking and landing approaches, and flying around stations
+	return GetFrame()->IsRotFrame();
+}
+
+bool Ship::RailsStep()
+{
+	if (!m_onRails) return true;
+	if (--m_railsCountdown <= 0) {
+		m_railsCountdown = m_railsInterval;
+		m_railsFullStep = true;
+	} else
+		m_railsFullStep = false;
+	return m_railsFullStep;
+}
+
+// constant acceleration leg with the thrust the AI last asked for, held
+// until its next full step, and gravity and drag where the ship is now
+void Ship::RailsTimeStepUpdate(const float timeStep)
+{
+	m_oldPos = GetPosition();
+
+	const vector3d force = m_railsForce + m_externalForce;
+	const vector3d accel = force / m_mass;
+	SetPosition(GetPosition() + (m_vel + 0.5 * accel * double(timeStep)) * double(timeStep));
+	m_vel += accel * double(timeStep);
+
+	// no angular thrust between full steps, but it keeps turning
+	const double len = m_angVel.Length();
+	if (len > 1e-16) {
+		const vector3d axis = m_angVel * (1.0 / len);
+		SetOrient(matrix3x3d::Rotate(len * timeStep, axis) * GetOrient());
+	}
+	m_oldAngDisplacement = m_angVel * timeStep;
+
+	m_lastForce = force;
+	m_lastTorque = vector3d(0.0);
+	CalcExternalForce();
+
+	if (GetTransitState() == TRANSIT_DRIVE_OFF) {
+		const vector3d maxThrust = GetMaxThrust(m_thrusters);
+		UpdateFuel(timeStep, vector3d(maxThrust.x * m_thrusters.x, maxThrust.y * m_thrusters.y,
+			maxThrust.z * m_thrusters.z));
+	}
+}
+
+void Ship::StaticUpdate(const float step)
 {
 	// Remove ship if unlabeled: (Traffic bug patch)
 	if (!m_invulnerable && m_unlabeled) {
@@ -1557,7 +1678,17 @@ void Ship::StaticUpdate(const float timeStep)
 
 	if (IsDead()) return;
 
-	if (m_controller) m_controller->StaticUpdate(timeStep);
+	// on rails, skipped time is made up on the next full step. the rails
+	// steps have already moved the ship through it, so the AI only gets the
+	// step its thrust is integrated over, and the rest is for the timers
+	if (m_onRails && !m_railsFullStep) {
+		m_railsElapsed += step;
+		return;
+	}
+	const float timeStep = step + m_railsElapsed;
+	m_railsElapsed = 0.0f;
+
+	if (m_controller) m_controller->StaticUpdate(step);
 
 	if (GetHullTemperature() >= m_maxHullTemp) {
 		CollisionContact dummy;
@@ -1851,7 +1982,7 @@ void Ship::CalculateVelocity(bool force_drive_1, double transit_factor)
 			break;
 
 		case EFM_TRANSIT:
-			TransitVelocity(Pi::game->GetTimeStep(), altitude, force_drive_1, transit_factor);
+			TransitVelocity(GetStepSize(), altitude, force_drive_1, transit_factor);
 			break;
 	}
 }
@@ -1966,7 +2097,7 @@ void Ship::TransitTunnelingTest(float timeStep)
 		float heading_check = ship_to_planet.Dot(ship_direction);
 		if (heading_check > 0.0f) {
 			assert(planet->IsType(Object::TERRAINBODY));
-			double terrain_height = static_cast<TerrainBody*>(planet)->GetTerrainHeight(ship_position.Normalized());
+			double terrain_height = static_cast<TerrainBody*>(planet)->GetTerrainHeightApprox(ship_position.Normalized(), 10.0);
 			ship_velocity *= timeStep;
 			double ship_step = ship_velocity.Length();
 			double distance_to_planet = ship_to_planet.Length();
@@ -2046,9 +2177,39 @@ void Ship::TransitStationCatch(float timeStep)
 
 void Ship::NotifyRemoved(const Body* const removedBody)
 {
+	std::vector<const Body*>::iterator it = std::find(m_watched.begin(), m_watched.end(), removedBody);
+	if (it != m_watched.end()) {
+		*it = m_watched.back();
+		m_watched.pop_back();
+	}
 	if (m_curAICmd) m_curAICmd->OnDeleted(removedBody);
 }
 
+void Ship::WatchBody(const Body *b)
+{
+	if (b == this || std::find(m_watched.begin(), m_watched.end(), b) != m_watched.end()) return;
+	m_watched.push_back(b);
+	// otherwise when we're put in one
+	if (m_watchSpace) m_watchSpace->SubscribeRemoval(this, b);
+}
+
+void Ship::NotifyEnteredSpace(Space *space)
+{
+	m_watchSpace = space;
+	for (std::vector<const Body*>::const_iterator it = m_watched.begin(); it != m_watched.end(); ++it)
+		space->SubscribeRemoval(this, *it);
+	// the station may have taken us in before we were in the space
+	if (m_dockedWith) space->SubscribeRemoval(m_dockedWith, this);
+}
+
+void Ship::NotifyLeftSpace()
+{
+	// the space has dropped our subscriptions, and anything we were watching
+	// isn't something we'll meet again
+	m_watchSpace = 0;
+	m_watched.clear();
+}
+
 bool Ship::Undock()
 {
 	return (m_dockedWith && m_dockedWith->LaunchShip(this, m_dockedWithPort));
@@ -2255,6 +2416,7 @@ void Ship::SetShipType(const ShipType::Id &shipId)
 	SetShipId(shipId);
 	m_equipment.InitSlotSizes(shipId);
 	SetModel(m_type->modelName.c_str());
+	GetModel()->EnableImpostor();
 	m_skin.SetDecal(m_type->manufacturer);
 	m_skin.Apply(GetModel());
 	Init();
@@ -150,6 +150,11 @@ public:
 	bool IsDecelerating() const { return m_decelerating; }
 
 	virtual void NotifyRemoved(const Body* const removedBody);
+	virtual void NotifyEnteredSpace(Space *space);
+	virtual void NotifyLeftSpace();
+	// the AI commands call this for each body they point at, so the ship
+	// hears when it's removed. forgotten when the orders change
+	void WatchBody(const Body *b);
 	virtual bool OnCollision(Object *o, Uint32 flags, double relVel);
 	virtual bool OnDamage(Object *attacker, float kgDamage, const CollisionContact& contactData);
 
@@ -243,6 +248,25 @@ public:
 
 	void AIClearInstructions();
 	bool AIIsActive() { return m_curAICmd ? true : false; }
+	// read-only planning for the current command. safe to call for many
+	// ships in parallel; the results are used by the following StaticUpdate
+	void AIThink();
+
+	// simulation level of detail, managed by Space. a ship on rails skips AI
+	// and full dynamics on most steps, coasting along the acceleration from
+	// its last full step, and catches up with a full step every few steps
+	bool IsOnRails() const { return m_onRails; }
+	void SetOnRails(bool onRails);
+	// true if nothing about the ship needs full-rate simulation right now
+	bool CanGoOnRails() const;
+	// steps between full ones while on rails, chosen by Space
+	int GetRailsInterval() const { return m_railsInterval; }
+	void SetRailsInterval(int steps);
+	// advance the rails schedule. returns true if this step is a full one
+	bool RailsStep();
+	// true if flying in a way that wants every step at the base rate, however
+	// far the ship is from anything (docking approaches, fights)
+	bool NeedsFineSteps() const;
 	void AIGetStatusText(char *str);
 
 	enum AIError { // <enum scope='Ship' name=ShipAIError prefix=AIERROR_ public>
@@ -367,6 +391,10 @@ protected:
 
 	virtual void Init();
 
+	// watches what the ship points at itself, whatever its orders. called
+	// again when clearing the orders drops everything watched
+	virtual void WatchOwnBodies() {}
+
 	void RenderLaserfire();
 	void ApplyThrusterLimits();
 		
@@ -456,6 +484,17 @@ private:
 	AIError m_aiMessage;
 	bool m_decelerating;
 
+	void RailsTimeStepUpdate(const float timeStep);
+	bool m_onRails;
+	bool m_railsFullStep;
+	int m_railsCountdown;
+	int m_railsInterval;
+	float m_railsElapsed;	// time skipped since the last full StaticUpdate
+	vector3d m_railsForce;	// the last full step's forces, less gravity and drag
+
+	std::vector<const Body*> m_watched;	// see WatchBody()
+	Space *m_watchSpace;	// the space the ship's subscribed in, if any
+
 	double m_thrusterFuel; 	// remaining fuel 0.0-1.0
 	double m_reserveFuel;	// 0-1, fuel not to touch for the current AI program
 
@@ -64,6 +64,22 @@ void AICommand::PostLoadFixup(Space *space)
 }
 
 
+void AIPlanSnapshot::Take(const Body *b)
+{
+	frame = b->GetFrame();
+	pos = b->GetPosition();
+	vel = b->GetVelocity();
+	orient = b->GetOrient();
+}
+
+bool AIPlanSnapshot::Matches(const Body *b) const
+{
+	return frame == b->GetFrame() && pos.ExactlyEqual(b->GetPosition())
+		&& vel.ExactlyEqual(b->GetVelocity()) && orient.VectorX().ExactlyEqual(b->GetOrient().VectorX())
+		&& orient.VectorY().ExactlyEqual(b->GetOrient().VectorY())
+		&& orient.VectorZ().ExactlyEqual(b->GetOrient().VectorZ());
+}
+
 bool AICommand::ProcessChild()
 {
 	if (!m_child) return true;						// no child present
@@ -76,7 +92,7 @@ bool AICommand::ProcessChild()
 // temporary evasion-test version
 bool AICmdKill::TimeStepUpdate()
 {
-	m_timeSinceChange += Pi::game->GetTimeStep();
+	m_timeSinceChange += m_ship->GetStepSize();
 	if (m_timeSinceChange < m_changeTime) {
 		m_ship->AIFaceDirection(m_curDir);
 		return false;
@@ -244,6 +260,23 @@ bool AICmdKamikaze::TimeStepUpdate()
 	return false;
 }
 
+void AICmdKill::Think()
+{
+	AICommand::Think();
+
+	m_plan.valid = false;
+	if (m_child || !m_target || m_target->IsDead()) return;
+	if (m_ship->GetFlightState() != Ship::FLYING) return;
+
+	m_plan.ship.Take(m_ship);
+	m_plan.target.Take(m_target);
+	m_plan.targpos = m_target->GetPositionRelTo(m_ship);
+	m_plan.targvel = m_target->GetVelocityRelTo(m_ship);
+	m_plan.targaccel = (m_target->GetVelocity() - m_lastVel) / m_ship->GetStepSize();
+	m_plan.leaddir = m_ship->AIGetLeadDir(m_target, m_plan.targaccel, 0);
+	m_plan.valid = true;
+}
+
 bool AICmdKill::TimeStepUpdate()
 {
 	if (m_ship->GetFlightState() == Ship::JUMPING) return false;
@@ -253,15 +286,18 @@ bool AICmdKill::TimeStepUpdate()
 	if (m_ship->GetFlightState() == Ship::FLYING) m_ship->SetWheelState(false);
 	else { LaunchShip(m_ship); return false; }
 
+	const bool usePlan = m_plan.valid && m_plan.ship.Matches(m_ship) && m_plan.target.Matches(m_target);
+	m_plan.valid = false;
+
 	const matrix3x3d &rot = m_ship->GetOrient();
-	vector3d targpos = m_target->GetPositionRelTo(m_ship);
-	vector3d targvel = m_target->GetVelocityRelTo(m_ship);
+	vector3d targpos = usePlan ? m_plan.targpos : m_target->GetPositionRelTo(m_ship);
+	vector3d targvel = usePlan ? m_plan.targvel : m_target->GetVelocityRelTo(m_ship);
 	vector3d targdir = targpos.NormalizedSafe();
 	vector3d heading = -rot.VectorZ();
 	// Accel will be wrong for a frame on timestep changes, but it doesn't matter
-	vector3d targaccel = (m_target->GetVelocity() - m_lastVel) / Pi::game->GetTimeStep();
+	vector3d targaccel = usePlan ? m_plan.targaccel : (m_target->GetVelocity() - m_lastVel) / m_ship->GetStepSize();
 	m_lastVel = m_target->GetVelocity();		// may need next frame
-	vector3d leaddir = m_ship->AIGetLeadDir(m_target, targaccel, 0);
+	vector3d leaddir = usePlan ? m_plan.leaddir : m_ship->AIGetLeadDir(m_target, targaccel, 0);
 
 	float hullDamage = m_ship->GetPercentHull()/100.0;
 	float thullDamage = m_target->GetPercentHull()/100.0;
@@ -309,7 +345,7 @@ bool AICmdKill::TimeStepUpdate()
 		else m_ship->SetGunState(0,0);
 		if (targpos.LengthSqr() > 4000*4000) m_ship->SetGunState(0,0);		// temp
 	}
-	m_leadOffset += m_leadDrift * Pi::game->GetTimeStep();
+	m_leadOffset += m_leadDrift * m_ship->GetStepSize();
 	double leadAV = (leaddir-targdir).Dot((leaddir-heading).NormalizedSafe());	// leaddir angvel
 	m_ship->AIFaceDirection((leaddir + m_leadOffset).Normalized(), leadAV);
 
@@ -694,12 +730,13 @@ static bool CheckSuicide(Ship *ship, const vector3d &tandir)
 }
 
 
-extern double calc_ivel(double dist, double vel, double acc);
+extern double calc_ivel(double dist, double vel, double acc, double timeStep);
 
 //------------------------------- Command: FlyTo
 // Fly to vicinity of body
 AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target) : AICommand(ship, CMD_FLYTO)
 {
+	m_plan.valid = false;
 	m_frame = 0;
 	m_state = EFS_MSIX;
 	m_lockhead = true;
@@ -722,6 +759,7 @@ AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target) : AICommand(ship, CMD_FLYTO)
 	}
 	else {
 		m_target = target; 
+		Track(m_target);
 		m_targframe = 0;
 	}
 
@@ -737,6 +775,7 @@ AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target) : AICommand(ship, CMD_FLYTO)
 // Fly to close dist of body
 AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target, double dist) : AICommand(ship, CMD_FLYTO)
 {
+	m_plan.valid = false;
 	m_frame = 0; 
 	m_state = EFS_MSIX; 
 	m_lockhead = true; 
@@ -753,12 +792,14 @@ AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target, double dist) : AICommand(ship,
 			if (m_ship->GetPositionRelTo(target).Length() > target->GetPhysRadius() + 1000.0) {
 				m_dist = target->GetPhysRadius() - 1000.0;
 			}
-			else { //flyto distance.
-				m_dist = static_cast<Planet *>(target)->GetTerrainHeight(ship->GetPosition().Normalized()) + dist;
+			else { //flyto distance. a few percent of it is near enough
+				m_dist = static_cast<Planet *>(target)->GetTerrainHeightApprox(ship->GetPosition().Normalized(),
+					std::max(TERRAIN_COLLISION_ERROR, 0.05 * dist), &ship->GetTerrainHeightCache()) + dist;
 			}
 		}
 	}
 	m_target = target; 
+	Track(m_target);
 	m_targframe = 0;
 }
 
@@ -766,6 +807,7 @@ AICmdFlyTo::AICmdFlyTo(Ship *ship, Body *target, double dist) : AICommand(ship,
 AICmdFlyTo::AICmdFlyTo(Ship *ship, Frame *targframe, const vector3d &posoff, double endvel, bool tangent)
 : AICommand(ship, CMD_FLYTO)
 {
+	m_plan.valid = false;
 	m_targframe = targframe; 
 	m_target = 0;
 	m_posoff = posoff;
@@ -791,6 +833,56 @@ AICmdFlyTo::~AICmdFlyTo()
 	}
 }
 
+// generate base target pos (with vicinity adjustment) & vel, in the ship's frame
+void AICmdFlyTo::CalcTarget(vector3d &targpos, vector3d &targvel) const
+{
+	if (m_target) {
+		targpos = m_target->GetPositionRelTo(m_ship->GetFrame());
+		targpos -= (targpos - m_ship->GetPosition()).NormalizedSafe() * m_dist;
+		targvel = m_target->GetVelocityRelTo(m_ship->GetFrame());
+	}
+	else {
+		targpos = GetPosInFrame(m_ship->GetFrame(), m_targframe, m_posoff);
+		targvel = GetVelInFrame(m_ship->GetFrame(), m_targframe, m_posoff);
+	}
+	Frame *targframe = m_target ? m_target->GetFrame() : m_targframe;
+	ParentSafetyAdjust(m_ship, targframe, targpos, targvel);
+}
+
+// body is the ship's frame body
+bool AICmdFlyTo::NeedCollisionCheck(const Body *body) const
+{
+	return (m_target && body != m_target)
+		|| (m_targframe && (!m_tangent || body != m_targframe->GetBody()));
+}
+
+bool AICmdFlyTo::PlanIsCurrent() const
+{
+	return m_plan.valid && m_plan.ship.Matches(m_ship);
+}
+
+void AICmdFlyTo::Think()
+{
+	AICommand::Think();
+
+	m_plan.valid = false;
+	if (!m_target && !m_targframe) return;
+	if (m_ship->GetFlightState() != Ship::FLYING) return;
+
+	m_plan.ship.Take(m_ship);
+	CalcTarget(m_plan.targpos, m_plan.targvel);
+
+	Body *body = m_ship->GetFrame()->GetBody();
+	m_plan.effectRad = MaxEffectRad(body, m_ship);
+	m_plan.coll = 0;
+	if (NeedCollisionCheck(body)) {
+		const vector3d relpos = m_plan.targpos - m_plan.ship.pos;
+		m_plan.coll = CheckCollision(m_ship, relpos.NormalizedSafe(), relpos.Length(),
+			m_plan.targpos, m_endvel, m_plan.effectRad);
+	}
+	m_plan.valid = true;
+}
+
 bool AICmdFlyTo::TimeStepUpdate()
 {
 	if (m_ship->GetFlightState() == Ship::JUMPING) {
@@ -967,19 +1059,16 @@ bool AICmdFlyTo::TimeStepUpdate()
 	}
 
 	// generate base target pos (with vicinity adjustment) & vel 
-	double timestep = Pi::game->GetTimeStep();
+	double timestep = m_ship->GetStepSize();
+	const bool usePlan = PlanIsCurrent();
+	m_plan.valid = false;
 	vector3d targpos, targvel;
-	if (m_target) {
-		targpos = m_target->GetPositionRelTo(m_ship->GetFrame());
-		targpos -= (targpos - m_ship->GetPosition()).NormalizedSafe() * m_dist;
-		targvel = m_target->GetVelocityRelTo(m_ship->GetFrame());
-	}
-	else {
-		targpos = GetPosInFrame(m_ship->GetFrame(), m_targframe, m_posoff);
-		targvel = GetVelInFrame(m_ship->GetFrame(), m_targframe, m_posoff);
+	if (usePlan) {
+		targpos = m_plan.targpos;
+		targvel = m_plan.targvel;
 	}
-	Frame *targframe = m_target ? m_target->GetFrame() : m_targframe;
-	ParentSafetyAdjust(m_ship, targframe, targpos, targvel);
+	else
+		CalcTarget(targpos, targvel);
 	vector3d relpos = targpos - m_ship->GetPosition();
 	vector3d reldir = relpos.NormalizedSafe();
 	vector3d relvel = targvel - m_ship->GetVelocity();
@@ -1007,11 +1096,10 @@ bool AICmdFlyTo::TimeStepUpdate()
 	// TODO: collision needs to be processed according to vdiff, not reldir?
 
 	Body *body = m_frame->GetBody();
-	const double effect_rad = MaxEffectRad(body, m_ship);
-	if ((m_target && body != m_target)
-		|| (m_targframe && (!m_tangent || body != m_targframe->GetBody()))) 
+	const double effect_rad = usePlan ? m_plan.effectRad : MaxEffectRad(body, m_ship);
+	if (NeedCollisionCheck(body)) 
 	{
-		int coll = CheckCollision(m_ship, reldir, target_distance, targpos, m_endvel, effect_rad);
+		int coll = usePlan ? m_plan.coll : CheckCollision(m_ship, reldir, target_distance, targpos, m_endvel, effect_rad);
 		if (coll == 0) {				// no collision
 			if (m_child) { delete m_child; m_child = 0; }
 		}
@@ -1113,7 +1201,7 @@ bool AICmdFlyTo::TimeStepUpdate()
 	//	if (perpspeed < tt*0.01*m_ship->GetAccelMin()) perpspeed = 0;
 
 	// calculate target speed
-	double ispeed = (max_deceleration < 1e-10) ? 0.0 : calc_ivel(target_distance, m_endvel, max_deceleration);
+	double ispeed = (max_deceleration < 1e-10) ? 0.0 : calc_ivel(target_distance, m_endvel, max_deceleration, m_ship->GetStepSize());
 
 	// cap target speed according to spare fuel remaining
 	double fuelspeed = m_ship->GetSpeedReachedWithFuel();
@@ -1193,7 +1281,9 @@ bool AICmdFlyTo::TimeStepUpdate()
 AICmdDock::AICmdDock(Ship *ship, SpaceStation *target) : AICommand(ship, CMD_DOCK)
 {
 	bool is_player = ship->IsPlayerShip();
+	m_plan.valid = false;
 	m_target = target;
+	Track(m_target);
 	m_state = eDockGetDataStart;
 	double grav = GetGravityAtPos(m_target->GetFrame(), m_target->GetPosition());
 	if (m_ship->GetAccelUp() < grav) {
@@ -1202,6 +1292,26 @@ AICmdDock::AICmdDock(Ship *ship, SpaceStation *target) : AICommand(ship, CMD_DOC
 	}
 }
 
+// the frame transforms for the approach. the docking data is only worked
+// out in TimeStepUpdate, so this is for the m_dockpos there already
+void AICmdDock::Think()
+{
+	AICommand::Think();
+
+	m_plan.valid = false;
+	if (m_child || !m_target) return;
+	if (m_ship->GetFlightState() != Ship::FLYING) return;
+
+	m_plan.ship.Take(m_ship);
+	m_plan.target.Take(m_target);
+	m_plan.targdist = m_target->GetPositionRelTo(m_ship).Length();
+	m_plan.dockpos = m_dockpos;
+	m_plan.targpos = GetPosInFrame(m_ship->GetFrame(), m_target->GetFrame(), m_dockpos);
+	m_plan.relvel = -m_target->GetVelocityRelTo(m_ship);
+	m_plan.trot = m_target->GetOrientRelTo(m_ship->GetFrame());
+	m_plan.valid = true;
+}
+
 // m_state values:
 // 0: get data for docking start pos
 // 1: Fly to docking start pos
@@ -1220,8 +1330,11 @@ bool AICmdDock::TimeStepUpdate()
 		return true; // docked, hopefully
 	}
 
+	bool usePlan = m_plan.valid && m_plan.ship.Matches(m_ship) && m_plan.target.Matches(m_target);
+	m_plan.valid = false;
+
 	// if we're not close to target, do a flyto first
-	double targdist = m_target->GetPositionRelTo(m_ship).Length();
+	double targdist = usePlan ? m_plan.targdist : m_target->GetPositionRelTo(m_ship).Length();
 	if (targdist > 16000.0) {
 		//m_child = new AICmdFlyTo(m_ship, m_target);
 		m_child = new AIParagonCmdFlyTo(m_ship, m_target);
@@ -1277,14 +1390,15 @@ bool AICmdDock::TimeStepUpdate()
 	}
 
 	// second docking waypoint
+	usePlan = usePlan && m_plan.dockpos.ExactlyEqual(m_dockpos);
 	m_ship->SetWheelState(true);
-	vector3d targpos = GetPosInFrame(m_ship->GetFrame(), m_target->GetFrame(), m_dockpos);
+	vector3d targpos = usePlan ? m_plan.targpos : GetPosInFrame(m_ship->GetFrame(), m_target->GetFrame(), m_dockpos);
 	vector3d relpos = targpos - m_ship->GetPosition();
 	vector3d reldir = relpos.NormalizedSafe();
-	vector3d relvel = -m_target->GetVelocityRelTo(m_ship);
+	vector3d relvel = usePlan ? m_plan.relvel : -m_target->GetVelocityRelTo(m_ship);
 
 	double maxdecel = m_ship->GetAccelUp() - GetGravityAtPos(m_target->GetFrame(), m_dockpos);
-	double ispeed = calc_ivel(relpos.Length(), 0.0, maxdecel);
+	double ispeed = calc_ivel(relpos.Length(), 0.0, maxdecel, m_ship->GetStepSize());
 	vector3d vdiff = ispeed*reldir - relvel;
 	m_ship->AIChangeVelDir(vdiff * m_ship->GetOrient());
 	if (vdiff.Dot(reldir) < 0) {
@@ -1292,9 +1406,9 @@ bool AICmdDock::TimeStepUpdate()
 	}
 
 	// get rotation of station for next frame
-	matrix3x3d trot = m_target->GetOrientRelTo(m_ship->GetFrame());
+	matrix3x3d trot = usePlan ? m_plan.trot : m_target->GetOrientRelTo(m_ship->GetFrame());
 	double av = m_target->GetAngVelocity().Length();
-	double ang = av * Pi::game->GetTimeStep();
+	double ang = av * m_ship->GetStepSize();
 	if (ang > 1e-16) {
 		vector3d axis = m_target->GetAngVelocity().Normalized();
 		trot = trot * matrix3x3d::Rotate(ang, axis);
@@ -1334,7 +1448,9 @@ bool AICmdHoldPosition::TimeStepUpdate()
 //------------------------------- Command: Fly Around
 void AICmdFlyAround::Setup(Body *obstructor, double alt, double vel, int mode)
 {
+	m_plan.valid = false;
 	m_obstructor = obstructor; m_alt = alt; m_vel = vel; m_targmode = mode;
+	Track(m_obstructor);
 
 	// generate suitable velocity if none provided
 	double minacc = (mode == 2) ? 0 : m_ship->GetAccelMin();
@@ -1370,10 +1486,31 @@ double AICmdFlyAround::MaxVel(double targdist, double targalt)
 	double t = sqrt(2.0 * targdist / m_ship->GetAccelFwd());
 	double vmaxprox = m_ship->GetAccelMin()*t;			// limit by target proximity
 	double vmaxstep = std::max(m_alt*0.05, m_alt-targalt);
-	vmaxstep /= Pi::game->GetTimeStep();			// limit by distance covered per timestep
+	vmaxstep /= m_ship->GetStepSize();			// limit by distance covered per timestep
 	return std::min(m_vel, std::min(vmaxprox, vmaxstep));
 }
 
+void AICmdFlyAround::Think()
+{
+	AICommand::Think();
+
+	m_plan.valid = false;
+	if (m_child || !m_obstructor) return;
+	if (m_ship->GetFlightState() != Ship::FLYING) return;
+
+	m_plan.ship.Take(m_ship);
+	m_plan.obstructor.Take(m_obstructor);
+	m_plan.targpos = (!m_targmode) ? m_targpos :
+		m_ship->GetVelocity().NormalizedSafe()*m_ship->GetPosition().LengthSqr();
+	m_plan.obspos = m_obstructor->GetPositionRelTo(m_ship);
+	if (m_plan.obspos.Length() > 1.1*m_alt) {
+		Frame *obsframe = m_obstructor->GetFrame()->GetNonRotFrame();
+		m_plan.tangent = GenerateTangent(m_ship, obsframe, m_plan.targpos, m_alt);
+		m_plan.tpos_obs = GetPosInFrame(obsframe, m_ship->GetFrame(), m_plan.targpos);
+	}
+	m_plan.valid = true;
+}
+
 bool AICmdFlyAround::TimeStepUpdate()
 {
 	if (m_ship->GetFlightState() == Ship::JUMPING) return false;
@@ -1383,10 +1520,13 @@ bool AICmdFlyAround::TimeStepUpdate()
 	if (m_ship->GetFlightState() == Ship::FLYING) m_ship->SetWheelState(false);
 	else { LaunchShip(m_ship); return false; }
 
-	double timestep = Pi::game->GetTimeStep();
+	double timestep = m_ship->GetStepSize();
 	vector3d targpos = (!m_targmode) ? m_targpos :
 		m_ship->GetVelocity().NormalizedSafe()*m_ship->GetPosition().LengthSqr();
-	vector3d obspos = m_obstructor->GetPositionRelTo(m_ship);
+	const bool usePlan = m_plan.valid && m_plan.ship.Matches(m_ship)
+		&& m_plan.obstructor.Matches(m_obstructor) && m_plan.targpos.ExactlyEqual(targpos);
+	m_plan.valid = false;
+	vector3d obspos = usePlan ? m_plan.obspos : m_obstructor->GetPositionRelTo(m_ship);
 	double obsdist = obspos.Length();
 	vector3d obsdir = obspos / obsdist;
 	vector3d relpos = targpos - m_ship->GetPosition();
@@ -1402,8 +1542,8 @@ bool AICmdFlyAround::TimeStepUpdate()
 	{
 		double v;
 		Frame *obsframe = m_obstructor->GetFrame()->GetNonRotFrame();
-		vector3d tangent = GenerateTangent(m_ship, obsframe, targpos, m_alt);
-		vector3d tpos_obs = GetPosInFrame(obsframe, m_ship->GetFrame(), targpos);
+		vector3d tangent = usePlan ? m_plan.tangent : GenerateTangent(m_ship, obsframe, targpos, m_alt);
+		vector3d tpos_obs = usePlan ? m_plan.tpos_obs : GetPosInFrame(obsframe, m_ship->GetFrame(), targpos);
 		if (m_targmode) v = m_vel;
 		else if (relpos.LengthSqr() < obsdist + tpos_obs.LengthSqr()) v = 0.0;
 		else v = MaxVel((tpos_obs-tangent).Length(), tpos_obs.Length());
@@ -1427,7 +1567,7 @@ bool AICmdFlyAround::TimeStepUpdate()
 
 	// calculate target velocity
 	double alt = (tanvel * timestep + obspos).Length();		// unnecessary?
-	double ivel = calc_ivel(alt - m_alt, 0.0, m_ship->GetAccelMin());
+	double ivel = calc_ivel(alt - m_alt, 0.0, m_ship->GetAccelMin(), m_ship->GetStepSize());
 
 	vector3d finalvel = tanvel + ivel * obsdir;
 	m_ship->AIMatchVel(finalvel);
@@ -1454,6 +1594,7 @@ bool AICmdFlyAround::TimeStepUpdate()
 AICmdTransitAround::AICmdTransitAround(Ship *ship, Body *obstructor) : AICommand(ship, CMD_TRANSITAROUND)
 {
 	m_obstructor = obstructor;
+	Track(m_obstructor);
 	m_alt = 0.0;
 	m_state = AITA_READY;
 	m_warmUpTime = 2.0f;
@@ -1476,7 +1617,7 @@ AICmdTransitAround::~AICmdTransitAround()
 bool AICmdTransitAround::TimeStepUpdate()
 {
 	if (!ProcessChild()) return false;
-	const double time_step = Pi::game->GetTimeStep();
+	const double time_step = m_ship->GetStepSize();
 	const double transit_low = std::max<double>(
 		TRANSIT_GRAVITY_RANGE_1 + (m_obstructor->GetPhysRadius() * 0.0019), 
 		TRANSIT_GRAVITY_RANGE_1);
@@ -1587,6 +1728,7 @@ AICmdFormation::AICmdFormation(Ship *ship, Ship *target, const vector3d &posoff)
 	: AICommand(ship, CMD_FORMATION)
 {
 	m_target = target;
+	Track(m_target);
 	m_posoff = posoff;
 }
 
@@ -1616,12 +1758,12 @@ bool AICmdFormation::TimeStepUpdate()
 	// adjust for target acceleration
 	matrix3x3d forient = m_target->GetFrame()->GetOrientRelTo(m_ship->GetFrame());
 	vector3d targaccel = forient * m_target->GetLastForce() / m_target->GetMass();
-	relvel -= targaccel * Pi::game->GetTimeStep();
+	relvel -= targaccel * m_ship->GetStepSize();
 	double maxdecel = m_ship->GetAccelFwd() + targaccel.Dot(reldir);
 	if (maxdecel < 0.0) maxdecel = 0.0;
 
 	// linear thrust
-	double ispeed = calc_ivel(targdist, 0.0, maxdecel);
+	double ispeed = calc_ivel(targdist, 0.0, maxdecel, m_ship->GetStepSize());
 	vector3d vdiff = ispeed*reldir - relvel;
 	m_ship->AIChangeVelDir(vdiff * m_ship->GetOrient());
 	if (m_target->IsDecelerating()) m_ship->SetDecelerating(true);
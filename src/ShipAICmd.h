@@ -13,6 +13,18 @@
 
 const double NO_TRANSIT_RANGE = 100000.0;
 
+// where a body was when Think() made a plan from it. the plan is only used
+// if the body is still exactly there when the command acts on it
+struct AIPlanSnapshot {
+	AIPlanSnapshot() : frame(0) {}
+	void Take(const Body *b);
+	bool Matches(const Body *b) const;
+
+	const Frame *frame;
+	vector3d pos, vel;
+	matrix3x3d orient;
+};
+
 class AICommand {
 public:
 	// This enum is solely to make the serialization work
@@ -43,6 +55,10 @@ public:
 	virtual ~AICommand() { if (m_child) delete m_child; }
 
 	virtual bool TimeStepUpdate() = 0;
+	// read-only planning pass run just before TimeStepUpdate, possibly on a
+	// worker thread alongside other ships. must not modify the ship, other
+	// bodies or frames; only precompute into the command's own members
+	virtual void Think() { if (m_child) m_child->Think(); }
 	bool ProcessChild();				// returns false if child is active
 	virtual void GetStatusText(char *str) {
 		if (m_child) m_child->GetStatusText(str);
@@ -62,6 +78,9 @@ public:
 	AICommand* GetChildCommand() const { return m_child; }
 
 protected:
+	// m_ship hears (through OnDeleted) if b leaves the space
+	void Track(const Body *b) { if (b) m_ship->WatchBody(b); }
+
 	CmdName m_cmdName;
 	Ship *m_ship;
 	AICommand *m_child;
@@ -72,6 +91,7 @@ protected:
 class AICmdDock : public AICommand {
 public:
 	virtual bool TimeStepUpdate();
+	virtual void Think();
 	AICmdDock(Ship *ship, SpaceStation *target);
 
 	virtual void GetStatusText(char *str) {
@@ -86,6 +106,7 @@ public:
 		wr.Vector3d(m_dockupdir); wr.Int32(m_state);
 	}
 	AICmdDock(Serializer::Reader &rd) : AICommand(rd, CMD_DOCK) {
+		m_plan.valid = false;
 		m_targetIndex = rd.Int32();
 		m_dockpos = rd.Vector3d(); m_dockdir = rd.Vector3d();
 		m_dockupdir = rd.Vector3d(); m_state = EDockingStates(rd.Int32());
@@ -93,12 +114,24 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = static_cast<SpaceStation *>(space->GetBodyByIndex(m_targetIndex));
+		Track(m_target);
 	}
 	virtual void OnDeleted(const Body *body) {
 		AICommand::OnDeleted(body);
-		if (static_cast<Body *>(m_target) == body) m_target = 0;
+		if (static_cast<Body *>(m_target) == body) { m_target = 0; m_plan.valid = false; }
 	}
 private:
+	// the station's position and orientation for the approach, from Think()
+	struct Plan {
+		bool valid;
+		AIPlanSnapshot ship, target;
+		double targdist;
+		vector3d dockpos;	// m_dockpos it was made for
+		vector3d targpos, relvel;
+		matrix3x3d trot;
+	};
+	Plan m_plan;
+
 	enum EDockingStates {
 		eDockGetDataStart = 0,	// 0: get data for docking start pos
 		eDockFlyToStart = 1,	// 1: Fly to docking start pos
@@ -130,6 +163,7 @@ private:
 class AICmdFlyTo : public AICommand {
 public:
 	virtual bool TimeStepUpdate();
+	virtual void Think();
 	AICmdFlyTo(Ship *ship, Frame *targframe, const vector3d &posoff, double endvel, bool tangent);
 	AICmdFlyTo(Ship *ship, Body *target);
 	AICmdFlyTo(Ship *ship, Body *target, double dist);
@@ -155,6 +189,7 @@ public:
 		wr.Int32(m_state);
 	}
 	AICmdFlyTo(Serializer::Reader &rd) : AICommand(rd, CMD_FLYTO) {
+		m_plan.valid = false;
 		m_targetIndex = rd.Int32();
 		m_dist = rd.Double();
 		m_targframeIndex = rd.Int32();
@@ -166,15 +201,31 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = space->GetBodyByIndex(m_targetIndex);
+		Track(m_target);
 		m_targframe = space->GetFrameByIndex(m_targframeIndex);
 		m_lockhead = true;
 	}
 	virtual void OnDeleted(const Body *body) {
 		AICommand::OnDeleted(body);
-		if (m_target == body) m_target = 0;
+		if (m_target == body) { m_target = 0; m_plan.valid = false; }
 	}
 
 private:
+	// target and path check computed by Think(). only used if the ship is
+	// still where it was when it was made
+	struct Plan {
+		bool valid;
+		AIPlanSnapshot ship;
+		vector3d targpos, targvel;
+		double effectRad;
+		int coll;
+	};
+	Plan m_plan;
+
+	void CalcTarget(vector3d &targpos, vector3d &targvel) const;
+	bool NeedCollisionCheck(const Body *body) const;
+	bool PlanIsCurrent() const;
+
 	enum EFlyToState {
 		EFS_THREE = 3,
 		//EFS_TWO = 2,
@@ -206,6 +257,7 @@ private:
 class AICmdFlyAround : public AICommand {
 public:
 	virtual bool TimeStepUpdate();
+	virtual void Think();
 	AICmdFlyAround(Ship *ship, Body *obstructor, double relalt, int mode=2);
 	AICmdFlyAround(Ship *ship, Body *obstructor, double alt, double vel, int mode=1);
 	virtual ~AICmdFlyAround() {}
@@ -222,12 +274,14 @@ public:
 		wr.Double(m_vel); wr.Double(m_alt); wr.Int32(m_targmode);
 	}
 	AICmdFlyAround(Serializer::Reader &rd) : AICommand(rd, CMD_FLYAROUND) {
+		m_plan.valid = false;
 		m_obstructorIndex = rd.Int32();
 		m_vel = rd.Double(); m_alt = rd.Double(); m_targmode = rd.Int32();
 	}
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_obstructor = space->GetBodyByIndex(m_obstructorIndex);
+		Track(m_obstructor);
 	}
 	virtual void OnDeleted(const Body *body) {
 		AICommand::OnDeleted(body);
@@ -240,6 +294,16 @@ protected:
 	double MaxVel(double targdist, double targalt);
 
 private:
+	// the obstructor's position and the tangent to it, from Think()
+	struct Plan {
+		bool valid;
+		AIPlanSnapshot ship, obstructor;
+		vector3d targpos;	// in the ship's frame, as it was made for
+		vector3d obspos;
+		vector3d tangent, tpos_obs;	// only if out beyond the orbit
+	};
+	Plan m_plan;
+
 	Body *m_obstructor;		// body to fly around
 	int m_obstructorIndex;	// deserialisation
 	double m_alt, m_vel;
@@ -277,6 +341,7 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_obstructor = space->GetBodyByIndex(m_obstructorIndex);
+		Track(m_obstructor);
 	}
 	virtual void OnDeleted(const Body *body) {
 		AICommand::OnDeleted(body);
@@ -305,8 +370,11 @@ private:
 class AICmdKill : public AICommand {
 public:
 	virtual bool TimeStepUpdate();
+	virtual void Think();
 	AICmdKill(Ship *ship, Ship *target) : AICommand (ship, CMD_KILL) {
+		m_plan.valid = false;
 		m_target = target;
+		Track(m_target);
 		m_leadTime = m_evadeTime = m_closeTime = 0.0;
 		m_lastVel = m_target->GetVelocity();
 	}
@@ -318,21 +386,31 @@ public:
 		wr.Int32(space->GetIndexForBody(m_target));
 	}
 	AICmdKill(Serializer::Reader &rd) : AICommand(rd, CMD_KILL) {
+		m_plan.valid = false;
 		m_targetIndex = rd.Int32();
 	}
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = static_cast<Ship *>(space->GetBodyByIndex(m_targetIndex));
+		Track(m_target);
 		m_leadTime = m_evadeTime = m_closeTime = 0.0;
 		m_lastVel = m_target->GetVelocity();
 	}
 
 	virtual void OnDeleted(const Body *body) {
-		if (static_cast<Body *>(m_target) == body) m_target = 0;
+		if (static_cast<Body *>(m_target) == body) { m_target = 0; m_plan.valid = false; }
 		AICommand::OnDeleted(body);
 	}
 
 private:
+	// where the target is and where to aim, from Think()
+	struct Plan {
+		bool valid;
+		AIPlanSnapshot ship, target;
+		vector3d targpos, targvel, targaccel, leaddir;
+	};
+	Plan m_plan;
+
 	Ship *m_target;
 	double m_leadTime, m_evadeTime, m_closeTime;
 	vector3d m_leadOffset, m_leadDrift, m_lastVel;
@@ -344,6 +422,7 @@ public:
 	virtual bool TimeStepUpdate();
 	AICmdKamikaze(Ship *ship, Body *target) : AICommand (ship, CMD_KAMIKAZE) {
 		m_target = target;
+		Track(m_target);
 	}
 
 	virtual void Save(Serializer::Writer &wr) {
@@ -357,6 +436,7 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = space->GetBodyByIndex(m_targetIndex);
+		Track(m_target);
 	}
 
 	virtual void OnDeleted(const Body *body) {
@@ -399,6 +479,7 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = static_cast<Ship*>(space->GetBodyByIndex(m_targetIndex));
+		Track(m_target);
 	}
 	virtual void OnDeleted(const Body *body) {
 		if (static_cast<Body *>(m_target) == body) m_target = 0;
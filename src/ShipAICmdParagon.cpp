@@ -207,6 +207,7 @@ AIParagonCmdFlyTo::AIParagonCmdFlyTo(Ship *ship, Body *target)
 	: AICommand(ship, CMD_PARAGON_FLYTO)
 {
 	m_target = target;
+	Track(m_target);
 	m_targetFrame = target->GetFrame();
 	m_arrivalRadius = GetArrivalRadius(target);
 	m_endVelocity = 0.0;
@@ -224,6 +225,7 @@ AIParagonCmdFlyTo::AIParagonCmdFlyTo(Ship *ship, Body *target, double distance)
 	: AICommand(ship, CMD_PARAGON_FLYTO)
 {
 	m_target = target;
+	Track(m_target);
 	m_targetFrame = target->GetFrame();
 	m_targetPosition = target->GetPositionRelTo(m_targetFrame);
 	m_endVelocity = 0.0;
@@ -946,6 +948,7 @@ AIParagonCmdDock::AIParagonCmdDock(Ship* ship, SpaceStation* station)
 {
 	assert(ship);
 	m_station = station;
+	Track(m_station);
 	m_state = EDS_ZERO;
 	m_waitingForSignalMessage = false;
 }
@@ -998,6 +1001,7 @@ void AIParagonCmdDock::PostLoadFixup(Space *space)
 {
 	AICommand::PostLoadFixup(space);
 	m_station = static_cast<SpaceStation*>(space->GetBodyByIndex(m_stationIndex));
+	Track(m_station);
 }
 
 void AIParagonCmdDock::OnDeleted(const Body *body)
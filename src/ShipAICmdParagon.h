@@ -55,6 +55,7 @@ public:
 	virtual void PostLoadFixup(Space *space) {
 		AICommand::PostLoadFixup(space);
 		m_target = space->GetBodyByIndex(m_targetIndex);
+		Track(m_target);
 		m_targetFrame = space->GetFrameByIndex(m_targframeIndex);
 		m_lockhead = true;
 	}
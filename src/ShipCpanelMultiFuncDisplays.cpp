@@ -302,16 +302,22 @@ void ScannerWidget::Update()
 	// collect the bodies to be displayed, and if AUTO, distances
 	Space::BodyNearList nearby;
 	Pi::game->GetSpace()->GetBodiesMaybeNear(Pi::player, SCANNER_RANGE_MAX, nearby);
+
+	// everything into the player's frame in one go
+	std::vector<vector3d> relPos(nearby.size());
+	if (!nearby.empty()) Body::GetInterpPositionsRelTo(Pi::player->GetFrame(), &nearby[0], nearby.size(), &relPos[0]);
+	const vector3d playerPos = Pi::player->GetInterpPosition();
+
 	for (Space::BodyNearIterator i = nearby.begin(); i != nearby.end(); ++i) {
 		if ((*i) == Pi::player) continue;
 
-		float dist = float((*i)->GetPositionRelTo(Pi::player).Length());
-
 		Contact c;
 		c.type = (*i)->GetType();
-		c.pos = (*i)->GetPositionRelTo(Pi::player);
+		c.pos = relPos[i - nearby.begin()] - playerPos;
 		c.isSpecial = false;
 
+		float dist = float(c.pos.Length());
+
 		switch ((*i)->GetType()) {
 
 			case Object::MISSILE:
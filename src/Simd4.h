@@ -0,0 +1,79 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SIMD4_H
+#define _SIMD4_H
+
+// Four floats side by side, for testing one ray against four boxes or
+// triangles at a time, or mixing two stereo frames of sound at once. SSE
+// where the compiler has it, plain loops otherwise. Comparisons give a
+// bitmask, one bit per lane as _mm_movemask_ps does.
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define SIMD4_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include <algorithm>
+
+#ifdef SIMD4_SSE
+
+struct Simd4f {
+	__m128 v;
+
+	Simd4f() {}
+	Simd4f(__m128 v_) : v(v_) {}
+	explicit Simd4f(float f) : v(_mm_set1_ps(f)) {}
+
+	// unaligned, std::vector doesn't promise 16 bytes everywhere
+	static Simd4f Load(const float *p) { return Simd4f(_mm_loadu_ps(p)); }
+	void Store(float *p) const { _mm_storeu_ps(p, v); }
+
+	friend Simd4f operator+(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_add_ps(a.v, b.v)); }
+	friend Simd4f operator-(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_sub_ps(a.v, b.v)); }
+	friend Simd4f operator*(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_mul_ps(a.v, b.v)); }
+	friend Simd4f operator/(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_div_ps(a.v, b.v)); }
+
+	friend Simd4f Min(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_min_ps(a.v, b.v)); }
+	friend Simd4f Max(const Simd4f &a, const Simd4f &b) { return Simd4f(_mm_max_ps(a.v, b.v)); }
+
+	friend int CmpLt(const Simd4f &a, const Simd4f &b) { return _mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+	friend int CmpLe(const Simd4f &a, const Simd4f &b) { return _mm_movemask_ps(_mm_cmple_ps(a.v, b.v)); }
+	friend int CmpGt(const Simd4f &a, const Simd4f &b) { return _mm_movemask_ps(_mm_cmpgt_ps(a.v, b.v)); }
+	friend int CmpGe(const Simd4f &a, const Simd4f &b) { return _mm_movemask_ps(_mm_cmpge_ps(a.v, b.v)); }
+};
+
+#else
+
+struct Simd4f {
+	float v[4];
+
+	Simd4f() {}
+	explicit Simd4f(float f) { v[0] = v[1] = v[2] = v[3] = f; }
+
+	static Simd4f Load(const float *p) { Simd4f r; for (int i=0; i<4; i++) r.v[i] = p[i]; return r; }
+	void Store(float *p) const { for (int i=0; i<4; i++) p[i] = v[i]; }
+
+#define SIMD4_OP(_name, _expr) \
+	friend Simd4f _name(const Simd4f &a, const Simd4f &b) { Simd4f r; for (int i=0; i<4; i++) r.v[i] = (_expr); return r; }
+	SIMD4_OP(operator+, a.v[i] + b.v[i])
+	SIMD4_OP(operator-, a.v[i] - b.v[i])
+	SIMD4_OP(operator*, a.v[i] * b.v[i])
+	SIMD4_OP(operator/, a.v[i] / b.v[i])
+	// same NaN behaviour as minps/maxps, the second operand wins
+	SIMD4_OP(Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+	SIMD4_OP(Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef SIMD4_OP
+
+#define SIMD4_CMP(_name, _op) \
+	friend int _name(const Simd4f &a, const Simd4f &b) { int m = 0; for (int i=0; i<4; i++) m |= (a.v[i] _op b.v[i]) ? (1<<i) : 0; return m; }
+	SIMD4_CMP(CmpLt, <)
+	SIMD4_CMP(CmpLe, <=)
+	SIMD4_CMP(CmpGt, >)
+	SIMD4_CMP(CmpGe, >=)
+#undef SIMD4_CMP
+};
+
+#endif
+
+#endif /* _SIMD4_H */
@@ -12,18 +12,30 @@
 #include <vector>
 #include <string>
 #include <cerrno>
+#include <atomic>
 #include "Sound.h"
+#include "SoundMix.h"
 #include "Body.h"
 #include "Pi.h"
 #include "Player.h"
 #include "FileSystem.h"
+#include "JobQueue.h"
+#include "jenkins/lookup3.h"
 
 namespace Sound {
 
-static const unsigned int FREQ = 44100;
+static const unsigned int FREQ = Mix::OUTPUT_RATE;
 static const unsigned int BUF_SIZE = 4096;
-static const unsigned int MAX_WAVSTREAMS = 10; //first two are for music
+static const unsigned int MAX_SFX_VOICES = 64;
+static const unsigned int MAX_WAVSTREAMS = MAX_SFX_VOICES + 2; //first two are for music
 static const double STREAM_IF_LONGER_THAN = 10.0;
+// commands from the game to the mixer, power of two
+static const Uint32 COMMAND_RING_SIZE = 256;
+// decoded Sint16s a stream keeps ready, three quarters of a second of
+// 44.1kHz stereo. power of two
+static const Uint32 STREAM_BUF_SAMPLES = 1 << 16;
+// the decode thread tops up streams at least this often
+static const Uint32 DECODE_INTERVAL_MS = 10;
 
 class OggFileDataStream {
 public:
@@ -108,17 +120,17 @@ const ov_callbacks OggFileDataStream::CALLBACKS = {
 	&OggFileDataStream::ov_callback_tell
 };
 
-static float m_masterVol = 1.0f;
+static std::atomic<float> m_masterVol(1.0f);
 static float m_sfxVol = 1.0f;
 
 void SetMasterVolume(const float vol)
 {
-	m_masterVol = vol;
+	m_masterVol.store(vol, std::memory_order_relaxed);
 }
 
 float GetMasterVolume()
 {
-	return m_masterVol;
+	return m_masterVol.load(std::memory_order_relaxed);
 }
 
 void SetSfxVolume(const float vol)
@@ -156,24 +168,52 @@ eventid BodyMakeNoise(const Body *b, const char *sfx, float vol)
 	v[0] = Clamp(v[0], 0.0f, 1.0f);
 	v[1] = Clamp(v[1], 0.0f, 1.0f);
 
-	return Sound::PlaySfx(sfx, v[0], v[1], 0);
+	// whatever the player's ship does matters more than what it hears
+	return Sound::PlaySfx(sfx, v[0], v[1], 0, (b == Pi::player) ? PRIORITY_HIGH : PRIORITY_NORMAL);
 }
 
-struct SoundEvent {
+/*
+ * Three threads share the work. The game thread decides what plays where
+ * and sends commands down a ring to the mixer, so it never waits for the
+ * audio lock. The mixer (the SDL audio callback) only mixes: samples that
+ * are too long to keep decoded are streamed, and the decode thread keeps a
+ * ring of decoded sound ready for each stream ahead of the mixer.
+ */
+
+// A streamed sample being played. The game thread makes it, the mixer reads
+// what the decode thread has decoded into buf and lets go of it when it's
+// done, and the decode thread deletes it after that.
+struct Stream {
+	Stream(const Sample *s, Op o): sample(s), opened(false),
+		writePos(0), readPos(0), eof(false), released(false), op(o) {}
+
 	const Sample *sample;
-	OggVorbis_File *oggv; // if sample->buf = 0 then stream this
+
+	// decode thread only
+	bool opened;
+	OggVorbis_File oggv;
 	OggFileDataStream ogg_data_stream;
-	Uint32 buf_pos;
-	float volume[2]; // left and right channels
+
+	Sint16 buf[STREAM_BUF_SAMPLES];
+	std::atomic<Uint32> writePos;	// decode thread moves this on
+	std::atomic<Uint32> readPos;	// mixer moves this on
+	std::atomic<bool> eof;			// nothing more will be written
+	std::atomic<bool> released;		// the mixer is finished with it
+	std::atomic<Uint32> op;			// for OP_REPEAT, set by the mixer
+};
+
+struct SoundEvent {
+	const Sample *sample;
+	Stream *stream; // if sample->buf = 0 then stream this
+	// for a stream the frame is counted from its readPos
+	Mix::Cursor cursor;
+	Mix::Gain gain;
 	eventid identifier;
 	Uint32 op;
-
-	float targetVolume[2];
-	float rateOfChange[2]; // per sample
-	bool ascend[2];
 };
 
 static std::map<std::string, Sample> sfx_samples;
+// mixer only, apart from Init() and Uninit() when it isn't running
 struct SoundEvent wavstream[MAX_WAVSTREAMS];
 
 static Sample *GetSample(const char *filename)
@@ -186,77 +226,632 @@ static Sample *GetSample(const char *filename)
 	}
 }
 
-static SoundEvent *GetEvent(eventid id)
+// the game thread's view of the streams: the event it last put in each
+// one, and the last event the mixer finished with in each. an event is
+// playing while it's in its stream and the mixer hasn't finished it
+static eventid s_slotEvent[MAX_WAVSTREAMS];
+static std::atomic<eventid> s_slotFinished[MAX_WAVSTREAMS];
+// what's needed to choose a voice to steal: how much the event matters,
+// and the louder of its target volumes
+static Priority s_slotPriority[MAX_WAVSTREAMS];
+static float s_slotLoudness[MAX_WAVSTREAMS];
+
+static int GetSlot(eventid id)
 {
+	if (id == 0) return -1;
 	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-		if (wavstream[i].sample && (wavstream[i].identifier == id))
-			return &wavstream[i];
+		if (s_slotEvent[i] == id && s_slotFinished[i].load(std::memory_order_acquire) != id)
+			return i;
 	}
-	return 0;
+	return -1;
 }
 
-bool SetOp(eventid id, Op op)
+static bool SlotFree(unsigned int slot)
 {
-	if (id == 0) return false;
-	bool ret = false;
-	SDL_LockAudio();
-	SoundEvent *se = GetEvent(id);
-	if (se) {
-		se->op = op;
-		ret = true;
+	return !s_slotEvent[slot] || s_slotFinished[slot].load(std::memory_order_acquire) == s_slotEvent[slot];
+}
+
+/*
+ * Samples. Nothing is decoded up front: a sample is decoded the first time
+ * it's played, unless the prewarm job has got to it first. Decoded samples
+ * are kept up to a memory limit, past which the least recently played that
+ * aren't playing are let go of, and can be cached decoded on disk.
+ */
+
+enum SampleState {
+	SAMPLE_UNLOADED,
+	SAMPLE_LOADING,	// by someone else, wait for them
+	SAMPLE_READY,	// decoded, or to be streamed
+	SAMPLE_FAILED
+};
+
+// written decoded samples start with this, then channels, rate and
+// buf_len as Uint32s
+static const Uint32 PCM_CACHE_MAGIC = 0x314d4350; // "PCM1"
+static const char PCM_CACHE_DIR[] = "sound_cache";
+
+// s_sampleLock covers the state and contents of every sample, and the
+// totals. the mixer only ever sees samples that are ready
+static SDL_mutex *s_sampleLock = 0;
+static SDL_cond *s_sampleLoaded = 0;
+static size_t s_decodedBytes = 0;
+static size_t s_maxDecodedBytes = 0;
+static bool s_cacheDecoded = false;
+static Uint32 s_sampleClock = 0;
+// set by Uninit(), after which anything still being decoded is thrown away
+static bool s_samplesClosed = false;
+static JobHandle s_prewarmJob;
+
+// game thread only: buffered samples handed to the mixer, which it may
+// still be playing
+struct PlayingSample {
+	eventid id;
+	unsigned int slot;
+	const Sample *sample;
+};
+static std::vector<PlayingSample> s_playing;
+
+// drops whatever the mixer has finished with. events in a slot finish in
+// the order they were started
+static void PrunePlaying()
+{
+	for (size_t i = 0; i < s_playing.size(); ) {
+		if (s_slotFinished[s_playing[i].slot].load(std::memory_order_acquire) >= s_playing[i].id) {
+			s_playing[i] = s_playing.back();
+			s_playing.pop_back();
+		} else
+			i++;
 	}
-	SDL_UnlockAudio();
-	return ret;
 }
 
+static void register_sound(const std::string &basename, const std::string &path, bool is_music)
+{
+	if (!ends_with_ci(basename, ".ogg")) return;
+
+	Sample sample;
+	sample.buf = 0;
+	sample.buf_len = 0;
+	sample.channels = 0;
+	sample.rate = 0;
+	sample.path = path;
+	sample.isMusic = is_music;
+	sample.loadState = SAMPLE_UNLOADED;
+	sample.lastUsed = 0;
+
+	if (is_music) {
+		// music keyed by pathname minus (datapath)/music/ and extension
+		sfx_samples[path.substr(0, path.size() - 4)] = sample;
+	} else {
+		// sfx keyed by basename minus the .ogg
+		sfx_samples[basename.substr(0, basename.size()-4)] = sample;
+	}
+}
+
+static std::string PcmCachePath(const FileSystem::FileData &oggdata)
+{
+	Uint32 hashA = 0, hashB = 0;
+	lookup3_hashlittle2(oggdata.GetData(), oggdata.GetSize(), &hashA, &hashB);
+	char name[32];
+	snprintf(name, sizeof(name), "%08x%08x.pcm", hashA, hashB);
+	return FileSystem::JoinPathBelow(PCM_CACHE_DIR, name);
+}
+
+static bool ReadPcmCache(const std::string &cachePath, Sample &out)
+{
+	RefCountedPtr<FileSystem::FileData> cached = FileSystem::userFiles.ReadFile(cachePath);
+	if (!cached || cached->GetSize() < 4*sizeof(Uint32)) return false;
+	Uint32 header[4];
+	memcpy(header, cached->GetData(), sizeof(header));
+	if (header[0] != PCM_CACHE_MAGIC || header[1] < 1 || header[1] > 2 || header[2] == 0 ||
+		cached->GetSize() != sizeof(header) + header[3]*sizeof(Uint16))
+		return false;
+	out.channels = header[1];
+	out.rate = header[2];
+	out.buf_len = header[3];
+	out.buf = new Uint16[out.buf_len];
+	memcpy(out.buf, cached->GetData() + sizeof(header), out.buf_len*sizeof(Uint16));
+	return true;
+}
+
+static void WritePcmCache(const std::string &cachePath, const Sample &sample)
+{
+	FILE *f = FileSystem::userFiles.OpenWriteStream(cachePath);
+	if (!f) return;
+	const Uint32 header[4] = { PCM_CACHE_MAGIC, sample.channels, sample.rate, sample.buf_len };
+	const bool ok = fwrite(header, sizeof(header), 1, f) == 1 &&
+		fwrite(sample.buf, sample.buf_len*sizeof(Uint16), 1, f) == 1;
+	fclose(f);
+	// a short file is turned down when it's read, but there's no point
+	// keeping it
+	if (!ok) Output("Could not write decoded sound cache '%s'\n", cachePath.c_str());
+}
+
+// fills out the format and, if it's short enough, the decoded contents of
+// path. from any thread, without s_sampleLock
+static bool decode_sound(const std::string &path, Sample &out)
+{
+	out.buf = 0;
+	RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(path);
+	if (!oggdata) {
+		Output("Could not read '%s'\n", path.c_str());
+		return false;
+	}
+
+	std::string cachePath;
+	if (s_cacheDecoded) {
+		cachePath = PcmCachePath(*oggdata);
+		if (ReadPcmCache(cachePath, out)) return true;
+	}
+
+	OggVorbis_File oggv;
+	OggFileDataStream datastream(oggdata);
+	oggdata.Reset();
+	if (ov_open_callbacks(&datastream, &oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+		Output("Vorbis could not understand '%s'\n", path.c_str());
+		return false;
+	}
+	struct vorbis_info *info;
+	info = ov_info(&oggv, -1);
+
+	if (info->rate <= 0) {
+		Output("Vorbis file %s has no sample rate. Bad!\n", path.c_str());
+		ov_clear(&oggv);
+		return false;
+	}
+	if ((info->channels < 1) || (info->channels > 2)) {
+		Output("Vorbis file %s is not mono or stereo. Bad!\n", path.c_str());
+		ov_clear(&oggv);
+		return false;
+	}
+
+	const Sint64 num_samples = ov_pcm_total(&oggv, -1);
+	// since samples are 16 bits we have:
+
+	out.buf_len = num_samples * info->channels;
+	out.channels = info->channels;
+	out.rate = info->rate;
+
+	const float seconds = num_samples/float(info->rate);
+	//Output("%f seconds\n", seconds);
+
+	// decode and store as raw sample if short enough
+	if (seconds < STREAM_IF_LONGER_THAN) {
+		out.buf = new Uint16[out.buf_len];
+
+		int i=0;
+		for (;;) {
+			int music_section;
+			int amt = ov_read(&oggv, reinterpret_cast<char*>(out.buf) + i,
+					2*out.buf_len - i, 0, 2, 1, &music_section);
+			if (amt <= 0) break;
+			i += amt;
+		}
+		if (s_cacheDecoded) WritePcmCache(cachePath, out);
+	}
+
+	ov_clear(&oggv);
+	return true;
+}
+
+// with s_sampleLock held. let go of the least recently played buffered
+// samples until there's room for needed more bytes, or only ones that are
+// playing are left
+static void EvictSamples(size_t needed)
+{
+	if (s_decodedBytes + needed <= s_maxDecodedBytes) return;
+
+	PrunePlaying();
+
+	std::vector<Sample*> candidates;
+	for (std::map<std::string, Sample>::iterator i = sfx_samples.begin(); i != sfx_samples.end(); ++i) {
+		Sample &sample = i->second;
+		if (sample.loadState != SAMPLE_READY || !sample.buf) continue;
+		bool playing = false;
+		for (size_t j = 0; j < s_playing.size(); j++)
+			if (s_playing[j].sample == &sample) { playing = true; break; }
+		if (!playing) candidates.push_back(&sample);
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const Sample *a, const Sample *b) { return a->lastUsed < b->lastUsed; });
+
+	for (size_t i = 0; i < candidates.size() && s_decodedBytes + needed > s_maxDecodedBytes; i++) {
+		Sample &sample = *candidates[i];
+		s_decodedBytes -= sample.buf_len * sizeof(Uint16);
+		delete[] sample.buf;
+		sample.buf = 0;
+		sample.loadState = SAMPLE_UNLOADED;
+	}
+}
+
+// with s_sampleLock held, on the end of decoding sample into decoded
+static void PublishSample(Sample &sample, bool ok, const Sample &decoded)
+{
+	if (s_samplesClosed) {
+		delete[] decoded.buf;
+		return;
+	}
+	if (!ok) {
+		sample.loadState = SAMPLE_FAILED;
+	} else {
+		sample.buf = decoded.buf;
+		sample.buf_len = decoded.buf_len;
+		sample.channels = decoded.channels;
+		sample.rate = decoded.rate;
+		sample.loadState = SAMPLE_READY;
+		if (sample.buf) s_decodedBytes += sample.buf_len * sizeof(Uint16);
+	}
+	SDL_CondBroadcast(s_sampleLoaded);
+}
+
+// game thread. gets sample ready to hand to the mixer, decoding it if no
+// one has. false if it can't be played
+static bool EnsureLoaded(Sample *sample)
+{
+	SDL_LockMutex(s_sampleLock);
+	while (sample->loadState == SAMPLE_LOADING)
+		SDL_CondWait(s_sampleLoaded, s_sampleLock);
+	sample->lastUsed = ++s_sampleClock;
+	if (sample->loadState == SAMPLE_UNLOADED) {
+		PROFILE_SCOPED()
+		sample->loadState = SAMPLE_LOADING;
+		SDL_UnlockMutex(s_sampleLock);
+		Sample decoded;
+		const bool ok = decode_sound(sample->path, decoded);
+		SDL_LockMutex(s_sampleLock);
+		if (ok && decoded.buf) EvictSamples(decoded.buf_len * sizeof(Uint16));
+		PublishSample(*sample, ok, decoded);
+	}
+	const bool ready = sample->loadState == SAMPLE_READY;
+	SDL_UnlockMutex(s_sampleLock);
+	return ready;
+}
+
+// decodes samples ahead of them being wanted, while there's room
+class PrewarmJob : public Job {
+public:
+	explicit PrewarmJob(const std::vector<Sample*> &samples): m_samples(samples), m_cancelled(false) {}
+
+	virtual void OnRun() {
+		for (size_t i = 0; i < m_samples.size() && !m_cancelled; i++) {
+			Sample &sample = *m_samples[i];
+			SDL_LockMutex(s_sampleLock);
+			const bool mine = !s_samplesClosed && sample.loadState == SAMPLE_UNLOADED;
+			if (mine) sample.loadState = SAMPLE_LOADING;
+			SDL_UnlockMutex(s_sampleLock);
+			if (!mine) continue;
+
+			Sample decoded;
+			const bool ok = decode_sound(sample.path, decoded);
+			SDL_LockMutex(s_sampleLock);
+			if (ok && decoded.buf && s_decodedBytes + decoded.buf_len*sizeof(Uint16) > s_maxDecodedBytes) {
+				// full. it'll be decoded again when it's played
+				delete[] decoded.buf;
+				sample.loadState = SAMPLE_UNLOADED;
+				SDL_CondBroadcast(s_sampleLoaded);
+			} else
+				PublishSample(sample, ok, decoded);
+			SDL_UnlockMutex(s_sampleLock);
+		}
+	}
+	virtual void OnFinish() {}
+	virtual void OnCancel() { m_cancelled = true; }
+
+private:
+	std::vector<Sample*> m_samples;
+	std::atomic<bool> m_cancelled;
+};
+
+/*
+ * Decode thread
+ */
+
+static SDL_Thread *s_decodeThread = 0;
+static SDL_mutex *s_decodeLock = 0;
+static SDL_cond *s_decodeWake = 0;
+// under s_decodeLock
+static std::vector<Stream*> s_newStreams;
+static bool s_decodeQuit = false;
+
+static void CloseStream(Stream *s)
+{
+	if (s->opened) {
+		ov_clear(&s->oggv);
+		s->opened = false;
+	}
+	s->ogg_data_stream.Reset();
+}
+
+static bool OpenStream(Stream *s)
+{
+	RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(s->sample->path);
+	if (!oggdata) {
+		Output("Could not open '%s'", s->sample->path.c_str());
+		return false;
+	}
+	s->ogg_data_stream.Reset(oggdata);
+	oggdata.Reset();
+	if (ov_open_callbacks(&s->ogg_data_stream, &s->oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
+		Output("Vorbis could not understand '%s'", s->sample->path.c_str());
+		s->ogg_data_stream.Reset();
+		return false;
+	}
+	s->opened = true;
+	return true;
+}
+
+// decode as much as there's room for
+static void DecodeStream(Stream *s)
+{
+	if (s->eof.load(std::memory_order_relaxed)) return;
+	if (!s->opened && !OpenStream(s)) {
+		s->eof.store(true, std::memory_order_release);
+		return;
+	}
+
+	bool rewound = false;
+	for (;;) {
+		const Uint32 w = s->writePos.load(std::memory_order_relaxed);
+		const Uint32 space = STREAM_BUF_SAMPLES - (w - s->readPos.load(std::memory_order_acquire));
+		// up to the end of the buffer, it wraps on the next time round
+		const Uint32 contiguous = std::min(space, STREAM_BUF_SAMPLES - (w & (STREAM_BUF_SAMPLES-1)));
+		if (contiguous == 0) break;
+
+		int music_section;
+		const int amt = ov_read(&s->oggv, reinterpret_cast<char*>(&s->buf[w & (STREAM_BUF_SAMPLES-1)]),
+				contiguous * sizeof(Sint16), 0, 2, 1, &music_section);
+		if (amt > 0) {
+			s->writePos.store(w + amt / sizeof(Sint16), std::memory_order_release);
+			rewound = false;
+			continue;
+		}
+		// end of the file. going round again only if that got us something
+		// last time, so a broken file doesn't keep us here for ever
+		if (amt == 0 && !rewound && (s->op.load(std::memory_order_relaxed) & OP_REPEAT)) {
+			ov_pcm_seek(&s->oggv, 0);
+			rewound = true;
+			continue;
+		}
+		s->eof.store(true, std::memory_order_release);
+		break;
+	}
+}
+
+static int DecodeThread(void *)
+{
+	std::vector<Stream*> streams;
+	for (;;) {
+		SDL_LockMutex(s_decodeLock);
+		if (s_newStreams.empty() && !s_decodeQuit)
+			SDL_CondWaitTimeout(s_decodeWake, s_decodeLock, DECODE_INTERVAL_MS);
+		streams.insert(streams.end(), s_newStreams.begin(), s_newStreams.end());
+		s_newStreams.clear();
+		const bool quit = s_decodeQuit;
+		SDL_UnlockMutex(s_decodeLock);
+
+		for (size_t i = 0; i < streams.size(); ) {
+			Stream *s = streams[i];
+			// after quitting no one's going to let go of them
+			if (quit || s->released.load(std::memory_order_acquire)) {
+				CloseStream(s);
+				delete s;
+				streams[i] = streams.back();
+				streams.pop_back();
+				continue;
+			}
+			DecodeStream(s);
+			i++;
+		}
+		if (quit) return 0;
+	}
+}
+
+static void StartStream(Stream *s)
+{
+	SDL_LockMutex(s_decodeLock);
+	s_newStreams.push_back(s);
+	SDL_CondSignal(s_decodeWake);
+	SDL_UnlockMutex(s_decodeLock);
+}
+
+/*
+ * Commands, game thread to mixer
+ */
+
+struct Command {
+	enum Type { PLAY, STOP, STOP_ALL, SET_OP, VOLUME_ANIMATE, SET_VOLUME };
+	Type type;
+	unsigned int slot;
+	eventid id;
+	const Sample *sample;
+	Stream *stream;
+	Op op;
+	float volume[2];
+	float rateOfChange[2];
+};
+
+// single producer (the game thread), single consumer (the mixer)
+static Command s_commands[COMMAND_RING_SIZE];
+static std::atomic<Uint32> s_commandHead(0);	// game thread moves this on
+static std::atomic<Uint32> s_commandTail(0);	// mixer moves this on
+
 static void DestroyEvent(SoundEvent *ev)
 {
-	if (ev->oggv) {
-		// streaming ogg
-		ov_clear(ev->oggv);
-		delete ev->oggv;
-		ev->oggv = 0;
-		ev->ogg_data_stream.Reset();
+	if (ev->stream) {
+		ev->stream->released.store(true, std::memory_order_release);
+		ev->stream = 0;
 	}
+	if (ev->sample)
+		s_slotFinished[ev - wavstream].store(ev->identifier, std::memory_order_release);
 	ev->sample = 0;
 }
 
+static void ApplyCommand(const Command &c)
+{
+	if (c.type == Command::STOP_ALL) {
+		for (unsigned int idx = 0; idx < MAX_WAVSTREAMS; idx++)
+			DestroyEvent(&wavstream[idx]);
+		return;
+	}
+
+	SoundEvent &ev = wavstream[c.slot];
+	if (c.type == Command::PLAY) {
+		DestroyEvent(&ev);
+		ev.sample = c.sample;
+		ev.stream = c.stream;
+		ev.cursor.frame = ev.cursor.frac = 0;
+		ev.cursor.step = Mix::StepForRate(c.sample->rate);
+		ev.gain.volume[0] = ev.gain.targetVolume[0] = c.volume[0];
+		ev.gain.volume[1] = ev.gain.targetVolume[1] = c.volume[1];
+		ev.op = c.op;
+		ev.identifier = c.id;
+		ev.gain.rateOfChange[0] = ev.gain.rateOfChange[1] = 0.0f;
+		return;
+	}
+
+	// the rest are for an event that might have finished since
+	if (!ev.sample || ev.identifier != c.id) return;
+	switch (c.type) {
+		case Command::STOP:
+			DestroyEvent(&ev);
+			break;
+		case Command::SET_OP:
+			ev.op = c.op;
+			if (ev.stream) ev.stream->op.store(c.op, std::memory_order_relaxed);
+			break;
+		case Command::VOLUME_ANIMATE:
+			ev.gain.targetVolume[0] = c.volume[0];
+			ev.gain.targetVolume[1] = c.volume[1];
+			ev.gain.rateOfChange[0] = c.rateOfChange[0];
+			ev.gain.rateOfChange[1] = c.rateOfChange[1];
+			break;
+		case Command::SET_VOLUME:
+			ev.gain.volume[0] = ev.gain.targetVolume[0] = c.volume[0];
+			ev.gain.volume[1] = ev.gain.targetVolume[1] = c.volume[1];
+			break;
+		default:
+			break;
+	}
+}
+
+// mixer side, or the game thread with the audio locked
+static void ApplyCommands()
+{
+	const Uint32 head = s_commandHead.load(std::memory_order_acquire);
+	Uint32 tail = s_commandTail.load(std::memory_order_relaxed);
+	while (tail != head) {
+		ApplyCommand(s_commands[tail & (COMMAND_RING_SIZE-1)]);
+		tail++;
+	}
+	s_commandTail.store(tail, std::memory_order_release);
+}
+
+static void SendCommand(const Command &c)
+{
+	const Uint32 head = s_commandHead.load(std::memory_order_relaxed);
+	if (head - s_commandTail.load(std::memory_order_acquire) < COMMAND_RING_SIZE) {
+		s_commands[head & (COMMAND_RING_SIZE-1)] = c;
+		s_commandHead.store(head + 1, std::memory_order_release);
+		return;
+	}
+	// full, the audio is paused or the mixer's way behind. the commands
+	// still have to happen in order, so do them ourselves
+	SDL_LockAudio();
+	ApplyCommands();
+	ApplyCommand(c);
+	SDL_UnlockAudio();
+}
+
+static void SendEventCommand(Command::Type type, int slot, eventid id)
+{
+	Command c;
+	c.type = type;
+	c.slot = slot;
+	c.id = id;
+	SendCommand(c);
+}
+
+bool SetOp(eventid id, Op op)
+{
+	const int slot = GetSlot(id);
+	if (slot < 0) return false;
+	Command c;
+	c.type = Command::SET_OP;
+	c.slot = slot;
+	c.id = id;
+	c.op = op;
+	SendCommand(c);
+	return true;
+}
+
+static Uint32 identifier = 1;
+static eventid StartEvent(unsigned int slot, const char *fx, const float volume_left, const float volume_right, const Op op, Priority priority)
+{
+	const eventid id = identifier++;
+	Command c;
+	c.type = Command::PLAY;
+	c.slot = slot;
+	c.id = id;
+	Sample *sample = GetSample(fx);
+	c.sample = (sample && EnsureLoaded(sample)) ? sample : 0;
+	if (!c.sample) {
+		// nothing to play, but it takes the stream all the same
+		if (s_slotEvent[slot]) SendEventCommand(Command::STOP, slot, s_slotEvent[slot]);
+		s_slotEvent[slot] = 0;
+		return id;
+	}
+	c.stream = 0;
+	c.op = op;
+	c.volume[0] = volume_left;
+	c.volume[1] = volume_right;
+	if (!c.sample->buf) {
+		c.stream = new Stream(c.sample, op);
+		StartStream(c.stream);
+	} else {
+		if (s_playing.size() >= 2*MAX_WAVSTREAMS) PrunePlaying();
+		PlayingSample p = { id, slot, c.sample };
+		s_playing.push_back(p);
+	}
+	s_slotEvent[slot] = id;
+	s_slotPriority[slot] = priority;
+	s_slotLoudness[slot] = std::max(volume_left, volume_right);
+	SendCommand(c);
+	return id;
+}
+
 /*
  * Volume should be 0-65535
  */
-static Uint32 identifier = 1;
-eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op)
+// true if a matters less than b
+static bool LessImportant(Priority pa, float loudnessA, Priority pb, float loudnessB)
 {
-	SDL_LockAudio();
+	if (pa != pb) return pa < pb;
+	return loudnessA < loudnessB;
+}
+
+eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op, Priority priority)
+{
+	const float vl = volume_left * GetSfxVolume();
+	const float vr = volume_right * GetSfxVolume();
 	unsigned int idx;
-	Uint32 age;
 	/* find free wavstream (first two reserved for music) */
 	for (idx = 2; idx < MAX_WAVSTREAMS; idx++) {
-		if (!wavstream[idx].sample) break;
+		if (SlotFree(idx)) break;
 	}
 	if (idx == MAX_WAVSTREAMS) {
-		/* otherwise overwrite oldest one */
-		age = 0; idx = 0;
-		for (unsigned int i = 2; i < MAX_WAVSTREAMS; i++) {
-			if ((i==0) || (wavstream[i].buf_pos > age)) {
+		/* otherwise steal the least important, the oldest of equals */
+		idx = 2;
+		for (unsigned int i = 3; i < MAX_WAVSTREAMS; i++) {
+			if (LessImportant(s_slotPriority[i], s_slotLoudness[i], s_slotPriority[idx], s_slotLoudness[idx]) ||
+				(!LessImportant(s_slotPriority[idx], s_slotLoudness[idx], s_slotPriority[i], s_slotLoudness[i]) &&
+				 s_slotEvent[i] < s_slotEvent[idx]))
 				idx = i;
-				age = wavstream[i].buf_pos;
-			}
 		}
-		DestroyEvent(&wavstream[idx]);
-	}
-	wavstream[idx].sample = GetSample(fx);
-	wavstream[idx].oggv = 0;
-	wavstream[idx].buf_pos = 0;
-	wavstream[idx].volume[0] = volume_left * GetSfxVolume();
-	wavstream[idx].volume[1] = volume_right * GetSfxVolume();
-	wavstream[idx].op = op;
-	wavstream[idx].identifier = identifier;
-	wavstream[idx].targetVolume[0] = volume_left * GetSfxVolume();
-	wavstream[idx].targetVolume[1] = volume_right * GetSfxVolume();
-	wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
-	SDL_UnlockAudio();
-	return identifier++;
+		// the new one matters less than anything playing, so it's the one
+		// that goes. it gets an id all the same, which never plays
+		if (LessImportant(priority, std::max(vl, vr), s_slotPriority[idx], s_slotLoudness[idx]))
+			return identifier++;
+	}
+	return StartEvent(idx, fx, vl, vr, op, priority);
 }
 
 //unlike PlaySfx, we want uninterrupted play and do not care about age
@@ -266,169 +861,93 @@ eventid PlayMusic(const char *fx, const float volume_left, const float volume_ri
 {
 	const int idx = nextMusicStream;
 	nextMusicStream ^= 1;
-	SDL_LockAudio();
-	if (wavstream[idx].sample)
-		DestroyEvent(&wavstream[idx]);
-	wavstream[idx].sample = GetSample(fx);
-	wavstream[idx].oggv = 0;
-	wavstream[idx].buf_pos = 0;
-	wavstream[idx].volume[0] = volume_left;
-	wavstream[idx].volume[1] = volume_right;
-	wavstream[idx].op = op;
-	wavstream[idx].identifier = identifier;
-	wavstream[idx].targetVolume[0] = volume_left; //already scaled in MusicPlayer
-	wavstream[idx].targetVolume[1] = volume_right;
-	wavstream[idx].rateOfChange[0] = wavstream[idx].rateOfChange[1] = 0.0f;
-	SDL_UnlockAudio();
-	return identifier++;
+	//already scaled in MusicPlayer
+	return StartEvent(idx, fx, volume_left, volume_right, op, PRIORITY_HIGH);
 }
 
 /*
- * len is the number of floats to put in buffer, NOT full samples (a sample would be 2 floats since stereo)
+ * Mixer
  */
-template <int T_channels, int T_upsample>
-static void fill_audio_1stream(float *buffer, int len, int stream_num)
-{
-	// inbuf will be smaller for mono and for 22050hz samples
-	Sint16 *inbuf = static_cast<Sint16*>(alloca(len*T_channels / T_upsample));
-	// hm pity to put this here ^^ since not used by ev.sample->buf case
-	SoundEvent &ev = wavstream[stream_num];
-	int inbuf_pos = 0;
-	int pos = 0;
-	while ((pos < len) && ev.sample) {
-		if (ev.sample->buf) {
-			// already decoded
-			inbuf = reinterpret_cast<Sint16 *>(ev.sample->buf);
-			inbuf_pos = ev.buf_pos;
-		} else {
-			// stream ogg vorbis
-			// ogg vorbis streaming
-			if (!ev.oggv) {
-				// open file to start streaming
-				ev.oggv = new OggVorbis_File;
-				RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(ev.sample->path);
-				if (!oggdata) {
-					Output("Could not open '%s'", ev.sample->path.c_str());
-					ev.sample = 0;
-					return;
-				}
-				ev.ogg_data_stream.Reset(oggdata);
-				oggdata.Reset();
-				if (ov_open_callbacks(&ev.ogg_data_stream, ev.oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-					Output("Vorbis could not understand '%s'", ev.sample->path.c_str());
-					ev.sample = 0;
-					return;
-				}
-			}
-			int i=0;
-			// (len-pos) = num floats the destination buffer wants.
-			// if we are stereo then to fill this we need (len-pos)*2 bytes
-			// if we are mono we want (len-pos) bytes
-			int wanted_bytes = (len-pos)*T_channels / T_upsample;
-			for (;;) {
-				int music_section;
-				if (wanted_bytes == 0) break;
-				int amt = ov_read(ev.oggv, reinterpret_cast<char*>(inbuf) + i,
-						wanted_bytes, 0, 2, 1, &music_section);
-				i += amt;
-				wanted_bytes -= amt;
-				if (amt == 0) break;
-			}
-		}
 
-		while (pos < len) {
-			/* Volume animations */
-			for (int chan=0; chan<2; chan++) {
-				if (ev.ascend[chan]) {
-					ev.volume[chan] = std::min(ev.volume[chan] + ev.rateOfChange[chan], ev.targetVolume[chan]);
-				} else {
-					ev.volume[chan] = std::max(ev.volume[chan] - ev.rateOfChange[chan], ev.targetVolume[chan]);
-				}
-			}
-
-			float s0, s1;
-
-			if (T_channels == 1) {
-				s0 = float(inbuf[inbuf_pos++]);
-				s1 = ev.volume[1] * s0;
-				s0 = ev.volume[0] * s0;
-				ev.buf_pos += 1;
-			} else /* stereo */ {
-				s0 = ev.volume[0] * float(inbuf[inbuf_pos++]);
-				s1 = ev.volume[1] * float(inbuf[inbuf_pos++]);
-				ev.buf_pos += 2;
-			}
-
-			if (T_upsample == 1) {
-				buffer[pos] += s0;
-				buffer[pos+1] += s1;
-				pos += 2;
-			} else {
-				buffer[pos] += s0;
-				buffer[pos+1] += s1;
-				buffer[pos+2] += s0;
-				buffer[pos+3] += s1;
-				pos += 4;
-			}
+/*
+ * mixes frames stereo frames of the event into buffer, or as many as there
+ * are. the sums are in SoundMix.cpp
+ */
+static void fill_audio_1stream(float *buffer, int frames, SoundEvent &ev)
+{
+	const int channels = ev.sample->channels;
+
+	if (ev.stream) {
+		// whatever the decode thread has ready. if that's not enough we
+		// come up short rather than wait for it
+		Stream &s = *ev.stream;
+		const bool eof = s.eof.load(std::memory_order_acquire);
+		const Uint32 r = s.readPos.load(std::memory_order_relaxed);
+		const Uint32 readyFrames = (s.writePos.load(std::memory_order_acquire) - r) / channels;
+		// the frames this could get through, and one more to interpolate
+		// towards, straightened out of the ring
+		const Uint32 needed = Uint32((Uint64(ev.cursor.frac) + Uint64(frames) * ev.cursor.step) >> 16) + 2;
+		const Uint32 have = std::min(readyFrames, needed);
+		Sint16 *src = static_cast<Sint16*>(alloca(sizeof(Sint16) * channels * (have + 1)));
+		for (Uint32 i = 0; i < have * channels; i++)
+			src[i] = s.buf[(r + i) & (STREAM_BUF_SAMPLES-1)];
+
+		// unless that's the end, the last frame is only looked at
+		const bool last = eof && have == readyFrames;
+		const Uint32 srcFrames = last ? have : (have ? have - 1 : 0);
+		ev.cursor.frame = 0;
+		Mix::MixVoice(buffer, frames, src, srcFrames, !last, channels, ev.cursor, ev.gain);
+		const Uint32 used = std::min(ev.cursor.frame, have);
+		s.readPos.store(r + used * channels, std::memory_order_release);
+		if (last && used == have) DestroyEvent(&ev);
+		return;
+	}
 
-			/* Repeat or end? */
-			if (ev.buf_pos >= ev.sample->buf_len) {
-				ev.buf_pos = 0;
-				inbuf_pos = 0;
-				if (!(ev.op & OP_REPEAT)) {
-					DestroyEvent(&ev);
-					break;
-				}
-				if (ev.oggv) {
-					// streaming ogg
-					ov_pcm_seek(ev.oggv, 0);
-					// repeat outer loop to decode some
-					// more vorbis from the start of the stream
-					break;
-				}
+	// already decoded
+	const Sint16 *src = reinterpret_cast<const Sint16 *>(ev.sample->buf);
+	const Uint32 srcFrames = ev.sample->buf_len / channels;
+	int done = 0;
+	while ((done < frames) && ev.sample) {
+		done += Mix::MixVoice(buffer + 2*done, frames - done, src, srcFrames, false, channels, ev.cursor, ev.gain);
+
+		/* Repeat or end? */
+		if (ev.cursor.frame >= srcFrames) {
+			if (!(ev.op & OP_REPEAT) || srcFrames == 0) {
+				DestroyEvent(&ev);
+				break;
 			}
+			ev.cursor.frame %= srcFrames;
 		}
 	}
 }
 
 static void fill_audio(void *udata, Uint8 *dsp_buf, int len)
 {
+	ApplyCommands();
+
 	const int len_in_floats = len>>1;
 	float *tmpbuf = static_cast<float*>(alloca(sizeof(float)*len_in_floats)); // len is in chars not samples
 	memset(static_cast<void*>(tmpbuf), 0, sizeof(float)*len_in_floats);
 
 	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-		if (!wavstream[i].sample) continue;
+		SoundEvent &ev = wavstream[i];
+		if (!ev.sample) continue;
 
-		wavstream[i].ascend[0] = (wavstream[i].targetVolume[0] > wavstream[i].volume[0]);
-		wavstream[i].ascend[1] = (wavstream[i].targetVolume[1] > wavstream[i].volume[1]);
-
-		if (wavstream[i].op & OP_STOP_AT_TARGET_VOLUME) {
-			if ((wavstream[i].targetVolume[0] <= wavstream[i].volume[0]) &&
-			    (wavstream[i].targetVolume[1] <= wavstream[i].volume[1])) {
-				DestroyEvent(&wavstream[i]);
+		if (ev.op & OP_STOP_AT_TARGET_VOLUME) {
+			if ((ev.gain.targetVolume[0] <= ev.gain.volume[0]) &&
+			    (ev.gain.targetVolume[1] <= ev.gain.volume[1])) {
+				DestroyEvent(&ev);
 				continue;
 			}
 		}
 
-		if (wavstream[i].sample->channels == 1) {
-			if (wavstream[i].sample->upsample == 1) {
-				fill_audio_1stream<1,1>(tmpbuf, len_in_floats, i);
-			} else {
-				fill_audio_1stream<1,2>(tmpbuf, len_in_floats, i);
-			}
-		} else {
-			if (wavstream[i].sample->upsample == 1) {
-				fill_audio_1stream<2,1>(tmpbuf, len_in_floats, i);
-			} else {
-				fill_audio_1stream<2,2>(tmpbuf, len_in_floats, i);
-			}
-		}
+		fill_audio_1stream(tmpbuf, len_in_floats/2, ev);
 	}
 
 	/* Convert float sample buffer to Sint16 samples the hardware likes */
+	const float masterVol = m_masterVol.load(std::memory_order_relaxed);
 	for (int pos=0; pos<len_in_floats; pos++) {
-		const float val = m_masterVol * tmpbuf[pos];
+		const float val = masterVol * tmpbuf[pos];
 		(reinterpret_cast<Sint16*>(dsp_buf))[pos] = Sint16(Clamp(val, -32768.0f, 32767.0f));
 	}
 }
@@ -436,80 +955,14 @@ static void fill_audio(void *udata, Uint8 *dsp_buf, int len)
 void DestroyAllEvents()
 {
 	/* silence any sound events */
-	SDL_LockAudio();
-	for (unsigned int idx = 0; idx < MAX_WAVSTREAMS; idx++) {
-		DestroyEvent(&wavstream[idx]);
-	}
-	SDL_UnlockAudio();
+	for (unsigned int idx = 0; idx < MAX_WAVSTREAMS; idx++)
+		s_slotEvent[idx] = 0;
+	Command c;
+	c.type = Command::STOP_ALL;
+	SendCommand(c);
 }
 
-static void load_sound(const std::string &basename, const std::string &path, bool is_music)
-{
-	if (!ends_with_ci(basename, ".ogg")) return;
-
-	Sample sample;
-	OggVorbis_File oggv;
-
-	RefCountedPtr<FileSystem::FileData> oggdata = FileSystem::gameDataFiles.ReadFile(path);
-	if (!oggdata) {
-		Error("Could not read '%s'", path.c_str());
-	}
-	OggFileDataStream datastream(oggdata);
-	oggdata.Reset();
-	if (ov_open_callbacks(&datastream, &oggv, 0, 0, OggFileDataStream::CALLBACKS) < 0) {
-		Error("Vorbis could not understand '%s'", path.c_str());
-	}
-	struct vorbis_info *info;
-	info = ov_info(&oggv, -1);
-
-	if ((static_cast<unsigned int>(info->rate) != FREQ) && (static_cast<unsigned int>(info->rate) != (FREQ>>1))) {
-		Error("Vorbis file %s is not %dHz or %dHz. Bad!", path.c_str(), FREQ, FREQ>>1);
-	}
-	if ((info->channels < 1) || (info->channels > 2)) {
-		Error("Vorbis file %s is not mono or stereo. Bad!", path.c_str());
-	}
-
-	int resample_multiplier = ((info->rate == (FREQ>>1)) ? 2 : 1);
-	const Sint64 num_samples = ov_pcm_total(&oggv, -1);
-	// since samples are 16 bits we have:
-
-	sample.buf = 0;
-	sample.buf_len = num_samples * info->channels;
-	sample.channels = info->channels;
-	sample.upsample = resample_multiplier;
-	sample.path = path;
-
-	const float seconds = num_samples/float(info->rate);
-	//Output("%f seconds\n", seconds);
-
-	// immediately decode and store as raw sample if short enough
-	if (seconds < STREAM_IF_LONGER_THAN) {
-		sample.buf = new Uint16[sample.buf_len];
-
-		int i=0;
-		for (;;) {
-			int music_section;
-			int amt = ov_read(&oggv, reinterpret_cast<char*>(sample.buf) + i,
-					2*sample.buf_len - i, 0, 2, 1, &music_section);
-			i += amt;
-			if (amt == 0) break;
-		}
-	}
-
-	if (is_music) {
-		sample.isMusic = true;
-		// music keyed by pathname minus (datapath)/music/ and extension
-		sfx_samples[path.substr(0, path.size() - 4)] = sample;
-	} else {
-		sample.isMusic = false;
-		// sfx keyed by basename minus the .ogg
-		sfx_samples[basename.substr(0, basename.size()-4)] = sample;
-	}
-
-	ov_clear(&oggv);
-}
-
-bool Init ()
+bool Init (size_t maxDecodedBytes, bool cacheDecoded)
 {
 	static bool isInitted = false;
 
@@ -534,19 +987,38 @@ bool Init ()
 			return false;
 		}
 
-		// load all the wretched effects
+		s_decodeLock = SDL_CreateMutex();
+		s_decodeWake = SDL_CreateCond();
+		s_decodeThread = SDL_CreateThread(&DecodeThread, "Sound decode", 0);
+
+		// these stay, the prewarm job can outlive Uninit()
+		s_sampleLock = SDL_CreateMutex();
+		s_sampleLoaded = SDL_CreateCond();
+		s_maxDecodedBytes = maxDecodedBytes;
+		s_cacheDecoded = cacheDecoded && FileSystem::userFiles.MakeDirectory(PCM_CACHE_DIR);
+
+		// find all the wretched effects
 		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "sounds", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
 			const FileSystem::FileInfo &info = files.Current();
 			assert(info.IsFile());
-			load_sound(info.GetName(), info.GetPath(), false);
+			register_sound(info.GetName(), info.GetPath(), false);
 		}
 
 		//I'd rather do this in MusicPlayer and store in a different map too, this will do for now
 		for (FileSystem::FileEnumerator files(FileSystem::gameDataFiles, "music", FileSystem::FileEnumerator::Recurse); !files.Finished(); files.Next()) {
 			const FileSystem::FileInfo &info = files.Current();
 			assert(info.IsFile());
-			load_sound(info.GetName(), info.GetPath(), true);
+			register_sound(info.GetName(), info.GetPath(), true);
+		}
+
+		// effects first, they're short and are wanted straight away. the
+		// music only needs its format reading, it's streamed
+		std::vector<Sample*> prewarm;
+		for (int music = 0; music < 2; music++) {
+			for (std::map<std::string, Sample>::iterator i = sfx_samples.begin(); i != sfx_samples.end(); ++i)
+				if (i->second.isMusic == (music != 0)) prewarm.push_back(&i->second);
 		}
+		s_prewarmJob = Pi::Jobs()->Queue(new PrewarmJob(prewarm));
 	}
 
 	/* silence any sound events */
@@ -558,9 +1030,36 @@ bool Init ()
 void Uninit ()
 {
 	DestroyAllEvents();
-	std::map<std::string, Sample>::iterator i;
-	for (i=sfx_samples.begin(); i!=sfx_samples.end(); ++i) delete[] (*i).second.buf;
 	SDL_CloseAudio ();
+	// the mixer's gone, so whatever it didn't get round to is ours
+	ApplyCommands();
+
+	if (s_decodeThread) {
+		SDL_LockMutex(s_decodeLock);
+		s_decodeQuit = true;
+		SDL_CondSignal(s_decodeWake);
+		SDL_UnlockMutex(s_decodeLock);
+		SDL_WaitThread(s_decodeThread, 0);
+		s_decodeThread = 0;
+		SDL_DestroyCond(s_decodeWake);
+		SDL_DestroyMutex(s_decodeLock);
+	}
+
+	// cancels the prewarm job. if it's part way through a sample it
+	// throws it away itself
+	s_prewarmJob = JobHandle();
+	s_playing.clear();
+
+	if (!s_sampleLock) return;
+	SDL_LockMutex(s_sampleLock);
+	s_samplesClosed = true;
+	std::map<std::string, Sample>::iterator i;
+	for (i=sfx_samples.begin(); i!=sfx_samples.end(); ++i) {
+		delete[] (*i).second.buf;
+		(*i).second.buf = 0;
+	}
+	s_decodedBytes = 0;
+	SDL_UnlockMutex(s_sampleLock);
 }
 
 void Pause (int on)
@@ -576,68 +1075,52 @@ void Event::Play(const char *fx, float volume_left, float volume_right, Op op)
 
 bool Event::Stop()
 {
-	if (eid) {
-		SDL_LockAudio();
-		SoundEvent *s = GetEvent(eid);
-		if (s) {
-			DestroyEvent(s);
-		}
-		SDL_UnlockAudio();
-		return s != 0;
-	} else {
-		return false;
-	}
+	const int slot = GetSlot(eid);
+	if (slot < 0) return false;
+	s_slotEvent[slot] = 0;
+	SendEventCommand(Command::STOP, slot, eid);
+	return true;
 }
 
 bool Event::IsPlaying() const
 {
-	if (eid == 0) return false;
-	else return GetEvent(eid) != 0;
+	return GetSlot(eid) >= 0;
 }
 
 bool Event::SetOp(Op op) {
-	if (eid == 0) return false;
-	bool ret = false;
-	SDL_LockAudio();
-	SoundEvent *se = GetEvent(eid);
-	if (se) {
-		se->op = op;
-		ret = true;
-	}
-	SDL_UnlockAudio();
-	return ret;
+	return Sound::SetOp(eid, op);
 }
 
 bool Event::VolumeAnimate(const float targetVol1, const float targetVol2, const float dv_dt1, const float dv_dt2)
 {
-	SDL_LockAudio();
-	SoundEvent *ev = GetEvent(eid);
-	if (ev) {
-		ev->targetVolume[0] = targetVol1;
-		ev->targetVolume[1] = targetVol2;
-		ev->rateOfChange[0] = dv_dt1 / float(FREQ);
-		ev->rateOfChange[1] = dv_dt2 / float(FREQ);
-	}
-	SDL_UnlockAudio();
-	return (ev != 0);
+	const int slot = GetSlot(eid);
+	if (slot < 0) return false;
+	Command c;
+	c.type = Command::VOLUME_ANIMATE;
+	c.slot = slot;
+	c.id = eid;
+	c.volume[0] = targetVol1;
+	c.volume[1] = targetVol2;
+	c.rateOfChange[0] = dv_dt1 / float(FREQ);
+	c.rateOfChange[1] = dv_dt2 / float(FREQ);
+	s_slotLoudness[slot] = std::max(targetVol1, targetVol2);
+	SendCommand(c);
+	return true;
 }
 
 bool Event::SetVolume(const float vol_left, const float vol_right)
 {
-	SDL_LockAudio();
-	bool status = false;
-	for (unsigned int i = 0; i < MAX_WAVSTREAMS; i++) {
-		if (wavstream[i].sample && (wavstream[i].identifier == eid)) {
-			wavstream[i].volume[0] = vol_left;
-			wavstream[i].volume[1] = vol_right;
-			wavstream[i].targetVolume[0] = vol_left;
-			wavstream[i].targetVolume[1] = vol_right;
-			status = true;
-			break;
-		}
-	}
-	SDL_UnlockAudio();
-	return status;
+	const int slot = GetSlot(eid);
+	if (slot < 0) return false;
+	Command c;
+	c.type = Command::SET_VOLUME;
+	c.slot = slot;
+	c.id = eid;
+	c.volume[0] = vol_left;
+	c.volume[1] = vol_right;
+	s_slotLoudness[slot] = std::max(vol_left, vol_right);
+	SendCommand(c);
+	return true;
 }
 
 const std::map<std::string, Sample> & GetSamples()
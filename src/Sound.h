@@ -18,14 +18,25 @@ enum {
 };
 typedef Uint32 Op;
 
+// when there are more sounds than voices the least important go first, and
+// of those the quietest
+enum Priority {
+	PRIORITY_LOW = 0,
+	PRIORITY_NORMAL = 1,
+	PRIORITY_HIGH = 2
+};
+
 struct Sample {
 	Uint16 *buf;
 	Uint32 buf_len;
 	Uint32 channels;
-	int upsample; // 1 = 44100, 2=22050
+	Uint32 rate; // Hz, resampled to the output rate as it's played
 	/* if buf is null, this will be path to an ogg we must stream */
 	std::string path;
 	bool isMusic;
+	// Sound.cpp's, for decoding on first use
+	int loadState;
+	Uint32 lastUsed;
 };
 
 class Event {
@@ -52,14 +63,15 @@ protected:
 };
 typedef Uint32 eventid;
 
-bool Init ();
+// decoded samples are kept up to maxDecodedBytes, and on disk if cacheDecoded
+bool Init (size_t maxDecodedBytes, bool cacheDecoded);
 void Uninit ();
 /**
  * Silence all active sound events.
  */
 void DestroyAllEvents();
 void Pause (int on);
-eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op);
+eventid PlaySfx (const char *fx, const float volume_left, const float volume_right, const Op op, Priority priority = PRIORITY_NORMAL);
 eventid PlayMusic (const char *fx, const float volume_left, const float volume_right, const Op op);
 inline static eventid PlaySfx (const char *fx) { return PlaySfx(fx, 1.0f, 1.0f, 0); }
 eventid BodyMakeNoise(const Body *b, const char *fx, float vol);
@@ -0,0 +1,85 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "SoundMix.h"
+#include "Simd4.h"
+#include <algorithm>
+
+namespace Sound {
+namespace Mix {
+
+static float Approach(float v, float target, float change)
+{
+	return (target > v) ? std::min(v + change, target) : std::max(v - change, target);
+}
+
+// adds n frames of interleaved stereo block into out, the volumes ramping
+// from where they are to where they get to by the end of the block
+static void AddBlock(float *out, const float *block, int n, Gain &gain)
+{
+	float end[2], delta[2];
+	for (int chan = 0; chan < 2; chan++) {
+		end[chan] = Approach(gain.volume[chan], gain.targetVolume[chan], gain.rateOfChange[chan] * n);
+		delta[chan] = (end[chan] - gain.volume[chan]) / n;
+	}
+
+	// two frames at a time
+	const float g[4] = {
+		gain.volume[0], gain.volume[1],
+		gain.volume[0] + delta[0], gain.volume[1] + delta[1]
+	};
+	const float gs[4] = { 2.0f*delta[0], 2.0f*delta[1], 2.0f*delta[0], 2.0f*delta[1] };
+	Simd4f vol = Simd4f::Load(g);
+	const Simd4f volStep = Simd4f::Load(gs);
+	int i = 0;
+	for (; i + 2 <= n; i += 2) {
+		(Simd4f::Load(out + 2*i) + Simd4f::Load(block + 2*i) * vol).Store(out + 2*i);
+		vol = vol + volStep;
+	}
+	if (i < n) {
+		out[2*i] += block[2*i] * (gain.volume[0] + delta[0]*i);
+		out[2*i+1] += block[2*i+1] * (gain.volume[1] + delta[1]*i);
+	}
+
+	gain.volume[0] = end[0];
+	gain.volume[1] = end[1];
+}
+
+template <int T_channels>
+static int MixVoiceChannels(float *out, int outFrames, const Sint16 *src, Uint32 srcFrames, bool hasNext,
+	Cursor &cursor, Gain &gain)
+{
+	float block[2*BLOCK_FRAMES];
+	int done = 0;
+	while (done < outFrames && cursor.frame < srcFrames) {
+		const int n = std::min(BLOCK_FRAMES, outFrames - done);
+		int got = 0;
+		for (; got < n && cursor.frame < srcFrames; got++) {
+			const Sint16 *a = src + cursor.frame * T_channels;
+			const Sint16 *b = (hasNext || cursor.frame + 1 < srcFrames) ? a + T_channels : a;
+			const float t = float(cursor.frac) * (1.0f / 65536.0f);
+			const float l = float(a[0]) + float(b[0] - a[0]) * t;
+			block[2*got] = l;
+			block[2*got+1] = (T_channels == 1) ? l : float(a[1]) + float(b[1] - a[1]) * t;
+
+			cursor.frac += cursor.step;
+			cursor.frame += cursor.frac >> 16;
+			cursor.frac &= 0xffff;
+		}
+		AddBlock(out + 2*done, block, got, gain);
+		done += got;
+	}
+	return done;
+}
+
+int MixVoice(float *out, int outFrames, const Sint16 *src, Uint32 srcFrames, bool hasNext,
+	int channels, Cursor &cursor, Gain &gain)
+{
+	if (channels == 1)
+		return MixVoiceChannels<1>(out, outFrames, src, srcFrames, hasNext, cursor, gain);
+	else
+		return MixVoiceChannels<2>(out, outFrames, src, srcFrames, hasNext, cursor, gain);
+}
+
+}
+}
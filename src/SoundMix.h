@@ -0,0 +1,47 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SOUNDMIX_H
+#define _SOUNDMIX_H
+
+#include <SDL_stdinc.h>
+
+// The sums the sound mixer does, kept apart from SDL's audio and the game
+// so they can be tried out on their own. Voices are 16 bit mono or
+// stereo at any rate, the output is float stereo at OUTPUT_RATE.
+namespace Sound {
+namespace Mix {
+
+static const Uint32 OUTPUT_RATE = 44100;
+// volumes chase their targets a block at a time, and ramp linearly
+// across each block
+static const int BLOCK_FRAMES = 64;
+
+struct Gain {
+	float volume[2];		// left and right, now
+	float targetVolume[2];
+	float rateOfChange[2];	// per output frame
+};
+
+// where a voice is in its source: a frame and a 16.16 fraction of the way
+// to the next, and how far it goes per output frame
+struct Cursor {
+	Uint32 frame;
+	Uint32 frac;
+	Uint32 step;
+};
+
+inline Uint32 StepForRate(Uint32 rate) { return Uint32((Uint64(rate) << 16) / OUTPUT_RATE); }
+
+// Adds src into out from cursor.frame on, resampling linearly, until
+// outFrames frames are done or src runs out at srcFrames. If hasNext, the
+// frame after the last is there in src to interpolate towards, otherwise
+// the last is held. Returns the output frames done; cursor and gain are
+// moved on.
+int MixVoice(float *out, int outFrames, const Sint16 *src, Uint32 srcFrames, bool hasNext,
+	int channels, Cursor &cursor, Gain &gain);
+
+}
+}
+
+#endif /* _SOUNDMIX_H */
@@ -113,7 +113,7 @@ const std::vector<std::string> MusicPlayer::GetSongList() const
 	using std::string;
 	using std::pair;
 	std::vector<string> songs;
-	const std::map<string, Sample> samples = Sound::GetSamples();
+	const std::map<string, Sample> &samples = Sound::GetSamples();
 	for (std::map<string, Sample>::const_iterator it = samples.begin();
 		it != samples.end(); ++it) {
 			if (it->second.isMusic)
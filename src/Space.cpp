@@ -25,6 +25,29 @@
 #include "Game.h"
 #include "MathUtil.h"
 #include "LuaEvent.h"
+#include "Ship.h"
+#include "Projectile.h"
+
+static const Uint32 AI_THINK_BATCH_SIZE = 8;
+
+// distance from the player beyond which AI ships go on rails, and the closer
+// one at which they come off again (the gap stops them flapping)
+static const double SIM_LOD_RAILS_DIST = 1.0e8;
+static const double SIM_LOD_FULL_DIST = 0.8e8;
+// longest stride a ship on rails takes between full steps, in ticks
+static const int SIM_LOD_MAX_INTERVAL = 16;
+
+// a body shouldn't get more than this much of the way to the nearest thing
+// in one of its steps. it's only our own speed we look at, so this leaves
+// room for the other thing coming the other way
+static const double SIM_STEP_CONTACT_FRACTION = 0.1;
+// bodies are found by their centres, this catches big ones (stations) whose
+// centre is just too far away but whose side isn't
+static const double SIM_STEP_NEAR_MARGIN = 1.0e4;
+
+// bodies moving more than this much of their collision radius in a step get
+// swept, below it the step-start overlap test can be trusted
+static const double SWEEP_MIN_STEP = 0.25;
 
 void Space::BodyNearFinder::Prepare()
 {
@@ -58,6 +81,8 @@ void Space::BodyNearFinder::GetBodiesMaybeNear(const vector3d &pos, double dist,
 
 Space::Space(Game *game)
 	: m_game(game)
+	, m_numShipsOnRails(0)
+	, m_tickStep(0.0f)
 	, m_frameIndexValid(false)
 	, m_bodyIndexValid(false)
 	, m_sbodyIndexValid(false)
@@ -76,6 +101,8 @@ Space::Space(Game *game)
 
 Space::Space(Game *game, const SystemPath &path)
 	: m_game(game)
+	, m_numShipsOnRails(0)
+	, m_tickStep(0.0f)
 	, m_frameIndexValid(false)
 	, m_bodyIndexValid(false)
 	, m_sbodyIndexValid(false)
@@ -106,6 +133,8 @@ Space::Space(Game *game, const SystemPath &path)
 
 Space::Space(Game *game, Serializer::Reader &rd, double at_time)
 	: m_game(game)
+	, m_numShipsOnRails(0)
+	, m_tickStep(0.0f)
 	, m_frameIndexValid(false)
 	, m_bodyIndexValid(false)
 	, m_sbodyIndexValid(false)
@@ -129,14 +158,24 @@ Space::Space(Game *game, Serializer::Reader &rd, double at_time)
 	m_rootFrame.reset(Frame::Unserialize(section, this, 0, at_time));
 	RebuildFrameIndex();
 
+	// saves before 82 have laser bolts in the list, which come back as null
+	// but keep their places so the indices of the bodies after them hold
 	Uint32 nbodies = rd.Int32();
+	std::vector<Body*> loaded;
+	loaded.reserve(nbodies);
 	for (Uint32 i = 0; i < nbodies; i++) {
-		m_bodies.push_back(Body::Unserialize(rd, this));
+		Body *b = Body::Unserialize(rd, this);
+		if (b) m_bodies.Add(b);
+		loaded.push_back(b);
 	}
-	RebuildBodyIndex();
+	m_bodyIndex.clear();
+	m_bodyIndex.push_back(0);
+	for (Body* b : loaded)
+		AddBodyToIndex(b);
+	m_bodyIndexValid = true;
 
 	Frame::PostUnserializeFixup(m_rootFrame.get(), this);
-	for (Body* b : m_bodies) {
+	for (Body* b : m_bodies.GetAll()) {
 		b->PostLoadFixup(this);
 		// Add hyperspace clouds to collections
 		if(b->GetType() == Body::Type::HYPERSPACECLOUD) {
@@ -146,6 +185,8 @@ Space::Space(Game *game, Serializer::Reader &rd, double at_time)
 			}
 		}
 	}
+	for (Body* b : m_bodies.GetAll())
+		b->NotifyEnteredSpace(this);
 
 	GenSectorCache(&path);
 }
@@ -153,9 +194,8 @@ Space::Space(Game *game, Serializer::Reader &rd, double at_time)
 Space::~Space()
 {
 	UpdateBodies(); // make sure anything waiting to be removed gets removed before we go and kill everything else
-    for (std::list<Body*>::iterator i = m_bodies.begin(); i != m_bodies.end(); ++i) {
-		KillBody(*i);
-    }
+	for (Body* b : m_bodies.GetAll())
+		KillBody(b);
     m_hyperspaceClouds.clear();
     m_permaHyperspaceClouds.clear();
 	UpdateBodies();
@@ -173,8 +213,8 @@ void Space::Serialize(Serializer::Writer &wr)
 	Frame::Serialize(section, m_rootFrame.get(), this);
 	wr.WrSection("Frames", section.GetData());
 
-	wr.Int32(m_bodies.size());
-	for (Body* b : m_bodies) {
+	wr.Int32(m_bodies.Size());
+	for (Body* b : m_bodies.GetAll()) {
 		b->Serialize(wr, this);
 	}
 }
@@ -260,20 +300,24 @@ void Space::RebuildBodyIndex()
 	m_bodyIndex.clear();
 	m_bodyIndex.push_back(0);
 
-	for (Body* b : m_bodies) {
-		m_bodyIndex.push_back(b);
-		// also index ships inside clouds
-		// XXX we should not have to know about this. move indexing grunt work
-		// down into the bodies?
-		if (b->IsType(Object::HYPERSPACECLOUD)) {
-			Ship *s = static_cast<HyperspaceCloud*>(b)->GetShip();
-			if (s) m_bodyIndex.push_back(s);
-		}
-	}
+	for (Body* b : m_bodies.GetAll())
+		AddBodyToIndex(b);
 
 	m_bodyIndexValid = true;
 }
 
+void Space::AddBodyToIndex(Body *b)
+{
+	m_bodyIndex.push_back(b);
+	// also index ships inside clouds
+	// XXX we should not have to know about this. move indexing grunt work
+	// down into the bodies?
+	if (b && b->IsType(Object::HYPERSPACECLOUD)) {
+		Ship *s = static_cast<HyperspaceCloud*>(b)->GetShip();
+		if (s) m_bodyIndex.push_back(s);
+	}
+}
+
 void Space::RebuildSystemBodyIndex()
 {
 	m_sbodyIndex.clear();
@@ -287,7 +331,12 @@ void Space::RebuildSystemBodyIndex()
 
 void Space::AddBody(Body *b)
 {
-	m_bodies.push_back(b);
+	m_bodies.Add(b);
+	b->NotifyEnteredSpace(this);
+	// one added during a tick gets its update this tick too, but missed
+	// UpdateSimLOD. it takes the rest of the tick in one
+	if (m_tickStep > 0.0f && b->IsType(Object::DYNAMICBODY))
+		static_cast<DynamicBody*>(b)->SetSubSteps(m_tickStep, 1);
 }
 
 void Space::RemoveBody(Body *b)
@@ -372,7 +421,7 @@ Body *Space::FindNearestTo(const Body *b, Object::Type t) const
 {
 	Body *nearest = 0;
 	double dist = FLT_MAX;
-	for (std::list<Body*>::const_iterator i = m_bodies.begin(); i != m_bodies.end(); ++i) {
+	for (std::vector<Body*>::const_iterator i = m_bodies.GetAll().begin(); i != m_bodies.GetAll().end(); ++i) {
 		if ((*i)->IsDead()) continue;
 		if ((*i)->IsType(t)) {
 			double d = (*i)->GetPositionRelTo(b).Length();
@@ -392,7 +441,7 @@ Body *Space::FindBodyForPath(const SystemPath *path) const
 
 	if (!body) return 0;
 
-	for (Body* b : m_bodies) {
+	for (Body* b : m_bodies.GetAll()) {
 		if (b->GetSystemBody() == body) return b;
 	}
 	return 0;
@@ -796,6 +845,8 @@ static void hitCallback(CollisionContact *c)
 	}
 }
 
+// how far off (in metres) the ground can be for terrain collisions
+
 // temporary one-point version
 static void CollideWithTerrain(Body *body)
 {
@@ -812,7 +863,8 @@ static void CollideWithTerrain(Body *body)
 	double altitude = body->GetPosition().Length() + aabb.min.y;
 	if (altitude >= (terrain->GetMaxFeatureRadius()*2.0)) return;
 
-	double terrHeight = terrain->GetTerrainHeight(body->GetPosition().Normalized());
+	double terrHeight = terrain->GetTerrainHeightApprox(body->GetPosition().Normalized(),
+		TERRAIN_COLLISION_ERROR, &dynBody->GetTerrainHeightCache());
 	if (altitude >= terrHeight) return;
 
 	CollisionContact c;
@@ -831,28 +883,223 @@ void Space::CollideFrame(Frame *f)
 		CollideFrame(kid);
 }
 
+// the part of a tick a body takes at once, see UpdateSimLOD()
+static float BodyStep(const Body *b, float step)
+{
+	if (!b->IsType(Object::DYNAMICBODY)) return step;
+	return static_cast<const DynamicBody*>(b)->GetStepSize();
+}
+
+// Collisions are found by overlap at the start of each step, which misses
+// anything that goes right through something in one step. Bodies that move
+// far enough for that are swept along the step they're about to take and
+// bounced off the first thing in their way before they get there.
+void Space::CollideSwept(float step)
+{
+	PROFILE_SCOPED()
+	m_sweptBodies.clear();
+	for (Body* b : m_bodies.GetAll()) {
+		if (!b->IsType(Object::DYNAMICBODY)) continue;
+		DynamicBody *dynBody = static_cast<DynamicBody*>(b);
+		Geom *geom = dynBody->GetGeom();
+		if (!geom) continue;
+
+		// everyone's motion first, the sweeps are relative to it. A body
+		// cut into pieces only sweeps its first, the rest are checked
+		// against the statics in SubStep()
+		const vector3d motion = dynBody->GetStepMotion(BodyStep(b, step));
+		geom->SetMotion(motion);
+		const double minStep = SWEEP_MIN_STEP * geom->GetGeomTree()->GetRadius();
+		if (dynBody->IsColliding() && motion.LengthSqr() > minStep*minStep)
+			m_sweptBodies.push_back(dynBody);
+	}
+
+	for (DynamicBody *dynBody : m_sweptBodies) {
+		Frame *f = dynBody->GetFrame();
+		if (!f) continue;
+		Geom *geom = dynBody->GetGeom();
+		CollisionContact c;
+		const double fraction = f->GetCollisionSpace()->SweepGeom(geom, geom->GetMotion(), &c);
+		if (fraction < 1.0) {
+			// the response wants the contact relative to where the body is
+			// now, not where it will be when it hits
+			c.pos -= geom->GetMotion() * fraction;
+			hitCallback(&c);
+		}
+	}
+}
+
+// ships plan from the world as it stands at the start of the step, so the
+// order they think in doesn't matter and they can do it side by side
+void Space::ThinkAI()
+{
+	PROFILE_SCOPED()
+	m_aiShips.clear();
+	for (Body* b : m_bodies.GetAll()) {
+		if (b->IsType(Object::SHIP) && static_cast<Ship*>(b)->AIIsActive())
+			m_aiShips.push_back(static_cast<Ship*>(b));
+	}
+
+	Pi::Jobs()->ParallelFor(m_aiShips.size(), AI_THINK_BATCH_SIZE, [this](Uint32 begin, Uint32 end) {
+		for (Uint32 i = begin; i < end; i++)
+			m_aiShips[i]->AIThink();
+	});
+}
+
+// How long a step b can take without getting more than
+// SIM_STEP_CONTACT_FRACTION of the way to anything, looking no further ahead
+// than horizon seconds.
+double Space::GetStepLimit(const DynamicBody *b, double horizon) const
+{
+	if (b->IsType(Object::SHIP)) {
+		const Ship *s = static_cast<const Ship*>(b);
+		// docked, landed and docking ships go where the station or ground puts them
+		if (s->GetFlightState() != Ship::FLYING) return horizon;
+		if (s->NeedsFineSteps()) return m_game->GetTimeStep();
+	}
+	if (!b->IsMoving()) return horizon;
+
+	const double speed = b->GetVelocity().Length();
+	const double accel = b->GetLastForce().Length() / b->GetMass();
+	// anything further away than this can't be reached within the horizon
+	const double reach = (speed + 0.5*accel*horizon) * horizon / SIM_STEP_CONTACT_FRACTION;
+	if (reach <= 0.0) return horizon;
+
+	double clearance = reach;
+	const Body *frameBody = b->GetFrame()->GetBody();
+	if (frameBody && frameBody != b)
+		clearance = std::min(clearance, b->GetPositionRelTo(frameBody).Length() - frameBody->GetPhysRadius());
+
+	BodyNearList nearBodies;
+	m_bodyNearFinder.GetBodiesMaybeNear(b, clearance + SIM_STEP_NEAR_MARGIN, nearBodies);
+	for (const Body *other : nearBodies) {
+		if (other == b || other == frameBody) continue;
+		clearance = std::min(clearance, b->GetPositionRelTo(other).Length() - other->GetPhysRadius());
+	}
+	clearance -= b->GetPhysRadius();
+	if (clearance <= 0.0) return m_game->GetTimeStep();
+
+	// time to cover the fraction from d = v*t + a*t*t/2, in the form that
+	// doesn't fall apart for no acceleration
+	const double d = SIM_STEP_CONTACT_FRACTION * clearance;
+	return std::min(horizon, 2.0*d / (speed + sqrt(speed*speed + 2.0*accel*d)));
+}
+
+// Every body gets a step sized to where it is and what it's doing. Ships far
+// from the player and from anything else go on rails and only take a full
+// step every few ticks, a longer stride the emptier their surroundings. When
+// a tick covers several base steps (Pi::MainLoop does that when it's behind)
+// anything that can't take the whole tick in one go is cut up into pieces
+// instead, down to the base step, see SubStep().
+//
+// ships on rails are only looked at on their full steps; anything that needs
+// a ship's attention sooner (damage, new orders) takes it off rails directly
+void Space::UpdateSimLOD(float step)
+{
+	PROFILE_SCOPED()
+	m_numShipsOnRails = 0;
+	m_subStepBodies.clear();
+
+	const float baseStep = m_game->GetTimeStep();
+	const int maxSubSteps = (baseStep > 0.0f) ? int(step / baseStep + 0.5f) : 1;
+
+	for (Body* b : m_bodies.GetAll()) {
+		if (!b->IsType(Object::DYNAMICBODY)) continue;
+		DynamicBody *dynBody = static_cast<DynamicBody*>(b);
+		dynBody->SetSubSteps(step, 1);
+
+		if (Pi::player && b != Pi::player && b->IsType(Object::SHIP)) {
+			Ship *s = static_cast<Ship*>(b);
+
+			if (s->RailsStep()) {
+				int interval = 1;
+				if (s->CanGoOnRails()) {
+					const double dist = s->GetPositionRelTo(Pi::player).Length();
+					if (dist > (s->IsOnRails() ? SIM_LOD_FULL_DIST : SIM_LOD_RAILS_DIST)) {
+						const double limit = GetStepLimit(s, SIM_LOD_MAX_INTERVAL * step);
+						while (interval < SIM_LOD_MAX_INTERVAL && 2 * interval * step <= limit)
+							interval *= 2;
+					}
+				}
+				// a stride of one tick is no stride at all
+				s->SetRailsInterval(interval);
+				s->SetOnRails(interval > 1);
+			}
+
+			if (s->IsOnRails()) {
+				m_numShipsOnRails++;
+				continue;
+			}
+		}
+
+		if (maxSubSteps > 1) {
+			const double limit = GetStepLimit(dynBody, step);
+			if (limit < step) {
+				dynBody->SetSubSteps(step, std::min(maxSubSteps, int(ceil(step / limit))));
+				m_subStepBodies.push_back(dynBody);
+			}
+		}
+	}
+}
+
+// The rest of the tick for a body cut into pieces. The first piece was taken
+// with everyone else, the others are full steps on their own against a world
+// that's already at the end of the tick. Stations and the ground are checked
+// before every piece, other moving things only get the sweep at the start.
+void Space::SubStep(DynamicBody *b, float step)
+{
+	const int pieces = b->GetSubSteps();
+	const float piece = step / pieces;
+	for (int i = 1; i < pieces; i++) {
+		if (b->IsDead()) return;
+
+		if (b->GetGeom()) b->GetFrame()->GetCollisionSpace()->CollideStatic(b->GetGeom(), &hitCallback);
+		CollideWithTerrain(b);
+		b->UpdateFrame();
+
+		if (b->IsType(Object::SHIP) && static_cast<Ship*>(b)->AIIsActive())
+			static_cast<Ship*>(b)->AIThink();
+		b->StaticUpdate(piece);
+		b->TimeStepUpdate(piece);
+	}
+}
+
 void Space::TimeStep(float step)
 {
 	PROFILE_SCOPED()
 	m_frameIndexValid = m_bodyIndexValid = m_sbodyIndexValid = false;
 
+	// bodies can be added while we go (weapons fire, cargo spills), so index
+	// rather than iterate; new ones get their update this step too
+	const std::vector<Body*> &bodies = m_bodies.GetAll();
+
 	// XXX does not need to be done this often
 	CollideFrame(m_rootFrame.get());
-	for (Body* b : m_bodies)
-		CollideWithTerrain(b);
+	for (size_t i = 0; i < bodies.size(); i++)
+		CollideWithTerrain(bodies[i]);
 
 	// update frames of reference
-	for (Body* b : m_bodies)
-		b->UpdateFrame();
+	for (size_t i = 0; i < bodies.size(); i++)
+		bodies[i]->UpdateFrame();
 
-	// AI acts here, then move all bodies and frames
-	for (Body* b : m_bodies)
-		b->StaticUpdate(step);
+	// AI thinks in parallel, then acts here, then move all bodies and frames
+	m_tickStep = step;
+	UpdateSimLOD(step);
+	ThinkAI();
+	for (size_t i = 0; i < bodies.size(); i++)
+		bodies[i]->StaticUpdate(BodyStep(bodies[i], step));
+	Projectile::StaticUpdateAll(step, m_rootFrame.get());
 
-	m_rootFrame->UpdateOrbitRails(m_game->GetTime(), m_game->GetTimeStep());
+	// forces are all in now, so the bodies know where they're heading
+	CollideSwept(step);
+
+	m_rootFrame->UpdateOrbitRails(m_game->GetTime(), step);
 
-	for (Body* b : m_bodies)
-		b->TimeStepUpdate(step);
+	for (size_t i = 0; i < bodies.size(); i++)
+		bodies[i]->TimeStepUpdate(BodyStep(bodies[i], step));
+	for (DynamicBody *dynBody : m_subStepBodies)
+		SubStep(dynBody, step);
+	Projectile::TimeStepAll(step, m_rootFrame.get());
 
 	// XXX don't emit events in hyperspace. this is mostly to maintain the
 	// status quo. in particular without this onEnterSystem will fire in the
@@ -865,28 +1112,37 @@ void Space::TimeStep(float step)
 	}
 
 	UpdateBodies();
+	m_tickStep = 0.0f;
 
 	m_bodyNearFinder.Prepare();
 }
 
+// whether any bolts might have b as their owner (see Projectile::Add)
+static bool CanFireBolts(const Body *b)
+{
+	return b->IsType(Object::SHIP) && !b->IsType(Object::MISSILE);
+}
+
 void Space::UpdateBodies()
 {
 #ifndef NDEBUG
 	m_processingFinalizationQueue = true;
 #endif
 
+	// the registry tells whoever needs to know. bolts remember who fired
+	// them, and only ships fire
 	for (Body* rmb : m_removeBodies) {
 		rmb->SetFrame(0);
-		for (Body* b : m_bodies)
-			b->NotifyRemoved(rmb);
-		m_bodies.remove(rmb);
+		m_bodies.Remove(rmb);
+		if (CanFireBolts(rmb))
+			Projectile::NotifyRemovedAll(rmb, m_rootFrame.get());
 	}
 	m_removeBodies.clear();
 
 	for (Body* killb : m_killBodies) {
-		for (Body* b : m_bodies)
-			b->NotifyRemoved(killb);
-		m_bodies.remove(killb);
+		m_bodies.Remove(killb);
+		if (CanFireBolts(killb))
+			Projectile::NotifyRemovedAll(killb, m_rootFrame.get());
 		delete killb;
 	}
 	m_killBodies.clear();
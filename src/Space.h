@@ -13,9 +13,11 @@
 #include "galaxy/StarSystem.h"
 #include "Background.h"
 #include "IterationProxy.h"
+#include "BodyRegistry.h"
 #include "HyperspaceCloud.h"
 
 class Body;
+class DynamicBody;
 class Frame;
 class Ship;
 class Game;
@@ -53,6 +55,17 @@ public:
 	void RemoveBody(Body *);
 	void KillBody(Body *);
 
+	// observer->NotifyRemoved(subject) will be called when subject leaves
+	// the space. only needed by bodies that don't ObservesAllRemovals().
+	// both must be in the space already
+	void SubscribeRemoval(Body *observer, const Body *subject) { m_bodies.Subscribe(observer, subject); }
+	void UnsubscribeRemoval(Body *observer, const Body *subject) { m_bodies.Unsubscribe(observer, subject); }
+
+	// weak reference to a body. resolves to null once the body has left
+	typedef BodyRegistry<Body>::Handle BodyHandle;
+	BodyHandle GetHandleForBody(const Body *b) const { return m_bodies.GetHandle(b); }
+	Body *GetBodyByHandle(const BodyHandle &h) const { return m_bodies.Get(h); }
+
 	void TimeStep(float step);
 
 	vector3d GetHyperspaceExitPoint(const SystemPath &source, const SystemPath &dest) const;
@@ -63,9 +76,11 @@ public:
 	Body *FindNearestTo(const Body *b, Object::Type t) const;
 	Body *FindBodyForPath(const SystemPath *path) const;
 
-	unsigned GetNumBodies() const { return m_bodies.size(); }
-	IterationProxy<std::list<Body*> > GetBodies() { return MakeIterationProxy(m_bodies); }
-	const IterationProxy<const std::list<Body*> > GetBodies() const { return MakeIterationProxy(m_bodies); }
+	unsigned GetNumBodies() const { return m_bodies.Size(); }
+	unsigned GetNumShipsOnRails() const { return m_numShipsOnRails; }
+	unsigned GetNumSubSteppedBodies() const { return m_subStepBodies.size(); }
+	IterationProxy<std::vector<Body*> > GetBodies() { return MakeIterationProxy(m_bodies.GetAll()); }
+	const IterationProxy<const std::vector<Body*> > GetBodies() const { return MakeIterationProxy(m_bodies.GetAll()); }
 
 	Background::Container *GetBackground() { return m_background.get(); }
 	Graphics::Texture *GetUniverseCubeMap() const { return m_background->GetUniverseBox()->GetCubeMap(); }
@@ -97,6 +112,21 @@ private:
 
 	void CollideFrame(Frame *f);
 
+	// sweep bodies moving too fast for CollideFrame() along their step
+	void CollideSwept(float step);
+	std::vector<DynamicBody*> m_sweptBodies;
+
+	// parallel read-only AI planning pass, ahead of the serial StaticUpdate
+	void ThinkAI();
+	std::vector<Ship*> m_aiShips;
+
+	// size each body's step for this tick: AI ships far from the player on
+	// and off rails, and pieces for bodies that can't take a long tick whole
+	void UpdateSimLOD(float step);
+	double GetStepLimit(const DynamicBody *b, double horizon) const;
+	void SubStep(DynamicBody *b, float step);
+	std::vector<DynamicBody*> m_subStepBodies;
+
 	std::unique_ptr<Frame> m_rootFrame;
 
 	RefCountedPtr<SectorCache::Slave> m_sectorCache;
@@ -105,8 +135,11 @@ private:
 
 	Game *m_game;
 
+	unsigned m_numShipsOnRails;
+	float m_tickStep;	// of the tick under way, 0 between ticks
+
 	// all the bodies we know about
-	std::list<Body*> m_bodies;
+	BodyRegistry<Body> m_bodies;
 
 	// bodies that were removed/killed this timestep and need pruning at the end
 	std::list<Body*> m_removeBodies;
@@ -114,6 +147,7 @@ private:
 
 	void RebuildFrameIndex();
 	void RebuildBodyIndex();
+	void AddBodyToIndex(Body *body);
 	void RebuildSystemBodyIndex();
 
 	void AddFrameToIndex(Frame *frame);
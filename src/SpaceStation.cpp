@@ -161,6 +161,7 @@ void SpaceStation::PostLoadFixup(Space *space)
 	ModelBody::PostLoadFixup(space);
 	for (Uint32 i=0; i<m_shipDocking.size(); i++) {
 		m_shipDocking[i].ship = static_cast<Ship*>(space->GetBodyByIndex(m_shipDocking[i].shipIndex));
+		if (m_shipDocking[i].ship) space->SubscribeRemoval(this, m_shipDocking[i].ship);
 	}
 
 	// Fixup docking queue indices to ship pointers
@@ -178,6 +179,7 @@ SpaceStation::SpaceStation(const SystemBody *sbody): ModelBody()
 	m_oldAngDisplacement = 0.0;
 
 	m_doorAnimationStep = m_doorAnimationState = 0.0;
+	m_space = 0;
 
 	InitStation();
 }
@@ -257,6 +259,16 @@ void SpaceStation::NotifyRemoved(const Body* const removedBody)
 
 }
 
+void SpaceStation::NotifyEnteredSpace(Space *space)
+{
+	m_space = space;
+}
+
+void SpaceStation::NotifyLeftSpace()
+{
+	m_space = 0;
+}
+
 int SpaceStation::GetMyDockingPort(const Ship *s) const
 {
 	for (Uint32 i=0; i<m_shipDocking.size(); i++) {
@@ -324,6 +336,9 @@ void SpaceStation::SetDocked(Ship *ship, int port)
 	shipDocking_t *temp;
 	GetDockingPort(port, ship->IsRemotlyDocked(), temp);
 	temp->ship = ship;
+	// we or the ship may not be in the space yet (a new game starts docked
+	// before Pi::game is set). then the ship subscribes us when it's added
+	if (m_space) m_space->SubscribeRemoval(this, ship);
 	temp->stage = m_type->numDockingStages+1;
 
 	// have to do this crap again in case it was called directly (Ship::SetDockWith())
@@ -401,6 +416,7 @@ bool SpaceStation::GetDockingClearance(Ship *s, std::string &outMsg)
 			shipDocking_t &sd = m_shipDocking[i];
 			sd.ship = s;
 			sd.stage = 1;
+			if (m_space) m_space->SubscribeRemoval(this, s);
 			sd.stagePos = 0;
 			outMsg = stringf(Lang::CLEARANCE_GRANTED_BAY_N, formatarg("bay", i+1));
 			return true;
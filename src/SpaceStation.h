@@ -34,7 +34,7 @@ public:
 
 	// Should point to SystemBody in Pi::currentSystem
 	SpaceStation(const SystemBody *);
-	SpaceStation() {}
+	SpaceStation() : m_space(0) {}
 	virtual ~SpaceStation();
 	virtual vector3d GetAngVelocity() const { return vector3d(0,m_type->angVel,0); }
 	virtual bool OnCollision(Object *b, Uint32 flags, double relVel);
@@ -45,6 +45,8 @@ public:
 	virtual const SystemBody *GetSystemBody() const { return m_sbody; }
 	virtual void PostLoadFixup(Space *space);
 	virtual void NotifyRemoved(const Body* const removedBody);
+	virtual void NotifyEnteredSpace(Space *space);
+	virtual void NotifyLeftSpace();
 
 	virtual void SetLabel(const std::string &label);
 
@@ -145,6 +147,7 @@ private:
 	DockingQueue m_dockingQueue;
 	std::vector<int> m_dockingQueueLoadedData;	// used for post load fixup of docking queue (holds body indices)
 	SceneGraph::ModelSkin m_skin;
+	Space *m_space;	// the space we're in, to subscribe to ships docking
 };
 
 #endif /* _SPACESTATION_H */
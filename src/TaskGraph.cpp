@@ -0,0 +1,134 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TaskGraph.h"
+#include "SDL.h"
+#include <algorithm>
+#include <cassert>
+
+// runs a worker task, and tells the graph on the main thread when it's done
+class TaskGraph::TaskJob : public Job {
+public:
+	TaskJob(TaskGraph *graph, TaskId id) : m_graph(graph), m_id(id) {}
+
+	virtual void OnRun() {
+		Task &task = m_graph->m_tasks[m_id];
+		task.start = SDL_GetPerformanceCounter();
+		task.fn();
+		task.end = SDL_GetPerformanceCounter();
+	}
+	virtual void OnFinish() { m_graph->Finished(m_id); }
+
+private:
+	TaskGraph *m_graph;
+	TaskId m_id;
+};
+
+TaskGraph::TaskGraph(JobQueue *jobs) :
+	m_jobs(jobs),
+	m_numDone(0),
+	m_runStart(0),
+	m_runEnd(0)
+{
+}
+
+TaskGraph::~TaskGraph()
+{
+	// a job still running would be left pointing at us
+	assert(m_numDone == m_tasks.size());
+}
+
+TaskGraph::TaskId TaskGraph::Add(const std::string &name, Thread thread, const std::function<void()> &fn, const std::vector<TaskId> &deps)
+{
+	const TaskId id = m_tasks.size();
+	m_tasks.push_back(Task());
+	Task &task = m_tasks.back();
+	task.name = name;
+	task.thread = thread;
+	task.fn = fn;
+	task.waitingOn = 0;
+	task.done = false;
+	task.start = task.end = 0;
+	for (std::vector<TaskId>::const_iterator it = deps.begin(); it != deps.end(); ++it) {
+		assert(*it < id);
+		if (m_tasks[*it].done) continue;
+		m_tasks[*it].dependents.push_back(id);
+		task.waitingOn++;
+	}
+	return id;
+}
+
+void TaskGraph::Ready(TaskId id)
+{
+	if (m_tasks[id].thread == WORKER)
+		m_handles.push_back(m_jobs->Queue(new TaskJob(this, id)));
+	else
+		m_mainReady.insert(std::upper_bound(m_mainReady.begin(), m_mainReady.end(), id), id);
+}
+
+void TaskGraph::Finished(TaskId id)
+{
+	Task &task = m_tasks[id];
+	task.done = true;
+	m_numDone++;
+	for (std::vector<TaskId>::const_iterator it = task.dependents.begin(); it != task.dependents.end(); ++it) {
+		if (--m_tasks[*it].waitingOn == 0)
+			Ready(*it);
+	}
+}
+
+void TaskGraph::Run(const std::function<void(float)> &progress)
+{
+	m_runStart = SDL_GetPerformanceCounter();
+	const Uint32 numDoneBefore = m_numDone;
+	for (TaskId id = 0; id < m_tasks.size(); id++) {
+		if (!m_tasks[id].done && m_tasks[id].waitingOn == 0)
+			Ready(id);
+	}
+
+	Uint32 numReported = m_numDone;
+	while (m_numDone < m_tasks.size()) {
+		if (!m_mainReady.empty()) {
+			// the earliest added first, so the order is the same every time
+			const TaskId id = m_mainReady.front();
+			m_mainReady.erase(m_mainReady.begin());
+			Task &task = m_tasks[id];
+			task.start = SDL_GetPerformanceCounter();
+			task.fn();
+			task.end = SDL_GetPerformanceCounter();
+			Finished(id);
+		} else if (m_jobs->FinishJobs() == 0) {
+			// nothing to do here until a worker's done
+			SDL_Delay(1);
+		}
+
+		if (progress && m_numDone != numReported) {
+			numReported = m_numDone;
+			progress(float(m_numDone - numDoneBefore) / float(m_tasks.size() - numDoneBefore));
+		}
+	}
+	m_handles.clear();
+	m_runEnd = SDL_GetPerformanceCounter();
+}
+
+double TaskGraph::GetTotalTime() const
+{
+	return double(m_runEnd - m_runStart) * 1000.0 / double(SDL_GetPerformanceFrequency());
+}
+
+void TaskGraph::WriteProfile(FILE *f) const
+{
+	std::vector<TaskId> order;
+	for (TaskId id = 0; id < m_tasks.size(); id++)
+		order.push_back(id);
+	std::stable_sort(order.begin(), order.end(), [this](TaskId a, TaskId b) { return m_tasks[a].start < m_tasks[b].start; });
+
+	const double toMs = 1000.0 / double(SDL_GetPerformanceFrequency());
+	fprintf(f, "%-24s %-8s %10s %10s\n", "stage", "thread", "start", "time");
+	for (std::vector<TaskId>::const_iterator it = order.begin(); it != order.end(); ++it) {
+		const Task &task = m_tasks[*it];
+		fprintf(f, "%-24s %-8s %10.2f %10.2f\n", task.name.c_str(), task.thread == WORKER ? "worker" : "main",
+			double(task.start - m_runStart) * toMs, double(task.end - task.start) * toMs);
+	}
+	fprintf(f, "%-24s %-8s %10.2f %10.2f\n", "total", "", 0.0, GetTotalTime());
+}
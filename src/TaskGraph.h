@@ -0,0 +1,67 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "SDL_stdinc.h"
+#include "JobQueue.h"
+
+// a set of tasks that each run once, each after the ones it depends on.
+// worker tasks go on the job queue as soon as they're free to run. main
+// thread tasks run on the caller, in the order they were added, while the
+// workers get on with theirs. anything that touches GL or the Lua states
+// belongs on the main thread
+//
+// records when each task started and how long it took, for WriteProfile
+class TaskGraph {
+public:
+	enum Thread { MAIN_THREAD, WORKER };
+	typedef Uint32 TaskId;
+
+	explicit TaskGraph(JobQueue *jobs);
+	~TaskGraph();
+
+	// deps must all have been added already, so there can't be a cycle
+	TaskId Add(const std::string &name, Thread thread, const std::function<void()> &fn,
+		const std::vector<TaskId> &deps = std::vector<TaskId>());
+
+	// runs everything added, returning when it's all done. progress is
+	// called on the main thread as each task finishes, with the fraction done
+	void Run(const std::function<void(float)> &progress = std::function<void(float)>());
+
+	// a line for each task: name, thread, and start and time taken in ms
+	// from the start of Run, in the order they started
+	void WriteProfile(FILE *f) const;
+
+	double GetTotalTime() const; // ms
+
+private:
+	class TaskJob;
+
+	struct Task {
+		std::string name;
+		Thread thread;
+		std::function<void()> fn;
+		std::vector<TaskId> dependents;
+		Uint32 waitingOn;
+		bool done;
+		Uint64 start, end;
+	};
+
+	void Ready(TaskId id);
+	void Finished(TaskId id);
+
+	JobQueue *m_jobs;
+	std::vector<Task> m_tasks;
+	std::vector<TaskId> m_mainReady;
+	std::vector<JobHandle> m_handles;
+	Uint32 m_numDone;
+	Uint64 m_runStart, m_runEnd;
+};
+
+#endif
@@ -141,6 +141,19 @@ double TerrainBody::GetTerrainHeight(const vector3d &pos_) const
 	}
 }
 
+double TerrainBody::GetTerrainHeightApprox(const vector3d &pos_, double maxError, TerrainHeightCache *cache) const
+{
+	if (!m_geosphere) return GetTerrainHeight(pos_);
+
+	const double radius = m_sbody->GetRadius();
+	double height;
+	if (m_geosphere->GetGeneratedHeight(pos_, maxError / radius, height))
+		return radius * (1.0 + height);
+
+	if (!cache) return GetTerrainHeight(pos_);
+	return cache->Get(this, pos_, maxError, [this](const vector3d &p) { return GetTerrainHeight(p); });
+}
+
 bool TerrainBody::IsSuperType(SystemBody::BodySuperType t) const
 {
 	if (!m_sbody) return false;
@@ -8,10 +8,15 @@
 #include "galaxy/StarSystem.h"
 #include "GeoSphere.h"
 #include "Camera.h"
+#include "TerrainHeightCache.h"
 
 class Frame;
 namespace Graphics { class Renderer; }
 
+// how closely the ground is known for collisions. Ships are set down on it
+// to the same error, so they sit where collision thinks the ground is
+static const double TERRAIN_COLLISION_ERROR = 0.5;
+
 class TerrainBody : public Body {
 public:
 	OBJDEF(TerrainBody, Body, TERRAINBODY);
@@ -22,6 +27,11 @@ public:
 	virtual bool OnCollision(Object *b, Uint32 flags, double relVel) { return true; }
 	virtual double GetMass() const { return m_mass; }
 	double GetTerrainHeight(const vector3d &pos) const;
+	// As GetTerrainHeight(), but may be off by up to maxError metres. Comes
+	// from the terrain already generated for rendering where that's detailed
+	// enough, then from cache if there is one, and only runs the fractal if
+	// neither will do. Main thread only.
+	double GetTerrainHeightApprox(const vector3d &pos, double maxError, TerrainHeightCache *cache = 0) const;
 	bool IsSuperType(SystemBody::BodySuperType t) const;
 	virtual const SystemBody *GetSystemBody() const { return m_sbody; }
 	GeoSphere *GetGeoSphere() const { return m_geosphere; }
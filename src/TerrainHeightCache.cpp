@@ -0,0 +1,156 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "TerrainHeightCache.h"
+
+namespace TerrainHeights {
+
+// how far outside [0,1] still counts as on the patch, so points right on an
+// edge don't fall between neighbours
+static const double EDGE_SLOP = 1e-6;
+
+static vector3d Perpendicular(const vector3d &v)
+{
+	const vector3d a = (fabs(v.x) < fabs(v.y)) ?
+		(fabs(v.x) < fabs(v.z) ? vector3d(1.0, 0.0, 0.0) : vector3d(0.0, 0.0, 1.0)) :
+		(fabs(v.y) < fabs(v.z) ? vector3d(0.0, 1.0, 0.0) : vector3d(0.0, 0.0, 1.0));
+	return v.Cross(a).Normalized();
+}
+
+static bool InPatch(double t) { return t >= -EDGE_SLOP && t <= 1.0 + EDGE_SLOP; }
+
+bool PatchCoords(const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
+	const vector3d &dir, double &x, double &y)
+{
+	// the patch surface is v0 + x*e1 + y*e2 + x*y*e3, and it's in direction
+	// dir where it has no component along either of two axes perpendicular
+	// to dir. That's two bilinear equations in x and y, and eliminating x
+	// leaves a quadratic in y.
+	const vector3d e1 = v1 - v0;
+	const vector3d e2 = v3 - v0;
+	const vector3d e3 = v0 - v1 + v2 - v3;
+
+	const vector3d p = Perpendicular(dir);
+	const vector3d q = dir.Cross(p);
+
+	const double a1 = v0.Dot(p), b1 = e1.Dot(p), c1 = e2.Dot(p), d1 = e3.Dot(p);
+	const double a2 = v0.Dot(q), b2 = e1.Dot(q), c2 = e2.Dot(q), d2 = e3.Dot(q);
+
+	const double A = c2*d1 - d2*c1;
+	const double B = a2*d1 + c2*b1 - b2*c1 - d2*a1;
+	const double C = a2*b1 - b2*a1;
+
+	double roots[2];
+	int numRoots = 0;
+	if (A == 0.0) {
+		if (B == 0.0) return false;
+		roots[numRoots++] = -C / B;
+	} else {
+		const double disc = B*B - 4.0*A*C;
+		if (disc < 0.0) return false;
+		// the stable form, A is tiny next to B for small (deep) patches
+		const double s = -0.5 * (B + (B < 0.0 ? -sqrt(disc) : sqrt(disc)));
+		if (s != 0.0) roots[numRoots++] = C / s;
+		roots[numRoots++] = s / A;
+	}
+
+	for (int i = 0; i < numRoots; i++) {
+		const double ry = roots[i];
+		if (!InPatch(ry)) continue;
+
+		const double den1 = b1 + d1*ry;
+		const double den2 = b2 + d2*ry;
+		double rx;
+		if (fabs(den1) >= fabs(den2)) {
+			if (den1 == 0.0) continue;
+			rx = -(a1 + c1*ry) / den1;
+		} else {
+			rx = -(a2 + c2*ry) / den2;
+		}
+		if (!InPatch(rx)) continue;
+
+		// the line through dir hits the patch on the far side of the sphere too
+		if ((v0 + rx*e1 + ry*e2 + rx*ry*e3).Dot(dir) <= 0.0) continue;
+
+		x = Clamp(rx, 0.0, 1.0);
+		y = Clamp(ry, 0.0, 1.0);
+		return true;
+	}
+	return false;
+}
+
+double Sample(const double *heights, int edgeLen, double x, double y)
+{
+	const int last = edgeLen - 1;
+	const double fx = Clamp(x, 0.0, 1.0) * last;
+	const double fy = Clamp(y, 0.0, 1.0) * last;
+	const int ix = std::min(int(fx), last - 1);
+	const int iy = std::min(int(fy), last - 1);
+	const double tx = fx - ix;
+	const double ty = fy - iy;
+
+	const double *row0 = &heights[iy*edgeLen + ix];
+	const double *row1 = row0 + edgeLen;
+	const double h0 = row0[0] + (row0[1] - row0[0]) * tx;
+	const double h1 = row1[0] + (row1[1] - row1[0]) * tx;
+	return h0 + (h1 - h0) * ty;
+}
+
+double EstimateError(const double *heights, int edgeLen)
+{
+	double err = 0.0;
+	for (int y = 0; y + 2 < edgeLen; y += 2) {
+		for (int x = 0; x + 2 < edgeLen; x += 2) {
+			const double *r0 = &heights[y*edgeLen + x];
+			const double *r1 = r0 + edgeLen;
+			const double *r2 = r1 + edgeLen;
+			err = std::max(err, fabs(r0[1] - 0.5*(r0[0] + r0[2])));
+			err = std::max(err, fabs(r2[1] - 0.5*(r2[0] + r2[2])));
+			err = std::max(err, fabs(r1[0] - 0.5*(r0[0] + r2[0])));
+			err = std::max(err, fabs(r1[2] - 0.5*(r0[2] + r2[2])));
+			err = std::max(err, fabs(r1[1] - 0.25*(r0[0] + r0[2] + r2[0] + r2[2])));
+		}
+	}
+	return err;
+}
+
+}
+
+const double TerrainHeightCache::INITIAL_CELL_SIZE = 1e-5;
+const double TerrainHeightCache::MIN_CELL_SIZE = 1e-9;
+const double TerrainHeightCache::MAX_CELL_SIZE = 1e-3;
+
+Uint32 TerrainHeightCache::s_hits = 0;
+
+void TerrainHeightCache::SetCell(const vector3d &centre, double size)
+{
+	m_centre = centre;
+	m_cellSize = size;
+	m_u = TerrainHeights::Perpendicular(centre);
+	m_v = centre.Cross(m_u);
+
+	// same order as patch corners
+	const double s = m_cellSize;
+	m_cornerDirs[0] = (centre - s*m_u - s*m_v).Normalized();
+	m_cornerDirs[1] = (centre + s*m_u - s*m_v).Normalized();
+	m_cornerDirs[2] = (centre + s*m_u + s*m_v).Normalized();
+	m_cornerDirs[3] = (centre - s*m_u + s*m_v).Normalized();
+}
+
+bool TerrainHeightCache::Lookup(const vector3d &dir, double &height) const
+{
+	// project onto the plane touching the sphere at the centre, the cell is
+	// a square there
+	const double d = dir.Dot(m_centre);
+	if (d <= 0.0) return false;
+	const double a = dir.Dot(m_u) / d;
+	const double b = dir.Dot(m_v) / d;
+	if (fabs(a) > m_cellSize || fabs(b) > m_cellSize) return false;
+
+	const double x = 0.5 * (a / m_cellSize + 1.0);
+	const double y = 0.5 * (b / m_cellSize + 1.0);
+	const double h0 = m_corners[0] + (m_corners[1] - m_corners[0]) * x;
+	const double h1 = m_corners[3] + (m_corners[2] - m_corners[3]) * x;
+	height = h0 + (h1 - h0) * y;
+	return true;
+}
@@ -0,0 +1,140 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _TERRAINHEIGHTCACHE_H
+#define _TERRAINHEIGHTCACHE_H
+
+#include "libs.h"
+
+// Terrain heights without running the fractal, from heightmaps that have
+// already been generated. Patch corners and surface coords are as for
+// GeoPatch: (0,0) is v0, (1,0) v1, (1,1) v2 and (0,1) v3.
+namespace TerrainHeights {
+
+	// surface coords of the point on the patch that's in direction dir, ie
+	// the inverse of GeoPatch::GetSpherePoint. false if dir misses the patch
+	bool PatchCoords(const vector3d &v0, const vector3d &v1, const vector3d &v2, const vector3d &v3,
+		const vector3d &dir, double &x, double &y);
+
+	// bilinear sample of an edgeLen*edgeLen heightmap at surface coords x,y
+	double Sample(const double *heights, int edgeLen, double x, double y);
+
+	// How far Sample() may be from the real terrain. The heightmap can't say
+	// what happens between its own samples, so this is how badly every other
+	// sample predicts the ones in between, which is what the heightmap would
+	// get wrong at half the resolution.
+	double EstimateError(const double *heights, int edgeLen);
+
+}
+
+// Remembers the terrain around the last place a body asked about, for bodies
+// that keep asking about the ground under them while they hang around one
+// spot (hovering, landing, sliding along the surface). Holds one square cell
+// of the sphere with a height at each corner, and answers anything inside it
+// by interpolation. The cell shrinks until interpolating across it is within
+// the error asked for, and grows again where the terrain is smooth.
+//
+// A miss tries at most one cell, so it costs at most MAX_MISS_EVALUATIONS
+// calls to heightAt. A cell that's too rough is thrown away, the next one is
+// smaller, and after each failure more misses in a row are answered straight
+// from heightAt before trying again.
+//
+// Not thread safe, each body has its own.
+class TerrainHeightCache {
+public:
+	TerrainHeightCache() : m_source(0), m_valid(false), m_cellSize(0.0), m_cellError(0.0), m_nextCellSize(INITIAL_CELL_SIZE), m_lastDir(0.0), m_failures(0), m_skipBuilds(0) {}
+
+	void Clear() { m_source = 0; m_valid = false; }
+
+	// the centre, four corners and four edge midpoints
+	static const int MAX_MISS_EVALUATIONS = 9;
+
+	// height in direction dir, within maxError of heightAt(dir). source is
+	// whatever heightAt gets its heights from, asking about a different one
+	// throws the cell away.
+	template <typename F>
+	double Get(const void *source, const vector3d &dir, double maxError, F heightAt) {
+		if (source != m_source) {
+			m_source = source;
+			m_valid = false;
+			m_lastDir = vector3d(0.0);
+			m_failures = 0;
+			m_skipBuilds = 0;
+		}
+
+		double height;
+		if (m_valid && m_cellError <= maxError && Lookup(dir, height)) {
+			++s_hits;
+			return height;
+		}
+
+		height = heightAt(dir);
+
+		// a body that's moving fast would be through the cell before it
+		// paid for the corners, so only build one for a body that's still
+		// around the last place it asked about
+		if (m_skipBuilds > 0) {
+			m_skipBuilds--;
+		} else if ((dir - m_lastDir).Length() < m_nextCellSize) {
+			SetCell(dir, m_nextCellSize);
+			for (int i = 0; i < 4; i++)
+				m_corners[i] = heightAt(m_cornerDirs[i]);
+			// bilinear does worst halfway between the corners, so see how
+			// far off it is there, the same way
+			// TerrainHeights::EstimateError() does for a heightmap
+			m_cellError = fabs(height - 0.25*(m_corners[0] + m_corners[1] + m_corners[2] + m_corners[3]));
+			for (int i = 0; i < 4; i++) {
+				const int j = (i+1) % 4;
+				const double mid = heightAt((m_cornerDirs[i] + m_cornerDirs[j]).Normalized());
+				m_cellError = std::max(m_cellError, fabs(mid - 0.5*(m_corners[i] + m_corners[j])));
+			}
+			m_valid = m_cellError <= maxError;
+			if (m_valid) {
+				m_failures = 0;
+				if (m_cellError < maxError*0.25)
+					m_nextCellSize = std::min(m_nextCellSize*2.0, MAX_CELL_SIZE);
+			} else {
+				m_nextCellSize = std::max(m_nextCellSize*0.5, MIN_CELL_SIZE);
+				if (m_failures < MAX_BACKOFF) m_failures++;
+				m_skipBuilds = (1 << m_failures) - 1;
+			}
+		}
+		m_lastDir = dir;
+
+		return height;
+	}
+
+	static Uint32 GetHitCount() { return s_hits; }
+	static void ClearHitCount() { s_hits = 0; }
+
+private:
+	// in radians, near enough
+	static const double INITIAL_CELL_SIZE;
+	static const double MIN_CELL_SIZE;
+	static const double MAX_CELL_SIZE;
+	// after n cells in a row fail, 2^n-1 misses go straight to heightAt
+	static const int MAX_BACKOFF = 6;
+
+	void SetCell(const vector3d &centre, double size);
+	bool Lookup(const vector3d &dir, double &height) const;
+
+	const void *m_source;
+	bool m_valid;
+
+	// cell centre and axes, and how far out along the axes the corners are
+	vector3d m_centre, m_u, m_v;
+	double m_cellSize;
+	vector3d m_cornerDirs[4];
+	double m_corners[4];
+	double m_cellError;
+	double m_nextCellSize;
+
+	vector3d m_lastDir;
+
+	int m_failures;
+	int m_skipBuilds;
+
+	static Uint32 s_hits;
+};
+
+#endif
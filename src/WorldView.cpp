@@ -1269,7 +1269,8 @@ void WorldView::RefreshButtonStateAndVisibility()
 			// This should rather be 1.5 * max_radius, but due to quirkses in terrain generation we must be generous.
 			if (center_dist <= 3.0 * terrain->GetMaxFeatureRadius()) {
 				vector3d surface_pos = pos.Normalized();
-				double radius = terrain->GetTerrainHeight(surface_pos);
+				// same place the terrain collision asks about, so it's usually cached
+				double radius = terrain->GetTerrainHeightApprox(surface_pos, 0.5, &Pi::player->GetTerrainHeightCache());
 				double altitude = center_dist - radius;
 
 				if (altitude < 10000000.0 && altitude < 0.5 * radius) {
@@ -1982,7 +1983,6 @@ void WorldView::UpdateCommsOptions()
 void WorldView::SelectBody(Body *target, bool reselectIsDeselect)
 {
 	if (!target || target == Pi::player) return;		// don't select self
-	if (target->IsType(Object::PROJECTILE)) return;
 
 	if (target->IsType(Object::SHIP)) {
 		if (Pi::player->GetCombatTarget() == target) {
@@ -2011,7 +2011,7 @@ Body* WorldView::PickBody(const double screenX, const double screenY) const
 		i = m_projectedPos.begin(); i != m_projectedPos.end(); ++i) {
 		Body *b = i->first;
 
-		if (b == Pi::player || b->IsType(Object::PROJECTILE))
+		if (b == Pi::player)
 			continue;
 
 		const double x1 = i->second.x - PICK_OBJECT_RECT_SIZE * 0.5;
@@ -2069,17 +2069,27 @@ void WorldView::UpdateProjectedObjects()
 		mission_body = Pi::game->GetSpace()->FindBodyForPath(mission_system);
 	}
 
-	for (Body* b : Pi::game->GetSpace()->GetBodies()) {
+	// everything into the camera frame in one go
+	auto bodies = Pi::game->GetSpace()->GetBodies();
+	const unsigned numBodies = Pi::game->GetSpace()->GetNumBodies();
+	std::vector<vector3d> camPos(numBodies);
+	if (numBodies) Body::GetInterpPositionsRelTo(cam_frame, &bodies[0], numBodies, &camPos[0]);
+	// distances from the player from the same positions, not a transform each
+	const vector3d playerCamPos = Pi::player->GetInterpPositionRelTo(cam_frame);
+
+	for (unsigned i = 0; i < numBodies; i++) {
+		Body *b = bodies[i];
 		// don't show the player label on internal camera
 		if (b->IsType(Object::PLAYER) && GetCamType() == CAM_INTERNAL)
 			continue;
 
-		vector3d pos = b->GetInterpPositionRelTo(cam_frame);
+		const double playerDistSqr = (camPos[i] - playerCamPos).LengthSqr();
+		vector3d pos = camPos[i];
 		if ((pos.z < -1.0) && project_to_screen(pos, pos, frustum, guiSize)) {
 
 			// only show labels on large or nearby bodies
 			if (b->IsType(Object::PLANET) || b->IsType(Object::STAR) || b->IsType(Object::SPACESTATION)
-				|| Pi::player->GetPositionRelTo(b).LengthSqr() < 1000000.0*1000000.0)
+				|| playerDistSqr < 1000000.0*1000000.0)
 			{
 				m_bodyLabels->Add(b->GetLabel(), sigc::bind(
 					sigc::mem_fun(this, &WorldView::SelectBody), b, true), float(pos.x), float(pos.y));
@@ -2091,8 +2101,8 @@ void WorldView::UpdateProjectedObjects()
 		}
 
 		// get nearest target for combat
-		if (Pi::KeyState(SDLK_RCTRL) && b->IsType(Object::SHIP) && !b->IsType(Object::PLAYER) && Pi::player->GetPositionRelTo(b).Length() < 10000.0 && Pi::player->GetPositionRelTo(b).Length() < dist) {
-			dist = Pi::player->GetPositionRelTo(b).Length();
+		if (Pi::KeyState(SDLK_RCTRL) && b->IsType(Object::SHIP) && !b->IsType(Object::PLAYER) && playerDistSqr < 10000.0*10000.0 && playerDistSqr < dist*dist) {
+			dist = sqrt(playerDistSqr);
 			Pi::player->SetCombatTarget(b);
 		}
 	}
@@ -2701,7 +2711,6 @@ void WorldView::DrawBodyIcon(Object::Type type, vector2f position, bool current_
 			tquad = m_hud2HyperspaceCloud.get();
 			break;
 
-		case Object::Type::PROJECTILE:
 		case Object::Type::MISSILE:
 		case Object::Type::PLAYER:
 			tquad = nullptr;
@@ -2807,9 +2816,6 @@ void WorldView::GetNavIconFile(Object::Type type, std::string &fileLocation)
 		fileLocation = "icons/hud2/unknown.png";
 		break;
 
-	case Object::Type::PROJECTILE:
-		fileLocation = "icons/hud2/unknown.png";
-		break;
 	case Object::Type::MISSILE:
 		fileLocation = "icons/hud2/unknown.png";
 		break;
@@ -3,10 +3,12 @@
 
 #include "BVHTree.h"
 #include "../buildopts.h"
+#include "../scenegraph/LoadingError.h"
 #include <stdio.h>
 #include <float.h>
+#include <algorithm>
+#include <memory>
 
-const int MAX_SPLITPOS_RETRIES = 15;
 
 BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs)
 {
@@ -22,7 +24,68 @@ BVHTree::BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs)
 	m_nodeAllocMax = numObjs*2 + 1;
 
 	m_root = AllocNode();
-	BuildNode(m_root, objPtrs, objAabbs, activeObjIdxs);
+	BuildNode(m_root, objPtrs, objAabbs, activeObjIdxs, 0);
+}
+
+// nodes are written as one flat array, with kids and leaf contents as
+// indices into the node and object arrays
+static const Uint32 NOT_LEAF = ~Uint32(0);
+
+BVHTree::BVHTree(Serializer::Reader &rd)
+{
+	// nothing's kept until it's all been read, as in GeomTree
+	m_objPtrAllocMax = m_objPtrAllocPos = Uint32(rd.Int32());
+	std::unique_ptr<objPtr_t[]> objPtrs(new objPtr_t[m_objPtrAllocMax]);
+	for (size_t i=0; i<m_objPtrAllocPos; i++)
+		objPtrs[i] = rd.Int32();
+
+	m_nodeAllocMax = m_nodeAllocPos = Uint32(rd.Int32());
+	if (m_nodeAllocMax == 0) throw SceneGraph::LoadingError("BVHTree with no nodes");
+	std::unique_ptr<BVHNode[]> nodes(new BVHNode[m_nodeAllocMax]);
+	for (size_t i=0; i<m_nodeAllocPos; i++) {
+		BVHNode *node = &nodes[i];
+		node->aabb.min = rd.Vector3d();
+		node->aabb.max = rd.Vector3d();
+		node->numTris = rd.Int32();
+		const Uint32 start = rd.Int32();
+		if (start != NOT_LEAF) {
+			if (node->numTris < 0 || size_t(start) + node->numTris > m_objPtrAllocMax)
+				throw SceneGraph::LoadingError("BVHTree leaf out of range");
+			node->triIndicesStart = &objPtrs[start];
+		} else {
+			for (int k=0; k<2; k++) {
+				const Uint32 kid = rd.Int32();
+				if (kid >= m_nodeAllocMax) throw SceneGraph::LoadingError("BVHTree node out of range");
+				node->kids[k] = &nodes[kid];
+			}
+		}
+	}
+	m_objPtrAlloc = objPtrs.release();
+	m_bvhNodes = nodes.release();
+	m_root = &m_bvhNodes[0];
+}
+
+void BVHTree::Save(Serializer::Writer &wr) const
+{
+	wr.Int32(m_objPtrAllocPos);
+	for (size_t i=0; i<m_objPtrAllocPos; i++)
+		wr.Int32(m_objPtrAlloc[i]);
+
+	assert(m_root == &m_bvhNodes[0]);
+	wr.Int32(m_nodeAllocPos);
+	for (size_t i=0; i<m_nodeAllocPos; i++) {
+		const BVHNode *node = &m_bvhNodes[i];
+		wr.Vector3d(node->aabb.min);
+		wr.Vector3d(node->aabb.max);
+		wr.Int32(node->numTris);
+		if (node->IsLeaf()) {
+			wr.Int32(node->triIndicesStart - m_objPtrAlloc);
+		} else {
+			wr.Int32(NOT_LEAF);
+			wr.Int32(node->kids[0] - m_bvhNodes);
+			wr.Int32(node->kids[1] - m_bvhNodes);
+		}
+	}
 }
 
 void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs)
@@ -44,91 +107,128 @@ void BVHTree::MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPt
 	}
 }
 
+static void Grow(Aabb &a, const Aabb &b)
+{
+	a.min.x = std::min(a.min.x, b.min.x); a.max.x = std::max(a.max.x, b.max.x);
+	a.min.y = std::min(a.min.y, b.min.y); a.max.y = std::max(a.max.y, b.max.y);
+	a.min.z = std::min(a.min.z, b.min.z); a.max.z = std::max(a.max.z, b.max.z);
+}
+
+static double SurfaceArea(const Aabb &a)
+{
+	const vector3d d = a.max - a.min;
+	return 2.0 * (d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+/*
+ * Split where the surface area heuristic says a ray is cheapest to trace:
+ * the chance of a ray through this node going through a kid is about the
+ * kid's surface area over this node's, so split to keep area * tris small.
+ * Split positions are only tried at SAH_BINS steps across the spread of
+ * tri centres, which is nearly as good as trying every tri and much
+ * quicker on big meshes.
+ */
 void BVHTree::BuildNode(BVHNode *node,
 			const objPtr_t *objPtrs,
 			const Aabb *objAabbs,
-			std::vector<objPtr_t> &activeObjIdx)
+			std::vector<objPtr_t> &activeObjIdx,
+			int depth)
 {
 	const int numTris = activeObjIdx.size();
 	if (numTris <= 0) Error("BuildNode called with no elements in activeObjIndex.");
 
-	if (numTris == 1) {
-		MakeLeaf(node, objPtrs, activeObjIdx);
-		return;
-	}
-
-	std::vector<int> splitSides(numTris);
-
-	Aabb aabb;
-	aabb.min = vector3d(FLT_MAX, FLT_MAX, FLT_MAX);
-	aabb.max = vector3d(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Aabb aabb, centres;
+	aabb.min = centres.min = vector3d(FLT_MAX, FLT_MAX, FLT_MAX);
+	aabb.max = centres.max = vector3d(-FLT_MAX, -FLT_MAX, -FLT_MAX);
 
 	for (int i=0; i<numTris; i++) {
-		int idx = activeObjIdx[i];
-		aabb.Update(objAabbs[idx].min);
-		aabb.Update(objAabbs[idx].max);
+		const Aabb &objAabb = objAabbs[activeObjIdx[i]];
+		Grow(aabb, objAabb);
+		const vector3d mid = 0.5 * (objAabb.min + objAabb.max);
+		Aabb midAabb;
+		midAabb.min = midAabb.max = mid;
+		Grow(centres, midAabb);
 	}
+	// leaves need their box too, the QBVH and edge collisions test them
 	node->numTris = numTris;
 	node->aabb = aabb;
 
-	Aabb splitBox = aabb;
-	double splitPos;
-	int splitAxis;
-	int s1count, s2count;
-	int attempt = 0;
-
-	for (;;) {
-		splitAxis = 0;
-
-		vector3d boxSize = splitBox.max - splitBox.min;
+	if (numTris == 1 || depth >= MAX_DEPTH) {
+		MakeLeaf(node, objPtrs, activeObjIdx);
+		return;
+	}
 
-		if (boxSize[1] > boxSize[0]) splitAxis = 1;
-		if ((boxSize[2] > boxSize[1]) && (boxSize[2] > boxSize[0])) splitAxis = 2;
+	struct Bin {
+		Aabb aabb;
+		int count;
+	};
 
-		// split pos in middle of splitBox
-		splitPos = 0.5f * (splitBox.min[splitAxis] + splitBox.max[splitAxis]);
-		s1count = 0, s2count = 0;
+	double bestCost = DBL_MAX;
+	int bestAxis = -1, bestBin = 0;
+	for (int axis=0; axis<3; axis++) {
+		const double extent = centres.max[axis] - centres.min[axis];
+		if (extent <= 0.0) continue;
+		const double scale = SAH_BINS / extent;
 
+		Bin bins[SAH_BINS];
+		for (int b=0; b<SAH_BINS; b++) bins[b].count = 0;
 		for (int i=0; i<numTris; i++) {
-			int idx = activeObjIdx[i];
-			double mid = 0.5 * (objAabbs[idx].min[splitAxis] + objAabbs[idx].max[splitAxis]);
-			if (mid < splitPos) {
-				splitSides[i] = 0;
-				s1count++;
-			} else {
-				splitSides[i] = 1;
-				s2count++;
-			}
+			const Aabb &objAabb = objAabbs[activeObjIdx[i]];
+			const double mid = 0.5 * (objAabb.min[axis] + objAabb.max[axis]);
+			const int b = std::min(int((mid - centres.min[axis]) * scale), SAH_BINS-1);
+			bins[b].count++;
+			Grow(bins[b].aabb, objAabb);
 		}
 
-		if (s1count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.max[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
-			}
-		} else if (s2count == numTris) {
-			if (attempt < MAX_SPLITPOS_RETRIES) {
-				// try splitting at average point
-				splitBox.min[splitAxis] = splitPos;
-				attempt++;
-				continue;
-			} else {
-				MakeLeaf(node, objPtrs, activeObjIdx);
-				return;
+		// area and count of everything right of each split, then sweep
+		// back from the left to cost each split
+		double rightArea[SAH_BINS];
+		int rightCount[SAH_BINS];
+		Aabb acc;
+		int count = 0;
+		for (int b=SAH_BINS-1; b>0; b--) {
+			Grow(acc, bins[b].aabb);
+			count += bins[b].count;
+			rightArea[b] = count ? SurfaceArea(acc) : 0.0;
+			rightCount[b] = count;
+		}
+		acc = Aabb();
+		count = 0;
+		for (int b=0; b<SAH_BINS-1; b++) {
+			Grow(acc, bins[b].aabb);
+			count += bins[b].count;
+			if (!count || !rightCount[b+1]) continue;
+			const double cost = SurfaceArea(acc)*count + rightArea[b+1]*rightCount[b+1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
 			}
 		}
-		break;
+	}
+
+	// all the tri centres in the same place, nothing will split them
+	if (bestAxis < 0) {
+		MakeLeaf(node, objPtrs, activeObjIdx);
+		return;
+	}
+
+	// costs in tri tests, a box test costing about the same as a tri
+	const double area = SurfaceArea(aabb);
+	const double splitCost = area > 0.0 ? 1.0 + bestCost / area : 1.0;
+	if (numTris <= MAX_LEAF_TRIS && splitCost >= double(numTris)) {
+		MakeLeaf(node, objPtrs, activeObjIdx);
+		return;
 	}
 
 	std::vector<int> side[2];
 
+	const double scale = SAH_BINS / (centres.max[bestAxis] - centres.min[bestAxis]);
 	for (int i=0; i<numTris; i++) {
-		side[splitSides[i]].push_back(activeObjIdx[i]);
+		const Aabb &objAabb = objAabbs[activeObjIdx[i]];
+		const double mid = 0.5 * (objAabb.min[bestAxis] + objAabb.max[bestAxis]);
+		const int b = std::min(int((mid - centres.min[bestAxis]) * scale), SAH_BINS-1);
+		side[b <= bestBin ? 0 : 1].push_back(activeObjIdx[i]);
 	}
 
 	// recurse!
@@ -136,6 +236,6 @@ void BVHTree::BuildNode(BVHNode *node,
 	node->kids[0] = AllocNode();
 	node->kids[1] = AllocNode();
 
-	BuildNode(node->kids[0], objPtrs, objAabbs, side[0]);
-	BuildNode(node->kids[1], objPtrs, objAabbs, side[1]);
-}
\ No newline at end of file
+	BuildNode(node->kids[0], objPtrs, objAabbs, side[0], depth+1);
+	BuildNode(node->kids[1], objPtrs, objAabbs, side[1], depth+1);
+}
@@ -9,6 +9,7 @@
 #include "../vector3.h"
 #include "../Aabb.h"
 #include "../utils.h"
+#include "../Serializer.h"
 
 struct BVHNode {
 	Aabb aabb;
@@ -33,16 +34,27 @@ class BVHTree {
 public:
 	typedef int objPtr_t;
 	BVHTree(int numObjs, const objPtr_t *objPtrs, const Aabb *objAabbs);
+	// a tree written by Save(), as it was, without building it again
+	BVHTree(Serializer::Reader &rd);
+	void Save(Serializer::Writer &wr) const;
 	~BVHTree() {
 		delete [] m_objPtrAlloc;
 		delete [] m_bvhNodes;
 	}
 	BVHNode *GetRoot() { return m_root; }
+	const BVHNode *GetRoot() const { return m_root; }
 private:
+	// deeper than this everything left goes in one leaf, so trees always
+	// fit the fixed traversal stacks
+	static const int MAX_DEPTH = 48;
+	static const int MAX_LEAF_TRIS = 4;
+	static const int SAH_BINS = 12;
+
 	void BuildNode(BVHNode *node,
 			const objPtr_t *objPtrs,
 			const Aabb *objAabbs,
-			std::vector<objPtr_t> &activeObjIdxs);
+			std::vector<objPtr_t> &activeObjIdxs,
+			int depth);
 	void MakeLeaf(BVHNode *node, const objPtr_t *objPtrs, std::vector<objPtr_t> &objs);
 	BVHNode *AllocNode() {
 		if (m_nodeAllocPos >= m_nodeAllocMax) Error("Out of space in m_bvhNodes.");
@@ -262,10 +262,39 @@ void CollisionSpace::CollideRaySphere(const vector3d &start, const vector3d &dir
 	}
 }
 
-void CollisionSpace::TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, Geom *ignore)
+void CollisionSpace::TraceRayGeom(Geom *g, const vector3d &start, const vector3d &dir, double len, CollisionContact *c)
+{
+	const matrix4x4d &invTrans = g->GetInvTransform();
+	vector3d ms = invTrans * start;
+	vector3d md = invTrans.ApplyRotationOnly(dir);
+	vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
+	vector3f modelDir = vector3f(md.x, md.y, md.z);
+
+	isect_t isect;
+	isect.dist = float(c->dist);
+	isect.triIdx = -1;
+	g->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
+	if (isect.triIdx != -1) {
+		c->pos = start + dir*double(isect.dist);
+
+		vector3f n = g->GetGeomTree()->GetTriNormal(isect.triIdx);
+		c->normal = vector3d(n.x, n.y, n.z);
+		c->normal = g->GetTransform().ApplyRotationOnly(c->normal);
+
+		c->depth = len - isect.dist;
+		c->triIdx = isect.triIdx;
+		c->userData1 = g->GetUserData();
+		c->userData2 = 0;
+		c->geomFlag = g->GetGeomTree()->GetTriFlag(isect.triIdx);
+		c->dist = isect.dist;
+	}
+}
+
+void CollisionSpace::TraceRayStatic(const vector3d &start, const vector3d &dir, double len, CollisionContact *c)
 {
+	if (!m_staticObjectTree) return;
+
 	vector3d invDir(1.0/dir.x, 1.0/dir.y, 1.0/dir.z);
-	c->dist = len;
 
 	BvhNode *vn_stack[16];
 	BvhNode *node = m_staticObjectTree->m_root;
@@ -283,34 +312,8 @@ void CollisionSpace::TraceRay(const vector3d &start, const vector3d &dir, double
 		if (node->geomStart) {
 			// it is a leaf node
 			// collide with all geoms
-			for (int i=0; i<node->numGeoms; i++) {
-				Geom *g = node->geomStart[i];
-
-				const matrix4x4d &invTrans = g->GetInvTransform();
-				vector3d ms = invTrans * start;
-				vector3d md = invTrans.ApplyRotationOnly(dir);
-				vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
-				vector3f modelDir = vector3f(md.x, md.y, md.z);
-
-				isect_t isect;
-				isect.dist = float(c->dist);
-				isect.triIdx = -1;
-				g->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
-				if (isect.triIdx != -1) {
-					c->pos = start + dir*double(isect.dist);
-
-					vector3f n = g->GetGeomTree()->GetTriNormal(isect.triIdx);
-					c->normal = vector3d(n.x, n.y, n.z);
-					c->normal = g->GetTransform().ApplyRotationOnly(c->normal);
-
-					c->depth = len - isect.dist;
-					c->triIdx = isect.triIdx;
-					c->userData1 = g->GetUserData();
-					c->userData2 = 0;
-					c->geomFlag = g->GetGeomTree()->GetTriFlag(isect.triIdx);
-					c->dist = isect.dist;
-				}
-			}
+			for (int i=0; i<node->numGeoms; i++)
+				TraceRayGeom(node->geomStart[i], start, dir, len, c);
 		} else if (node->kids[0]) {
 			vn_stack[++stackPos] = node->kids[0];
 			node = node->kids[1];
@@ -320,50 +323,85 @@ pop_jizz:
 		if (stackPos < 0) break;
 		node = vn_stack[stackPos--];
 	}
+}
+
+void CollisionSpace::TraceRayPlanet(const vector3d &start, const vector3d &dir, double len, CollisionContact *c)
+{
+	isect_t isect;
+	isect.dist = float(c->dist);
+	isect.triIdx = -1;
+	CollideRaySphere(start, dir, &isect);
+	if (isect.triIdx != -1) {
+		c->pos = start + dir*double(isect.dist);
+		c->normal = vector3d(0.0);
+		c->depth = len - isect.dist;
+		c->triIdx = -1;
+		c->userData1 = sphere.userData;
+		c->userData2 = 0;
+		c->geomFlag = 0;
+	}
+}
+
+void CollisionSpace::TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, Geom *ignore)
+{
+	c->dist = len;
+
+	TraceRayStatic(start, dir, len, c);
 
 	for (std::list<Geom*>::iterator i = m_geoms.begin(); i != m_geoms.end(); ++i) {
 		if ((*i) == ignore) continue;
-		if ((*i)->IsEnabled()) {
-			const matrix4x4d &invTrans = (*i)->GetInvTransform();
-			vector3d ms = invTrans * start;
-			vector3d md = invTrans.ApplyRotationOnly(dir);
-			vector3f modelStart = vector3f(ms.x, ms.y, ms.z);
-			vector3f modelDir = vector3f(md.x, md.y, md.z);
+		if ((*i)->IsEnabled())
+			TraceRayGeom(*i, start, dir, len, c);
+	}
 
-			isect_t isect;
-			isect.dist = float(c->dist);
-			isect.triIdx = -1;
-			(*i)->GetGeomTree()->TraceRay(modelStart, modelDir, &isect);
-			if (isect.triIdx != -1) {
-				c->pos = start + dir*double(isect.dist);
-
-				vector3f n = (*i)->GetGeomTree()->GetTriNormal(isect.triIdx);
-				c->normal = vector3d(n.x, n.y, n.z);
-				c->normal = (*i)->GetTransform().ApplyRotationOnly(c->normal);
-
-				c->depth = len - isect.dist;
-				c->triIdx = isect.triIdx;
-				c->userData1 = (*i)->GetUserData();
-				c->userData2 = 0;
-				c->geomFlag = (*i)->GetGeomTree()->GetTriFlag(isect.triIdx);
-				c->dist = isect.dist;
-			}
-		}
+	TraceRayPlanet(start, dir, len, c);
+}
+
+void CollisionSpace::TraceRays(int count, const vector3d *starts, const vector3d *dirs, const double *lens, CollisionContact *contacts)
+{
+	PROFILE_SCOPED()
+	if (count <= 0) return;
+
+	// box around every ray in the batch
+	Aabb rayAabb;
+	rayAabb.min = rayAabb.max = starts[0];
+	for (int r=0; r<count; r++) {
+		rayAabb.Update(starts[r]);
+		rayAabb.Update(starts[r] + dirs[r]*lens[r]);
 	}
-	{
-		isect_t isect;
-		isect.dist = float(c->dist);
-		isect.triIdx = -1;
-		CollideRaySphere(start, dir, &isect);
-		if (isect.triIdx != -1) {
-			c->pos = start + dir*double(isect.dist);
-			c->normal = vector3d(0.0);
-			c->depth = len - isect.dist;
-			c->triIdx = -1;
-			c->userData1 = sphere.userData;
-			c->userData2 = 0;
-			c->geomFlag = 0;
+
+	// only geoms that poke into it are worth looking at
+	m_rayGeoms.clear();
+	for (std::list<Geom*>::iterator i = m_geoms.begin(); i != m_geoms.end(); ++i) {
+		if (!(*i)->IsEnabled()) continue;
+		const vector3d pos = (*i)->GetPosition();
+		const double rad = (*i)->GetGeomTree()->GetRadius();
+		Aabb geomAabb;
+		geomAabb.min = pos - vector3d(rad, rad, rad);
+		geomAabb.max = pos + vector3d(rad, rad, rad);
+		if (geomAabb.Intersects(rayAabb))
+			m_rayGeoms.push_back(*i);
+	}
+
+	for (int r=0; r<count; r++) {
+		const vector3d &start = starts[r];
+		const vector3d &dir = dirs[r];
+		const double len = lens[r];
+		CollisionContact *c = &contacts[r];
+		c->dist = len;
+
+		TraceRayStatic(start, dir, len, c);
+
+		for (Geom *g : m_rayGeoms) {
+			// closest approach of the segment to the geom's bounding sphere
+			const vector3d toGeom = g->GetPosition() - start;
+			const double along = Clamp(toGeom.Dot(dir), 0.0, len);
+			const double rad = g->GetGeomTree()->GetRadius();
+			if ((toGeom - dir*along).LengthSqr() > rad*rad) continue;
+			TraceRayGeom(g, start, dir, len, c);
 		}
+
+		TraceRayPlanet(start, dir, len, c);
 	}
 }
 
@@ -418,3 +456,81 @@ void CollisionSpace::Collide(void (*callback)(CollisionContact*))
 		CollideGeoms(*i, mailboxMin, callback);
 	}
 }
+
+void CollisionSpace::CollideStatic(Geom *g, void (*callback)(CollisionContact*))
+{
+	if (!g->IsEnabled()) return;
+	if (m_needStaticGeomRebuild) {
+		if (m_staticObjectTree) delete m_staticObjectTree;
+		m_staticObjectTree = new BvhTree(m_staticGeoms);
+		m_needStaticGeomRebuild = false;
+	}
+
+	const vector3d pos = g->GetPosition();
+	const double radius = g->GetGeomTree()->GetRadius();
+	Aabb aabb;
+	aabb.min = pos - vector3d(radius, radius, radius);
+	aabb.max = pos + vector3d(radius, radius, radius);
+
+	if (m_staticObjectTree) m_staticObjectTree->CollideGeom(g, aabb, 0, callback);
+	if (sphere.radius > 0.0) g->CollideSphere(sphere, callback);
+}
+
+void CollisionSpace::SweepGeomPair(Geom *g, Geom *g2, const vector3d &motion, double &fraction, CollisionContact *c)
+{
+	if (g2 == g || !g2->IsEnabled()) return;
+	if (g->GetGroup() && g2->GetGroup() == g->GetGroup()) return;
+
+	const vector3d rel = motion - g2->GetMotion();
+	const double len = rel.Length();
+	if (len <= 0.0) return;
+
+	// bounding spheres first, closest approach over the part of the step left
+	const vector3d toG2 = g2->GetPosition() - g->GetPosition();
+	const double along = Clamp(toG2.Dot(rel) / len, 0.0, len*fraction);
+	const double rad = g->GetGeomTree()->GetRadius() + g2->GetGeomTree()->GetRadius();
+	if ((toG2 - rel*(along/len)).LengthSqr() > rad*rad) return;
+
+	CollisionContact hit;
+	if (!g->Sweep(g2, rel*fraction, &hit)) return;
+	fraction = hit.dist / len;
+	*c = hit;
+}
+
+double CollisionSpace::SweepGeom(Geom *g, const vector3d &motion, CollisionContact *c)
+{
+	PROFILE_SCOPED()
+	double fraction = 1.0;
+	if (!g->IsEnabled()) return fraction;
+
+	// box round the bounding sphere's path
+	const vector3d pos = g->GetPosition();
+	const double radius = g->GetGeomTree()->GetRadius();
+	Aabb path;
+	path.min = path.max = pos;
+	path.Update(pos + motion);
+	path.min -= vector3d(radius);
+	path.max += vector3d(radius);
+
+	if (m_staticObjectTree && m_staticObjectTree->m_root) {
+		BvhNode *stack[16];
+		int stackPos = 0;
+		stack[0] = m_staticObjectTree->m_root;
+		while (stackPos >= 0) {
+			BvhNode *node = stack[stackPos--];
+			if (!path.Intersects(node->aabb)) continue;
+			if (node->geomStart) {
+				for (int i=0; i<node->numGeoms; i++)
+					SweepGeomPair(g, node->geomStart[i], motion, fraction, c);
+			} else if (node->kids[0]) {
+				stack[++stackPos] = node->kids[0];
+				stack[++stackPos] = node->kids[1];
+			}
+		}
+	}
+
+	for (std::list<Geom*>::iterator i = m_geoms.begin(); i != m_geoms.end(); ++i)
+		SweepGeomPair(g, *i, motion, fraction, c);
+
+	return fraction;
+}
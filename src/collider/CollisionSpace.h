@@ -5,6 +5,7 @@
 #define _COLLISION_SPACE
 
 #include <list>
+#include <vector>
 #include "../vector3.h"
 
 class Geom;
@@ -31,7 +32,21 @@ public:
 	void AddStaticGeom(Geom*);
 	void RemoveStaticGeom(Geom*);
 	void TraceRay(const vector3d &start, const vector3d &dir, double len, CollisionContact *c, Geom *ignore = 0);
+	// Trace a batch of rays (eg all the laser bolts in a frame). Dynamic
+	// geoms that can't be reached by any of them are dropped once up front,
+	// and each ray only tests the remaining geoms whose bounding sphere it
+	// passes through. Results are as if TraceRay was called for each.
+	void TraceRays(int count, const vector3d *starts, const vector3d *dirs, const double *lens, CollisionContact *contacts);
 	void Collide(void (*callback)(CollisionContact*));
+	// Collide() for one geom against just the static geoms and the planet
+	// sphere, for a body taking extra steps between everyone else's
+	void CollideStatic(Geom *g, void (*callback)(CollisionContact*));
+	// Where g first touches another geom if it moves by motion this step and
+	// the others by their Geom::GetMotion(), for things moving too fast for
+	// Collide() to catch. Returns the fraction of the step it gets through
+	// untouched, 1 if all of it, and fills in c if less. Not the planet
+	// sphere, there's no getting through that between steps.
+	double SweepGeom(Geom *g, const vector3d &motion, CollisionContact *c);
 	void SetSphere(const vector3d &pos, double radius, void *user_data) {
 		sphere.pos = pos; sphere.radius = radius; sphere.userData = user_data;
 	}
@@ -46,12 +61,17 @@ public:
 private:
 	void CollideGeoms(Geom *a, int minMailboxValue, void (*callback)(CollisionContact*));
 	void CollideRaySphere(const vector3d &start, const vector3d &dir, isect_t *isect);
+	void TraceRayStatic(const vector3d &start, const vector3d &dir, double len, CollisionContact *c);
+	void TraceRayPlanet(const vector3d &start, const vector3d &dir, double len, CollisionContact *c);
+	static void TraceRayGeom(Geom *g, const vector3d &start, const vector3d &dir, double len, CollisionContact *c);
+	static void SweepGeomPair(Geom *g, Geom *g2, const vector3d &motion, double &fraction, CollisionContact *c);
 	std::list<Geom*> m_geoms;
 	std::list<Geom*> m_staticGeoms;
 	bool m_needStaticGeomRebuild;
 	BvhTree *m_staticObjectTree;
 	BvhTree *m_dynamicObjectTree;
 	Sphere sphere;
+	std::vector<Geom*> m_rayGeoms;	// TraceRays scratch
 
 	static int s_nextHandle;
 };
@@ -6,6 +6,7 @@
 #include "GeomTree.h"
 #include "collider.h"
 #include "BVHTree.h"
+#include "QBVH.h"
 
 static const unsigned int MAX_CONTACTS = 8;
 
@@ -15,6 +16,7 @@ Geom::Geom(const GeomTree *geomtree)
 	m_orient = matrix4x4d::Identity();
 	m_invOrient = matrix4x4d::Identity();
 	m_active = true;
+	m_motion = vector3d(0.0);
 	m_data = 0;
 	m_mailboxIndex = 0;
 	m_group = 0;
@@ -93,7 +95,7 @@ void Geom::Collide(Geom *b, void (*callback)(CollisionContact*))
 //	Output("%d 'rays' in %dms (%f rps)\n", numEdges, t, 1000.0*numEdges / (double)t);
 }
 
-static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &b)
+static Aabb rotatedAabb(const Aabb &a, const matrix4x4d &transA)
 {
 	Aabb arot;
 	vector3d p[8];
@@ -107,75 +109,75 @@ static bool rotatedAabbIsectsNormalOne(Aabb &a, const matrix4x4d &transA, Aabb &
 	p[7] = transA * vector3d(a.max.x, a.max.y, a.max.z);
 	arot.min = arot.max = p[0];
 	for (int i=1; i<8; i++) arot.Update(p[i]);
-	return b.Intersects(arot);
+	return arot;
 }
 
 /*
- * Intersect this Geom's edge BVH tree with geom b's triangle BVH tree.
+ * Intersect this Geom's edge BVH tree with geom b's triangle QBVH.
  * Generate collision contacts.
  */
 void Geom::CollideEdgesWithTrisOf(int &maxContacts, Geom *b, const matrix4x4d &transTo, void (*callback)(CollisionContact*))
 {
+	static const int STACK_SIZE = 64;
 	struct stackobj {
-		BVHNode *edgeNode;
-		BVHNode *triNode;
-	} stack[32];
+		const BVHNode *edgeNode;
+		Uint32 triNode;
+	} stack[STACK_SIZE];
 	int stackpos = 0;
 
+	const QBVH *btris = b->GetGeomTree()->m_triQTree;
 	stack[0].edgeNode = GetGeomTree()->m_edgeTree->GetRoot();
-	stack[0].triNode = b->GetGeomTree()->m_triTree->GetRoot();
+	stack[0].triNode = QBVH::ROOT;
 
 	while ((stackpos >= 0) && (maxContacts > 0)) {
-		BVHNode *edgeNode = stack[stackpos].edgeNode;
-		BVHNode *triNode = stack[stackpos].triNode;
+		const BVHNode *edgeNode = stack[stackpos].edgeNode;
+		const Uint32 triNode = stack[stackpos].triNode;
 		stackpos--;
 
-		// does the edgeNode (with its aabb described in 6 planes transformed and rotated to
-		// b's coordinates) intersect with one or other of b's child nodes?
-		if (triNode->triIndicesStart || edgeNode->triIndicesStart) {
-			// reached triangle leaf node or edge leaf node.
-			// Intersect all edges under edgeNode with this leaf
+		if (edgeNode->IsLeaf() || stackpos + 2 >= STACK_SIZE) {
+			// reached edge leaf node (or ran out of stack).
+			// Intersect all edges under edgeNode with triNode
 			CollideEdgesTris(maxContacts, edgeNode, transTo, b, triNode, callback);
-		} else {
-			BVHNode *left = triNode->kids[0];
-			BVHNode *right = triNode->kids[1];
-			bool edgeNodeIsectsLeftChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, left->aabb);
-			bool edgeNodeIsectsRightChild = rotatedAabbIsectsNormalOne(edgeNode->aabb, transTo, right->aabb);
-			//edgeNodeIsectsRightChild = edgeNodeIsectsLeftChild = true;
-			if (edgeNodeIsectsRightChild) {
-				if (edgeNodeIsectsLeftChild) {
-					// isects both. split edgeNode and try again
-					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[0];
-					stack[stackpos].triNode = triNode;
-					++stackpos;
-					stack[stackpos].edgeNode = edgeNode->kids[1];
-					stack[stackpos].triNode = triNode;
-				} else {
-					// hits only right child. go down into that
-					// side with same edge node
-					++stackpos;
-					stack[stackpos].edgeNode = edgeNode;
-					stack[stackpos].triNode = triNode->kids[1];
-				}
-			} else if (edgeNodeIsectsLeftChild) {
-				// hits only left child
+			continue;
+		}
+
+		// which of triNode's kids does the edgeNode (its aabb rotated into
+		// b's coordinates) intersect with?
+		const int hits = btris->OverlapMask(triNode, rotatedAabb(edgeNode->aabb, transTo));
+		if (!hits) continue;
+
+		const bool oneKid = !(hits & (hits-1));
+		if (oneKid) {
+			int kid = 0;
+			while (!(hits & (1<<kid))) kid++;
+			const Uint32 child = btris->GetNode(triNode).child[kid];
+			if (QBVH::IsLeaf(child)) {
+				// only a triangle leaf, trace the edges from here
+				CollideEdgesTris(maxContacts, edgeNode, transTo, b, triNode, callback);
+			} else {
+				// go down into that side with same edge node
 				++stackpos;
 				stack[stackpos].edgeNode = edgeNode;
-				stack[stackpos].triNode = triNode->kids[0];
-			} else {
-				// hits none
+				stack[stackpos].triNode = child;
 			}
+		} else {
+			// isects several. split edgeNode and try again
+			++stackpos;
+			stack[stackpos].edgeNode = edgeNode->kids[0];
+			stack[stackpos].triNode = triNode;
+			++stackpos;
+			stack[stackpos].edgeNode = edgeNode->kids[1];
+			stack[stackpos].triNode = triNode;
 		}
 	}
 }
 
 /*
  * Collide one edgeNode (all edges below it) of this Geom with the triangle
- * BVH of another geom (b), starting from btriNode.
+ * QBVH of another geom (b), starting from btriNode.
  */
 void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const matrix4x4d &transToB,
-		Geom *b, const BVHNode *btriNode, void (*callback)(CollisionContact*))
+		Geom *b, Uint32 btriNode, void (*callback)(CollisionContact*))
 {
 	if (maxContacts <= 0) return;
 	if (edgeNode->triIndicesStart) {
@@ -226,3 +228,107 @@ void Geom::CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const mat
 	}
 }
 
+
+/*
+ * Conservative advancement: nothing of this geom can touch b before its
+ * bounding sphere does, so skip to there, then trace each of our corners
+ * forward through b's triangles and each of b's corners near the path back
+ * through ours. The nearest of those is where the meshes first meet.
+ */
+bool Geom::Sweep(Geom *b, const vector3d &motion, CollisionContact *c)
+{
+	const double len = motion.Length();
+	if (len <= 0.0) return false;
+	const vector3d dir = motion * (1.0/len);
+	const double radius = m_geomtree->GetRadius();
+
+	// in b's coords
+	const matrix4x4d transToB = b->m_invOrient * m_orient;
+	const vector3d bDir = b->m_invOrient.ApplyRotationOnly(dir);
+	const vector3f bDirf(bDir);
+	const vector3d bCentre = b->m_invOrient * GetPosition();
+
+	isect_t isect;
+	isect.dist = float(len);
+	isect.triIdx = -1;
+	b->m_geomtree->SweepSphere(vector3f(bCentre), bDirf, float(radius), &isect);
+	if (isect.triIdx == -1) return false;
+	// a little short of it, for float error in the sweep
+	const double advance = std::max(0.0, double(isect.dist) - 0.01*radius);
+
+	double best = len;
+	int bestTri = -1;
+	bool bestIsOurs = false;
+	vector3d bestPos;	// in b's coords
+
+	const float *verts = m_geomtree->GetVertices();
+	for (int i=0; i<m_geomtree->GetNumVertices(); i++) {
+		const vector3d v = transToB * vector3d(&verts[3*i]) + bDir*advance;
+		isect.dist = float(best - advance);
+		isect.triIdx = -1;
+		b->m_geomtree->TraceRay(vector3f(v), bDirf, &isect);
+		if (isect.triIdx == -1) continue;
+		best = advance + isect.dist;
+		bestTri = isect.triIdx;
+		bestIsOurs = false;
+		bestPos = v + bDir*double(isect.dist);
+	}
+
+	// b's corners anywhere our bounding sphere goes
+	Aabb path;
+	path.min = path.max = bCentre + bDir*advance;
+	path.Update(bCentre + bDir*best);
+	path.min -= vector3d(radius);
+	path.max += vector3d(radius);
+
+	const matrix4x4d transToA = m_invOrient * b->m_orient;
+	const vector3d aDir = -m_invOrient.ApplyRotationOnly(dir);
+	const vector3f aDirf(aDir);
+	const GeomTree::Edge *bEdges = b->m_geomtree->GetEdges();
+	const float *bVerts = b->m_geomtree->GetVertices();
+
+	const BVHNode *stack[64];
+	int stackpos = 0;
+	stack[0] = b->m_geomtree->m_edgeTree->GetRoot();
+	while (stackpos >= 0) {
+		const BVHNode *node = stack[stackpos--];
+		if (!node->aabb.Intersects(path)) continue;
+		if (!node->IsLeaf()) {
+			assert(stackpos + 2 < 64);
+			stack[++stackpos] = node->kids[0];
+			stack[++stackpos] = node->kids[1];
+			continue;
+		}
+		for (int i=0; i<node->numTris; i++) {
+			const GeomTree::Edge &e = bEdges[node->triIndicesStart[i]];
+			const int ends[2] = { e.v1i, e.v2i };
+			for (int j=0; j<2; j++) {
+				const vector3d w(&bVerts[ends[j]]);
+				if (!path.IsIn(w)) continue;
+				isect.dist = float(best - advance);
+				isect.triIdx = -1;
+				m_geomtree->TraceRay(vector3f(transToA * w + aDir*advance), aDirf, &isect);
+				if (isect.triIdx == -1) continue;
+				best = advance + isect.dist;
+				bestTri = isect.triIdx;
+				bestIsOurs = true;
+				bestPos = w;
+			}
+		}
+	}
+
+	if (bestTri == -1) return false;
+
+	const vector3f n = bestIsOurs ? m_geomtree->GetTriNormal(bestTri) : b->m_geomtree->GetTriNormal(bestTri);
+	c->normal = (bestIsOurs ? m_orient : b->m_orient).ApplyRotationOnly(vector3d(n.x, n.y, n.z));
+	// pointing back at us, whichever way the triangle faces
+	if (c->normal.Dot(dir) > 0.0) c->normal = -c->normal;
+	c->pos = b->m_orient * bestPos;
+	c->depth = len - best;
+	c->dist = best;
+	c->triIdx = bestTri;
+	c->userData1 = m_data;
+	c->userData2 = b->m_data;
+	c->geomFlag = bestIsOurs ? m_geomtree->GetTriFlag(bestTri) : b->m_geomtree->GetTriFlag(bestTri);
+	return true;
+}
@@ -27,6 +27,15 @@ public:
 	bool IsEnabled() { return m_active; }
 	const GeomTree *GetGeomTree() { return m_geomtree; }
 	void Collide(Geom *b, void (*callback)(CollisionContact*));
+	// Where this geom, moving by motion (world coords, b standing still and
+	// neither of them turning), first touches b. Fills in c and returns true
+	// if that's before the end of motion, c->dist being how far along it.
+	// Only corners meeting faces are found; edges crossing edges are left to
+	// Collide() once they're through each other.
+	bool Sweep(Geom *b, const vector3d &motion, CollisionContact *c);
+	// how far the geom is going to move this step, for CollisionSpace::SweepGeom()
+	void SetMotion(const vector3d &motion) { m_motion = motion; }
+	const vector3d &GetMotion() const { return m_motion; }
 	void CollideSphere(Sphere &sphere, void (*callback)(CollisionContact*));
 	void SetUserData(void *d) { m_data = d; }
 	void *GetUserData() { return m_data; }
@@ -40,13 +49,14 @@ public:
 private:
 	void CollideEdgesWithTrisOf(int &maxContacts, Geom *b, const matrix4x4d &transTo, void (*callback)(CollisionContact*));
 	void CollideEdgesTris(int &maxContacts, const BVHNode *edgeNode, const matrix4x4d &transToB,
-		Geom *b, const BVHNode *btriNode, void (*callback)(CollisionContact*));
+		Geom *b, Uint32 btriNode, void (*callback)(CollisionContact*));
 	int m_mailboxIndex; // used to avoid duplicate collisions
 	void CollideEdges(const matrix4x4d &transToB, Geom *b, void (*callback)(CollisionContact*));
 	// double-buffer position so we can keep previous position
 	matrix4x4d m_orient, m_invOrient;
 	bool m_active;
 	const GeomTree *m_geomtree;
+	vector3d m_motion;
 	void *m_data;
 	int m_group;
 };
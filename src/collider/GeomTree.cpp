@@ -4,6 +4,9 @@
 #include "../libs.h"
 #include "GeomTree.h"
 #include "BVHTree.h"
+#include "QBVH.h"
+#include "../scenegraph/LoadingError.h"
+#include <memory>
 
 int GeomTree::stats_rayTriIntersections;
 
@@ -18,9 +21,10 @@ GeomTree::~GeomTree()
 	delete[] m_edges;
 	delete m_triTree;
 	delete m_edgeTree;
+	delete m_triQTree;
 }
 
-GeomTree::GeomTree(int numVerts, int numTris, float *vertices, Uint16 *indices, unsigned int *triflags)
+GeomTree::GeomTree(int numVerts, int numTris, float *vertices, Uint32 *indices, unsigned int *triflags)
 : m_numVertices(numVerts)
 , m_numTris(numTris)
 {
@@ -98,6 +102,7 @@ GeomTree::GeomTree(int numVerts, int numTris, float *vertices, Uint16 *indices,
 	//int t = SDL_GetTicks();
 	m_triTree = new BVHTree(activeTris.size(), &activeTris[0], aabbs);
 	delete [] aabbs;
+	m_triQTree = new QBVH(m_triTree->GetRoot(), m_vertices, m_indices);
 	//Output("Tri tree of %d tris build in %dms\n", activeTris.size(), SDL_GetTicks() - t);
 
 	m_numEdges = edges.size();
@@ -135,133 +140,115 @@ GeomTree::GeomTree(int numVerts, int numTris, float *vertices, Uint16 *indices,
 	//Output("Edge tree of %d edges build in %dms\n", m_numEdges, SDL_GetTicks() - t);
 }
 
-static bool SlabsRayAabbTest(const BVHNode *n, const vector3f &start, const vector3f &invDir, isect_t *isect)
+// nothing's kept until it's all been read, so a bad file throws without
+// leaking what came before the bad part
+GeomTree::GeomTree(Serializer::Reader &rd)
+: m_numVertices(rd.Int32())
 {
-	float
-	l1      = (n->aabb.min.x - start.x) * invDir.x,
-	l2      = (n->aabb.max.x - start.x) * invDir.x,
-	lmin    = std::min(l1,l2),
-	lmax    = std::max(l1,l2);
-
-	l1      = (n->aabb.min.y - start.y) * invDir.y;
-	l2      = (n->aabb.max.y - start.y) * invDir.y;
-	lmin    = std::max(std::min(l1,l2), lmin);
-	lmax    = std::min(std::max(l1,l2), lmax);
-
-	l1      = (n->aabb.min.z - start.z) * invDir.z;
-	l2      = (n->aabb.max.z - start.z) * invDir.z;
-	lmin    = std::max(std::min(l1,l2), lmin);
-	lmax    = std::min(std::max(l1,l2), lmax);
-
-	return ((lmax >= 0.f) & (lmax >= lmin) & (lmin < isect->dist));
-}
+	if (m_numVertices < 0) throw SceneGraph::LoadingError("GeomTree vertex count out of range");
+	std::unique_ptr<float[]> vertices(new float[m_numVertices*3]);
+	for (int i=0; i<m_numVertices*3; i++)
+		vertices[i] = rd.Float();
+
+	m_numTris = rd.Int32();
+	if (m_numTris < 0) throw SceneGraph::LoadingError("GeomTree triangle count out of range");
+	std::unique_ptr<Uint32[]> indices(new Uint32[m_numTris*3]);
+	for (int i=0; i<m_numTris*3; i++) {
+		indices[i] = rd.Int32();
+		if (indices[i] >= Uint32(m_numVertices)) throw SceneGraph::LoadingError("GeomTree index out of range");
+	}
+	std::unique_ptr<unsigned int[]> triFlags(new unsigned int[m_numTris]);
+	for (int i=0; i<m_numTris; i++)
+		triFlags[i] = rd.Int32();
+
+	m_radius = rd.Double();
+	m_aabb.min = rd.Vector3d();
+	m_aabb.max = rd.Vector3d();
+	m_aabb.radius = rd.Double();
+
+	m_numEdges = rd.Int32();
+	if (m_numEdges < 0) throw SceneGraph::LoadingError("GeomTree edge count out of range");
+	std::unique_ptr<Edge[]> edges(new Edge[m_numEdges]);
+	for (int i=0; i<m_numEdges; i++) {
+		Edge &e = edges[i];
+		e.v1i = rd.Int32();
+		e.v2i = rd.Int32();
+		e.len = rd.Float();
+		e.dir = rd.Vector3f();
+		e.triFlag = rd.Int32();
+		if (Uint32(e.v1i) + 3 > Uint32(m_numVertices*3) || Uint32(e.v2i) + 3 > Uint32(m_numVertices*3))
+			throw SceneGraph::LoadingError("GeomTree edge out of range");
+	}
 
-void GeomTree::TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const
-{
-	TraceRay(m_triTree->GetRoot(), start, dir, isect);
+	std::unique_ptr<BVHTree> triTree(new BVHTree(rd));
+	std::unique_ptr<BVHTree> edgeTree(new BVHTree(rd));
+	m_triQTree = new QBVH(triTree->GetRoot(), vertices.get(), indices.get());
+
+	m_vertices = vertices.release();
+	m_indices = indices.release();
+	m_triFlags = triFlags.release();
+	m_edges = edges.release();
+	m_triTree = triTree.release();
+	m_edgeTree = edgeTree.release();
 }
 
-void GeomTree::TraceRay(const BVHNode *currnode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
+void GeomTree::Save(Serializer::Writer &wr) const
 {
-	BVHNode *stack[32];
-	int stackpos = -1;
-	vector3f invDir(1.0f/a_dir.x, 1.0f/a_dir.y, 1.0f/a_dir.z);
+	wr.Int32(m_numVertices);
+	for (int i=0; i<m_numVertices*3; i++)
+		wr.Float(m_vertices[i]);
+
+	wr.Int32(m_numTris);
+	for (int i=0; i<m_numTris*3; i++)
+		wr.Int32(m_indices[i]);
+	for (int i=0; i<m_numTris; i++)
+		wr.Int32(m_triFlags[i]);
+
+	wr.Double(m_radius);
+	wr.Vector3d(m_aabb.min);
+	wr.Vector3d(m_aabb.max);
+	wr.Double(m_aabb.radius);
+
+	wr.Int32(m_numEdges);
+	for (int i=0; i<m_numEdges; i++) {
+		const Edge &e = m_edges[i];
+		wr.Int32(e.v1i);
+		wr.Int32(e.v2i);
+		wr.Float(e.len);
+		wr.Vector3f(e.dir);
+		wr.Int32(e.triFlag);
+	}
 
-	for (;;) {
-		while (!currnode->IsLeaf()) {
-			if (!SlabsRayAabbTest(currnode, a_origin, invDir, isect)) goto pop_bstack;
+	m_triTree->Save(wr);
+	m_edgeTree->Save(wr);
+}
 
-			stackpos++;
-			stack[stackpos] = currnode->kids[1];
-			currnode = currnode->kids[0];
-		}
-		// triangle intersection jizz
-		for (int i=0; i<currnode->numTris; i++) {
-			RayTriIntersect(1, a_origin, &a_dir, currnode->triIndicesStart[i], isect);
-		}
-pop_bstack:
-		if (stackpos < 0) break;
-		currnode = stack[stackpos];
-		stackpos--;
-	}
+void GeomTree::TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const
+{
+	m_triQTree->TraceRay(QBVH::ROOT, start, dir, isect);
 }
 
-struct bvhstack {
-	BVHNode *node;
-	int activeRay;
-};
+void GeomTree::TraceRay(Uint32 startNode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const
+{
+	m_triQTree->TraceRay(startNode, a_origin, a_dir, isect);
+}
 
 /*
  * Bundle of rays with common origin
  */
 void GeomTree::TraceCoherentRays(int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const
 {
-	TraceCoherentRays(m_triTree->GetRoot(), numRays, a_origin, a_dirs, isects);
+	m_triQTree->TraceCoherentRays(QBVH::ROOT, numRays, a_origin, a_dirs, isects);
 }
 
-void GeomTree::TraceCoherentRays(const BVHNode *currnode, int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const
+void GeomTree::TraceCoherentRays(Uint32 startNode, int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const
 {
-	bvhstack stack[32];
-	int stackpos = -1;
-	vector3f *invDirs = static_cast<vector3f*>(alloca(sizeof(vector3f)*numRays));
-	for (int i=0; i<numRays; i++) {
-		invDirs[i] = vector3f(1.0f/a_dirs[i].x, 1.0f/a_dirs[i].y, 1.0f/a_dirs[i].z);
-	}
-	int activeRay = numRays - 1;
-
-	for (;;) {
-		while (!currnode->IsLeaf()) {
-			do {
-				if (SlabsRayAabbTest(currnode, a_origin, invDirs[activeRay], &isects[activeRay])) break;
-			} while (activeRay-- > 0);
-			if (activeRay < 0) goto pop_bstack;
-
-			stackpos++;
-			stack[stackpos].node = currnode->kids[1];
-			stack[stackpos].activeRay = activeRay;
-			currnode = currnode->kids[0];
-		}
-		// triangle intersection jizz
-		for (int i=0; i<currnode->numTris; i++) {
-			RayTriIntersect(activeRay+1, a_origin, a_dirs, currnode->triIndicesStart[i], isects);
-		}
-pop_bstack:
-		if (stackpos < 0) break;
-		currnode = stack[stackpos].node;
-		activeRay = stack[stackpos].activeRay;
-		stackpos--;
-	}
+	m_triQTree->TraceCoherentRays(startNode, numRays, a_origin, a_dirs, isects);
 }
 
-void GeomTree::RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const
+void GeomTree::SweepSphere(const vector3f &start, const vector3f &dir, float radius, isect_t *isect) const
 {
-	stats_rayTriIntersections++;
-	const vector3f a(&m_vertices[3*m_indices[triIdx]]);
-	const vector3f b(&m_vertices[3*m_indices[triIdx+1]]);
-	const vector3f c(&m_vertices[3*m_indices[triIdx+2]]);
-
-	vector3f v0_cross, v1_cross, v2_cross;
-	const vector3f n = (c-a).Cross(b-a);
-	const float nominator = n.Dot(a-origin);
-
-	v0_cross = (c-origin).Cross(b-origin);
-	v1_cross = (b-origin).Cross(a-origin);
-	v2_cross = (a-origin).Cross(c-origin);
-
-	for (int i=0; i<numRays; i++) {
-		const float v0d = v0_cross.Dot(dirs[i]);
-		const float v1d = v1_cross.Dot(dirs[i]);
-		const float v2d = v2_cross.Dot(dirs[i]);
-
-		if (((v0d > 0) && (v1d > 0) && (v2d > 0)) ||
-		    ((v0d < 0) && (v1d < 0) && (v2d < 0))) {
-			const float dist = nominator / dirs[i].Dot(n);
-			if ((dist > 0) && (dist < isects[i].dist)) {
-				isects[i].dist = dist;
-				isects[i].triIdx = triIdx/3;
-			}
-		}
-	}
+	m_triQTree->SweepSphere(QBVH::ROOT, start, dir, radius, isect);
 }
 
 vector3f GeomTree::GetTriNormal(int triIdx) const
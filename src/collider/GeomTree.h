@@ -6,6 +6,7 @@
 
 #include "libs.h"
 #include "CollisionContact.h"
+#include "../Serializer.h"
 
 struct isect_t {
 	// triIdx = -1 if no intersection
@@ -14,21 +15,29 @@ struct isect_t {
 };
 
 class BVHTree;
-struct BVHNode;
+class QBVH;
 
 class GeomTree {
 public:
-	GeomTree(int numVerts, int numTris, float *vertices, Uint16 *indices, unsigned int *triflags);
+	GeomTree(int numVerts, int numTris, float *vertices, Uint32 *indices, unsigned int *triflags);
+	// a tree written by Save(), trees and all, without building it again
+	GeomTree(Serializer::Reader &rd);
 	~GeomTree();
+	void Save(Serializer::Writer &wr) const;
 	const Aabb &GetAabb() const { return m_aabb; }
 	// dir should be unit length,
 	// isect.dist should be ray length
 	// isect.triIdx should be -1 unless repeat calls with same isect_t
 	void CollideEdgesWithTrisOf(const GeomTree *other, const matrix4x4d &transTo, void (*callback)(CollisionContact*)) const;
 	void TraceRay(const vector3f &start, const vector3f &dir, isect_t *isect) const;
-	void TraceRay(const BVHNode *startNode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const;
+	// startNode is a node of m_triQTree
+	void TraceRay(Uint32 startNode, const vector3f &a_origin, const vector3f &a_dir, isect_t *isect) const;
 	void TraceCoherentRays(int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const;
-	void TraceCoherentRays(const BVHNode *startNode, int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const;
+	void TraceCoherentRays(Uint32 startNode, int numRays, const vector3f &a_origin, const vector3f *a_dirs, isect_t *isects) const;
+	// a sphere moving along a ray, same contract as TraceRay. isect.dist
+	// comes back as how far its centre gets before touching, 0 if it starts
+	// out touching
+	void SweepSphere(const vector3f &start, const vector3f &dir, float radius, isect_t *isect) const;
 	vector3f GetTriNormal(int triIdx) const;
 	unsigned int GetTriFlag(int triIdx) const { return m_triFlags[triIdx]; }
 	double GetRadius() const { return m_radius; }
@@ -49,23 +58,23 @@ public:
 
 	BVHTree *m_triTree;
 	BVHTree *m_edgeTree;
+	// m_triTree four ways, which is what rays are traced through
+	QBVH *m_triQTree;
 
 	const float *GetVertices() const { return m_vertices; }
-	const Uint16 *GetIndices() const { return m_indices; }
+	const Uint32 *GetIndices() const { return m_indices; }
 	const unsigned int *GetTriFlags() const { return m_triFlags; }
 	int GetNumVertices() const { return m_numVertices; }
 	int GetNumTris() const { return m_numTris; }
 
 private:
-	void RayTriIntersect(int numRays, const vector3f &origin, const vector3f *dirs, int triIdx, isect_t *isects) const;
-
 	double m_radius;
 	Aabb m_aabb;
 
 	int m_numEdges;
 	Edge *m_edges;
 
-	const Uint16 *m_indices;
+	const Uint32 *m_indices;
 	const unsigned int *m_triFlags;
 	int m_numTris;
 };
@@ -0,0 +1,441 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "QBVH.h"
+#include "BVHTree.h"
+#include "GeomTree.h"
+#include "../Simd4.h"
+
+// BVHTree::MAX_DEPTH levels, each pushing at most three more than it pops
+static const int STACK_SIZE = 160;
+
+static double SurfaceArea(const Aabb &a)
+{
+	const vector3d d = a.max - a.min;
+	return 2.0 * (d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+QBVH::QBVH(const BVHNode *root, const float *vertices, const Uint32 *indices)
+: m_vertices(vertices)
+, m_indices(indices)
+{
+	BuildNode(root);
+}
+
+/*
+ * One four way node from a binary node and its descendants: keep opening
+ * up the biggest kid that isn't a leaf until there are four kids.
+ */
+Uint32 QBVH::BuildNode(const BVHNode *bnode)
+{
+	const Uint32 idx = m_nodes.size();
+	m_nodes.push_back(QBVHNode());
+
+	const BVHNode *kids[4];
+	int numKids = 0;
+	if (bnode->IsLeaf()) {
+		// only happens at the root of a tiny mesh
+		kids[numKids++] = bnode;
+	} else {
+		kids[numKids++] = bnode->kids[0];
+		kids[numKids++] = bnode->kids[1];
+		while (numKids < 4) {
+			int best = -1;
+			double bestArea = -1.0;
+			for (int i=0; i<numKids; i++) {
+				if (kids[i]->IsLeaf()) continue;
+				const double area = SurfaceArea(kids[i]->aabb);
+				if (area > bestArea) {
+					best = i;
+					bestArea = area;
+				}
+			}
+			if (best < 0) break;
+			const BVHNode *open = kids[best];
+			kids[best] = open->kids[0];
+			kids[numKids++] = open->kids[1];
+		}
+	}
+
+	// m_nodes grows while the kids are built, so fill in a copy
+	QBVHNode node;
+	memset(&node, 0, sizeof(node));
+	node.numKids = numKids;
+	for (int i=0; i<numKids; i++) {
+		const Aabb &aabb = kids[i]->aabb;
+		node.minX[i] = float(aabb.min.x); node.maxX[i] = float(aabb.max.x);
+		node.minY[i] = float(aabb.min.y); node.maxY[i] = float(aabb.max.y);
+		node.minZ[i] = float(aabb.min.z); node.maxZ[i] = float(aabb.max.z);
+		if (kids[i]->IsLeaf()) {
+			node.child[i] = LEAF | AddPacks(kids[i]);
+			node.numPacks[i] = (kids[i]->numTris + 3) / 4;
+		} else {
+			node.child[i] = BuildNode(kids[i]);
+		}
+	}
+	m_nodes[idx] = node;
+	return idx;
+}
+
+Uint32 QBVH::AddPacks(const BVHNode *leaf)
+{
+	const Uint32 first = m_packs.size();
+	for (int i=0; i<leaf->numTris; i+=4) {
+		QBVHTriPack pack;
+		memset(&pack, 0, sizeof(pack));
+		for (int lane=0; lane<4; lane++) {
+			if (i+lane >= leaf->numTris) {
+				pack.triIdx[lane] = -1;
+				continue;
+			}
+			const int t = leaf->triIndicesStart[i+lane];
+			const float *a = &m_vertices[3*m_indices[t]];
+			const float *b = &m_vertices[3*m_indices[t+1]];
+			const float *c = &m_vertices[3*m_indices[t+2]];
+			pack.v0x[lane] = a[0]; pack.v0y[lane] = a[1]; pack.v0z[lane] = a[2];
+			pack.e1x[lane] = b[0]-a[0]; pack.e1y[lane] = b[1]-a[1]; pack.e1z[lane] = b[2]-a[2];
+			pack.e2x[lane] = c[0]-a[0]; pack.e2y[lane] = c[1]-a[1]; pack.e2z[lane] = c[2]-a[2];
+			pack.triIdx[lane] = t/3;
+		}
+		m_packs.push_back(pack);
+	}
+	return first;
+}
+
+/*
+ * Where the ray enters each of a node's kids (tmin), and which kids it hits
+ * nearer than maxDist.
+ */
+static int SlabsRayQuadTest(const QBVHNode &n, const Simd4f &ox, const Simd4f &oy, const Simd4f &oz,
+	const Simd4f &idx, const Simd4f &idy, const Simd4f &idz, float maxDist, Simd4f &tmin)
+{
+	const Simd4f x1 = (Simd4f::Load(n.minX) - ox) * idx;
+	const Simd4f x2 = (Simd4f::Load(n.maxX) - ox) * idx;
+	const Simd4f y1 = (Simd4f::Load(n.minY) - oy) * idy;
+	const Simd4f y2 = (Simd4f::Load(n.maxY) - oy) * idy;
+	const Simd4f z1 = (Simd4f::Load(n.minZ) - oz) * idz;
+	const Simd4f z2 = (Simd4f::Load(n.maxZ) - oz) * idz;
+
+	tmin = Max(Max(Min(x1, x2), Min(y1, y2)), Min(z1, z2));
+	const Simd4f tmax = Min(Min(Max(x1, x2), Max(y1, y2)), Max(z1, z2));
+
+	return CmpGe(tmax, Simd4f(0.f)) & CmpGe(tmax, tmin) & CmpLt(tmin, Simd4f(maxDist)) & ((1 << n.numKids) - 1);
+}
+
+void QBVH::IntersectPacks(Uint32 firstPack, Uint32 numPacks, const vector3f &origin, const vector3f &dir, isect_t *isect) const
+{
+	GeomTree::stats_rayTriIntersections += 4*numPacks;
+
+	const Simd4f dx(dir.x), dy(dir.y), dz(dir.z);
+	const Simd4f zero(0.f), one(1.f);
+	for (Uint32 i=firstPack; i<firstPack+numPacks; i++) {
+		const QBVHTriPack &p = m_packs[i];
+		const Simd4f e1x = Simd4f::Load(p.e1x), e1y = Simd4f::Load(p.e1y), e1z = Simd4f::Load(p.e1z);
+		const Simd4f e2x = Simd4f::Load(p.e2x), e2y = Simd4f::Load(p.e2y), e2z = Simd4f::Load(p.e2z);
+
+		// p = dir x e2
+		const Simd4f px = dy*e2z - dz*e2y;
+		const Simd4f py = dz*e2x - dx*e2z;
+		const Simd4f pz = dx*e2y - dy*e2x;
+		const Simd4f det = e1x*px + e1y*py + e1z*pz;
+		const Simd4f invDet = one / det;
+
+		const Simd4f tx = Simd4f(origin.x) - Simd4f::Load(p.v0x);
+		const Simd4f ty = Simd4f(origin.y) - Simd4f::Load(p.v0y);
+		const Simd4f tz = Simd4f(origin.z) - Simd4f::Load(p.v0z);
+		const Simd4f u = (tx*px + ty*py + tz*pz) * invDet;
+
+		// q = t x e1
+		const Simd4f qx = ty*e1z - tz*e1y;
+		const Simd4f qy = tz*e1x - tx*e1z;
+		const Simd4f qz = tx*e1y - ty*e1x;
+		const Simd4f v = (dx*qx + dy*qy + dz*qz) * invDet;
+		const Simd4f t = (e2x*qx + e2y*qy + e2z*qz) * invDet;
+
+		// either facing, as RayTriIntersect was
+		int hits = (CmpGt(det, zero) | CmpLt(det, zero)) &
+			CmpGe(u, zero) & CmpGe(v, zero) & CmpLe(u + v, one) &
+			CmpGt(t, zero) & CmpLt(t, Simd4f(isect->dist));
+		if (!hits) continue;
+
+		float dists[4];
+		t.Store(dists);
+		for (int lane=0; lane<4; lane++, hits >>= 1) {
+			if ((hits & 1) && dists[lane] < isect->dist) {
+				isect->dist = dists[lane];
+				isect->triIdx = p.triIdx[lane];
+			}
+		}
+	}
+}
+
+struct qbvhstack {
+	Uint32 child;
+	Uint32 numPacks;
+	float tmin;
+};
+
+void QBVH::TraceRay(Uint32 startNode, const vector3f &origin, const vector3f &dir, isect_t *isect) const
+{
+	qbvhstack stack[STACK_SIZE];
+	int stackpos = 0;
+	stack[0].child = startNode;
+	stack[0].numPacks = 0;
+	stack[0].tmin = 0.f;
+
+	const Simd4f ox(origin.x), oy(origin.y), oz(origin.z);
+	const Simd4f idx(1.0f/dir.x), idy(1.0f/dir.y), idz(1.0f/dir.z);
+
+	while (stackpos >= 0) {
+		const qbvhstack top = stack[stackpos--];
+		// something nearer was hit since this was pushed
+		if (top.tmin >= isect->dist) continue;
+
+		if (IsLeaf(top.child)) {
+			IntersectPacks(top.child & ~LEAF, top.numPacks, origin, dir, isect);
+			continue;
+		}
+
+		const QBVHNode &n = m_nodes[top.child];
+		Simd4f tmin;
+		int hits = SlabsRayQuadTest(n, ox, oy, oz, idx, idy, idz, isect->dist, tmin);
+		if (!hits) continue;
+
+		float t[4];
+		tmin.Store(t);
+		// push the far kids first so the near ones come off the stack first
+		// and shorten the ray for the rest
+		int order[4], numHits = 0;
+		for (int i=0; i<4; i++) {
+			if (!(hits & (1<<i))) continue;
+			int j = numHits++;
+			for (; j > 0 && t[order[j-1]] < t[i]; j--) order[j] = order[j-1];
+			order[j] = i;
+		}
+		assert(stackpos + numHits < STACK_SIZE);
+		for (int j=0; j<numHits; j++) {
+			const int i = order[j];
+			++stackpos;
+			stack[stackpos].child = n.child[i];
+			stack[stackpos].numPacks = n.numPacks[i];
+			stack[stackpos].tmin = t[i];
+		}
+	}
+}
+
+void QBVH::TraceCoherentRays(Uint32 startNode, int numRays, const vector3f &origin, const vector3f *dirs, isect_t *isects) const
+{
+	Uint32 stack[STACK_SIZE];
+	Uint32 packStack[STACK_SIZE];
+	int stackpos = 0;
+	stack[0] = startNode;
+	packStack[0] = 0;
+
+	const Simd4f ox(origin.x), oy(origin.y), oz(origin.z);
+	vector3f *invDirs = static_cast<vector3f*>(alloca(sizeof(vector3f)*numRays));
+	for (int r=0; r<numRays; r++) {
+		invDirs[r] = vector3f(1.0f/dirs[r].x, 1.0f/dirs[r].y, 1.0f/dirs[r].z);
+	}
+
+	while (stackpos >= 0) {
+		const Uint32 child = stack[stackpos];
+		const Uint32 numPacks = packStack[stackpos];
+		stackpos--;
+
+		if (IsLeaf(child)) {
+			for (int r=0; r<numRays; r++)
+				IntersectPacks(child & ~LEAF, numPacks, origin, dirs[r], &isects[r]);
+			continue;
+		}
+
+		const QBVHNode &n = m_nodes[child];
+		int hits = 0;
+		Simd4f tmin;
+		for (int r=0; r<numRays && hits != int((1 << n.numKids) - 1); r++)
+			hits |= SlabsRayQuadTest(n, ox, oy, oz, Simd4f(invDirs[r].x), Simd4f(invDirs[r].y), Simd4f(invDirs[r].z), isects[r].dist, tmin);
+
+		assert(stackpos + 4 < STACK_SIZE);
+		for (int i=3; i>=0; i--) {
+			if (!(hits & (1<<i))) continue;
+			++stackpos;
+			stack[stackpos] = n.child[i];
+			packStack[stackpos] = n.numPacks[i];
+		}
+	}
+}
+
+int QBVH::OverlapMask(Uint32 node, const Aabb &aabb) const
+{
+	const QBVHNode &n = m_nodes[node];
+	// strictly overlapping, as Aabb::Intersects()
+	const int mask =
+		CmpLt(Simd4f::Load(n.minX), Simd4f(float(aabb.max.x))) & CmpGt(Simd4f::Load(n.maxX), Simd4f(float(aabb.min.x))) &
+		CmpLt(Simd4f::Load(n.minY), Simd4f(float(aabb.max.y))) & CmpGt(Simd4f::Load(n.maxY), Simd4f(float(aabb.min.y))) &
+		CmpLt(Simd4f::Load(n.minZ), Simd4f(float(aabb.max.z))) & CmpGt(Simd4f::Load(n.maxZ), Simd4f(float(aabb.min.z)));
+	return mask & ((1 << n.numKids) - 1);
+}
+
+/*
+ * Sphere sweeps. A sphere of radius r moving along a ray touches a triangle
+ * when its centre reaches the triangle grown by r: the face pushed out r
+ * either side, cylinders round the edges and spheres round the corners.
+ * Each test gives the distance along dir where the centre first gets there,
+ * or 0 if it's there already.
+ */
+static bool SweepSphereVertex(const vector3d &start, const vector3d &dir, const vector3d &v, double r, double &t)
+{
+	const vector3d m = start - v;
+	const double c = m.LengthSqr() - r*r;
+	if (c <= 0.0) {
+		t = 0.0;
+		return true;
+	}
+	const double b = m.Dot(dir);
+	if (b >= 0.0) return false;
+	const double disc = b*b - c;
+	if (disc < 0.0) return false;
+	t = -b - sqrt(disc);
+	return true;
+}
+
+static bool SweepSphereEdge(const vector3d &start, const vector3d &dir, const vector3d &p, const vector3d &q, double r, double &t)
+{
+	const vector3d e = q - p;
+	const double ee = e.LengthSqr();
+	if (ee <= 0.0) return false;
+	// everything across the edge, along it doesn't matter until the end
+	const vector3d m = start - p;
+	const vector3d dp = dir - e*(dir.Dot(e)/ee);
+	const vector3d mp = m - e*(m.Dot(e)/ee);
+	const double c = mp.LengthSqr() - r*r;
+	double hit;
+	if (c <= 0.0) {
+		hit = 0.0;
+	} else {
+		const double a = dp.LengthSqr();
+		const double b = mp.Dot(dp);
+		if (a <= 0.0 || b >= 0.0) return false;
+		const double disc = b*b - a*c;
+		if (disc < 0.0) return false;
+		hit = (-b - sqrt(disc)) / a;
+	}
+	// past the ends the corner spheres take over
+	const double s = (m + dir*hit).Dot(e) / ee;
+	if (s < 0.0 || s > 1.0) return false;
+	t = hit;
+	return true;
+}
+
+static bool PointInTriangle(const vector3d &p, const vector3d &a, const vector3d &e1, const vector3d &e2)
+{
+	const vector3d v = p - a;
+	const double d00 = e1.Dot(e1), d01 = e1.Dot(e2), d11 = e2.Dot(e2);
+	const double d20 = v.Dot(e1), d21 = v.Dot(e2);
+	const double denom = d00*d11 - d01*d01;
+	if (denom <= 0.0) return false;
+	const double s = (d11*d20 - d01*d21) / denom;
+	const double u = (d00*d21 - d01*d20) / denom;
+	return s >= 0.0 && u >= 0.0 && s + u <= 1.0;
+}
+
+static bool SweepSphereFace(const vector3d &start, const vector3d &dir, const vector3d &a, const vector3d &e1, const vector3d &e2, double r, double &t)
+{
+	vector3d n = e1.Cross(e2);
+	const double len = n.Length();
+	if (len <= 0.0) return false;
+	n *= 1.0/len;
+
+	// from whichever side the sphere is on
+	const double dist = (start - a).Dot(n);
+	const double side = dist >= 0.0 ? 1.0 : -1.0;
+	double hit;
+	if (fabs(dist) <= r) {
+		hit = 0.0;
+	} else {
+		const double closing = -dir.Dot(n) * side;
+		if (closing <= 0.0) return false;
+		hit = (fabs(dist) - r) / closing;
+	}
+	// where the sphere touches the plane
+	const vector3d p = start + dir*hit - n*(side*std::min(fabs(dist), r));
+	if (!PointInTriangle(p, a, e1, e2)) return false;
+	t = hit;
+	return true;
+}
+
+void QBVH::SweepPacks(Uint32 firstPack, Uint32 numPacks, const vector3d &start, const vector3d &dir, double radius, isect_t *isect) const
+{
+	for (Uint32 i=firstPack; i<firstPack+numPacks; i++) {
+		const QBVHTriPack &p = m_packs[i];
+		for (int lane=0; lane<4; lane++) {
+			if (p.triIdx[lane] < 0) continue;
+			GeomTree::stats_rayTriIntersections++;
+			const vector3d a(p.v0x[lane], p.v0y[lane], p.v0z[lane]);
+			const vector3d e1(p.e1x[lane], p.e1y[lane], p.e1z[lane]);
+			const vector3d e2(p.e2x[lane], p.e2y[lane], p.e2z[lane]);
+			const vector3d b = a + e1, c = a + e2;
+
+			double best = isect->dist, t;
+			// a face hit comes before any edge or corner of the same tri
+			if (SweepSphereFace(start, dir, a, e1, e2, radius, t)) {
+				best = std::min(best, t);
+			} else {
+				if (SweepSphereEdge(start, dir, a, b, radius, t)) best = std::min(best, t);
+				if (SweepSphereEdge(start, dir, b, c, radius, t)) best = std::min(best, t);
+				if (SweepSphereEdge(start, dir, c, a, radius, t)) best = std::min(best, t);
+				if (SweepSphereVertex(start, dir, a, radius, t)) best = std::min(best, t);
+				if (SweepSphereVertex(start, dir, b, radius, t)) best = std::min(best, t);
+				if (SweepSphereVertex(start, dir, c, radius, t)) best = std::min(best, t);
+			}
+			if (best < isect->dist) {
+				isect->dist = float(best);
+				isect->triIdx = p.triIdx[lane];
+			}
+		}
+	}
+}
+
+void QBVH::SweepSphere(Uint32 startNode, const vector3f &start, const vector3f &dir, float radius, isect_t *isect) const
+{
+	Uint32 stack[STACK_SIZE];
+	Uint32 packStack[STACK_SIZE];
+	int stackpos = 0;
+	stack[0] = startNode;
+	packStack[0] = 0;
+
+	const Simd4f ox(start.x), oy(start.y), oz(start.z);
+	const Simd4f idx(1.0f/dir.x), idy(1.0f/dir.y), idz(1.0f/dir.z);
+	const Simd4f r(radius);
+	const vector3d dstart(start), ddir(dir);
+
+	while (stackpos >= 0) {
+		const Uint32 child = stack[stackpos];
+		const Uint32 numPacks = packStack[stackpos];
+		stackpos--;
+
+		if (IsLeaf(child)) {
+			SweepPacks(child & ~LEAF, numPacks, dstart, ddir, radius, isect);
+			continue;
+		}
+
+		// the ray against the kids' boxes grown by the radius
+		const QBVHNode &n = m_nodes[child];
+		const Simd4f x1 = (Simd4f::Load(n.minX) - r - ox) * idx;
+		const Simd4f x2 = (Simd4f::Load(n.maxX) + r - ox) * idx;
+		const Simd4f y1 = (Simd4f::Load(n.minY) - r - oy) * idy;
+		const Simd4f y2 = (Simd4f::Load(n.maxY) + r - oy) * idy;
+		const Simd4f z1 = (Simd4f::Load(n.minZ) - r - oz) * idz;
+		const Simd4f z2 = (Simd4f::Load(n.maxZ) + r - oz) * idz;
+		const Simd4f tmin = Max(Max(Min(x1, x2), Min(y1, y2)), Min(z1, z2));
+		const Simd4f tmax = Min(Min(Max(x1, x2), Max(y1, y2)), Max(z1, z2));
+		const int hits = CmpGe(tmax, Simd4f(0.f)) & CmpGe(tmax, tmin) & CmpLt(tmin, Simd4f(isect->dist)) & ((1 << n.numKids) - 1);
+
+		assert(stackpos + 4 < STACK_SIZE);
+		for (int i=3; i>=0; i--) {
+			if (!(hits & (1<<i))) continue;
+			++stackpos;
+			stack[stackpos] = n.child[i];
+			packStack[stackpos] = n.numPacks[i];
+		}
+	}
+}
@@ -0,0 +1,77 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _QBVH_H
+#define _QBVH_H
+
+#include <vector>
+#include "../Aabb.h"
+
+struct BVHNode;
+struct isect_t;
+
+// Four kids per node, their boxes stored axis by axis so one ray is tested
+// against all four boxes at once. Each node has a row of four floats per
+// box side, and leaves are triangles in fours laid out the same way.
+struct QBVHNode {
+	float minX[4], minY[4], minZ[4];
+	float maxX[4], maxY[4], maxZ[4];
+	// node index, or QBVH::LEAF | first tri pack
+	Uint32 child[4];
+	Uint32 numPacks[4];
+	// kids fill the slots from 0
+	Uint32 numKids;
+};
+
+struct QBVHTriPack {
+	// first vertex and the two edges from it, ready for Moller-Trumbore
+	float v0x[4], v0y[4], v0z[4];
+	float e1x[4], e1y[4], e1z[4];
+	float e2x[4], e2y[4], e2z[4];
+	// -1 in unused lanes, which have zero edges and never hit
+	int triIdx[4];
+};
+
+// The triangle BVH of a GeomTree squashed into four-way nodes, for tracing
+// rays. Built from the binary tree rather than from scratch, so it's cheap
+// enough to redo whenever a GeomTree is loaded.
+class QBVH {
+public:
+	static const Uint32 LEAF = 0x80000000;
+	static const Uint32 ROOT = 0;
+
+	// indices as the GeomTree's, leaf contents are 3*triangle
+	QBVH(const BVHNode *root, const float *vertices, const Uint32 *indices);
+
+	// same contract as GeomTree::TraceRay(), from node startNode down
+	void TraceRay(Uint32 startNode, const vector3f &origin, const vector3f &dir, isect_t *isect) const;
+	// rays with a common origin, a kid is visited if any of them hit it
+	void TraceCoherentRays(Uint32 startNode, int numRays, const vector3f &origin, const vector3f *dirs, isect_t *isects) const;
+	// as TraceRay() but for a sphere of the given radius moving along the
+	// ray, isect->dist is how far its centre gets before it touches (0 if
+	// it's touching already)
+	void SweepSphere(Uint32 startNode, const vector3f &start, const vector3f &dir, float radius, isect_t *isect) const;
+
+	// bit n set for each kid n of node whose box overlaps aabb
+	int OverlapMask(Uint32 node, const Aabb &aabb) const;
+	const QBVHNode &GetNode(Uint32 node) const { return m_nodes[node]; }
+	static bool IsLeaf(Uint32 child) { return (child & LEAF) != 0; }
+
+	size_t GetNumNodes() const { return m_nodes.size(); }
+	size_t GetNumPacks() const { return m_packs.size(); }
+
+private:
+	Uint32 BuildNode(const BVHNode *bnode);
+	Uint32 AddPacks(const BVHNode *leaf);
+	// the nearest hit among a leaf's packs, if nearer than isect->dist
+	void IntersectPacks(Uint32 firstPack, Uint32 numPacks, const vector3f &origin, const vector3f &dir, isect_t *isect) const;
+	void SweepPacks(Uint32 firstPack, Uint32 numPacks, const vector3d &start, const vector3d &dir, double radius, isect_t *isect) const;
+
+	const float *m_vertices;
+	const Uint32 *m_indices;
+
+	std::vector<QBVHNode> m_nodes;
+	std::vector<QBVHTriPack> m_packs;
+};
+
+#endif /* _QBVH_H */
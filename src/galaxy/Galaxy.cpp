@@ -14,24 +14,28 @@ const float GALAXY_RADIUS = 50000.0;
 const float SOL_OFFSET_X = 25000.0;
 const float SOL_OFFSET_Y = 0.0;
 
+static const std::string s_filename("galaxy.bmp");
 static SDL_Surface *s_galaxybmp;
 
-void Init()
+RefCountedPtr<FileSystem::FileData> ReadBitmap()
 {
-	static const std::string filename("galaxy.bmp");
+	RefCountedPtr<FileSystem::FileData> filedata = FileSystem::gameDataFiles.ReadFile(s_filename);
+	if (!filedata)
+		Output("Galaxy: couldn't load '%s'\n", s_filename.c_str());
+	return filedata;
+}
 
-	RefCountedPtr<FileSystem::FileData> filedata = FileSystem::gameDataFiles.ReadFile(filename);
-	if (!filedata) {
-		Output("Galaxy: couldn't load '%s'\n", filename.c_str());
-		Pi::Quit();
-	}
+bool Init(const RefCountedPtr<FileSystem::FileData> &filedata)
+{
+	if (!filedata) return false;
 
 	SDL_RWops *datastream = SDL_RWFromConstMem(filedata->GetData(), filedata->GetSize());
 	s_galaxybmp = SDL_LoadBMP_RW(datastream, 1);
 	if (!s_galaxybmp) {
-		Output("Galaxy: couldn't load: %s (%s)\n", filename.c_str(), SDL_GetError());
-		Pi::Quit();
+		Output("Galaxy: couldn't load: %s (%s)\n", s_filename.c_str(), SDL_GetError());
+		return false;
 	}
+	return true;
 }
 
 void Uninit()
@@ -5,13 +5,20 @@
 #define _GALAXY_H
 
 /* Sector density lookup */
+namespace FileSystem { class FileData; }
+
 namespace Galaxy {
 	// lightyears
 	extern const float GALAXY_RADIUS;
 	extern const float SOL_OFFSET_X;
 	extern const float SOL_OFFSET_Y;
 
-	void Init();
+	// loaded in two halves so the decoding can go to a worker. ReadBitmap
+	// reads galaxy.bmp, and has to be on the main thread: the file system
+	// can't be read from two threads at once. Init decodes it, and returns
+	// false with the reason logged if it couldn't be loaded
+	RefCountedPtr<FileSystem::FileData> ReadBitmap();
+	bool Init(const RefCountedPtr<FileSystem::FileData> &data);
 	void Uninit();
 	SDL_Surface *GetGalaxyBitmap();
 	/* 0 - 255 */
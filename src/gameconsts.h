@@ -32,8 +32,10 @@ static const int	EPOCH_START_YEAR = 2184;
 // 79: +New system hyperspace clouds (3 types of hyperspace clouds instead of 2)
 // 80: Pattern fix
 // 81: Remote docking feature added
+// 82: Laser bolts stored per frame instead of as bodies
+// 83: Ships keep the time they skipped on rails
 static const int  s_baseSaveVersion = 78;		
-static const int  s_latestSaveVersion = 81;		
+static const int  s_latestSaveVersion = 83;		
 
 
 #endif /* _GAMECONSTS_H */
@@ -25,7 +25,9 @@ enum VertexAttribFormat {
 	ATTRIB_FORMAT_FLOAT2,
 	ATTRIB_FORMAT_FLOAT3,
 	ATTRIB_FORMAT_FLOAT4,
-	ATTRIB_FORMAT_UBYTE4
+	ATTRIB_FORMAT_UBYTE4,
+	ATTRIB_FORMAT_SHORT4,	// signed, passed through as is (scale it in the transform)
+	ATTRIB_FORMAT_BYTE4		// signed, normalized to -1..1 (eg normals)
 };
 
 enum BufferUsage {
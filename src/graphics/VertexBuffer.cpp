@@ -15,7 +15,10 @@ Uint32 VertexBufferDesc::GetAttribSize(VertexAttribFormat f)
 	case ATTRIB_FORMAT_FLOAT4:
 		return 16;
 	case ATTRIB_FORMAT_UBYTE4:
+	case ATTRIB_FORMAT_BYTE4:
 		return 4;
+	case ATTRIB_FORMAT_SHORT4:
+		return 8;
 	default:
 		return 0;
 	}
@@ -14,6 +14,8 @@ GLint get_num_components(VertexAttribFormat fmt)
 		return 3;
 	case ATTRIB_FORMAT_FLOAT4:
 	case ATTRIB_FORMAT_UBYTE4:
+	case ATTRIB_FORMAT_SHORT4:
+	case ATTRIB_FORMAT_BYTE4:
 		return 4;
 	default:
 		assert(false);
@@ -26,6 +28,10 @@ GLenum get_component_type(VertexAttribFormat fmt)
 	switch (fmt) {
 	case ATTRIB_FORMAT_UBYTE4:
 		return GL_UNSIGNED_BYTE;
+	case ATTRIB_FORMAT_SHORT4:
+		return GL_SHORT;
+	case ATTRIB_FORMAT_BYTE4:
+		return GL_BYTE;
 	case ATTRIB_FORMAT_FLOAT2:
 	case ATTRIB_FORMAT_FLOAT3:
 	case ATTRIB_FORMAT_FLOAT4:
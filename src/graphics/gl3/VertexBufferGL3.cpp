@@ -15,6 +15,8 @@ GLint get_num_components(VertexAttribFormat fmt)
 		return 3;
 	case ATTRIB_FORMAT_FLOAT4:
 	case ATTRIB_FORMAT_UBYTE4:
+	case ATTRIB_FORMAT_SHORT4:
+	case ATTRIB_FORMAT_BYTE4:
 		return 4;
 	default:
 		assert(false);
@@ -27,6 +29,10 @@ GLenum get_component_type(VertexAttribFormat fmt)
 	switch (fmt) {
 	case ATTRIB_FORMAT_UBYTE4:
 		return GL_UNSIGNED_BYTE;
+	case ATTRIB_FORMAT_SHORT4:
+		return GL_SHORT;
+	case ATTRIB_FORMAT_BYTE4:
+		return GL_BYTE;
 	case ATTRIB_FORMAT_FLOAT2:
 	case ATTRIB_FORMAT_FLOAT3:
 	case ATTRIB_FORMAT_FLOAT4:
@@ -212,6 +218,12 @@ void VertexBuffer::SetAttribPointers(Effect* effect)
 				type = GL_UNSIGNED_BYTE;
 				normalized = true;
 			}
+			// packed formats say for themselves what they hold
+			const VertexAttribFormat fmt = m_desc.attrib[i].format;
+			if (fmt == ATTRIB_FORMAT_SHORT4 || fmt == ATTRIB_FORMAT_BYTE4) {
+				type = get_component_type(fmt);
+				normalized = (fmt == ATTRIB_FORMAT_BYTE4);
+			}
 			glVertexAttribPointer(al, EffectAttributesSizes[ai], type, normalized, m_desc.stride, offset);
 		}
 		m_isSetForEffect = true;
@@ -4,12 +4,14 @@
 #include "libs.h"
 #include "Pi.h"
 #include "ModelViewer.h"
+#include "FileSourceArchive.h"
 #include "utils.h"
 #include <cstdio>
 
 enum RunMode {
 	MODE_GAME,
 	MODE_MODELVIEWER,
+	MODE_PACKDATA,
 	MODE_VERSION,
 	MODE_USAGE,
 	MODE_UNKNOWN
@@ -42,6 +44,11 @@ int main(int argc, char** argv)
 			goto start;
 		}
 
+		if (modeopt == "packdata" || modeopt == "pd") {
+			mode = MODE_PACKDATA;
+			goto start;
+		}
+
 		if (modeopt == "version" || modeopt == "v") {
 			mode = MODE_VERSION;
 			goto start;
@@ -88,6 +95,25 @@ start:
 			break;
 		}
 
+		case MODE_PACKDATA: {
+			const std::string archivePath = (argc > 2) ? argv[2] : FileSystem::GetDataDir() + ".pak";
+			FILE *out = fopen(archivePath.c_str(), "wb");
+			if (!out) {
+				Output("couldn't write %s\n", archivePath.c_str());
+				return 1;
+			}
+			FileSystem::FileSourceFS data(FileSystem::GetDataDir());
+			const bool ok = FileSystem::PackArchive(data, out, FileSystem::NewestModTime(data.GetRoot()));
+			fclose(out);
+			if (!ok) {
+				Output("couldn't pack %s\n", FileSystem::GetDataDir().c_str());
+				remove(archivePath.c_str());
+				return 1;
+			}
+			Output("packed %s into %s\n", FileSystem::GetDataDir().c_str(), archivePath.c_str());
+			break;
+		}
+
 		case MODE_VERSION: {
 			std::string version(PARAGON_VERSION);
 			if (strlen(PARAGON_EXTRAVERSION)) version += " (" PARAGON_EXTRAVERSION ")";
@@ -101,6 +127,7 @@ start:
 				"available modes:\n"
 				"    -game        [-g]     game (default)\n"
 				"    -modelviewer [-mv]    model viewer\n"
+				"    -packdata    [-pd]    pack the data directory into data.pak\n"
 				"    -version     [-v]     show version\n"
 				"    -help        [-h,-?]  this help\n"
 			);
@@ -3,12 +3,15 @@
 
 #include "libs.h"
 #include "FileSystem.h"
+#include "FileSourceArchive.h"
 #include "utils.h"
 #include <cassert>
 #include <algorithm>
 #include <cerrno>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <unistd.h>
 
@@ -244,4 +247,41 @@ namespace FileSystem {
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		return fopen(fullpath.c_str(), (flags & WRITE_TEXT) ? "w" : "wb");
 	}
+
+	MappedFile *MappedFile::Open(const std::string &path)
+	{
+		const int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) return 0;
+		struct stat st;
+		void *data = MAP_FAILED;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+			data = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd); // the mapping keeps the file
+		if (data == MAP_FAILED) return 0;
+		return new MappedFile(static_cast<const char*>(data), st.st_size, 0);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		munmap(const_cast<char*>(m_data), m_size);
+	}
+
+	Uint64 NewestModTime(const std::string &path)
+	{
+		struct stat statinfo;
+		if (stat(path.c_str(), &statinfo) != 0) return 0;
+		Uint64 newest = statinfo.st_mtime;
+		if (!S_ISDIR(statinfo.st_mode)) return newest;
+
+		DIR *dir = opendir(path.c_str());
+		if (!dir) return newest;
+		struct dirent *entry;
+		while ((entry = readdir(dir))) {
+			if (strcmp(entry->d_name, ".") == 0) continue;
+			if (strcmp(entry->d_name, "..") == 0) continue;
+			newest = std::max(newest, NewestModTime(JoinPath(path, entry->d_name)));
+		}
+		closedir(dir);
+		return newest;
+	}
 }
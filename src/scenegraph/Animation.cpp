@@ -3,65 +3,141 @@
 
 #include "Animation.h"
 #include "scenegraph/Model.h"
+#include "NodeCopyCache.h"
 #include <iostream>
+#include <algorithm>
 
 namespace SceneGraph {
 
 typedef std::vector<AnimationChannel> ChannelList;
-typedef ChannelList::iterator ChannelIterator;
+typedef ChannelList::const_iterator ChannelIterator;
 
 Animation::Animation(const std::string &name, double duration)
 : m_duration(duration)
 , m_time(0.0)
+, m_interpolatedTime(-1.0)
 , m_name(name)
+, m_shared(0)
+, m_keyIndexStep(1.0)
 {
 }
 
-Animation::Animation(const Animation &anim)
+Animation::Animation(const Animation &anim, const NodeCopyCache &cache)
 : m_duration(anim.m_duration)
 , m_time(0.0)
+, m_interpolatedTime(-1.0)
 , m_name(anim.m_name)
+, m_shared(anim.m_shared ? anim.m_shared : &anim)
+, m_keyIndexStep(1.0)
 {
-	for(ChannelList::const_iterator chan = anim.m_channels.begin(); chan != anim.m_channels.end(); ++chan) {
-		m_channels.push_back(*chan);
+	const unsigned int numChannels = anim.GetChannels().size();
+	m_targets.reserve(numChannels);
+	for (unsigned int i = 0; i < numChannels; i++)
+		m_targets.push_back(cache.Find(anim.GetTarget(i)));
+}
+
+bool Animation::Update()
+{
+	if (m_time == m_interpolatedTime) return false;
+	Interpolate();
+	return true;
+}
+
+// steps a second in the key index, and at most this many steps in all
+static const double KEY_INDEX_RATE = 30.0;
+static const unsigned int MAX_KEY_INDEX_STEPS = 1024;
+
+template <typename Key>
+static void BuildTrackIndex(const std::vector<Key> &keys, double step, unsigned int numSteps,
+	std::vector<unsigned int> &index)
+{
+	index.resize(numSteps);
+	unsigned int frame = 0;
+	for (unsigned int i = 0; i < numSteps; i++) {
+		const double t = i * step;
+		while (frame + 1 < keys.size() && keys[frame+1].time <= t)
+			frame++;
+		index[i] = frame;
 	}
 }
 
-void Animation::UpdateChannelTargets(Node *root)
+// the last key at or before t, or the first if there isn't one. Carries on
+// from the cursor if t hasn't gone back past it
+template <typename Key>
+static unsigned int FindKey(const std::vector<Key> &keys, const std::vector<unsigned int> &index,
+	double step, double t, unsigned int cursor)
+{
+	unsigned int frame;
+	if (cursor < keys.size() && keys[cursor].time <= t)
+		frame = cursor;
+	else
+		frame = index[std::min(size_t(std::max(t, 0.0) / step), index.size() - 1)];
+	while (frame + 1 < keys.size() && keys[frame+1].time <= t)
+		frame++;
+	return frame;
+}
+
+template <typename Key>
+static float KeyFactor(const Key &a, const Key &b, double t)
 {
-	for(ChannelList::iterator chan = m_channels.begin(); chan != m_channels.end(); ++chan) {
-		//update channels to point to new node structure
-		MatrixTransform *trans = dynamic_cast<MatrixTransform*>(root->FindNode(chan->node->GetName()));
-		assert(trans);
-		chan->node = trans;
+	const double diffTime = b.time - a.time;
+	assert(diffTime > 0.0);
+	return Clamp(float((t - a.time) / diffTime), 0.f, 1.f);
+}
+
+const std::vector<Animation::KeyIndex> &Animation::GetKeyIndex() const
+{
+	if (m_shared) return m_shared->GetKeyIndex();
+	if (m_keyIndex.size() == m_channels.size()) return m_keyIndex;
+
+	const unsigned int numSteps = std::min(MAX_KEY_INDEX_STEPS, unsigned(m_duration * KEY_INDEX_RATE) + 1);
+	m_keyIndexStep = std::max(m_duration / numSteps, 1e-6);
+	m_keyIndex.resize(m_channels.size());
+	for (unsigned int i = 0; i < m_channels.size(); i++) {
+		const AnimationChannel &chan = m_channels[i];
+		KeyIndex &index = m_keyIndex[i];
+		BuildTrackIndex(chan.positionKeys, m_keyIndexStep, numSteps, index.position);
+		BuildTrackIndex(chan.rotationKeys, m_keyIndexStep, numSteps, index.rotation);
+		BuildTrackIndex(chan.scaleKeys, m_keyIndexStep, numSteps, index.scale);
 	}
+	return m_keyIndex;
 }
 
 void Animation::Interpolate()
 {
 	const double mtime = m_time;
+	m_interpolatedTime = mtime;
+
+	const ChannelList &channels = GetChannels();
+	const std::vector<KeyIndex> &keyIndex = GetKeyIndex();
+	const double step = m_shared ? m_shared->m_keyIndexStep : m_keyIndexStep;
+	if (m_cursors.size() != channels.size()) {
+		const KeyCursor start = { 0, 0, 0 };
+		m_cursors.assign(channels.size(), start);
+	}
 
 	//go through channels and calculate transforms
-	for(ChannelIterator chan = m_channels.begin(); chan != m_channels.end(); ++chan) {
-		matrix4x4f trans = chan->node->GetTransform();
-
-		if (!chan->rotationKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->rotationKeys.size()) {
-				if (mtime < chan->rotationKeys[frame+1].time)
-					break;
-				frame++;
-			}
-
-			const RotationKey &a = chan->rotationKeys[frame];
+	for (unsigned int i = 0; i < channels.size(); i++) {
+		const AnimationChannel &chan = channels[i];
+		const KeyIndex &index = keyIndex[i];
+		KeyCursor &cursor = m_cursors[i];
+		MatrixTransform *node = GetTarget(i);
+		matrix4x4f trans = node->GetTransform();
+
+		if (!chan.rotationKeys.empty()) {
+			const unsigned int frame = FindKey(chan.rotationKeys, index.rotation, step, mtime, cursor.rotation);
+			cursor.rotation = frame;
+
+			const RotationKey &a = chan.rotationKeys[frame];
 			vector3f saved_position = trans.GetTranslate();
-			if (frame + 1 < chan->rotationKeys.size()) {
-				const RotationKey &b = chan->rotationKeys[frame + 1];
-				double diffTime = b.time - a.time;
-				assert(diffTime > 0.0);
-				const float factor = Clamp(float((mtime - a.time) / diffTime), 0.f, 1.f);
-				trans = Quaternionf::Slerp(a.rotation, b.rotation, factor).ToMatrix3x3<float>();
+			if (frame + 1 < chan.rotationKeys.size()) {
+				const RotationKey &b = chan.rotationKeys[frame + 1];
+				const float factor = KeyFactor(a, b, mtime);
+				//sitting on a key is common (gear up, doors shut), no need to slerp
+				if (factor > 0.f)
+					trans = Quaternionf::Slerp(a.rotation, b.rotation, factor).ToMatrix3x3<float>();
+				else
+					trans = a.rotation.ToMatrix3x3<float>();
 			} else {
 				trans = a.rotation.ToMatrix3x3<float>();
 			}
@@ -71,53 +147,37 @@ void Animation::Interpolate()
 		//scaling will not work without rotation since it would
 		//continously scale the transform (would have to add originalTransform or
 		//something to MT)
-		if (!chan->scaleKeys.empty() && !chan->rotationKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->scaleKeys.size()) {
-				if (mtime < chan->scaleKeys[frame+1].time)
-					break;
-				frame++;
-			}
+		if (!chan.scaleKeys.empty() && !chan.rotationKeys.empty()) {
+			const unsigned int frame = FindKey(chan.scaleKeys, index.scale, step, mtime, cursor.scale);
+			cursor.scale = frame;
 
-			const ScaleKey &a = chan->scaleKeys[frame];
+			const ScaleKey &a = chan.scaleKeys[frame];
 			vector3f out;
-			if (frame + 1 < chan->scaleKeys.size()) {
-				const ScaleKey &b = chan->scaleKeys[frame + 1];
-				double diffTime = b.time - a.time;
-				assert(diffTime > 0.0);
-				const float factor = Clamp(float((mtime - a.time) / diffTime), 0.f, 1.f);
-				out = a.scale + (b.scale - a.scale) * factor;
+			if (frame + 1 < chan.scaleKeys.size()) {
+				const ScaleKey &b = chan.scaleKeys[frame + 1];
+				out = a.scale + (b.scale - a.scale) * KeyFactor(a, b, mtime);
 			} else {
 				out = a.scale;
 			}
 			trans.Scale(out.x, out.y, out.z);
 		}
 
-		if (!chan->positionKeys.empty()) {
-			//find a frame. To optimize, should begin search from previous frame (when mTime > previous mTime)
-			unsigned int frame = 0;
-			while (frame + 1 < chan->positionKeys.size()) {
-				if (mtime < chan->positionKeys[frame+1].time)
-					break;
-				frame++;
-			}
+		if (!chan.positionKeys.empty()) {
+			const unsigned int frame = FindKey(chan.positionKeys, index.position, step, mtime, cursor.position);
+			cursor.position = frame;
 
-			const PositionKey &a = chan->positionKeys[frame];
+			const PositionKey &a = chan.positionKeys[frame];
 			vector3f out;
-			if (frame + 1 < chan->positionKeys.size()) {
-				const PositionKey &b = chan->positionKeys[frame + 1];
-				double diffTime = b.time - a.time;
-				assert(diffTime > 0.0);
-				const float factor = Clamp(float((mtime - a.time) / diffTime), 0.f, 1.f);
-				out = a.position + (b.position - a.position) * factor;
+			if (frame + 1 < chan.positionKeys.size()) {
+				const PositionKey &b = chan.positionKeys[frame + 1];
+				out = a.position + (b.position - a.position) * KeyFactor(a, b, mtime);
 			} else {
 				out = a.position;
 			}
 			trans.SetTranslate(out);
 		}
 
-		chan->node->SetTransform(trans);
+		node->SetTransform(trans);
 	}
 }
 
@@ -15,26 +15,61 @@ namespace SceneGraph {
 class Loader;
 class BinaryConverter;
 class Node;
+class NodeCopyCache;
 
 class Animation {
 public:
 	Animation(const std::string &name, double duration);
-	Animation(const Animation&);
-	void UpdateChannelTargets(Node *root);
+	// for a model instance: the keys are shared with anim, which has to
+	// outlive this, and the channels animate the copies of its nodes in cache
+	Animation(const Animation &anim, const NodeCopyCache &cache);
 	double GetDuration() const { return m_duration; }
 	const std::string &GetName() const { return m_name; }
 	double GetProgress();
 	void SetProgress(double); //0.0 -- 1.0, overrides m_time
 	void Interpolate(); //update transforms according to m_time;
-	const std::vector<AnimationChannel>& GetChannels() const { return m_channels; }
+	bool Update(); //Interpolate() if m_time has changed since, true if it did
+	const std::vector<AnimationChannel>& GetChannels() const { return m_shared ? m_shared->m_channels : m_channels; }
+	// for animations put together in code, loaders fill the channels in themselves
+	void AddChannel(const AnimationChannel &chan) { m_channels.push_back(chan); m_keyIndex.clear(); }
+	// the node a channel moves in this animation's model
+	MatrixTransform *GetTarget(unsigned int channel) const {
+		return m_targets.empty() ? m_channels[channel].node : m_targets[channel];
+	}
 
 private:
+	// the key each track is on at fixed steps through the animation, so
+	// finding a key anywhere is a lookup and a short scan
+	struct KeyIndex {
+		std::vector<unsigned int> position;
+		std::vector<unsigned int> rotation;
+		std::vector<unsigned int> scale;
+	};
+	// the keys an instance was on last time, playback mostly moves on by
+	// one key or none
+	struct KeyCursor {
+		unsigned int position;
+		unsigned int rotation;
+		unsigned int scale;
+	};
+
+	// built on first use, in the animation the keys belong to. Animations
+	// are only interpolated on the main thread
+	const std::vector<KeyIndex> &GetKeyIndex() const;
+
 	friend class Loader;
 	friend class BinaryConverter;
 	double m_duration;
 	double m_time;
+	double m_interpolatedTime;
 	std::string m_name;
 	std::vector<AnimationChannel> m_channels;
+	// instances only: where the keys are, and the node each channel moves
+	const Animation *m_shared;
+	std::vector<MatrixTransform*> m_targets;
+	std::vector<KeyCursor> m_cursors;
+	mutable std::vector<KeyIndex> m_keyIndex;
+	mutable double m_keyIndexStep;
 };
 
 }
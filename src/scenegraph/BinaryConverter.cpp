@@ -5,13 +5,18 @@
 #include "Parser.h"
 #include "FileSystem.h"
 #include "StringF.h"
+#include "CollMesh.h"
+#include "jenkins/lookup3.h"
 
 using namespace SceneGraph;
 
 // Attempt at version history:
 // 1: prototype
 // 2: converted StaticMesh to VertexBuffer
-const Uint32 SGM_VERSION = 2;
+// 3: built collision mesh and trees, 32-bit collision indices
+// 4: collision trees split by surface area
+// 5: hash of the source model and meshes it was compiled from
+const Uint32 SGM_VERSION = 5;
 const std::string SGM_EXTENSION = ".sgm";
 const std::string SAVE_TARGET_DIR = "binarymodels";
 
@@ -40,6 +45,27 @@ public:
 	NodeDatabase db;
 };
 
+// gives the dynamic collision geometry nodes back their trees, in the
+// order CollisionVisitor made them
+class DynGeomTreeVisitor : public NodeVisitor
+{
+public:
+	DynGeomTreeVisitor(const std::vector<GeomTree*> &trees) : m_trees(trees), m_next(0) {}
+
+	virtual void ApplyCollisionGeometry(CollisionGeometry &cg) override
+	{
+		if (!cg.IsDynamic()) return;
+		if (m_next >= m_trees.size()) throw LoadingError("Missing dynamic collision tree");
+		cg.SetGeomTree(m_trees[m_next++]);
+	}
+
+	bool AllUsed() const { return m_next == m_trees.size(); }
+
+private:
+	const std::vector<GeomTree*> &m_trees;
+	size_t m_next;
+};
+
 BinaryConverter::BinaryConverter(Graphics::Renderer *r)
 	: BaseLoader(r)
 	, m_patternsUsed(false)
@@ -77,6 +103,10 @@ void BinaryConverter::Save(const std::string& filename, Model* m)
 
 	wr.Int32(SGM_VERSION);
 
+	const FileSystem::FileInfo source = FindModelFile(filename);
+	if (!source.IsFile()) throw CouldNotOpenFileException();
+	wr.Int32(SourceHash(source));
+
 	wr.String(m->GetName().c_str());
 
 	SaveMaterials(wr, m);
@@ -91,6 +121,8 @@ void BinaryConverter::Save(const std::string& filename, Model* m)
 	for (unsigned int i = 0; i < m->GetNumTags(); i++)
 		wr.String(m->GetTagByIndex(i)->GetName().c_str());
 
+	SaveCollision(wr, m);
+
 	const std::string& data = wr.GetData();
 	const size_t nwritten = fwrite(data.data(), data.length(), 1, f);
 	fclose(f);
@@ -98,10 +130,20 @@ void BinaryConverter::Save(const std::string& filename, Model* m)
 	if (nwritten != 1) throw CouldNotWriteToFileException();
 }
 
-Model *BinaryConverter::Load(const std::string &filename)
+Model *BinaryConverter::Load(const std::string &shortname)
 {
-	Model *m = Load(filename, "models");
-	return m;
+	RefCountedPtr<FileSystem::FileData> binfile = FileSystem::userFiles.ReadFile(
+		FileSystem::JoinPathBelow(SAVE_TARGET_DIR, shortname + SGM_EXTENSION));
+	if (!binfile.Valid()) throw LoadingError("File not found");
+
+	// textures and patterns are found next to the source, and the file's
+	// only any use while that's what it was compiled from
+	const FileSystem::FileInfo source = FindModelFile(shortname);
+	if (!source.IsFile()) throw LoadingError("Source model not found");
+	const Uint32 sourceHash = SourceHash(source);
+
+	Serializer::Reader rd(binfile->AsByteRange());
+	return CreateModel(rd, &sourceHash);
 }
 
 Model *BinaryConverter::Load(const std::string &shortname, const std::string &basepath)
@@ -127,7 +169,7 @@ Model *BinaryConverter::Load(const std::string &shortname, const std::string &ba
 				RefCountedPtr<FileSystem::FileData> binfile = info.Read();
 				if (binfile.Valid()) {
 					Serializer::Reader rd(binfile->AsByteRange());
-					Model* model = CreateModel(rd);
+					Model* model = CreateModel(rd, nullptr);
 					return model;
 				}
 			}
@@ -138,33 +180,52 @@ Model *BinaryConverter::Load(const std::string &shortname, const std::string &ba
 	return nullptr;
 }
 
-Model *BinaryConverter::CreateModel(Serializer::Reader &rd)
+Model *BinaryConverter::CreateModel(Serializer::Reader &rd, const Uint32 *sourceHash)
 {
-	//verify signature
-	const Uint32 sig = rd.Int32();
-	if (sig != 0x314D4753) //'SGM1'
-		throw LoadingError("Not a binary model file");
-
-	const Uint32 version = rd.Int32();
-	if (version != 2)
-		throw LoadingError("Unsupported file version");
-
-	const std::string modelName = rd.String();
-
-	m_model = new Model(m_renderer, modelName);
-
-	m_patternsUsed = false;
-	LoadMaterials(rd);
-
-	Group* root = dynamic_cast<Group*>(LoadNode(rd));
-	if (!root) throw LoadingError("Expected root");
-	m_model->m_root.Reset(root);
-
-	LoadAnimations(rd);
-
-	m_model->UpdateAnimations();
-	m_model->CreateCollisionMesh();
-	if (m_patternsUsed) SetUpPatterns();
+	m_model = 0;
+	try {
+		//verify signature
+		const Uint32 sig = rd.Int32();
+		if (sig != 0x314D4753) //'SGM1'
+			throw LoadingError("Not a binary model file");
+
+		const Uint32 version = rd.Int32();
+		if (version != SGM_VERSION)
+			throw LoadingError("Unsupported file version");
+
+		const Uint32 compiledFrom = rd.Int32();
+		if (sourceHash && compiledFrom != *sourceHash)
+			throw LoadingError("Source model has changed");
+
+		const std::string modelName = rd.String();
+
+		m_model = new Model(m_renderer, modelName);
+
+		m_patternsUsed = false;
+		LoadMaterials(rd);
+
+		Group* root = dynamic_cast<Group*>(LoadNode(rd));
+		if (!root) throw LoadingError("Expected root");
+		m_model->m_root.Reset(root);
+
+		LoadAnimations(rd);
+
+		//tags were registered with their nodes
+		for (Uint32 numTags = rd.Int32(); numTags > 0; numTags--)
+			rd.String();
+
+		m_model->UpdateAnimations();
+		LoadCollision(rd);
+		if (m_patternsUsed) SetUpPatterns();
+	} catch (SavedGameCorruptException &) {
+		delete m_model;
+		m_model = 0;
+		throw LoadingError("File is truncated");
+	} catch (...) {
+		delete m_model;
+		m_model = 0;
+		throw;
+	}
 
 	return m_model;
 }
@@ -282,7 +343,29 @@ void BinaryConverter::LoadAnimations(Serializer::Reader &rd)
 	}
 }
 
-ModelDefinition BinaryConverter::FindModelDefinition(const std::string &shortname)
+void BinaryConverter::SaveCollision(Serializer::Writer &wr, Model *m)
+{
+	//building the trees is the slow part of loading big models,
+	//so they're stored ready built
+	RefCountedPtr<CollMesh> collMesh = m->GetCollisionMesh();
+	if (!collMesh.Valid())
+		collMesh = m->CreateCollisionMesh();
+	collMesh->Save(wr);
+}
+
+void BinaryConverter::LoadCollision(Serializer::Reader &rd)
+{
+	RefCountedPtr<CollMesh> collMesh(new CollMesh(rd));
+
+	DynGeomTreeVisitor dv(collMesh->GetDynGeomTrees());
+	m_model->m_root->Accept(dv);
+	if (!dv.AllUsed()) throw LoadingError("Unused dynamic collision trees");
+
+	m_model->m_collMesh = collMesh;
+	m_model->m_boundingRadius = collMesh->GetAabb().GetRadius();
+}
+
+FileSystem::FileInfo BinaryConverter::FindModelFile(const std::string &shortname)
 {
 	const std::string basepath = "models";
 
@@ -293,31 +376,65 @@ ModelDefinition BinaryConverter::FindModelDefinition(const std::string &shortnam
 
 		//check it's the expected type
 		if (info.IsFile() && ends_with_ci(fpath, ".model")) {
-			//check it's the wanted name & load it
+			//check it's the wanted name
 			const std::string name = info.GetName();
 
 			if (shortname == name.substr(0, name.length()-6)) {
-				ModelDefinition modelDefinition;
-				try {
-					//curPath is used to find textures, patterns,
-					//possibly other data files for this model.
-					//Strip trailing slash
-					m_curPath = info.GetDir();
-					assert(!m_curPath.empty());
-					if (m_curPath[m_curPath.length()-1] == '/')
-						m_curPath = m_curPath.substr(0, m_curPath.length()-1);
-
-					Parser p(fileSource, fpath, m_curPath);
-					p.Parse(&modelDefinition);
-					return modelDefinition;
-				} catch (ParseError &err) {
-					Output("%s\n", err.what());
-					throw LoadingError(err.what());
-				}
+				//curPath is used to find textures, patterns,
+				//possibly other data files for this model.
+				//Strip trailing slash
+				m_curPath = info.GetDir();
+				assert(!m_curPath.empty());
+				if (m_curPath[m_curPath.length()-1] == '/')
+					m_curPath = m_curPath.substr(0, m_curPath.length()-1);
+				return info;
 			}
 		}
 	}
-	throw (LoadingError("File not found"));
+	return FileSystem::FileInfo();
+}
+
+ModelDefinition BinaryConverter::FindModelDefinition(const std::string &shortname)
+{
+	const FileSystem::FileInfo info = FindModelFile(shortname);
+	if (!info.IsFile()) throw (LoadingError("File not found"));
+	return ParseModelFile(info);
+}
+
+ModelDefinition BinaryConverter::ParseModelFile(const FileSystem::FileInfo &info)
+{
+	ModelDefinition modelDefinition;
+	try {
+		Parser p(FileSystem::gameDataFiles, info.GetPath(), m_curPath);
+		p.Parse(&modelDefinition);
+		return modelDefinition;
+	} catch (ParseError &err) {
+		Output("%s\n", err.what());
+		throw LoadingError(err.what());
+	}
+}
+
+// the .model file and every mesh it names, so editing any of them makes the
+// compiled file out of date. Textures are still read from the source when
+// the model's loaded, so they don't count
+Uint32 BinaryConverter::SourceHash(const FileSystem::FileInfo &modelFile)
+{
+	std::vector<std::string> paths;
+	paths.push_back(modelFile.GetPath());
+	const ModelDefinition def = ParseModelFile(modelFile);
+	for (const LodDefinition &lod : def.lodDefs)
+		paths.insert(paths.end(), lod.meshNames.begin(), lod.meshNames.end());
+	paths.insert(paths.end(), def.collisionDefs.begin(), def.collisionDefs.end());
+
+	Uint32 hash = SGM_VERSION;
+	for (const std::string &path : paths) {
+		RefCountedPtr<FileSystem::FileData> data = FileSystem::gameDataFiles.ReadFile(path);
+		if (!data.Valid()) throw LoadingError(stringf("%0 not found", path));
+		const Uint32 size = data->GetSize();
+		hash = lookup3_hashlittle(&size, sizeof(size), hash);
+		hash = lookup3_hashlittle(data->GetData(), data->GetSize(), hash);
+	}
+	return hash;
 }
 
 Node* BinaryConverter::LoadNode(Serializer::Reader &rd)
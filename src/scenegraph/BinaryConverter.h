@@ -17,6 +17,7 @@
 #include "CollisionGeometry.h"
 #include "Thruster.h"
 #include "Billboard.h"
+#include "FileSystem.h"
 #include <functional>
 
 namespace SceneGraph
@@ -25,8 +26,13 @@ class BinaryConverter : public BaseLoader
 {
 public:
 	BinaryConverter(Graphics::Renderer*);
+	// writes userFiles/binarymodels/<filename>.sgm, marked with what the
+	// source model and its meshes were when it was compiled
 	void Save(const std::string& filename, Model* m);
+	// reads what Save wrote, as long as the source hasn't changed since.
+	// Throws LoadingError otherwise
 	Model *Load(const std::string &filename);
+	// any <filename>.sgm under path in the game data, unchecked
 	Model *Load(const std::string &filename, const std::string &path);
 
 	//if you implement any new node types, you must also register a loader function
@@ -34,12 +40,20 @@ public:
 	void RegisterLoader(const std::string &typeName, std::function<Node*(NodeDatabase&)>);
 
 private:
-	Model *CreateModel(Serializer::Reader&);
+	// sourceHash is what the file has to have been compiled from, if it's checked
+	Model *CreateModel(Serializer::Reader&, const Uint32 *sourceHash);
 	void SaveMaterials(Serializer::Writer&, Model* m);
 	void LoadMaterials(Serializer::Reader&);
 	void SaveAnimations(Serializer::Writer&, Model* m);
 	void LoadAnimations(Serializer::Reader&);
+	void SaveCollision(Serializer::Writer&, Model* m);
+	void LoadCollision(Serializer::Reader&);
 	ModelDefinition FindModelDefinition(const std::string&);
+	// the .model file for a model, non-existent if there isn't one. Sets
+	// m_curPath to its directory
+	FileSystem::FileInfo FindModelFile(const std::string&);
+	ModelDefinition ParseModelFile(const FileSystem::FileInfo&);
+	Uint32 SourceHash(const FileSystem::FileInfo &modelFile);
 
 	Node* LoadNode(Serializer::Reader&);
 	void LoadChildren(Serializer::Reader&, Group* parent);
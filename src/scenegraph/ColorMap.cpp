@@ -4,15 +4,24 @@
 #include "ColorMap.h"
 #include "graphics/Renderer.h"
 #include <SDL_stdinc.h>
+#include <map>
 
 namespace SceneGraph {
 
+ColorMap::TextureMap ColorMap::s_textures;
+
 ColorMap::ColorMap()
 : m_smooth(true)
+, m_renderer(0)
 {
 
 }
 
+ColorMap::~ColorMap()
+{
+	Release();
+}
+
 Graphics::Texture *ColorMap::GetTexture()
 {
 	assert(m_texture.Valid());
@@ -36,24 +45,46 @@ void ColorMap::Generate(Graphics::Renderer *r, const Color &a, const Color &b, c
 	AddColor(w, a, colors);
 	AddColor(w, b, colors);
 	AddColor(w, c, colors);
-	vector2f size(colors.size()/3, 1.f);
+	m_renderer = r;
+	m_colors.swap(colors);
+	Acquire();
+}
 
-	const Graphics::TextureFormat format = Graphics::TEXTURE_RGB_888;
+void ColorMap::SetSmooth(bool smooth)
+{
+	m_smooth = smooth;
+	if (m_texture.Valid()) Acquire();
+}
+
+// points m_texture at the shared texture for the colours, making it if
+// no one else has
+void ColorMap::Acquire()
+{
+	TextureKey key(m_renderer, m_colors);
+	key.second.push_back(m_smooth ? 1 : 0);
 
-	if (!m_texture.Valid()) {
+	TextureMap::iterator it = s_textures.find(key);
+	if (it == s_textures.end()) {
+		it = s_textures.insert(std::make_pair(key, SharedTexture())).first;
+		vector2f size(m_colors.size()/3, 1.f);
 		const Graphics::TextureSampleMode sampleMode = m_smooth ? Graphics::LINEAR_CLAMP : Graphics::NEAREST_CLAMP;
-		m_texture.Reset(r->CreateTexture(Graphics::TextureDescriptor(Graphics::TEXTURE_RGB_888, size, sampleMode)));
+		it->second.texture.Reset(m_renderer->CreateTexture(Graphics::TextureDescriptor(Graphics::TEXTURE_RGB_888, size, sampleMode)));
+		it->second.texture->Update(&m_colors[0], size, Graphics::TEXTURE_RGB_888);
 	}
-
-	m_texture->Update(&colors[0], size, format);
+	if (m_texture.Valid() && it == m_shared) return;
+	// before letting go of the old one, which may be the same texture
+	it->second.users++;
+	Release();
+	m_shared = it;
+	m_texture = it->second.texture;
 }
 
-void ColorMap::SetSmooth(bool smooth)
+void ColorMap::Release()
 {
-	m_smooth = smooth;
-	if (m_texture.Valid()) {
-		m_texture->SetSampleMode(m_smooth ? Graphics::LINEAR_CLAMP : Graphics::NEAREST_CLAMP);
-	}
+	if (!m_texture.Valid()) return;
+	m_texture.Reset();
+	if (--m_shared->second.users == 0)
+		s_textures.erase(m_shared);
 }
 
 }
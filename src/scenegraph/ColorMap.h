@@ -4,11 +4,13 @@
 #ifndef _SCENEGRAPH_COLORMAP_H
 #define _SCENEGRAPH_COLORMAP_H
 /*
- * Color look-up texture generator for newmodel pattern system
+ * Color look-up texture generator for newmodel pattern system.
+ * Color maps with the same colours share a texture.
  */
 #include "libs.h"
 #include "graphics/Texture.h"
 #include <SDL_stdinc.h>
+#include <map>
 
 namespace Graphics { class Renderer; }
 
@@ -17,15 +19,35 @@ namespace SceneGraph {
 class ColorMap {
 public:
 	ColorMap();
+	~ColorMap();
+	// each copy would have to count as a user of the texture
+	ColorMap(const ColorMap&) = delete;
+	ColorMap& operator=(const ColorMap&) = delete;
 	Graphics::Texture *GetTexture();
 	void Generate(Graphics::Renderer *r, const Color &a, const Color &b, const Color &c);
 	void SetSmooth(bool);
 
 private:
+	// renderer, colours and then smoothing
+	typedef std::pair<Graphics::Renderer*, std::vector<Uint8> > TextureKey;
+	struct SharedTexture {
+		SharedTexture() : users(0) {}
+		RefCountedPtr<Graphics::Texture> texture;
+		int users; // maps using it. it goes when the last one lets go
+	};
+	typedef std::map<TextureKey, SharedTexture> TextureMap;
+
 	void AddColor(int width, const Color &c, std::vector<Uint8> &out);
+	void Acquire();
+	void Release();
 
 	bool m_smooth;
+	Graphics::Renderer *m_renderer;
+	std::vector<Uint8> m_colors;
 	RefCountedPtr<Graphics::Texture> m_texture;
+	TextureMap::iterator m_shared; // m_texture's entry, while it's valid
+
+	static TextureMap s_textures;
 };
 
 }
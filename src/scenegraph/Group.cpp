@@ -28,7 +28,7 @@ Group::Group(const Group &group, NodeCopyCache *cache)
 		itr != group.m_children.end();
 		++itr)
 	{
-		Node *node = (*itr)->Clone(cache);
+		Node *node = (cache && cache->IsShared(*itr)) ? *itr : (*itr)->Clone(cache);
 		AddChild(node);
 	}
 }
@@ -0,0 +1,202 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include "Impostor.h"
+#include "Model.h"
+#include "graphics/Graphics.h"
+#include "graphics/Light.h"
+#include "graphics/Material.h"
+#include "graphics/Renderer.h"
+#include "graphics/RenderState.h"
+#include "graphics/RenderTarget.h"
+#include <map>
+
+namespace SceneGraph {
+
+// views all round at each of the elevations, one cell of the atlas each
+static const int VIEWS_AROUND = 8;
+static const int VIEW_ELEVATIONS = 4;
+static const float ELEVATIONS[VIEW_ELEVATIONS] = { -60.f, -20.f, 20.f, 60.f };
+static const int CELL_SIZE = 64;
+// narrow enough to pass for a picture taken from far off
+static const float VIEW_FOV = 10.f;
+
+static float s_pixelRadius = 0.f;
+static bool s_batching = false;
+static bool s_building = false;
+static std::map<std::string, RefCountedPtr<Impostor> > s_impostors;
+static std::vector<Impostor*> s_queued;
+
+void Impostor::Init(float pixelRadius)
+{
+	s_pixelRadius = pixelRadius;
+}
+
+void Impostor::Uninit()
+{
+	s_queued.clear();
+	s_impostors.clear();
+}
+
+RefCountedPtr<Impostor> Impostor::ForModel(const std::string &name)
+{
+	RefCountedPtr<Impostor> &imp = s_impostors[name];
+	if (!imp.Valid()) imp.Reset(new Impostor());
+	return imp;
+}
+
+void Impostor::BeginBatch()
+{
+	s_batching = true;
+}
+
+void Impostor::EndBatch(Graphics::Renderer *r)
+{
+	PROFILE_SCOPED()
+	s_batching = false;
+	for (std::vector<Impostor*>::iterator it = s_queued.begin(); it != s_queued.end(); ++it)
+		(*it)->Draw(r);
+	s_queued.clear();
+}
+
+Impostor::Impostor()
+: m_state(UNBUILT)
+, m_radius(0.f)
+, m_renderState(0)
+, m_quads(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0)
+{
+}
+
+Impostor::~Impostor()
+{
+}
+
+// direction from the model to the camera for a view, and the other two
+// axes of the picture, all in model space
+static void ViewAxes(int around, int elevation, vector3f &x, vector3f &y, vector3f &z)
+{
+	const float yaw = DEG2RAD(360.f * around / VIEWS_AROUND);
+	const float pitch = DEG2RAD(ELEVATIONS[elevation]);
+	z = vector3f(sin(yaw) * cos(pitch), sin(pitch), cos(yaw) * cos(pitch));
+	x = vector3f(0.f, 1.f, 0.f).Cross(z).Normalized();
+	y = z.Cross(x);
+}
+
+bool Impostor::Build(Model *model)
+{
+	PROFILE_SCOPED()
+	Graphics::Renderer *r = model->GetRenderer();
+	m_radius = model->GetDrawClipRadius();
+
+	Graphics::RenderTargetDesc rtd(VIEWS_AROUND * CELL_SIZE, VIEW_ELEVATIONS * CELL_SIZE,
+		Graphics::TextureFormat::TEXTURE_RGBA_8888, Graphics::TextureFormat::TEXTURE_DEPTH, false);
+	m_target.reset(r->CreateRenderTarget(rtd));
+	if (!m_target) return false;
+
+	Graphics::MaterialDescriptor desc;
+	desc.textures = 1;
+	m_material.reset(r->CreateMaterial(desc));
+	m_material->texture0 = m_target->GetColorTexture();
+
+	Graphics::RenderStateDesc rsd;
+	rsd.blendMode = Graphics::BLEND_ALPHA;
+	rsd.depthWrite = false;
+	m_renderState = r->CreateRenderState(rsd);
+
+	// lit from over the shoulder, whatever the scene's lights are
+	const Graphics::Light light(Graphics::Light::LIGHT_DIRECTIONAL, vector3f(0.5f, 1.f, 1.f).Normalized(),
+		Color::WHITE, Color::WHITE, 0.f);
+	const Color oldAmbient = r->GetAmbientColor();
+	Graphics::RenderTarget *oldTarget = r->GetActiveRenderTarget();
+	{
+		Graphics::Renderer::MatrixTicket projTicket(r, Graphics::MatrixMode::PROJECTION);
+		Graphics::Renderer::MatrixTicket viewTicket(r, Graphics::MatrixMode::MODELVIEW);
+		Graphics::Renderer::LightsTicket lightsTicket(r, 1, &light);
+		r->SetAmbientColor(Color(64));
+
+		const float dist = m_radius / tan(DEG2RAD(VIEW_FOV * 0.5f));
+		r->SetPerspectiveProjection(VIEW_FOV, 1.f, dist - m_radius, dist + m_radius);
+
+		r->SetRenderTarget(m_target.get());
+		r->SetClearColor(Color(0));
+		r->ClearScreen();
+
+		s_building = true;
+		for (int e = 0; e < VIEW_ELEVATIONS; e++) {
+			for (int a = 0; a < VIEWS_AROUND; a++) {
+				Graphics::Renderer::ViewportTicket viewportTicket(r, a * CELL_SIZE, e * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+				vector3f x, y, z;
+				ViewAxes(a, e, x, y, z);
+				matrix4x4f trans = matrix4x4f::Identity();
+				trans[0] = x.x; trans[4] = x.y; trans[8] = x.z;
+				trans[1] = y.x; trans[5] = y.y; trans[9] = y.z;
+				trans[2] = z.x; trans[6] = z.y; trans[10] = z.z;
+				trans[14] = -dist;
+				model->Render(trans);
+			}
+		}
+		s_building = false;
+
+		r->SetRenderTarget(oldTarget);
+		r->SetClearColor(Color(0.f));
+		r->SetAmbientColor(oldAmbient);
+	}
+	return true;
+}
+
+bool Impostor::Queue(Model *model, const matrix4x4f &trans)
+{
+	if (!s_batching || s_building || s_pixelRadius <= 0.f || m_state == FAILED) return false;
+
+	//same sums as LOD
+	const float dist = trans.GetTranslate().Length();
+	const float pixrad = Graphics::GetScreenHeight() * model->GetDrawClipRadius() / (dist * Graphics::GetFovFactor());
+	if (pixrad >= s_pixelRadius) return false;
+
+	if (m_state == UNBUILT) {
+		m_state = Build(model) ? READY : FAILED;
+		if (m_state == FAILED) return false;
+	}
+
+	//the view taken from nearest where the camera is
+	const matrix3x3f orient = trans.GetOrient();
+	const vector3f toCamera = (orient.Transpose() * -trans.GetTranslate()).Normalized();
+	const float yaw = atan2(toCamera.x, toCamera.z);
+	const float pitch = RAD2DEG(asin(Clamp(toCamera.y, -1.f, 1.f)));
+	const int around = (int(floor(yaw / (2.f * float(M_PI)) * VIEWS_AROUND + 0.5f)) + VIEWS_AROUND) % VIEWS_AROUND;
+	int elevation = 0;
+	for (int e = 1; e < VIEW_ELEVATIONS; e++) {
+		if (fabs(pitch - ELEVATIONS[e]) < fabs(pitch - ELEVATIONS[elevation]))
+			elevation = e;
+	}
+
+	//a quad facing the way the picture was taken from. Render targets are
+	//bottom up
+	vector3f x, y, z;
+	ViewAxes(around, elevation, x, y, z);
+	const vector3f centre = trans.GetTranslate();
+	const vector3f vx = orient * x * m_radius;
+	const vector3f vy = orient * y * m_radius;
+	const float u0 = float(around) / VIEWS_AROUND, u1 = float(around + 1) / VIEWS_AROUND;
+	const float v0 = float(elevation) / VIEW_ELEVATIONS, v1 = float(elevation + 1) / VIEW_ELEVATIONS;
+
+	if (m_quads.GetNumVerts() == 0) s_queued.push_back(this);
+	m_quads.Add(centre - vx + vy, vector2f(u0, v1)); //top left
+	m_quads.Add(centre - vx - vy, vector2f(u0, v0)); //bottom left
+	m_quads.Add(centre + vx + vy, vector2f(u1, v1)); //top right
+
+	m_quads.Add(centre + vx + vy, vector2f(u1, v1)); //top right
+	m_quads.Add(centre - vx - vy, vector2f(u0, v0)); //bottom left
+	m_quads.Add(centre + vx - vy, vector2f(u1, v0)); //bottom right
+	return true;
+}
+
+void Impostor::Draw(Graphics::Renderer *r)
+{
+	Graphics::Renderer::MatrixTicket ticket(r, Graphics::MatrixMode::MODELVIEW);
+	r->SetTransform(matrix4x4f::Identity());
+	r->DrawTriangles(&m_quads, m_renderState, m_material.get());
+	m_quads.Clear();
+}
+
+}
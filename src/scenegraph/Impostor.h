@@ -0,0 +1,65 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SCENEGRAPH_IMPOSTOR_H
+#define _SCENEGRAPH_IMPOSTOR_H
+/*
+ * Pictures of a model from all round, drawn as flat quads instead of the
+ * model once it's only a few pixels across on screen. The pictures are
+ * taken the first time a model is that small, and shared by all its
+ * instances (so they all wear the colours of whichever came first).
+ *
+ * Quads are collected between BeginBatch and EndBatch, and drawn together,
+ * one draw for each model.
+ */
+#include "libs.h"
+#include "RefCounted.h"
+#include "graphics/VertexArray.h"
+
+namespace Graphics {
+	class Material;
+	class Renderer;
+	class RenderState;
+	class RenderTarget;
+}
+
+namespace SceneGraph {
+
+class Model;
+
+class Impostor : public RefCounted {
+public:
+	// models smaller than pixelRadius on screen are drawn as impostors, 0
+	// for never
+	static void Init(float pixelRadius);
+	static void Uninit();
+
+	// the impostor for models called name
+	static RefCountedPtr<Impostor> ForModel(const std::string &name);
+
+	static void BeginBatch();
+	static void EndBatch(Graphics::Renderer *r);
+
+	// Adds a quad for model at trans to the batch if it's small enough, and
+	// there is a batch. False if the model should be drawn itself
+	bool Queue(Model *model, const matrix4x4f &trans);
+
+	~Impostor();
+
+private:
+	Impostor();
+	bool Build(Model *model);
+	void Draw(Graphics::Renderer *r);
+
+	enum State { UNBUILT, READY, FAILED };
+	State m_state;
+	float m_radius;
+	std::unique_ptr<Graphics::RenderTarget> m_target;
+	std::unique_ptr<Graphics::Material> m_material;
+	Graphics::RenderState *m_renderState;
+	Graphics::VertexArray m_quads; //view space, this frame's
+};
+
+}
+
+#endif
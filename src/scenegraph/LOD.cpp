@@ -38,18 +38,25 @@ void LOD::AddLevel(float pixelSize, Node *nod)
 	AddChild(nod);
 }
 
-void LOD::Render(const matrix4x4f &trans, const RenderData *rd)
+int LOD::SelectLevel(const matrix4x4f &trans, float boundingRadius) const
 {
 	//figure out approximate pixel size of object's bounding radius
 	//on screen and pick a child to render
 	const vector3f cameraPos(-trans[12], -trans[13], -trans[14]);
 	//fov is vertical, so using screen height
-	const float pixrad = Graphics::GetScreenHeight() * rd->boundingRadius / (cameraPos.Length() * Graphics::GetFovFactor());
-	if (m_pixelSizes.empty()) return;
+	const float pixrad = Graphics::GetScreenHeight() * boundingRadius / (cameraPos.Length() * Graphics::GetFovFactor());
+	if (m_pixelSizes.empty()) return -1;
 	unsigned int lod = m_children.size() - 1;
 	for (unsigned int i=m_pixelSizes.size(); i > 0; i--) {
 		if (pixrad < m_pixelSizes[i-1]) lod = i-1;
 	}
+	return lod;
+}
+
+void LOD::Render(const matrix4x4f &trans, const RenderData *rd)
+{
+	const int lod = SelectLevel(trans, rd->boundingRadius);
+	if (lod < 0) return;
 	m_children[lod]->Render(trans, rd);
 }
 
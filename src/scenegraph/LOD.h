@@ -19,6 +19,8 @@ public:
 	virtual void Accept(NodeVisitor &v);
 	virtual void Render(const matrix4x4f &trans, const RenderData *rd);
 	void AddLevel(float pixelRadius, Node *child);
+	// the child to draw at trans for a model of boundingRadius, -1 for none
+	int SelectLevel(const matrix4x4f &trans, float boundingRadius) const;
 	virtual void Save(NodeDatabase&) override;
 	static LOD* Load(NodeDatabase&);
 
@@ -736,7 +736,7 @@ RefCountedPtr<CollisionGeometry> Loader::CreateCollisionGeometry(RefCountedPtr<S
 	mesh.vertexBuffer->Unmap();
 
 	//copy indices from buffer
-	std::vector<unsigned short> idx;
+	std::vector<Uint32> idx;
 	idx.reserve(numIdx);
 
 	Uint32 *idxPtr = mesh.indexBuffer->Map(Graphics::BUFFER_MAP_READ);
@@ -858,7 +858,7 @@ void Loader::LoadCollision(const std::string &filename)
 	if(scene->mNumMeshes == 0)
 		throw LoadingError("No geometry found");
 
-	std::vector<unsigned short> indices;
+	std::vector<Uint32> indices;
 	std::vector<vector3f> vertices;
 	unsigned int indexOffset = 0;
 
@@ -0,0 +1,21 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#ifndef _SCENEGRAPH_LOADINGERROR_H
+#define _SCENEGRAPH_LOADINGERROR_H
+
+// on its own so the collider can throw it while reading a compiled model's
+// trees without pulling in the rest of the scenegraph
+#include <stdexcept>
+#include <string>
+
+namespace SceneGraph
+{
+
+struct LoadingError : public std::runtime_error {
+	LoadingError(const std::string &str) : std::runtime_error(str.c_str()) { }
+};
+
+}
+
+#endif
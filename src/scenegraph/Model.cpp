@@ -3,6 +3,8 @@
 
 #include "Model.h"
 #include "CollisionVisitor.h"
+#include "CollisionGeometry.h"
+#include "LOD.h"
 #include "NodeCopyCache.h"
 #include "graphics/Renderer.h"
 #include "graphics/TextureBuilder.h"
@@ -27,6 +29,10 @@ Model::Model(Graphics::Renderer *r, const std::string &name)
 : m_boundingRadius(10.f)
 , m_renderer(r)
 , m_name(name)
+, m_instancedNodesValid(false)
+, m_numSolidItems(0)
+, m_drawListValid(false)
+, m_drawMatricesValid(false)
 , m_curPatternIndex(0)
 , m_curPattern(0)
 , m_debugFlags(0)
@@ -43,12 +49,17 @@ Model::Model(const Model &model)
 , m_collMesh(model.m_collMesh) //might have to make this per-instance at some point
 , m_renderer(model.m_renderer)
 , m_name(model.m_name)
+, m_instancedNodesValid(false)
+, m_numSolidItems(0)
+, m_drawListValid(false)
+, m_drawMatricesValid(false)
+, m_impostor(model.m_impostor)
 , m_curPatternIndex(model.m_curPatternIndex)
 , m_curPattern(model.m_curPattern)
 , m_debugFlags(0)
 {
-	//selective copying of node structure
-	NodeCopyCache cache;
+	//selective copying of node structure, the rest is shared
+	NodeCopyCache cache(&model.GetInstancedNodes());
 	m_root.Reset(dynamic_cast<Group*>(model.m_root->Clone(&cache)));
 
 	//materials are shared by meshes
@@ -67,19 +78,13 @@ Model::Model(const Model &model)
 		SetPattern(0);
 	}
 
-	//animations need to be copied and retargeted
-	for (AnimationContainer::const_iterator it = model.m_animations.begin(); it != model.m_animations.end(); ++it) {
-		const Animation *anim = *it;
-		m_animations.push_back(new Animation(*anim));
-		m_animations.back()->UpdateChannelTargets(m_root.Get());
-	}
+	//animations share the keys and move this instance's copies
+	for (AnimationContainer::const_iterator it = model.m_animations.begin(); it != model.m_animations.end(); ++it)
+		m_animations.push_back(new Animation(**it, cache));
 
-	//m_tags needs to be updated
-	for (TagContainer::const_iterator it = model.m_tags.begin(); it != model.m_tags.end(); ++it) {
-		MatrixTransform *t = dynamic_cast<MatrixTransform*>(m_root->FindNode((*it)->GetName()));
-		assert(t != 0);
-		m_tags.push_back(t);
-	}
+	//tags are always copied
+	for (TagContainer::const_iterator it = model.m_tags.begin(); it != model.m_tags.end(); ++it)
+		m_tags.push_back(cache.Find(*it));
 }
 
 Model::~Model()
@@ -93,51 +98,201 @@ Model *Model::MakeInstance() const
 	return m;
 }
 
-void Model::Render(const matrix4x4f &trans, const RenderData *rd)
+// marks node if it's one an instance changes, or is above one
+static bool MarkInstanced(Node *node, const std::set<const Node*> &changed, std::set<const Node*> &out)
+{
+	bool instanced = changed.count(node) > 0;
+	if (dynamic_cast<Label3D*>(node)) {
+		instanced = true;
+	} else if (CollisionGeometry *cg = dynamic_cast<CollisionGeometry*>(node)) {
+		instanced = instanced || cg->IsDynamic();
+	} else if (MatrixTransform *mt = dynamic_cast<MatrixTransform*>(node)) {
+		//NavLights hangs an instance's lights on these
+		instanced = instanced || starts_with(mt->GetName(), "navlight_");
+	}
+
+	if (Group *group = dynamic_cast<Group*>(node)) {
+		for (unsigned int i = 0; i < group->GetNumChildren(); i++) {
+			if (MarkInstanced(group->GetChildAt(i), changed, out))
+				instanced = true;
+		}
+	}
+
+	if (instanced) out.insert(node);
+	return instanced;
+}
+
+const std::set<const Node*> &Model::GetInstancedNodes() const
 {
-	//update color parameters (materials are shared by model instances)
+	if (!m_instancedNodesValid) {
+		std::set<const Node*> changed;
+		for (AnimationContainer::const_iterator it = m_animations.begin(); it != m_animations.end(); ++it) {
+			for (unsigned int i = 0; i < (*it)->GetChannels().size(); i++)
+				changed.insert((*it)->GetTarget(i));
+		}
+		changed.insert(m_tags.begin(), m_tags.end());
+
+		m_instancedNodes.clear();
+		MarkInstanced(m_root.Get(), changed, m_instancedNodes);
+		m_instancedNodesValid = true;
+	}
+	return m_instancedNodes;
+}
+
+// Materials are shared by model instances, and the renderer takes no
+// parameters per draw, so they get this model's just before it's drawn
+void Model::SetMaterialParameters(const RenderData &params)
+{
+	//color parameters
 	if (m_curPattern) {
-		for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
-			if ((*it).second->GetDescriptor().usePatterns) {
-				(*it).second->texture4 = m_colorMap.GetTexture();
-				(*it).second->texture3 = m_curPattern;
-			}
+		for (std::vector<Graphics::Material*>::const_iterator it = m_patternMaterials.begin(); it != m_patternMaterials.end(); ++it) {
+			(*it)->texture4 = m_colorMap.GetTexture();
+			(*it)->texture3 = m_curPattern;
 		}
 	}
 
-	//update decals (materials and geometries are shared)
+	//decals (materials and geometries are shared)
 	for (unsigned int i=0; i < MAX_DECAL_MATERIALS; i++) {
 		if (m_decalMaterials[i]) {
 			m_decalMaterials[i]->texture0 = m_curDecals[i];
 		}
 	}
 
+	// Set atmospheric properties for rendering
+	for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
+		(*it).second->atmosphereColor = params.atmosColor;
+		(*it).second->atmosphereDensity = params.atmosDensity;
+	}
+}
+
+void Model::CompileNode(Node *node, Uint32 transform, Uint32 lod, unsigned int mask, bool checkMask,
+	std::vector<DrawItem> &transparent)
+{
+	Group *group = dynamic_cast<Group*>(node);
+	if (!group) {
+		//nothing to draw
+		if (dynamic_cast<CollisionGeometry*>(node)) return;
+		const DrawItem item = { node, transform, lod, checkMask };
+		if (mask & NODE_SOLID) m_drawItems.push_back(item);
+		if (mask & NODE_TRANSPARENT) transparent.push_back(item);
+		return;
+	}
+
+	if (MatrixTransform *mt = dynamic_cast<MatrixTransform*>(node)) {
+		const DrawTransform t = { mt, transform };
+		transform = m_drawTransforms.size();
+		m_drawTransforms.push_back(t);
+	}
+
+	if (LOD *lodNode = dynamic_cast<LOD*>(node)) {
+		for (unsigned int i = 0; i < group->GetNumChildren(); i++) {
+			const DrawLOD level = { lodNode, transform, int(i), lod };
+			m_drawLODs.push_back(level);
+			CompileNode(group->GetChildAt(i), transform, m_drawLODs.size()-1, mask, false, transparent);
+		}
+		return;
+	}
+
+	for (unsigned int i = 0; i < group->GetNumChildren(); i++) {
+		Node *child = group->GetChildAt(i);
+		//leaves' masks are looked at as they're drawn, they get switched
+		//on and off (navlights, shields)
+		if (dynamic_cast<Group*>(child)) {
+			if (child->GetNodeMask() & mask)
+				CompileNode(child, transform, lod, mask & child->GetNodeMask(), true, transparent);
+		} else
+			CompileNode(child, transform, lod, mask, true, transparent);
+	}
+}
+
+void Model::CompileDrawList()
+{
+	m_drawTransforms.clear();
+	m_drawLODs.clear();
+	m_drawItems.clear();
+	const DrawTransform modelTransform = { 0, 0 };
+	m_drawTransforms.push_back(modelTransform);
+	const DrawLOD always = { 0, 0, 0, 0 };
+	m_drawLODs.push_back(always);
+
+	std::vector<DrawItem> transparent;
+	CompileNode(m_root.Get(), 0, 0, NODE_SOLID | NODE_TRANSPARENT, false, transparent);
+	m_numSolidItems = m_drawItems.size();
+	m_drawItems.insert(m_drawItems.end(), transparent.begin(), transparent.end());
+
+	m_patternMaterials.clear();
+	for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
+		if ((*it).second->GetDescriptor().usePatterns)
+			m_patternMaterials.push_back((*it).second.Get());
+	}
+
+	m_drawMatrices.resize(m_drawTransforms.size());
+	m_viewMatrices.resize(m_drawTransforms.size());
+	m_lodActive.resize(m_drawLODs.size());
+	m_drawListValid = true;
+	m_drawMatricesValid = false;
+}
+
+void Model::UpdateDrawMatrices()
+{
+	//parents come before their kids
+	m_drawMatrices[0] = matrix4x4f::Identity();
+	for (size_t i = 1; i < m_drawTransforms.size(); i++) {
+		const DrawTransform &t = m_drawTransforms[i];
+		m_drawMatrices[i] = m_drawMatrices[t.parent] * t.node->GetTransform();
+	}
+	m_drawMatricesValid = true;
+}
+
+void Model::DrawList(const matrix4x4f &trans, RenderData &params)
+{
+	if (!m_drawListValid) CompileDrawList();
+	if (!m_drawMatricesValid) UpdateDrawMatrices();
+
+	for (size_t i = 0; i < m_drawMatrices.size(); i++)
+		m_viewMatrices[i] = trans * m_drawMatrices[i];
+
+	m_lodActive[0] = true;
+	for (size_t i = 1; i < m_drawLODs.size(); i++) {
+		const DrawLOD &l = m_drawLODs[i];
+		m_lodActive[i] = m_lodActive[l.parent] &&
+			l.node->SelectLevel(m_viewMatrices[l.transform], params.boundingRadius) == l.level;
+	}
+
+	for (size_t i = 0; i < m_drawItems.size(); i++) {
+		const DrawItem &item = m_drawItems[i];
+		params.nodemask = (i < m_numSolidItems) ? NODE_SOLID : NODE_TRANSPARENT;
+		if (!m_lodActive[item.lod]) continue;
+		if (item.checkMask && !(item.node->GetNodeMask() & params.nodemask)) continue;
+		item.node->Render(m_viewMatrices[item.transform], &params);
+	}
+}
+
+void Model::Render(const matrix4x4f &trans, const RenderData *rd)
+{
+	if (!rd && m_impostor.Valid() && m_impostor->Queue(this, trans))
+		return;
+
 	//Override renderdata if this model is called from ModelNode
 	RenderData params = (rd != 0) ? (*rd) : m_renderData;
 
+	if (!m_drawListValid) CompileDrawList();
+	SetMaterialParameters(params);
+
 	m_renderer->SetTransform(trans);
 	//using the entire model bounding radius for all nodes at the moment.
 	//BR could also be a property of Node.
 	params.boundingRadius = GetDrawClipRadius();
 
-	// Set atmospheric properties for rendering
-	for (MaterialContainer::const_iterator it = m_materials.begin(); it != m_materials.end(); ++it) {
-		(*it).second->atmosphereColor = params.atmosColor;
-		(*it).second->atmosphereDensity = params.atmosDensity;
-	}
-
-	//render in two passes, if this is the top-level model
 	if (m_debugFlags & DEBUG_WIREFRAME) {
 		m_renderer->SetWireFrameMode(true);
 	}
 
+	//submodels are drawn the old way, in whichever pass their parent is in
 	if (params.nodemask & MASK_IGNORE) {
 		m_root->Render(trans, &params);
 	} else {
-		params.nodemask = NODE_SOLID;
-		m_root->Render(trans, &params);
-		params.nodemask = NODE_TRANSPARENT;
-		m_root->Render(trans, &params);
+		DrawList(trans, params);
 	}
 
 	if (!m_debugFlags) {
@@ -206,7 +361,7 @@ void Model::DrawCollisionMesh()
 	if (!m_collMesh) return;
 
 	const vector3f *vertices = reinterpret_cast<const vector3f*>(m_collMesh->GetGeomTree()->GetVertices());
-	const Uint16 *indices = m_collMesh->GetGeomTree()->GetIndices();
+	const Uint32 *indices = m_collMesh->GetGeomTree()->GetIndices();
 	const unsigned int *triFlags = m_collMesh->GetGeomTree()->GetTriFlags();
 	const unsigned int numIndices = m_collMesh->GetGeomTree()->GetNumTris() * 3;
 
@@ -305,6 +460,8 @@ void Model::AddTag(const std::string &name, MatrixTransform *node)
 	node->SetNodeFlags(node->GetNodeFlags() | NODE_TAG);
 	m_root->AddChild(node);
 	m_tags.push_back(node);
+	m_instancedNodesValid = false;
+	m_drawListValid = false;
 }
 
 void Model::SetPattern(unsigned int index)
@@ -383,8 +540,10 @@ Animation *Model::FindAnimation(const std::string &name) const
 void Model::UpdateAnimations()
 {
 	// XXX WIP. Assuming animations are controlled manually by SetProgress.
-	for (AnimationContainer::iterator anim = m_animations.begin(); anim != m_animations.end(); ++anim)
-		(*anim)->Interpolate();
+	for (AnimationContainer::iterator anim = m_animations.begin(); anim != m_animations.end(); ++anim) {
+		if ((*anim)->Update())
+			m_drawMatricesValid = false;
+	}
 }
 
 void Model::SetThrust(const vector3f &lin, const vector3f &ang)
@@ -467,6 +626,7 @@ void Model::Load(Serializer::Reader &rd)
 {
 	LoadVisitor lv(&rd);
 	m_root->Accept(lv);
+	m_drawMatricesValid = false;
 
 	for (AnimationContainer::const_iterator i = m_animations.begin(); i != m_animations.end(); ++i)
 		(*i)->SetProgress(rd.Double());
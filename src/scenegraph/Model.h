@@ -55,6 +55,13 @@
  *  - 3D labels (well, 2D) on models
  *  - spaceship thrusters
  *
+ * Instances: MakeInstance() shares the geometry, materials, patterns, keys
+ * and everything in the node graph that's the same for every instance with
+ * the model. An instance copies only the nodes that can differ (animated
+ * and tag transforms, navlight transforms, labels, dynamic collision
+ * geometry) and the groups above them, and keeps its pattern, colours and
+ * decals. Instances must not outlive the model they were made from.
+ *
  * Things to optimize:
  *  - model cache
  *  - removing unnecessary nodes from the scene graph: pre-translate unanimated meshes etc.
@@ -63,7 +70,9 @@
 #include "Animation.h"
 #include "ColorMap.h"
 #include "Group.h"
+#include "Impostor.h"
 #include "Label3D.h"
+#include "LoadingError.h"
 #include "Pattern.h"
 #include "CollMesh.h"
 #include "graphics/Material.h"
@@ -71,19 +80,17 @@
 #include "Serializer.h"
 #include "DeleteEmitter.h"
 #include <stdexcept>
+#include <set>
 
 namespace Graphics { class Renderer; }
 
 namespace SceneGraph
 {
 class BaseLoader;
+class LOD;
 class ModelBinarizer;
 class BinaryConverter;
 
-struct LoadingError : public std::runtime_error {
-	LoadingError(const std::string &str) : std::runtime_error(str.c_str()) { }
-};
-
 typedef std::vector<std::pair<std::string, RefCountedPtr<Graphics::Material> > > MaterialContainer;
 typedef std::vector<Animation*> AnimationContainer;
 typedef std::vector<MatrixTransform *> TagContainer;
@@ -104,6 +111,11 @@ public:
 
 	float GetDrawClipRadius() const { return m_boundingRadius; }
 	void Render(const matrix4x4f &trans, const RenderData *rd = 0); //ModelNode can override RD
+	//the node graph is flattened for drawing. call after adding or removing
+	//nodes, or changing a group's node mask, once the model's been drawn
+	void InvalidateDrawList() { m_drawListValid = false; }
+	//drawn as an impostor when small on screen (see Impostor)
+	void EnableImpostor() { m_impostor = Impostor::ForModel(m_name); }
 	RefCountedPtr<CollMesh> CreateCollisionMesh();
 	RefCountedPtr<CollMesh> GetCollisionMesh() const { return m_collMesh; }
 	RefCountedPtr<Group> GetRoot() { return m_root; }
@@ -167,6 +179,35 @@ public:
 private:
 	Model(const Model&);
 
+	// the nodes an instance needs its own copies of
+	const std::set<const Node*> &GetInstancedNodes() const;
+
+	// The draw list: every node that draws, with the transform and LOD
+	// level it's under, solid pass first. Transforms are in model space and
+	// only worked out again when an animation moves.
+	struct DrawTransform {
+		MatrixTransform *node;
+		Uint32 parent;
+	};
+	struct DrawLOD {
+		LOD *node;
+		Uint32 transform;
+		int level;
+		Uint32 parent;
+	};
+	struct DrawItem {
+		Node *node;
+		Uint32 transform;
+		Uint32 lod;
+		bool checkMask; //false for LOD levels, which draw whatever their mask
+	};
+	void CompileDrawList();
+	void CompileNode(Node *node, Uint32 transform, Uint32 lod, unsigned int mask, bool checkMask,
+		std::vector<DrawItem> &transparent);
+	void UpdateDrawMatrices();
+	void DrawList(const matrix4x4f &trans, RenderData &params);
+	void SetMaterialParameters(const RenderData &params);
+
 	static const unsigned int MAX_DECAL_MATERIALS = 4;
 	ColorMap m_colorMap;
 	float m_boundingRadius;
@@ -180,6 +221,20 @@ private:
 	std::vector<Animation *> m_animations;
 	TagContainer m_tags; //named attachment points
 	RenderData m_renderData;
+	mutable std::set<const Node*> m_instancedNodes;
+	mutable bool m_instancedNodesValid;
+
+	std::vector<DrawTransform> m_drawTransforms; //[0] is the model
+	std::vector<DrawLOD> m_drawLODs; //[0] is always on
+	std::vector<DrawItem> m_drawItems;
+	size_t m_numSolidItems;
+	std::vector<Graphics::Material*> m_patternMaterials;
+	std::vector<matrix4x4f> m_drawMatrices;
+	std::vector<matrix4x4f> m_viewMatrices;
+	std::vector<bool> m_lodActive;
+	bool m_drawListValid;
+	bool m_drawMatricesValid;
+	RefCountedPtr<Impostor> m_impostor;
 
 	//per-instance flavour data
 	unsigned int m_curPatternIndex;
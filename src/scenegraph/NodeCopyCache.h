@@ -6,6 +6,7 @@
 
 #include "RefCounted.h"
 #include <map>
+#include <set>
 
 namespace SceneGraph {
 
@@ -13,6 +14,15 @@ class Node;
 
 class NodeCopyCache {
 public:
+	NodeCopyCache() : m_instanced(0) { }
+	// copies only the nodes in instanced, the rest are shared with the
+	// original graph
+	explicit NodeCopyCache(const std::set<const Node*> *instanced) : m_instanced(instanced) { }
+
+	bool IsShared(const Node *origNode) const {
+		return m_instanced && m_instanced->find(origNode) == m_instanced->end();
+	}
+
 	template <typename T> T *Copy(const T *origNode) {
 		const bool doCache = origNode->GetRefCount() > 1;
 		if (doCache) {
@@ -21,13 +31,19 @@ public:
 				return static_cast<T*>((*i).second);
 		}
 		T *newNode = new T(*origNode, this);
-		if (doCache)
-			m_cache.insert(std::make_pair(origNode, newNode));
+		m_cache.insert(std::make_pair(origNode, newNode));
 		return newNode;
 	}
 
+	// the copy of origNode, or origNode itself if it wasn't copied
+	template <typename T> T *Find(T *origNode) const {
+		std::map<const Node*,Node*>::const_iterator i = m_cache.find(origNode);
+		return (i != m_cache.end()) ? static_cast<T*>((*i).second) : origNode;
+	}
+
 private:
 	std::map<const Node*,Node*> m_cache;
+	const std::set<const Node*> *m_instanced;
 };
 
 }
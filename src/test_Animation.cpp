@@ -0,0 +1,168 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "scenegraph/Animation.h"
+#include "scenegraph/MatrixTransform.h"
+#include "scenegraph/NodeCopyCache.h"
+#include "Random.h"
+
+using namespace std;
+using namespace SceneGraph;
+
+namespace {
+	// made up in the shape of a station's docking animation: doors, clamps
+	// and a lift for each pad, keyed at 24 frames a second the way the
+	// exporter writes them. F7 in the model viewer times the real ones
+	Animation *MakeDocking(Random &rng, int numPads, double duration, vector< RefCountedPtr<MatrixTransform> > &nodes) {
+		const int CHANNELS_PER_PAD = 8;
+		const int numKeys = int(duration * 24.0) + 1;
+		Animation *anim = new Animation("docking_pad", duration);
+		for (int c = 0; c < numPads * CHANNELS_PER_PAD; c++) {
+			MatrixTransform *node = new MatrixTransform(0, matrix4x4f::Identity());
+			nodes.push_back(RefCountedPtr<MatrixTransform>(node));
+			AnimationChannel chan(node);
+			const vector3f axis = vector3f(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0)).Normalized();
+			const float turn = float(rng.Double(0.1, 3.0));
+			// some only move for part of it, and some hold still at the ends
+			const int first = (c % 3 == 0) ? numKeys / 4 : 0;
+			for (int k = first; k < numKeys; k++) {
+				const double t = k / 24.0;
+				const float s = float(t / duration);
+				chan.positionKeys.push_back(PositionKey(t, vector3f(s * 10.f, float(c), sin(s * 6.f))));
+				chan.rotationKeys.push_back(RotationKey(t, Quaternionf(turn * s, axis)));
+				if (c % 4 == 0)
+					chan.scaleKeys.push_back(ScaleKey(t, vector3f(1.f + s, 1.f, 1.f)));
+			}
+			anim->AddChannel(chan);
+		}
+		return anim;
+	}
+
+	template <typename Key>
+	unsigned int ScanKeys(const vector<Key> &keys, double t) {
+		unsigned int frame = 0;
+		while (frame + 1 < keys.size() && t >= keys[frame+1].time)
+			frame++;
+		return frame;
+	}
+
+	template <typename Key>
+	float Factor(const Key &a, const Key &b, double t) {
+		return Clamp(float((t - a.time) / (b.time - a.time)), 0.f, 1.f);
+	}
+
+	// what Interpolate did before it kept cursors: a search from the first
+	// key of every track, every time
+	matrix4x4f ScanChannel(const AnimationChannel &chan, const matrix4x4f &current, double t) {
+		matrix4x4f trans = current;
+		if (!chan.rotationKeys.empty()) {
+			const unsigned int frame = ScanKeys(chan.rotationKeys, t);
+			const RotationKey &a = chan.rotationKeys[frame];
+			const vector3f saved_position = trans.GetTranslate();
+			if (frame + 1 < chan.rotationKeys.size()) {
+				const RotationKey &b = chan.rotationKeys[frame + 1];
+				trans = Quaternionf::Slerp(a.rotation, b.rotation, Factor(a, b, t)).ToMatrix3x3<float>();
+			} else
+				trans = a.rotation.ToMatrix3x3<float>();
+			trans.SetTranslate(saved_position);
+		}
+		if (!chan.scaleKeys.empty() && !chan.rotationKeys.empty()) {
+			const unsigned int frame = ScanKeys(chan.scaleKeys, t);
+			const ScaleKey &a = chan.scaleKeys[frame];
+			vector3f out = a.scale;
+			if (frame + 1 < chan.scaleKeys.size()) {
+				const ScaleKey &b = chan.scaleKeys[frame + 1];
+				out = a.scale + (b.scale - a.scale) * Factor(a, b, t);
+			}
+			trans.Scale(out.x, out.y, out.z);
+		}
+		if (!chan.positionKeys.empty()) {
+			const unsigned int frame = ScanKeys(chan.positionKeys, t);
+			const PositionKey &a = chan.positionKeys[frame];
+			vector3f out = a.position;
+			if (frame + 1 < chan.positionKeys.size()) {
+				const PositionKey &b = chan.positionKeys[frame + 1];
+				out = a.position + (b.position - a.position) * Factor(a, b, t);
+			}
+			trans.SetTranslate(out);
+		}
+		return trans;
+	}
+
+	float MaxDifference(const matrix4x4f &a, const matrix4x4f &b) {
+		float d = 0.f;
+		for (int i = 0; i < 16; i++)
+			d = std::max(d, fabs(a[i] - b[i]));
+		return d;
+	}
+}
+
+// Checks keyframe lookup gives what a full search does
+void test_animation() {
+
+	cout << "--------------------------" << endl;
+	cout << "Running animation tests" << endl;
+	cout << "--------------------------" << endl;
+
+	Random rng(0xdeadbeef);
+	const double DURATION = 12.0;
+	vector< RefCountedPtr<MatrixTransform> > nodes;
+	Animation *docking = MakeDocking(rng, 4, DURATION, nodes);
+	const vector<AnimationChannel> &channels = docking->GetChannels();
+
+	// forwards a frame at a time, then all over the place, with the same
+	// result as a search from the start
+	{
+		vector<double> progress;
+		for (int i = 0; i <= 600; i++)
+			progress.push_back(i / 600.0);
+		for (int i = 0; i < 600; i++)
+			progress.push_back(rng.Double(-0.1, 1.1));
+		float worst = 0.f;
+		for (unsigned int p = 0; p < progress.size(); p++) {
+			vector<matrix4x4f> before(channels.size());
+			for (unsigned int c = 0; c < channels.size(); c++)
+				before[c] = docking->GetTarget(c)->GetTransform();
+			docking->SetProgress(progress[p]);
+			docking->Interpolate();
+			const double t = Clamp(progress[p], 0.0, 1.0) * DURATION;
+			for (unsigned int c = 0; c < channels.size(); c++)
+				worst = std::max(worst, MaxDifference(docking->GetTarget(c)->GetTransform(), ScanChannel(channels[c], before[c], t)));
+		}
+		cout << "key lookup: " << (worst < 1e-5f ? "pass" : "fail") << " (" << worst << ")" << endl;
+	}
+
+	// an instance plays its copies of the nodes the same way, keeping its
+	// own place in the keys
+	{
+		NodeCopyCache cache;
+		vector< RefCountedPtr<MatrixTransform> > copies;
+		for (unsigned int c = 0; c < channels.size(); c++)
+			copies.push_back(RefCountedPtr<MatrixTransform>(static_cast<MatrixTransform*>(channels[c].node->Clone(&cache))));
+		Animation *instance = new Animation(*docking, cache);
+		float worst = 0.f;
+		for (int i = 0; i < 600; i++) {
+			instance->SetProgress(i / 600.0);
+			instance->Interpolate();
+			docking->SetProgress(rng.Double());
+			docking->Interpolate();
+			docking->SetProgress(i / 600.0);
+			docking->Interpolate();
+			for (unsigned int c = 0; c < channels.size(); c++) {
+				if (instance->GetTarget(c) != copies[c].Get()) worst = 1.f;
+				worst = std::max(worst, MaxDifference(instance->GetTarget(c)->GetTransform(), docking->GetTarget(c)->GetTransform()));
+			}
+		}
+		cout << "instances: " << (worst < 1e-5f ? "pass" : "fail") << " (" << worst << ")" << endl;
+		delete instance;
+	}
+
+	delete docking;
+
+	cout << "--------------------------" << endl;
+	cout << "End of animation tests." << endl;
+	cout << "--------------------------" << endl;
+}
@@ -0,0 +1,141 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <list>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "BodyRegistry.h"
+#include "Random.h"
+
+using namespace std;
+
+namespace {
+	// stands in for Body: "ships" hear about everything, "projectiles" only
+	// point at the ship that fired them
+	struct TestBody {
+		TestBody(bool ship) : m_registrySlot(BodyRegistry<TestBody>::INVALID_SLOT), isShip(ship), isWatcher(false), parent(0), notified(0), killed(0), added(0), left(false) {}
+
+		bool ObservesAllRemovals() const { return isShip; }
+		bool ObservesAdditions() const { return isWatcher; }
+		bool IsReferenceable() const { return isShip; }
+		void NotifyRemoved(const TestBody *b) {
+			notified++;
+			if (parent == b) parent = 0;
+		}
+		void NotifyAdded(TestBody *b) { added++; }
+		void NotifyLeftSpace() { left = true; }
+
+		Uint32 m_registrySlot;
+		bool isShip;
+		bool isWatcher; // like the player's sensors
+		const TestBody *parent;
+		int notified;
+		int killed;
+		int added;
+		bool left;
+	};
+
+	double Millis(chrono::steady_clock::time_point start) {
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	}
+}
+
+// Test suite and stress benchmark for the Space body registry
+void test_bodyregistry() {
+
+	cout << "--------------------------" << endl;
+	cout << "Running body registry tests" << endl;
+	cout << "--------------------------" << endl;
+
+	const int NUM_BODIES = 10000;
+	const int NUM_SHIPS = 100;
+
+	Random rng(0xbadf00d);
+
+	vector<TestBody*> bodies;
+	vector<TestBody*> killOrder;
+	for (int i=0; i<NUM_BODIES; ++i) {
+		TestBody *b = new TestBody(i < NUM_SHIPS);
+		if (!b->isShip) b->parent = bodies[rng.Int32(NUM_SHIPS)];
+		bodies.push_back(b);
+	}
+	killOrder = bodies;
+	for (int i=NUM_BODIES-1; i>0; --i)
+		swap(killOrder[i], killOrder[rng.Int32(i+1)]);
+	for (int i=0; i<NUM_BODIES; ++i)
+		killOrder[i]->killed = i;
+
+	// spawn everything, then kill it all in a random order
+	BodyRegistry<TestBody> reg;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	for (TestBody *b : bodies) {
+		reg.Add(b);
+		if (b->parent) reg.Subscribe(b, b->parent);
+	}
+	const double addTime = Millis(start);
+
+	cout << "add: " << (reg.Size() == size_t(NUM_BODIES) ? "pass" : "fail") << endl;
+
+	BodyRegistry<TestBody>::Handle firstHandle = reg.GetHandle(bodies[NUM_SHIPS]);
+	cout << "handle lookup: " << (reg.Get(firstHandle) == bodies[NUM_SHIPS] ? "pass" : "fail") << endl;
+
+	start = chrono::steady_clock::now();
+	for (TestBody *b : killOrder) reg.Remove(b);
+	const double removeTime = Millis(start);
+
+	cout << "remove: " << (reg.Size() == 0 ? "pass" : "fail") << endl;
+	cout << "stale handle: " << (reg.Get(firstHandle) == 0 ? "pass" : "fail") << endl;
+
+	// every projectile whose parent died first heard about it, and nobody
+	// heard about projectiles they didn't subscribe to
+	bool cleared = true;
+	for (TestBody *b : bodies) {
+		if (b->parent && b->parent->killed < b->killed) cleared = false;
+		if (!b->parent && !b->isShip && b->notified != 1) cleared = false;
+		if (!b->isShip && b->notified > 1) cleared = false;
+		if (b->isShip && b->notified >= NUM_SHIPS) cleared = false;
+	}
+	cout << "notifications: " << (cleared ? "pass" : "fail") << endl;
+
+	// slots are reused, old handles stay stale
+	reg.Add(bodies[0]);
+	cout << "slot reuse: " << (reg.Get(firstHandle) == 0 && reg.Get(reg.GetHandle(bodies[0])) == bodies[0] ? "pass" : "fail") << endl;
+	reg.Remove(bodies[0]);
+
+	// a watcher hears about the bodies there before it and the ones after,
+	// and that it's left
+	{
+		TestBody watcher(false);
+		watcher.isWatcher = true;
+		for (int i = 0; i < 10; i++) reg.Add(bodies[i]);
+		reg.Add(&watcher);
+		for (int i = 10; i < 15; i++) reg.Add(bodies[i]);
+		reg.Remove(&watcher);
+		reg.Add(bodies[15]);
+		cout << "add notifications: " << (watcher.added == 15 && watcher.left ? "pass" : "fail") << endl;
+		for (int i = 0; i < 16; i++) reg.Remove(bodies[i]);
+	}
+
+	// the old way, for comparison: a list, a linear remove, and everyone
+	// told about everything
+	for (TestBody *b : bodies) b->notified = 0;
+	list<TestBody*> naive;
+	start = chrono::steady_clock::now();
+	for (TestBody *b : bodies) naive.push_back(b);
+	for (TestBody *b : killOrder) {
+		for (TestBody *o : naive) o->NotifyRemoved(b);
+		naive.remove(b);
+	}
+	const double naiveTime = Millis(start);
+
+	cout << NUM_BODIES << " bodies: add " << addTime << "ms, remove " << removeTime
+		<< "ms (list with notify-all: " << naiveTime << "ms)" << endl;
+
+	for (TestBody *b : bodies) delete b;
+
+	cout << "--------------------------" << endl;
+	cout << "End of body registry tests." << endl;
+	cout << "--------------------------" << endl;
+}
@@ -0,0 +1,290 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <vector>
+#include "collider/collider.h"
+#include "collider/GeomTree.h"
+#include "collider/Geom.h"
+#include "Random.h"
+#include "SDL.h"
+
+using namespace std;
+
+namespace {
+	// A surface of revolution, u round the axis and v round the section,
+	// as the arrays a GeomTree takes (and owns)
+	template <typename F>
+	GeomTree *MakeMesh(int uSegs, int vSegs, bool closedV, F pointAt) {
+		const int vRows = closedV ? vSegs : vSegs+1;
+		const int numVerts = uSegs * vRows;
+		float *verts = new float[numVerts*3];
+		for (int u=0; u<uSegs; u++) {
+			for (int v=0; v<vRows; v++) {
+				const vector3d p = pointAt(2.0*M_PI*u/uSegs, (closedV ? 2.0 : 1.0)*M_PI*v/vSegs);
+				float *out = &verts[3*(u*vRows + v)];
+				out[0] = float(p.x); out[1] = float(p.y); out[2] = float(p.z);
+			}
+		}
+		const int numTris = uSegs*vSegs*2;
+		Uint32 *indices = new Uint32[numTris*3];
+		Uint32 *idx = indices;
+		for (int u=0; u<uSegs; u++) {
+			for (int v=0; v<vSegs; v++) {
+				const Uint32 a = u*vRows + v;
+				const Uint32 b = ((u+1)%uSegs)*vRows + v;
+				const Uint32 c = ((u+1)%uSegs)*vRows + (v+1)%vRows;
+				const Uint32 d = u*vRows + (v+1)%vRows;
+				*idx++ = a; *idx++ = b; *idx++ = c;
+				*idx++ = a; *idx++ = c; *idx++ = d;
+			}
+		}
+		unsigned int *flags = new unsigned int[numTris];
+		for (int i=0; i<numTris; i++) flags[i] = 0;
+		return new GeomTree(numVerts, numTris, verts, indices, flags);
+	}
+
+	// stand-ins for the real models: a station ring and a ship hull
+	GeomTree *MakeStation() {
+		return MakeMesh(160, 64, true, [](double u, double v) {
+			const double r = 500.0 + 60.0*cos(v);
+			return vector3d(r*cos(u), 60.0*sin(v), r*sin(u));
+		});
+	}
+	GeomTree *MakeShip() {
+		return MakeMesh(32, 32, false, [](double u, double v) {
+			return vector3d(15.0*sin(v)*cos(u), 5.0*sin(v)*sin(u), 25.0*cos(v));
+		});
+	}
+
+	// every triangle, no tree
+	isect_t BruteForceTrace(const GeomTree *g, const vector3d &o, const vector3d &d, double len) {
+		isect_t isect;
+		isect.triIdx = -1;
+		isect.dist = float(len);
+		double best = len;
+		const float *verts = g->GetVertices();
+		const Uint32 *indices = g->GetIndices();
+		for (int i=0; i<g->GetNumTris(); i++) {
+			const vector3d a(&verts[3*indices[3*i]]);
+			const vector3d e1 = vector3d(&verts[3*indices[3*i+1]]) - a;
+			const vector3d e2 = vector3d(&verts[3*indices[3*i+2]]) - a;
+			const vector3d p = d.Cross(e2);
+			const double det = e1.Dot(p);
+			if (det == 0.0) continue;
+			const vector3d t = o - a;
+			const double u = t.Dot(p) / det;
+			const vector3d q = t.Cross(e1);
+			const double v = d.Dot(q) / det;
+			const double dist = e2.Dot(q) / det;
+			if (u >= 0.0 && v >= 0.0 && u+v <= 1.0 && dist > 0.0 && dist < best) {
+				best = dist;
+				isect.triIdx = i;
+				isect.dist = float(dist);
+			}
+		}
+		return isect;
+	}
+
+	// brute force edge collision, how many of a's edges go through b
+	int BruteForceEdgeHits(const GeomTree *a, const matrix4x4d &aToB, const GeomTree *b) {
+		int hits = 0;
+		for (int i=0; i<a->GetNumEdges(); i++) {
+			const GeomTree::Edge &e = a->GetEdges()[i];
+			const vector3d from = aToB * vector3d(&a->GetVertices()[e.v1i]);
+			const vector3d dir = aToB.ApplyRotationOnly(vector3d(e.dir.x, e.dir.y, e.dir.z));
+			if (BruteForceTrace(b, from, dir, e.len).triIdx != -1) hits++;
+		}
+		return hits;
+	}
+
+	vector<CollisionContact> s_contacts;
+	void ContactCallback(CollisionContact *c) { s_contacts.push_back(*c); }
+
+	vector3d RandomDir(Random &rng) {
+		vector3d d;
+		do {
+			d = vector3d(rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0), rng.Double(-1.0, 1.0));
+		} while (d.LengthSqr() > 1.0 || d.LengthSqr() < 1e-6);
+		return d.Normalized();
+	}
+}
+
+// Checks tracing and mesh collisions against doing it the slow way, and
+// says how fast they are
+void test_collision() {
+
+	cout << "--------------------------" << endl;
+	cout << "Running collision tests" << endl;
+	cout << "--------------------------" << endl;
+
+	Random rng(0xc0111de);
+
+	Uint32 t = SDL_GetTicks();
+	GeomTree *station = MakeStation();
+	GeomTree *ship = MakeShip();
+	cout << "built " << station->GetNumTris() << " + " << ship->GetNumTris() << " tri trees in "
+		<< SDL_GetTicks() - t << "ms" << endl;
+
+	// rays from all round the station, at points on and near the ring
+	const int NUM_RAYS = 200000;
+	const double RAY_LEN = 3000.0;
+	vector<vector3f> origins(NUM_RAYS), dirs(NUM_RAYS);
+	for (int i=0; i<NUM_RAYS; i++) {
+		const vector3d o = RandomDir(rng) * 1500.0;
+		const double a = rng.Double(2.0*M_PI);
+		const vector3d target = vector3d(500.0*cos(a), 0.0, 500.0*sin(a)) + RandomDir(rng)*80.0;
+		origins[i] = vector3f(o);
+		dirs[i] = vector3f((target - o).Normalized());
+	}
+
+	vector<isect_t> isects(NUM_RAYS);
+	int numHits = 0;
+	GeomTree::stats_rayTriIntersections = 0;
+	t = SDL_GetTicks();
+	for (int i=0; i<NUM_RAYS; i++) {
+		isects[i].triIdx = -1;
+		isects[i].dist = float(RAY_LEN);
+		station->TraceRay(origins[i], dirs[i], &isects[i]);
+		if (isects[i].triIdx != -1) numHits++;
+	}
+	t = std::max(SDL_GetTicks() - t, Uint32(1));
+	cout << NUM_RAYS << " rays (" << numHits << " hits) in " << t << "ms, "
+		<< (1000.0*NUM_RAYS/t) << " rays/sec, "
+		<< (double(GeomTree::stats_rayTriIntersections)/NUM_RAYS) << " tri tests per ray" << endl;
+
+	// a ray that grazes an edge between two triangles may hit either
+	int mismatches = 0;
+	const int NUM_CHECKED = 2000;
+	for (int i=0; i<NUM_CHECKED; i++) {
+		const isect_t check = BruteForceTrace(station, vector3d(origins[i]), vector3d(dirs[i]), RAY_LEN);
+		if ((check.triIdx == -1) != (isects[i].triIdx == -1) ||
+			fabs(check.dist - isects[i].dist) > 1e-3 * check.dist)
+			mismatches++;
+	}
+	cout << "rays match brute force: " << (mismatches == 0 ? "pass" : "fail") << " ("
+		<< mismatches << " of " << NUM_CHECKED << " differ)" << endl;
+
+	// coherent rays give the same answers as one at a time
+	bool coherentOk = true;
+	const int BUNDLE = 16;
+	for (int i=0; i+BUNDLE <= 4000; i+=BUNDLE) {
+		isect_t bundle[BUNDLE];
+		for (int j=0; j<BUNDLE; j++) {
+			bundle[j].triIdx = -1;
+			bundle[j].dist = float(RAY_LEN);
+		}
+		station->TraceCoherentRays(BUNDLE, origins[i], &dirs[i], bundle);
+		for (int j=0; j<BUNDLE; j++) {
+			isect_t single;
+			single.triIdx = -1;
+			single.dist = float(RAY_LEN);
+			station->TraceRay(origins[i], dirs[i+j], &single);
+			if (single.triIdx != bundle[j].triIdx || single.dist != bundle[j].dist) coherentOk = false;
+		}
+	}
+	cout << "coherent rays: " << (coherentOk ? "pass" : "fail") << endl;
+
+	// the ship poking into the ring, and just clear of it
+	Geom stationGeom(station), shipGeom(ship);
+	stationGeom.SetUserData(station);
+	shipGeom.SetUserData(ship);
+	matrix4x4d shipOrient = matrix4x4d::RotateYMatrix(0.3) * matrix4x4d::RotateXMatrix(0.2);
+	shipGeom.MoveTo(shipOrient, vector3d(0.0, 65.0, 500.0));
+	const matrix4x4d shipToStation = stationGeom.GetInvTransform() * shipGeom.GetTransform();
+	const matrix4x4d stationToShip = shipGeom.GetInvTransform() * stationGeom.GetTransform();
+
+	s_contacts.clear();
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	const int bruteHits = BruteForceEdgeHits(ship, shipToStation, station) + BruteForceEdgeHits(station, stationToShip, ship);
+	bool contactsOk = !s_contacts.empty() && bruteHits > 0;
+	for (size_t i=0; i<s_contacts.size(); i++) {
+		const CollisionContact &c = s_contacts[i];
+		if (c.depth <= 0.0) contactsOk = false;
+		// on the triangle it says it hit
+		const GeomTree *hit = static_cast<const GeomTree*>(c.userData2);
+		const Geom &hitGeom = (hit == station) ? stationGeom : shipGeom;
+		const vector3d local = hitGeom.GetInvTransform() * c.pos;
+		const vector3d a(&hit->GetVertices()[3*hit->GetIndices()[3*c.triIdx]]);
+		const vector3f n = hit->GetTriNormal(c.triIdx);
+		if (fabs((local - a).Dot(vector3d(n.x, n.y, n.z))) > 1e-2) contactsOk = false;
+	}
+	cout << "touching contacts: " << (contactsOk ? "pass" : "fail") << " ("
+		<< s_contacts.size() << " contacts, " << bruteHits << " edges through by brute force)" << endl;
+
+	shipGeom.MoveTo(shipOrient, vector3d(0.0, 95.0, 500.0));
+	s_contacts.clear();
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	const int clearHits = BruteForceEdgeHits(ship, stationGeom.GetInvTransform() * shipGeom.GetTransform(), station);
+	cout << "clear of the ring: " << (s_contacts.empty() && clearHits == 0 ? "pass" : "fail") << endl;
+
+	// contact generation, the ship at a few places along the ring
+	const int NUM_COLLIDES = 2000;
+	size_t numContacts = 0;
+	t = SDL_GetTicks();
+	for (int i=0; i<NUM_COLLIDES; i++) {
+		const double a = 0.01 * i;
+		shipGeom.MoveTo(shipOrient, vector3d(500.0*cos(a), 62.0, 500.0*sin(a)));
+		s_contacts.clear();
+		shipGeom.Collide(&stationGeom, ContactCallback);
+		numContacts += s_contacts.size();
+	}
+	t = std::max(SDL_GetTicks() - t, Uint32(1));
+	cout << NUM_COLLIDES << " ship/station collisions (" << numContacts << " contacts) in " << t << "ms, "
+		<< (1000.0*numContacts/t) << " contacts/sec" << endl;
+
+	// a sphere flying in along x at the outside of the ring, which has a
+	// vertex right at (560,0,0)
+	isect_t sweep;
+	sweep.triIdx = -1;
+	sweep.dist = 1000.0f;
+	station->SweepSphere(vector3f(1000.0f, 0.0f, 0.0f), vector3f(-1.0f, 0.0f, 0.0f), 10.0f, &sweep);
+	const bool sphereHit = sweep.triIdx != -1 && fabs(sweep.dist - 430.0f) < 0.01f;
+	sweep.triIdx = -1;
+	sweep.dist = 1000.0f;
+	station->SweepSphere(vector3f(1000.0f, 71.0f, 0.0f), vector3f(-1.0f, 0.0f, 0.0f), 10.0f, &sweep);
+	cout << "swept sphere: " << (sphereHit && sweep.triIdx == -1 ? "pass" : "fail") << endl;
+
+	// the ship going through the ring's tube in one step: overlap tests at
+	// either end of it find nothing, the sweep finds where it hits
+	shipGeom.SetMotion(vector3d(0.0));
+	const vector3d sweepStart(0.0, 0.0, 800.0), sweepMotion(0.0, 0.0, -600.0);
+	shipGeom.MoveTo(shipOrient, sweepStart);
+	CollisionContact sweepContact;
+	const bool swept = shipGeom.Sweep(&stationGeom, sweepMotion, &sweepContact);
+	const double sweepDist = sweepContact.dist;
+	s_contacts.clear();
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	shipGeom.MoveTo(shipOrient, sweepStart + sweepMotion);
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	const bool endsClear = s_contacts.empty();
+	// just short of the hit it's clear, just past it the meshes overlap
+	shipGeom.MoveTo(shipOrient, sweepStart + sweepMotion.Normalized()*(sweepDist - 0.5));
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	const bool beforeClear = s_contacts.empty();
+	shipGeom.MoveTo(shipOrient, sweepStart + sweepMotion.Normalized()*(sweepDist + 0.5));
+	shipGeom.Collide(&stationGeom, ContactCallback);
+	const bool afterHit = !s_contacts.empty();
+	cout << "swept ship: " << (endsClear && swept && beforeClear && afterHit ? "pass" : "fail")
+		<< " (hits after " << sweepDist << "m)" << endl;
+
+	const int NUM_SWEEPS = 1000;
+	int numSweepHits = 0;
+	shipGeom.MoveTo(shipOrient, sweepStart);
+	t = SDL_GetTicks();
+	for (int i=0; i<NUM_SWEEPS; i++) {
+		const double a = 2.0*M_PI*i/NUM_SWEEPS;
+		shipGeom.MoveTo(shipOrient, vector3d(800.0*cos(a), rng.Double(-80.0, 80.0), 800.0*sin(a)));
+		if (shipGeom.Sweep(&stationGeom, vector3d(-600.0*cos(a), 0.0, -600.0*sin(a)), &sweepContact)) numSweepHits++;
+	}
+	t = std::max(SDL_GetTicks() - t, Uint32(1));
+	cout << NUM_SWEEPS << " ship sweeps (" << numSweepHits << " hits) in " << t << "ms, "
+		<< (1000.0*NUM_SWEEPS/t) << " sweeps/sec" << endl;
+
+	delete ship;
+	delete station;
+
+	cout << "--------------------------" << endl;
+	cout << "End of collision tests." << endl;
+	cout << "--------------------------" << endl;
+}
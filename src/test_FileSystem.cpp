@@ -3,8 +3,11 @@
 
 #include "FileSystem.h"
 #include "FileSourceZip.h"
+#include "FileSourceArchive.h"
 #include "utils.h"
+#include "SDL.h"
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
 
 static const char *ftype_name(const FileSystem::FileInfo &info) {
@@ -80,6 +83,76 @@ void test_enum_models(FileSystem::FileSource &fs)
 	}
 }
 
+// reads every file under fs, returns the bytes read
+static size_t read_all(FileSystem::FileSource &fs, const std::vector<std::string> &paths)
+{
+	size_t bytes = 0;
+	for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++it) {
+		RefCountedPtr<FileSystem::FileData> data = fs.ReadFile(*it);
+		if (data) bytes += data->GetSize();
+	}
+	return bytes;
+}
+
+// packs data, then checks the archive has the same files and directories
+// with the same contents, and times reading them all each way
+void test_archive(FileSystem::FileSource &data)
+{
+	using namespace FileSystem;
+
+	const std::string archiveName("test_data.pak");
+	FILE *out = userFiles.OpenWriteStream(archiveName);
+	if (!out) {
+		printf("archive: couldn't write %s\n", archiveName.c_str());
+		return;
+	}
+	Uint32 t = SDL_GetTicks();
+	const Uint64 sourceTime = NewestModTime(data.GetRoot());
+	const bool packed = PackArchive(data, out, sourceTime);
+	fclose(out);
+	printf("archive: packed in %ums: %s\n", SDL_GetTicks() - t, packed ? "pass" : "fail");
+
+	FileSourceArchive archive(JoinPath(userFiles.GetRoot(), archiveName), data.IsTrusted());
+	printf("archive: source time: %s\n", (sourceTime && archive.GetSourceTime() == sourceTime) ? "pass" : "fail");
+	std::vector<std::string> paths;
+	int dirs = 0, mismatches = 0;
+	for (FileEnumerator files(data, "", FileEnumerator::Recurse | FileEnumerator::IncludeDirs); !files.Finished(); files.Next()) {
+		const FileInfo &fi = files.Current();
+		const FileInfo ai = archive.Lookup(fi.GetPath());
+		if (ai.GetType() != fi.GetType()) {
+			printf("archive: %s is %s, should be %s\n", fi.GetPath().c_str(), ftype_name(ai), ftype_name(fi));
+			mismatches++;
+		} else if (ai.GetSource().IsTrusted() != fi.GetSource().IsTrusted()) {
+			printf("archive: %s isn't trusted as it should be\n", fi.GetPath().c_str());
+			mismatches++;
+		} else if (fi.IsDir()) {
+			std::vector<FileInfo> a, b;
+			data.ReadDirectory(fi.GetPath(), a);
+			archive.ReadDirectory(fi.GetPath(), b);
+			if (a.size() != b.size()) mismatches++;
+			dirs++;
+		} else {
+			RefCountedPtr<FileData> a = data.ReadFile(fi.GetPath());
+			RefCountedPtr<FileData> b = archive.ReadFile(fi.GetPath());
+			if (!b || a->GetSize() != b->GetSize() || memcmp(a->GetData(), b->GetData(), a->GetSize()) != 0) {
+				printf("archive: %s reads differently\n", fi.GetPath().c_str());
+				mismatches++;
+			}
+			paths.push_back(fi.GetPath());
+		}
+	}
+	printf("archive: %u files, %d directories: %s\n", unsigned(paths.size()), dirs, mismatches ? "fail" : "pass");
+
+	t = SDL_GetTicks();
+	const size_t fsBytes = read_all(data, paths);
+	const Uint32 fsTime = SDL_GetTicks() - t;
+	t = SDL_GetTicks();
+	const size_t archiveBytes = read_all(archive, paths);
+	const Uint32 archiveTime = SDL_GetTicks() - t;
+	printf("archive: read %u bytes in %ums from the directory, %u bytes in %ums from the archive\n",
+		unsigned(fsBytes), fsTime, unsigned(archiveBytes), archiveTime);
+}
+
 void test_filesystem()
 {
 	using namespace FileSystem;
@@ -90,7 +163,7 @@ void test_filesystem()
 	printf("data dir is '%s'\n", FileSystem::GetDataDir().c_str());
 	printf("user dir is '%s'\n", FileSystem::GetUserDir().c_str());
 
-	FileSourceFS fsAppData(FileSystem::GetDataDir());
+	FileSourceFS fsAppData(FileSystem::GetDataDir(), true);
 	FileSourceFS fsUserData(FileSystem::JoinPath(FileSystem::GetUserDir(), "data"));
 	//FileSourceZip fsZip("/home/jpab/.pioneer/mods/swapships.zip");
 
@@ -105,6 +178,8 @@ void test_filesystem()
 
 	fs.AppendSource(&fsUserData);
 	fs.AppendSource(&fsAppData);
+
+	test_archive(fsAppData);
 	//test_enum_models(fs);
 
 	//printf("With zip:\n");
@@ -0,0 +1,66 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <vector>
+#include "JobQueue.h"
+#include "TaskGraph.h"
+#include "SDL.h"
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+// Test suite for the job queue's parallel loop and task graphs
+void test_jobqueue() {
+
+	cout << "----------------------" << endl;
+	cout << "Running job queue tests" << endl;
+	cout << "----------------------" << endl;
+
+	JobQueue jq(4);
+
+	// every index visited exactly once, for sizes around the batch boundaries
+	const Uint32 counts[] = {0, 1, 7, 8, 9, 1000};
+	for (int i=0; i<6; ++i) {
+		vector<int> visits(counts[i], 0);
+		jq.ParallelFor(counts[i], 8, [&visits](Uint32 begin, Uint32 end) {
+			for (Uint32 j = begin; j < end; j++)
+				visits[j]++;
+		});
+		bool ok = true;
+		for (Uint32 j = 0; j < counts[i]; j++)
+			if (visits[j] != 1) ok = false;
+		cout << "ParallelFor " << counts[i] << ": " << (ok ? "pass" : "fail") << endl;
+	}
+
+	// leftover batch jobs get cleaned up without running anything
+	jq.FinishJobs();
+
+	// tasks run after what they depend on, and main thread ones on this
+	// thread in the order they were added
+	{
+		TaskGraph graph(&jq);
+		vector<int> order;
+		atomic<int> workersDone(0);
+		const std::thread::id mainThread = std::this_thread::get_id();
+		bool onMain = true;
+		const TaskGraph::TaskId slow = graph.Add("slow", TaskGraph::WORKER, [&workersDone] { SDL_Delay(50); ++workersDone; });
+		const TaskGraph::TaskId quick = graph.Add("quick", TaskGraph::WORKER, [&workersDone] { ++workersDone; });
+		const TaskGraph::TaskId a = graph.Add("a", TaskGraph::MAIN_THREAD, [&] { order.push_back(0); onMain &= std::this_thread::get_id() == mainThread; });
+		graph.Add("b", TaskGraph::MAIN_THREAD, [&] { order.push_back(workersDone == 2 ? 1 : -1); onMain &= std::this_thread::get_id() == mainThread; }, { slow, quick, a });
+		graph.Add("c", TaskGraph::MAIN_THREAD, [&] { order.push_back(2); onMain &= std::this_thread::get_id() == mainThread; });
+		graph.Add("d", TaskGraph::WORKER, [] {}, { quick });
+		float lastProgress = 0.f;
+		graph.Run([&lastProgress](float progress) { lastProgress = progress; });
+		// c doesn't wait for the slow one, so it goes before b
+		const bool ok = order.size() == 3 && order[0] == 0 && order[1] == 2 && order[2] == 1 && onMain && lastProgress == 1.f;
+		cout << "TaskGraph: " << (ok ? "pass" : "fail") << endl;
+		graph.WriteProfile(stdout);
+	}
+
+	cout << "----------------------" << endl;
+	cout << "End of job queue tests." << endl;
+	cout << "----------------------" << endl;
+}
@@ -0,0 +1,146 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "SoundMix.h"
+#include "Random.h"
+#include "SDL.h"
+
+using namespace std;
+using namespace Sound;
+
+namespace {
+	Mix::Gain FixedGain(float v) {
+		Mix::Gain g;
+		g.volume[0] = g.volume[1] = g.targetVolume[0] = g.targetVolume[1] = v;
+		g.rateOfChange[0] = g.rateOfChange[1] = 0.0f;
+		return g;
+	}
+
+	Mix::Cursor StartCursor(Uint32 rate) {
+		Mix::Cursor c;
+		c.frame = c.frac = 0;
+		c.step = Mix::StepForRate(rate);
+		return c;
+	}
+
+	// a sine at freq Hz, sampled at rate
+	vector<Sint16> Tone(Uint32 rate, int channels, float freq, int frames) {
+		vector<Sint16> tone(frames * channels);
+		for (int i = 0; i < frames; i++)
+			for (int c = 0; c < channels; c++)
+				tone[i*channels + c] = Sint16(16000.0 * sin(2.0 * M_PI * freq * i / rate + c));
+		return tone;
+	}
+}
+
+// Checks the mixer's sums and times mixing lots of voices at once
+void test_soundmix() {
+
+	cout << "--------------------------" << endl;
+	cout << "Running sound mixer tests" << endl;
+	cout << "--------------------------" << endl;
+
+	const int FRAMES = 1000;
+
+	// at the output rate it's just a copy
+	{
+		vector<Sint16> src = Tone(Mix::OUTPUT_RATE, 2, 440.0f, FRAMES);
+		vector<float> out(2*FRAMES, 0.0f);
+		Mix::Cursor cursor = StartCursor(Mix::OUTPUT_RATE);
+		Mix::Gain gain = FixedGain(1.0f);
+		const int done = Mix::MixVoice(&out[0], FRAMES, &src[0], FRAMES, false, 2, cursor, gain);
+		bool same = (done == FRAMES) && (cursor.frame == Uint32(FRAMES));
+		for (int i = 0; i < 2*FRAMES; i++)
+			if (out[i] != float(src[i])) same = false;
+		cout << "pass through: " << (same ? "pass" : "fail") << endl;
+	}
+
+	// half rate mono comes out twice as long, on both sides, the frames in
+	// between half way between their neighbours
+	{
+		vector<Sint16> src = Tone(Mix::OUTPUT_RATE/2, 1, 440.0f, FRAMES);
+		vector<float> out(4*FRAMES, 0.0f);
+		Mix::Cursor cursor = StartCursor(Mix::OUTPUT_RATE/2);
+		Mix::Gain gain = FixedGain(1.0f);
+		const int done = Mix::MixVoice(&out[0], 2*FRAMES, &src[0], FRAMES, false, 1, cursor, gain);
+		bool ok = (done == 2*FRAMES);
+		for (int i = 0; i + 1 < FRAMES; i++) {
+			const float mid = 0.5f * (float(src[i]) + float(src[i+1]));
+			if (out[4*i] != float(src[i]) || out[4*i+1] != float(src[i]) ||
+				fabs(out[4*i+2] - mid) > 0.5f || out[4*i+3] != out[4*i+2])
+				ok = false;
+		}
+		cout << "resample: " << (ok ? "pass" : "fail") << endl;
+	}
+
+	// volumes get to their targets at the rate asked, and no further
+	{
+		vector<Sint16> src(2*FRAMES, 1000);
+		vector<float> out(2*FRAMES, 0.0f);
+		Mix::Cursor cursor = StartCursor(Mix::OUTPUT_RATE);
+		Mix::Gain gain = FixedGain(0.0f);
+		gain.targetVolume[0] = 1.0f;
+		gain.targetVolume[1] = 0.5f;
+		gain.rateOfChange[0] = gain.rateOfChange[1] = 1.0f / 500.0f;
+		Mix::MixVoice(&out[0], FRAMES, &src[0], FRAMES, false, 2, cursor, gain);
+		bool ok = gain.volume[0] == 1.0f && gain.volume[1] == 0.5f;
+		for (int i = 1; i < FRAMES; i++)
+			if (out[2*i] < out[2*i-2] || out[2*i+1] < out[2*i-1]) ok = false;
+		// halfway up, give or take a block
+		if (fabs(out[2*250] - 500.0f) > 1000.0f * Mix::BLOCK_FRAMES / 500.0f) ok = false;
+		if (out[2*(FRAMES-1)] != 1000.0f || out[2*(FRAMES-1)+1] != 500.0f) ok = false;
+		cout << "volume ramp: " << (ok ? "pass" : "fail") << endl;
+	}
+
+	// voices at the rates and channels the data has, mixed a buffer at a
+	// time the way the audio callback does
+	Random rng(0xdeadbeef);
+	const Uint32 rates[] = { 22050, 44100, 48000, 32000 };
+	const int BUF_FRAMES = 4096;
+	const int SECONDS = 10;
+	const int SOURCE_FRAMES = 48000 * 2;
+	const int voiceCounts[] = { 8, 32, 64, 128 };
+	for (unsigned int n = 0; n < sizeof(voiceCounts)/sizeof(voiceCounts[0]); n++) {
+		const int numVoices = voiceCounts[n];
+		vector< vector<Sint16> > sources(numVoices);
+		vector<int> channels(numVoices);
+		vector<Mix::Cursor> cursors(numVoices);
+		vector<Mix::Gain> gains(numVoices);
+		for (int v = 0; v < numVoices; v++) {
+			const Uint32 rate = rates[v % 4];
+			channels[v] = 1 + (v & 1);
+			sources[v] = Tone(rate, channels[v], 100.0f + rng.Int32(2000), SOURCE_FRAMES);
+			cursors[v] = StartCursor(rate);
+			gains[v] = FixedGain(0.5f);
+			// some fading, so the ramps get used
+			gains[v].targetVolume[v & 1] = 0.0f;
+			gains[v].rateOfChange[v & 1] = 1.0f / Mix::OUTPUT_RATE;
+		}
+
+		vector<float> out(2*BUF_FRAMES);
+		const int numBufs = SECONDS * Mix::OUTPUT_RATE / BUF_FRAMES;
+		Uint32 t = SDL_GetTicks();
+		for (int b = 0; b < numBufs; b++) {
+			fill(out.begin(), out.end(), 0.0f);
+			for (int v = 0; v < numVoices; v++) {
+				int done = 0;
+				while (done < BUF_FRAMES) {
+					done += Mix::MixVoice(&out[2*done], BUF_FRAMES - done, &sources[v][0], SOURCE_FRAMES,
+						false, channels[v], cursors[v], gains[v]);
+					if (cursors[v].frame >= Uint32(SOURCE_FRAMES)) cursors[v].frame -= SOURCE_FRAMES;
+				}
+			}
+		}
+		t = std::max(SDL_GetTicks() - t, Uint32(1));
+		const double audioSeconds = double(numBufs) * BUF_FRAMES / Mix::OUTPUT_RATE;
+		cout << numVoices << " voices: " << audioSeconds << "s of audio in " << t << "ms, "
+			<< t / audioSeconds << "ms of CPU per second (" << out[0] << ")" << endl;
+	}
+
+	cout << "--------------------------" << endl;
+	cout << "End of sound mixer tests." << endl;
+	cout << "--------------------------" << endl;
+}
@@ -0,0 +1,128 @@
+// Copyright © 2008-2014 Pioneer Developers. See AUTHORS.txt for details
+// Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
+
+#include <iostream>
+#include <vector>
+#include "TerrainHeightCache.h"
+#include "Random.h"
+
+using namespace std;
+
+namespace {
+	// stands in for a terrain fractal: smooth hills, in planet radii
+	int s_evaluations = 0;
+	double TestHeight(const vector3d &p) {
+		s_evaluations++;
+		return 0.001 * (2.0 + sin(40.0*p.x)*cos(30.0*p.y) + 0.5*sin(70.0*p.z + 1.0));
+	}
+
+	vector3d SpherePoint(const vector3d *v, double x, double y) {
+		return (v[0] + x*(1.0-y)*(v[1]-v[0]) + x*y*(v[2]-v[0]) + (1.0-x)*y*(v[3]-v[0])).Normalized();
+	}
+}
+
+// Checks the shortcuts for terrain height lookups against running the "fractal"
+void test_terrainheightcache() {
+
+	cout << "--------------------------" << endl;
+	cout << "Running terrain height cache tests" << endl;
+	cout << "--------------------------" << endl;
+
+	Random rng(0xfeedbeef);
+
+	// a cube face, then patches split down from it the way GeoPatch does
+	vector3d v[4] = {
+		vector3d( 1, 1, 1).Normalized(), vector3d(-1, 1, 1).Normalized(),
+		vector3d(-1,-1, 1).Normalized(), vector3d( 1,-1, 1).Normalized()
+	};
+
+	const int edgeLen = 17;
+	const double frac = 1.0 / (edgeLen-1);
+	vector<double> heights(edgeLen*edgeLen);
+
+	bool coordsOk = true, missOk = true, boundOk = true;
+	for (int depth = 0; depth < 12; depth++) {
+		for (int y = 0; y < edgeLen; y++)
+			for (int x = 0; x < edgeLen; x++)
+				heights[x + y*edgeLen] = TestHeight(SpherePoint(v, x*frac, y*frac));
+		const double estimate = TerrainHeights::EstimateError(&heights[0], edgeLen);
+
+		double worst = 0.0;
+		for (int i = 0; i < 200; i++) {
+			const double x = rng.Double(), y = rng.Double();
+			const vector3d dir = SpherePoint(v, x, y);
+			double px, py;
+			if (!TerrainHeights::PatchCoords(v[0], v[1], v[2], v[3], dir, px, py) ||
+				fabs(px - x) > 1e-6 || fabs(py - y) > 1e-6) {
+				coordsOk = false;
+				continue;
+			}
+			worst = max(worst, fabs(TerrainHeights::Sample(&heights[0], edgeLen, px, py) - TestHeight(dir)));
+		}
+		if (worst > estimate) boundOk = false;
+
+		// straight through the other side of the planet isn't on the patch
+		double px, py;
+		if (TerrainHeights::PatchCoords(v[0], v[1], v[2], v[3], -SpherePoint(v, 0.5, 0.5), px, py))
+			missOk = false;
+
+		cout << "depth " << depth << ": worst error " << worst << ", estimated " << estimate << endl;
+
+		// on to the first kid, split the same way as QuadPatchJob does
+		const vector3d cn = (v[0]+v[1]+v[2]+v[3]).Normalized();
+		v[1] = (v[0]+v[1]).Normalized();
+		v[3] = (v[3]+v[0]).Normalized();
+		v[2] = cn;
+	}
+	cout << "patch coords: " << (coordsOk ? "pass" : "fail") << endl;
+	cout << "other side: " << (missOk ? "pass" : "fail") << endl;
+	cout << "error bound: " << (boundOk ? "pass" : "fail") << endl;
+
+	// a body creeping along, asking every step
+	const double maxError = 1e-7;
+	TerrainHeightCache cache;
+	int source;
+	vector3d dir = vector3d(0.3, 0.8, 0.5).Normalized();
+	const vector3d step = dir.Cross(vector3d(0.0, 0.0, 1.0)).Normalized() * 2e-7;
+	const int NUM_STEPS = 10000;
+	double worst = 0.0;
+	int worstMiss = 0;
+	s_evaluations = 0;
+	TerrainHeightCache::ClearHitCount();
+	for (int i = 0; i < NUM_STEPS; i++) {
+		dir = (dir + step).Normalized();
+		const int before = s_evaluations;
+		const double cached = cache.Get(&source, dir, maxError, TestHeight);
+		const int evaluations = s_evaluations;
+		worstMiss = max(worstMiss, evaluations - before);
+		worst = max(worst, fabs(cached - TestHeight(dir)));
+		s_evaluations = evaluations;
+	}
+	cout << "cache: " << TerrainHeightCache::GetHitCount() << " hits, " << s_evaluations << " evaluations for "
+		<< NUM_STEPS << " lookups, worst error " << worst << endl;
+	cout << "cache error: " << (worst <= maxError ? "pass" : "fail") << endl;
+	cout << "cache saves work: " << (s_evaluations < NUM_STEPS ? "pass" : "fail") << endl;
+
+	// an error no cell can meet, so every one it tries is thrown away
+	int roughSource;
+	s_evaluations = 0;
+	for (int i = 0; i < NUM_STEPS; i++) {
+		dir = (dir + step).Normalized();
+		const int before = s_evaluations;
+		cache.Get(&roughSource, dir, 0.0, TestHeight);
+		worstMiss = max(worstMiss, s_evaluations - before);
+	}
+	cout << "rough: " << s_evaluations << " evaluations for " << NUM_STEPS << " lookups" << endl;
+	cout << "cache miss cost: " << (worstMiss <= TerrainHeightCache::MAX_MISS_EVALUATIONS ? "pass" : "fail") << endl;
+	cout << "cache backs off: " << (s_evaluations < 2*NUM_STEPS ? "pass" : "fail") << endl;
+
+	// a different terrain doesn't get the old one's heights
+	int otherSource;
+	s_evaluations = 0;
+	cache.Get(&otherSource, dir, maxError, TestHeight);
+	cout << "cache source: " << (s_evaluations == 1 ? "pass" : "fail") << endl;
+
+	cout << "--------------------------" << endl;
+	cout << "End of terrain height cache tests." << endl;
+	cout << "--------------------------" << endl;
+}
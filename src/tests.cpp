@@ -5,6 +5,12 @@ void test_frames();
 void test_stringf();
 void test_filesystem();
 void test_random();
+void test_jobqueue();
+void test_bodyregistry();
+void test_terrainheightcache();
+void test_collision();
+void test_soundmix();
+void test_animation();
 
 int main(int argc, char *argv[])
 {
@@ -12,5 +18,11 @@ int main(int argc, char *argv[])
 	test_stringf();
 	test_filesystem();
 	test_random();
+	test_jobqueue();
+	test_bodyregistry();
+	test_terrainheightcache();
+	test_collision();
+	test_soundmix();
+	test_animation();
 	return 0;
 }
@@ -11,14 +11,20 @@
 #include <algorithm>
 #include "graphics/gl3/Effect.h"
 #include "graphics/gl3/EffectMaterial.h"
+#include "jenkins/lookup3.h"
 
 #include FT_GLYPH_H
 
 static const int ATLAS_SIZE = 1024;
 
+// number of laid out strings kept per font
+static const size_t TEXT_RUN_CACHE_SIZE = 512;
+
 namespace Text {
 
 int TextureFont::s_glyphCount = 0;
+int TextureFont::s_runCacheHits = 0;
+int TextureFont::s_runCacheMisses = 0;
 
 void TextureFont::AddGlyphGeometry(Graphics::VertexArray *va, const Glyph &glyph, float x, float y, const Color &c)
 {
@@ -180,11 +186,8 @@ int TextureFont::PickCharacter(const char *str, float mouseX, float mouseY)
 	return i2;
 }
 
-void TextureFont::RenderString(const char *str, float x, float y, const Color &color)
+void TextureFont::CreateGeometry(Graphics::VertexArray &va, const char *str, float x, float y, const Color &color)
 {
-	PROFILE_SCOPED()
-	m_vertices.Clear();
-
 	float alpha_f = color.a / 255.0f;
 	const Color premult_color = Color(color.r * alpha_f, color.g * alpha_f, color.b * alpha_f, color.a);
 
@@ -206,7 +209,7 @@ void TextureFont::RenderString(const char *str, float x, float y, const Color &c
 			i += n;
 
 			const Glyph &glyph = GetGlyph(chr);
-			AddGlyphGeometry(&m_vertices, glyph, roundf(px), py, premult_color);
+			AddGlyphGeometry(&va, glyph, roundf(px), py, premult_color);
 
 			if (str[i]) {
 				Uint32 chr2;
@@ -221,19 +224,10 @@ void TextureFont::RenderString(const char *str, float x, float y, const Color &c
 			px += glyph.advX;
 		}
 	}
-
-	if(m_vertices.GetNumVerts() > 0) {
-		m_mat->GetEffect()->SetProgram();
-		m_mat->GetEffect()->GetUniform(m_outlineId).Set(m_descriptor.outline ? 1.0f : 0.0f);
-		m_renderer->DrawTriangles(&m_vertices, m_renderState, m_mat.get());
-	}
 }
 
-Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &color)
+Color TextureFont::CreateMarkupGeometry(Graphics::VertexArray &va, const char *str, float x, float y, const Color &color)
 {
-	PROFILE_SCOPED()
-	m_vertices.Clear();
-
 	float px = x;
 	float py = y;
 
@@ -271,7 +265,7 @@ Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &
 			i += n;
 
 			const Glyph &glyph = GetGlyph(chr);
-			AddGlyphGeometry(&m_vertices, glyph, roundf(px), py, premult_c);
+			AddGlyphGeometry(&va, glyph, roundf(px), py, premult_c);
 
 			// XXX kerning doesn't skip markup
 			if (str[i]) {
@@ -288,11 +282,190 @@ Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &
 		}
 	}
 
-	if(m_vertices.GetNumVerts() > 0) {
+	return c;
+}
+
+// the same strings tend to be drawn in the same places frame after frame, so
+// we keep the most recently drawn ones laid out in vertex buffers. a string
+// only gets a buffer the second time it's seen, so text that changes every
+// frame (counters, timers) doesn't churn the cache with buffers that are
+// never reused
+TextureFont::TextRun *TextureFont::LookupTextRun(const char *str, const Color &color, bool markup, const vector2f &offset)
+{
+	const size_t len = strlen(str);
+
+	Uint32 extra[4];
+	memcpy(&extra[0], &color, sizeof(Uint32));
+	memcpy(&extra[1], &offset.x, sizeof(Uint32));
+	memcpy(&extra[2], &offset.y, sizeof(Uint32));
+	extra[3] = markup ? 1 : 0;
+	const Uint32 hash = lookup3_hashlittle(str, len, lookup3_hashword(extra, 4, 0));
+
+	auto i = m_textRuns.find(hash);
+	if (i != m_textRuns.end()) {
+		TextRun &run = (*i).second;
+		if (run.markup == markup && run.color == color && run.offset.x == offset.x && run.offset.y == offset.y && run.str.compare(0, std::string::npos, str, len) == 0) {
+			m_textRunsLRU.splice(m_textRunsLRU.begin(), m_textRunsLRU, run.lruPos);
+			return &run;
+		}
+
+		// hash collision. the new string takes over the slot
+		m_textRunsLRU.erase(run.lruPos);
+		m_textRuns.erase(i);
+	}
+
+	if (m_textRuns.size() >= TEXT_RUN_CACHE_SIZE) {
+		m_textRuns.erase(m_textRunsLRU.back());
+		m_textRunsLRU.pop_back();
+	}
+
+	TextRun &run = m_textRuns[hash];
+	run.str.assign(str, len);
+	run.color = color;
+	run.markup = markup;
+	run.offset = offset;
+	run.endColor = color;
+	m_textRunsLRU.push_front(hash);
+	run.lruPos = m_textRunsLRU.begin();
+
+	return 0;
+}
+
+struct TextVertex {
+	vector3f pos;
+	Color4ub col;
+	vector2f uv;
+};
+
+// fills the run's vertex buffer from m_vertices
+void TextureFont::BuildTextRun(TextRun &run)
+{
+	if (m_vertices.GetNumVerts() == 0)
+		return;
+
+	Graphics::VertexBufferDesc vbd;
+	vbd.attrib[0].semantic = Graphics::ATTRIB_POSITION;
+	vbd.attrib[0].format   = Graphics::ATTRIB_FORMAT_FLOAT3;
+	vbd.attrib[0].offset   = offsetof(TextVertex, pos);
+	vbd.attrib[1].semantic = Graphics::ATTRIB_DIFFUSE;
+	vbd.attrib[1].format   = Graphics::ATTRIB_FORMAT_UBYTE4;
+	vbd.attrib[1].offset   = offsetof(TextVertex, col);
+	vbd.attrib[2].semantic = Graphics::ATTRIB_UV0;
+	vbd.attrib[2].format   = Graphics::ATTRIB_FORMAT_FLOAT2;
+	vbd.attrib[2].offset   = offsetof(TextVertex, uv);
+	vbd.stride = sizeof(TextVertex);
+	vbd.numVertices = m_vertices.GetNumVerts();
+	vbd.usage = Graphics::BUFFER_USAGE_STATIC;
+	run.vertexBuffer.Reset(m_renderer->CreateVertexBuffer(vbd));
+
+	TextVertex *vtxPtr = run.vertexBuffer->Map<TextVertex>(Graphics::BUFFER_MAP_WRITE);
+	for (Uint32 i = 0; i < m_vertices.GetNumVerts(); i++) {
+		vtxPtr->pos = vector3f(m_vertices.position[i].x, m_vertices.position[i].y, m_vertices.position[i].z);
+		vtxPtr->col = m_vertices.diffuse[i];
+		vtxPtr->uv = m_vertices.uv0[i];
+		vtxPtr++;
+	}
+	run.vertexBuffer->Unmap();
+}
+
+void TextureFont::DrawTextGeometry(Graphics::VertexBuffer *vb, const vector2f &pos)
+{
+	Graphics::Renderer::MatrixTicket ticket(m_renderer, Graphics::MatrixMode::MODELVIEW);
+	m_renderer->Translate(pos.x, pos.y, 0.0f);
+
+	if (Graphics::Hardware::GL3()) {
 		m_mat->GetEffect()->SetProgram();
 		m_mat->GetEffect()->GetUniform(m_outlineId).Set(m_descriptor.outline ? 1.0f : 0.0f);
-		m_renderer->DrawTriangles(&m_vertices, m_renderState, m_mat.get());
 	}
+	m_renderer->DrawBuffer(vb, m_renderState, m_mat.get());
+}
+
+void TextureFont::DrawTextGeometry(Graphics::VertexArray *va, const vector2f &pos)
+{
+	if (va->GetNumVerts() == 0)
+		return;
+
+	Graphics::Renderer::MatrixTicket ticket(m_renderer, Graphics::MatrixMode::MODELVIEW);
+	m_renderer->Translate(pos.x, pos.y, 0.0f);
+
+	if (Graphics::Hardware::GL3()) {
+		m_mat->GetEffect()->SetProgram();
+		m_mat->GetEffect()->GetUniform(m_outlineId).Set(m_descriptor.outline ? 1.0f : 0.0f);
+	}
+	m_renderer->DrawTriangles(va, m_renderState, m_mat.get());
+}
+
+// runs are cached per sub-pixel offset, so it's rounded to a few steps to
+// keep moving labels from laying out a new run every frame
+static const float SUBPIXEL_STEPS = 4.0f;
+
+// the whole pixel part of a draw position, and what's left of it
+static void SplitPosition(float x, float y, vector2f &pos, vector2f &offset)
+{
+	pos = vector2f(floorf(x), floorf(y));
+	offset = vector2f(floorf((x - pos.x) * SUBPIXEL_STEPS) / SUBPIXEL_STEPS,
+		floorf((y - pos.y) * SUBPIXEL_STEPS) / SUBPIXEL_STEPS);
+}
+
+void TextureFont::RenderString(const char *str, float x, float y, const Color &color)
+{
+	PROFILE_SCOPED()
+
+	vector2f pos, offset;
+	SplitPosition(x, y, pos, offset);
+
+	TextRun *run = LookupTextRun(str, color, false, offset);
+	if (run && run->vertexBuffer) {
+		s_runCacheHits++;
+		DrawTextGeometry(run->vertexBuffer.Get(), pos);
+		return;
+	}
+
+	s_runCacheMisses++;
+
+	m_vertices.Clear();
+	CreateGeometry(m_vertices, str, offset.x, offset.y, color);
+
+	if (run) {
+		BuildTextRun(*run);
+		if (run->vertexBuffer) {
+			DrawTextGeometry(run->vertexBuffer.Get(), pos);
+			return;
+		}
+	}
+
+	DrawTextGeometry(&m_vertices, pos);
+}
+
+Color TextureFont::RenderMarkup(const char *str, float x, float y, const Color &color)
+{
+	PROFILE_SCOPED()
+
+	vector2f pos, offset;
+	SplitPosition(x, y, pos, offset);
+
+	TextRun *run = LookupTextRun(str, color, true, offset);
+	if (run && run->vertexBuffer) {
+		s_runCacheHits++;
+		DrawTextGeometry(run->vertexBuffer.Get(), pos);
+		return run->endColor;
+	}
+
+	s_runCacheMisses++;
+
+	m_vertices.Clear();
+	const Color c = CreateMarkupGeometry(m_vertices, str, offset.x, offset.y, color);
+
+	if (run) {
+		run->endColor = c;
+		BuildTextRun(*run);
+		if (run->vertexBuffer) {
+			DrawTextGeometry(run->vertexBuffer.Get(), pos);
+			return c;
+		}
+	}
+
+	DrawTextGeometry(&m_vertices, pos);
 	return c;
 }
 
@@ -566,6 +739,11 @@ TextureFont::TextureFont(const FontDescriptor &descriptor, Graphics::Renderer *r
 
 	m_height = float(m_face->height) / 64.f * float(m_face->size->metrics.y_scale) / 65536.f;
 	m_descender = -float(m_face->descender) / 64.f * float(m_face->size->metrics.y_scale) / 65536.f;
+
+	// nearly everything we draw is printable ASCII. baking it all now keeps
+	// the atlas uploads out of the first frames that draw text
+	for (Uint32 chr = 0x20; chr < 0x7f; chr++)
+		GetGlyph(chr);
 }
 
 TextureFont::~TextureFont()
@@ -10,7 +10,10 @@
 #include "graphics/Texture.h"
 #include "graphics/Material.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
 #include "graphics/RenderState.h"
+#include <list>
+#include <unordered_map>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
@@ -51,8 +54,15 @@ public:
 	static int GetGlyphCount() { return s_glyphCount; }
 	static void ClearGlyphCount() { s_glyphCount = 0; }
 
+	// strings drawn from the text run cache, and strings that had to be laid out
+	static int GetRunCacheHits() { return s_runCacheHits; }
+	static int GetRunCacheMisses() { return s_runCacheMisses; }
+	static void ClearRunCacheStats() { s_runCacheHits = s_runCacheMisses = 0; }
+
 	// fill a vertex array with single-colored text
 	void CreateGeometry(Graphics::VertexArray &, const char *str, float x, float y, const Color &color = Color::WHITE);
+	// fill a vertex array with text with colour markup. returns the final colour
+	Color CreateMarkupGeometry(Graphics::VertexArray &, const char *str, float x, float y, const Color &color = Color::WHITE);
 	RefCountedPtr<Graphics::Texture> GetTexture() { return m_texture; }
 
 private:
@@ -71,6 +81,30 @@ private:
 	Glyph BakeGlyph(Uint32 chr);
 
 	void AddGlyphGeometry(Graphics::VertexArray *va, const Glyph &glyph, float x, float y, const Color &color);
+
+	// a string that has been laid out and put in a vertex buffer, ready to
+	// draw. runs are laid out at the sub-pixel part of the position they
+	// were asked for, and translated to the whole-pixel part when drawn
+	struct TextRun {
+		std::string str;
+		Color color;
+		bool markup;
+		vector2f offset;
+		Color endColor;
+		RefCountedPtr<Graphics::VertexBuffer> vertexBuffer;
+		std::list<Uint32>::iterator lruPos;
+	};
+	TextRun *LookupTextRun(const char *str, const Color &color, bool markup, const vector2f &offset);
+	void BuildTextRun(TextRun &run);
+	void DrawTextGeometry(Graphics::VertexBuffer *vb, const vector2f &pos);
+	void DrawTextGeometry(Graphics::VertexArray *va, const vector2f &pos);
+
+	std::unordered_map<Uint32,TextRun> m_textRuns;
+	std::list<Uint32> m_textRunsLRU; // most recently used first
+
+	static int s_runCacheHits;
+	static int s_runCacheMisses;
+
 	float m_height;
 	float m_descender;
 	std::unique_ptr<Graphics::Material> m_mat;
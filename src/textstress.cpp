@@ -2,6 +2,7 @@
 // Licensed under the terms of the GPL v3. See licenses/GPL-3.txt
 
 #include <cstdlib>
+#include <cstring>
 #include "SDL.h"
 #include "FileSystem.h"
 #include "OS.h"
@@ -38,8 +39,6 @@ int main(int argc, char **argv)
 	r->SetOrthographicProjection(0, WIDTH, HEIGHT, 0, -1, 1);
 	r->SetTransform(matrix4x4f::Identity());
 	r->SetClearColor(Color::BLACK);
-	r->SetBlendMode(Graphics::BLEND_ALPHA);
-	r->SetDepthTest(false);
 
 	const Text::FontDescriptor fontDesc(Text::FontDescriptor::Load(FileSystem::gameDataFiles, "fonts/UIFont.ini", "en"));
 	Text::TextureFont *font = new Text::TextureFont(fontDesc, r);
@@ -48,6 +47,14 @@ int main(int argc, char **argv)
 	for (int i = 33; i < 127; i++)
 		str.push_back(i);
 
+	// a screenful of labels each frame, drawn in the same places like the
+	// HUD does, or with "random" at new (sub-pixel) positions every frame
+	// like labels that follow ships about. either way it's the same glyphs
+	const bool randomPositions = argc > 1 && !strcmp(argv[1], "random");
+
+	Uint32 lastStats = SDL_GetTicks();
+	int frames = 0;
+
 	while (1) {
 		bool done = false;
 
@@ -59,8 +66,30 @@ int main(int argc, char **argv)
 		if (done)
 			break;
 
-		font->RenderString(str.c_str(), rand()%(WIDTH*2)-WIDTH, rand()%HEIGHT, Color::WHITE);
+		r->ClearScreen();
+
+		const float lineHeight = font->GetHeight();
+		for (int line = 0; line * lineHeight < HEIGHT; line++) {
+			if (randomPositions)
+				font->RenderString(str.c_str() + (line % 32), float(rand() % WIDTH) * 0.5f - WIDTH * 0.25f,
+					float(rand() % (HEIGHT * 4)) * 0.25f, Color::WHITE);
+			else
+				font->RenderString(str.c_str() + (line % 32), 0.0f, line * lineHeight, Color::WHITE);
+		}
+
 		r->SwapBuffers();
+		frames++;
+
+		const Uint32 now = SDL_GetTicks();
+		if (now - lastStats >= 1000) {
+			Output("%d fps, %d glyphs/sec, %d cached runs/sec, %d uncached runs/sec\n",
+				frames, Text::TextureFont::GetGlyphCount(),
+				Text::TextureFont::GetRunCacheHits(), Text::TextureFont::GetRunCacheMisses());
+			Text::TextureFont::ClearGlyphCount();
+			Text::TextureFont::ClearRunCacheStats();
+			frames = 0;
+			lastStats = now;
+		}
 	}
 
 	delete font;
@@ -51,7 +51,7 @@ void Container::AddWidget(Widget *widget)
 	widget->Attach(this);
 	m_widgets.push_back(RefCountedPtr<Widget>(widget));
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 void Container::RemoveWidget(Widget *widget)
@@ -67,7 +67,7 @@ void Container::RemoveWidget(Widget *widget)
 	widget->Detach();
 	m_widgets.erase(i);
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 void Container::RemoveAllWidgets()
@@ -78,7 +78,7 @@ void Container::RemoveAllWidgets()
 		i = m_widgets.erase(i);
 	}
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 void Container::Disable()
@@ -133,6 +133,7 @@ void Container::SetWidgetDimensions(Widget *widget, const Point &position, const
 	assert(widget->GetContainer() == this);
 
 	widget->SetDimensions(position, size);
+	GetContext()->m_frameStats.widgetsLaidOut++;
 }
 
 Widget *Container::GetWidgetAt(const Point &pos)
@@ -7,6 +7,7 @@
 #include "Lua.h"
 #include "FileSystem.h"
 #include <typeinfo>
+#include <set>
 
 namespace UI {
 
@@ -40,6 +41,7 @@ Context::Context(LuaManager *lua, Graphics::Renderer *renderer, int width, int h
 	m_height(height),
 	m_scale(std::min(float(m_height)/SCALE_CUTOFF_HEIGHT, 1.0f)),
 	m_needsLayout(false),
+	m_layoutGeneration(1),
 	m_eventDispatcher(this),
 	m_skin("ui/Skin.ini", renderer, GetScale()),
 	m_lua(lua)
@@ -118,23 +120,72 @@ Widget *Context::GetWidgetAt(const Point &pos)
 
 void Context::Layout()
 {
-	// some widgets (eg MultiLineText) can require two layout passes because we
-	// don't know their preferred size until after their first layout run. so
-	// then we have to do layout again to make sure everyone else gets it right
-	m_needsLayout = false;
-
-	LayoutChildren();
-	if (m_needsLayout)
+	if (m_needsLayout) {
+		// a full layout satisfies any outstanding requests and leaves every
+		// stored preferred size stale
+		for (std::vector< RefCountedPtr<Widget> >::iterator i = m_layoutQueue.begin(); i != m_layoutQueue.end(); ++i)
+			(*i)->m_layoutQueued = false;
+		m_layoutQueue.clear();
+		m_layoutGeneration++;
+
+		m_needsLayout = false;
 		LayoutChildren();
+	}
 
-	m_needsLayout = false;
+	// some widgets (eg MultiLineText) can require two layout passes because we
+	// don't know their preferred size until after their first layout run. they
+	// request another layout, which we handle right away so that everyone
+	// else gets it right
+	LayoutQueuedWidgets();
+	if (!m_layoutQueue.empty())
+		LayoutQueuedWidgets();
 
 	m_eventDispatcher.LayoutUpdated();
 }
 
+void Context::LayoutQueuedWidgets()
+{
+	std::vector< RefCountedPtr<Widget> > queue;
+	queue.swap(m_layoutQueue);
+
+	// find the topmost widget each request affects. a widget whose preferred
+	// size hasn't changed can be laid out again in the space it already has;
+	// otherwise its container has to redo its layout too, and so on up.
+	// layers are always the full size of the screen, so they stop it
+	std::set<Widget*> roots;
+	for (std::vector< RefCountedPtr<Widget> >::iterator i = queue.begin(); i != queue.end(); ++i) {
+		Widget *w = (*i).Get();
+		w->m_layoutQueued = false;
+
+		// removed since the request. it'll be laid out if it gets added again
+		if (!w->GetContainer() || !w->IsVisible())
+			continue;
+
+		while (w->GetContainer() != this && w->PreferredSizeChanged())
+			w = w->GetContainer();
+		roots.insert(w);
+	}
+
+	for (std::set<Widget*>::iterator i = roots.begin(); i != roots.end(); ++i) {
+		Widget *w = *i;
+
+		// nested inside another root, which will lay it out anyway
+		bool nested = false;
+		for (Widget *c = w->GetContainer(); c && !nested; c = c->GetContainer())
+			nested = roots.count(c) > 0;
+		if (nested)
+			continue;
+
+		w->Layout();
+		m_frameStats.widgetsLaidOut++;
+	}
+}
+
 void Context::Update()
 {
-	if (m_needsLayout)
+	m_frameStats = FrameStats();
+
+	if (m_needsLayout || !m_layoutQueue.empty())
 		Layout();
 
 	Container::Update();
@@ -203,7 +254,15 @@ void Context::DrawWidget(Widget *w)
 
 	m_renderer->SetTransform(matrix4x4f::Translation(m_drawWidgetPosition.x, m_drawWidgetPosition.y, 0));
 
+	Widget *prevSkinWidget = m_skin.BeginWidget(w);
 	w->Draw();
+	m_skin.EndWidget(prevSkinWidget);
+
+	m_frameStats.widgetsDrawn++;
+	if (w->m_skinBatchesChanged) {
+		m_frameStats.widgetsRedrawn++;
+		w->m_skinBatchesChanged = false;
+	}
 
 	m_scissorStack.pop();
 
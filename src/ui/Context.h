@@ -126,6 +126,8 @@ public:
 	bool Dispatch(const Event &event) { return m_eventDispatcher.Dispatch(event); }
 	bool DispatchSDLEvent(const SDL_Event &event) { return m_eventDispatcher.DispatchSDLEvent(event); }
 
+	// force a layout of the entire widget tree. widgets that only need
+	// themselves laid out again should call Widget::RequestLayout() instead
 	void RequestLayout() { m_needsLayout = true; }
 
 	void SelectWidget(Widget *target) { m_eventDispatcher.SelectWidget(target); }
@@ -152,6 +154,15 @@ public:
 
 	const Point &GetScissor() const { return m_scissorStack.top().second; }
 
+	// counters for the last frame, reset by Update()
+	struct FrameStats {
+		FrameStats() : widgetsLaidOut(0), widgetsDrawn(0), widgetsRedrawn(0) {}
+		Uint32 widgetsLaidOut;
+		Uint32 widgetsDrawn;
+		Uint32 widgetsRedrawn; // drawn with rebuilt (not cached) geometry
+	};
+	const FrameStats &GetFrameStats() const { return m_frameStats; }
+
 private:
 	virtual Point PreferredSize() { return Point(); }
 
@@ -163,6 +174,21 @@ private:
 
 	bool m_needsLayout;
 
+	// widgets that have asked to be laid out again. see Widget::RequestLayout()
+	friend class Widget;
+	void QueueLayout(Widget *w) { m_layoutQueue.push_back(RefCountedPtr<Widget>(w)); }
+	void LayoutQueuedWidgets();
+	std::vector< RefCountedPtr<Widget> > m_layoutQueue;
+
+	// preferred sizes stored by widgets from an older generation can't be
+	// trusted. bumped on full layout and on anything that can change the
+	// preferred size of a widget without it knowing (eg font inheritance)
+	Uint32 GetLayoutGeneration() const { return m_layoutGeneration; }
+	void InvalidateLayoutCache() { m_layoutGeneration++; }
+	Uint32 m_layoutGeneration;
+
+	FrameStats m_frameStats;
+
 	std::vector<Layer*> m_layers;
 
 	EventDispatcher m_eventDispatcher;
@@ -38,7 +38,7 @@ void Label::Draw()
 Label *Label::SetText(const std::string &text)
 {
 	m_text = text;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -21,7 +21,7 @@ Layer *Layer::SetInnerWidget(Widget *w, const Point &pos, const Point &size)
 	Container::AddWidget(w);
 	Container::SetWidgetDimensions(w, pos, size);
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 
 	return this;
 }
@@ -31,7 +31,7 @@ void Layer::RemoveInnerWidget()
 	Container::RemoveAllWidgets();
 	m_widget.Reset(0);
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 }
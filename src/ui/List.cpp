@@ -45,7 +45,7 @@ List *List::AddOption(const std::string &text)
 
 	m_optionBackgrounds.push_back(background);
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 
 	return this;
 }
@@ -106,7 +106,7 @@ void List::Clear()
 	static_cast<VBox*>(m_container->GetInnerWidget())->Clear();
 	m_selected = -1;
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 bool List::HandleOptionMouseOver(int index)
@@ -29,7 +29,7 @@ Point MultiLineText::PreferredSize()
 void MultiLineText::Layout()
 {
 	const Point newSize(m_layout->ComputeSize(GetSize()));
-	if (m_preferredSize != newSize) GetContext()->RequestLayout();
+	if (m_preferredSize != newSize) RequestLayout();
 	m_preferredSize = newSize;
 	SetActiveArea(m_preferredSize);
 }
@@ -51,7 +51,7 @@ MultiLineText *MultiLineText::SetText(const std::string &text)
 	m_text = text;
 	m_layout.reset(new TextLayout(GetContext()->GetFont(GetFont()), m_text));
 	m_preferredSize = Point();
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
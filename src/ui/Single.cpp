@@ -28,7 +28,7 @@ Single *Single::SetInnerWidget(Widget *widget)
 	AddWidget(widget);
 	m_innerWidget = widget;
 
-	GetContext()->RequestLayout();
+	RequestLayout();
 
 	return this;
 }
@@ -38,7 +38,7 @@ void Single::RemoveInnerWidget()
 	if (m_innerWidget) {
 		Container::RemoveWidget(m_innerWidget);
 		m_innerWidget = 0;
-		GetContext()->RequestLayout();
+		RequestLayout();
 	}
 }
 
@@ -5,6 +5,8 @@
 #include "IniConfig.h"
 #include "graphics/TextureBuilder.h"
 #include "graphics/VertexArray.h"
+#include "graphics/VertexBuffer.h"
+#include "Widget.h"
 #include "FileSystem.h"
 #include "MainMaterial.h"
 
@@ -14,7 +16,8 @@ static const float SKIN_SIZE = 512.0f;
 
 Skin::Skin(const std::string &filename, Graphics::Renderer *renderer, float scale) :
 	m_renderer(renderer),
-	m_scale(scale)
+	m_scale(scale),
+	m_drawWidget(0)
 {
 	IniConfig cfg;
 	// set defaults
@@ -115,8 +118,87 @@ static inline vector2f scaled(const vector2f &v)
 	return v * (1.0f / SKIN_SIZE);
 }
 
+Widget *Skin::BeginWidget(Widget *w)
+{
+	Widget *prev = m_drawWidget;
+	m_drawWidget = w;
+	w->m_skinBatchIndex = 0;
+	return prev;
+}
+
+// a widget generally draws the same elements in the same order every frame,
+// so the geometry for the nth element it draws is kept in its nth batch and
+// reused for as long as the element and its rectangle stay the same
+bool Skin::DrawCachedBatch(const void *element, const Point &pos, const Point &size, Graphics::RenderState *state, Graphics::Material *material) const
+{
+	if (!m_drawWidget || m_drawWidget->m_skinBatchIndex >= m_drawWidget->m_skinBatches.size())
+		return false;
+
+	const Widget::SkinBatch &batch = m_drawWidget->m_skinBatches[m_drawWidget->m_skinBatchIndex];
+	if (batch.element != element || batch.pos != pos || batch.size != size || !batch.vertexBuffer)
+		return false;
+
+	m_renderer->DrawBuffer(batch.vertexBuffer.Get(), state, material, Graphics::TRIANGLE_STRIP);
+	m_drawWidget->m_skinBatchIndex++;
+	return true;
+}
+
+struct SkinVertex {
+	vector3f pos;
+	vector2f uv;
+};
+
+void Skin::DrawBatch(const void *element, const Point &pos, const Point &size, Graphics::VertexArray &va, Graphics::RenderState *state, Graphics::Material *material) const
+{
+	// nothing to cache it on
+	if (!m_drawWidget) {
+		m_renderer->DrawTriangles(&va, state, material, Graphics::TRIANGLE_STRIP);
+		return;
+	}
+
+	if (m_drawWidget->m_skinBatchIndex >= m_drawWidget->m_skinBatches.size())
+		m_drawWidget->m_skinBatches.resize(m_drawWidget->m_skinBatchIndex+1);
+	Widget::SkinBatch &batch = m_drawWidget->m_skinBatches[m_drawWidget->m_skinBatchIndex];
+
+	batch.element = element;
+	batch.pos = pos;
+	batch.size = size;
+
+	const bool hasUV = va.HasAttrib(Graphics::ATTRIB_UV0);
+
+	Graphics::VertexBufferDesc vbd;
+	vbd.attrib[0].semantic = Graphics::ATTRIB_POSITION;
+	vbd.attrib[0].format   = Graphics::ATTRIB_FORMAT_FLOAT3;
+	vbd.attrib[0].offset   = offsetof(SkinVertex, pos);
+	if (hasUV) {
+		vbd.attrib[1].semantic = Graphics::ATTRIB_UV0;
+		vbd.attrib[1].format   = Graphics::ATTRIB_FORMAT_FLOAT2;
+		vbd.attrib[1].offset   = offsetof(SkinVertex, uv);
+	}
+	vbd.stride = sizeof(SkinVertex);
+	vbd.numVertices = va.GetNumVerts();
+	vbd.usage = Graphics::BUFFER_USAGE_STATIC;
+	batch.vertexBuffer.Reset(m_renderer->CreateVertexBuffer(vbd));
+
+	SkinVertex *vtxPtr = batch.vertexBuffer->Map<SkinVertex>(Graphics::BUFFER_MAP_WRITE);
+	for (Uint32 i = 0; i < va.GetNumVerts(); i++) {
+		vtxPtr->pos = vector3f(va.position[i].x, va.position[i].y, va.position[i].z);
+		vtxPtr->uv = hasUV ? va.uv0[i] : vector2f(0.0f);
+		vtxPtr++;
+	}
+	batch.vertexBuffer->Unmap();
+
+	m_drawWidget->m_skinBatchIndex++;
+	m_drawWidget->m_skinBatchesChanged = true;
+
+	m_renderer->DrawBuffer(batch.vertexBuffer.Get(), state, material, Graphics::TRIANGLE_STRIP);
+}
+
 void Skin::DrawRectElement(const RectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
 {
+	if (DrawCachedBatch(&element, pos, size, GetRenderState(blendMode), m_textureMaterial.Get()))
+		return;
+
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
 
 	va.Add(vector3f(pos.x,        pos.y,        0.0f), scaled(vector2f(element.pos.x,                element.pos.y)));
@@ -124,7 +206,7 @@ void Skin::DrawRectElement(const RectElement &element, const Point &pos, const P
 	va.Add(vector3f(pos.x+size.x, pos.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y)));
 	va.Add(vector3f(pos.x+size.x, pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+element.size.y)));
 
-	m_renderer->DrawTriangles(&va, GetRenderState(blendMode), m_textureMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	DrawBatch(&element, pos, size, va, GetRenderState(blendMode), m_textureMaterial.Get());
 }
 
 void Skin::DrawBorderedRectElement(const BorderedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
@@ -132,6 +214,9 @@ void Skin::DrawBorderedRectElement(const BorderedRectElement &element, const Poi
 	const float width = element.borderWidth;
 	const float height = element.borderHeight;
 
+	if (DrawCachedBatch(&element, pos, size, GetRenderState(blendMode), m_textureMaterial.Get()))
+		return;
+
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
 
 	va.Add(vector3f(pos.x,              pos.y,        0.0f), scaled(vector2f(element.pos.x,                             element.pos.y)));
@@ -169,13 +254,16 @@ void Skin::DrawBorderedRectElement(const BorderedRectElement &element, const Poi
 	va.Add(vector3f(pos.x+size.x,       pos.y+size.y-height, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y-height)));
 	va.Add(vector3f(pos.x+size.x,       pos.y+size.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y)));
 
-	m_renderer->DrawTriangles(&va, GetRenderState(blendMode), m_textureMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	DrawBatch(&element, pos, size, va, GetRenderState(blendMode), m_textureMaterial.Get());
 }
 
 void Skin::DrawVerticalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
 {
 	const float height = element.edgeWidth;
 
+	if (DrawCachedBatch(&element, pos, size, GetRenderState(blendMode), m_textureMaterial.Get()))
+		return;
+
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
 
 	va.Add(vector3f(pos.x+size.x, pos.y,               0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y)));
@@ -187,13 +275,16 @@ void Skin::DrawVerticalEdgedRectElement(const EdgedRectElement &element, const P
 	va.Add(vector3f(pos.x+size.x, pos.y+size.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x, element.pos.y+element.size.y)));
 	va.Add(vector3f(pos.x,        pos.y+size.y,        0.0f), scaled(vector2f(element.pos.x,                element.pos.y+element.size.y)));
 
-	m_renderer->DrawTriangles(&va, GetRenderState(blendMode), m_textureMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	DrawBatch(&element, pos, size, va, GetRenderState(blendMode), m_textureMaterial.Get());
 }
 
 void Skin::DrawHorizontalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode) const
 {
 	const float width = element.edgeWidth;
 
+	if (DrawCachedBatch(&element, pos, size, GetRenderState(blendMode), m_textureMaterial.Get()))
+		return;
+
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION | Graphics::ATTRIB_UV0);
 
 	va.Add(vector3f(pos.x,              pos.y,        0.0f), scaled(vector2f(element.pos.x,                      element.pos.y)));
@@ -205,11 +296,16 @@ void Skin::DrawHorizontalEdgedRectElement(const EdgedRectElement &element, const
 	va.Add(vector3f(pos.x+size.x,       pos.y,        0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y)));
 	va.Add(vector3f(pos.x+size.x,       pos.y+size.y, 0.0f), scaled(vector2f(element.pos.x+element.size.x,       element.pos.y+element.size.y)));
 
-	m_renderer->DrawTriangles(&va, GetRenderState(blendMode), m_textureMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	DrawBatch(&element, pos, size, va, GetRenderState(blendMode), m_textureMaterial.Get());
 }
 
 void Skin::DrawRectColor(const Color &col, const Point &pos, const Point &size) const
 {
+	// colour comes from the material, so the geometry is shared by all colours
+	m_colorMaterial->diffuse = col;
+	if (DrawCachedBatch(m_colorMaterial.Get(), pos, size, GetAlphaBlendState(), m_colorMaterial.Get()))
+		return;
+
 	Graphics::VertexArray va(Graphics::ATTRIB_POSITION);
 
 	va.Add(vector3f(pos.x,        pos.y,        0.0f));
@@ -217,8 +313,7 @@ void Skin::DrawRectColor(const Color &col, const Point &pos, const Point &size)
 	va.Add(vector3f(pos.x+size.x, pos.y,        0.0f));
 	va.Add(vector3f(pos.x+size.x, pos.y+size.y, 0.0f));
 
-	m_colorMaterial->diffuse = col;
-	m_renderer->DrawTriangles(&va, GetAlphaBlendState(), m_colorMaterial.Get(), Graphics::TRIANGLE_STRIP);
+	DrawBatch(m_colorMaterial.Get(), pos, size, va, GetAlphaBlendState(), m_colorMaterial.Get());
 }
 
 static size_t SplitSpec(const std::string &spec, std::vector<int> &output)
@@ -13,12 +13,22 @@
 
 #include <SDL_stdinc.h>
 
+namespace Graphics { class VertexArray; }
+
 namespace UI {
 
+class Widget;
+
 class Skin {
 public:
 	Skin(const std::string &filename, Graphics::Renderer *renderer, float scale);
 
+	// elements drawn between these calls have their geometry cached on the
+	// widget. Context does this for each widget it draws. BeginWidget returns
+	// the previous widget, which should be passed to EndWidget
+	Widget *BeginWidget(Widget *w);
+	void EndWidget(Widget *prev) { m_drawWidget = prev; }
+
 	void DrawBackgroundNormal(const Point &pos, const Point &size) const {
 		DrawBorderedRectElement(m_backgroundNormal, pos, size);
 	}
@@ -222,6 +232,11 @@ private:
 	Graphics::RenderState *m_alphaSetState;
 	Graphics::RenderState *m_alphaMaskState;
 
+	Widget *m_drawWidget;
+
+	bool DrawCachedBatch(const void *element, const Point &pos, const Point &size, Graphics::RenderState *state, Graphics::Material *material) const;
+	void DrawBatch(const void *element, const Point &pos, const Point &size, Graphics::VertexArray &va, Graphics::RenderState *state, Graphics::Material *material) const;
+
 	void DrawRectElement(const RectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode = Graphics::BLEND_ALPHA) const;
 	void DrawBorderedRectElement(const BorderedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode = Graphics::BLEND_ALPHA) const;
 	void DrawVerticalEdgedRectElement(const EdgedRectElement &element, const Point &pos, const Point &size, Graphics::BlendMode blendMode = Graphics::BLEND_ALPHA) const;
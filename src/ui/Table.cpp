@@ -371,7 +371,7 @@ Table *Table::SetHeadingRow(const WidgetSet &set)
 	m_header->Clear();
 	m_header->AddRow(set.widgets);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -379,7 +379,7 @@ Table *Table::AddRow(const WidgetSet &set)
 {
 	m_body->AddRow(set.widgets);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -387,14 +387,14 @@ void Table::ClearRows()
 {
 	m_body->Clear();
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 }
 
 Table *Table::SetRowSpacing(int spacing)
 {
 	m_body->SetRowSpacing(spacing);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -402,7 +402,7 @@ Table *Table::SetColumnSpacing(int spacing)
 {
 	m_layout.SetColumnSpacing(spacing);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -410,7 +410,7 @@ Table *Table::SetRowAlignment(RowAlignDirection dir)
 {
 	m_body->SetRowAlignment(dir);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -418,7 +418,7 @@ Table *Table::SetColumnAlignment(ColumnAlignDirection mode)
 {
 	m_layout.SetColumnAlignment(mode);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
@@ -426,7 +426,7 @@ Table *Table::SetHeadingFont(Font font)
 {
 	m_header->SetFont(font);
 	m_dirty = true;
-	GetContext()->RequestLayout();
+	RequestLayout();
 	return this;
 }
 
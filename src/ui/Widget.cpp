@@ -4,6 +4,7 @@
 #include "Widget.h"
 #include "Container.h"
 #include "Context.h"
+#include "graphics/VertexBuffer.h"
 
 namespace UI {
 
@@ -19,7 +20,11 @@ Widget::Widget(Context *context) :
 	m_font(FONT_INHERIT),
 	m_disabled(false),
 	m_mouseOver(false),
-	m_visible(false)
+	m_visible(false),
+	m_layoutQueued(false),
+	m_layoutGeneration(0),
+	m_skinBatchIndex(0),
+	m_skinBatchesChanged(false)
 {
 	assert(m_context);
 }
@@ -64,6 +69,8 @@ void Widget::Detach()
 	m_container = 0;
 	m_position = Point();
 	m_size = Point();
+	m_layoutGeneration = 0;
+	m_skinBatches.clear();
 }
 
 void Widget::SetDimensions(const Point &position, const Point &size)
@@ -73,6 +80,36 @@ void Widget::SetDimensions(const Point &position, const Point &size)
 	SetActiveArea(size);
 }
 
+void Widget::RequestLayout()
+{
+	// detached widgets get laid out by their container when they're added
+	if (!m_container) {
+		if (this == m_context)
+			m_context->RequestLayout();
+		return;
+	}
+
+	if (m_layoutQueued)
+		return;
+
+	m_layoutQueued = true;
+	m_context->QueueLayout(this);
+}
+
+bool Widget::PreferredSizeChanged()
+{
+	const Point preferredSize = CalcLayoutContribution();
+
+	// the stored size is only trustworthy if nothing has invalidated it since
+	// (full layout, font change, reattach). if it's not, assume the worst
+	const bool changed = m_layoutGeneration != m_context->GetLayoutGeneration() || preferredSize != m_layoutPreferredSize;
+
+	m_layoutPreferredSize = preferredSize;
+	m_layoutGeneration = m_context->GetLayoutGeneration();
+
+	return changed;
+}
+
 void Widget::NotifyVisible(bool visible)
 {
 	if (m_visible != visible) {
@@ -90,7 +127,9 @@ void Widget::SetActiveArea(const Point &activeArea, const Point &activeOffset)
 Widget *Widget::SetFont(Font font)
 {
 	m_font = font;
-	GetContext()->RequestLayout();
+	// children may inherit the font, so every stored preferred size is suspect
+	GetContext()->InvalidateLayoutCache();
+	RequestLayout();
 	return this;
 }
 
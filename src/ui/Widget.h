@@ -13,6 +13,8 @@
 #include <climits>
 #include <set>
 
+namespace Graphics { class VertexBuffer; }
+
 // Widget is the base class for all UI elements. There's a couple of things it
 // must implement, and a few more it might want to implement if it wants to do
 // something fancy.
@@ -68,8 +70,10 @@
 //
 // Event handlers from user input are called before Layout(), which gives a
 // widget an opportunity to modify the layout based on input. If a widget
-// wants to change its size it must call GetContext()->RequestLayout() to
-// force a layout change to occur.
+// wants to change its size it must call RequestLayout() to force a layout
+// change to occur. Only the widget is laid out again unless its preferred
+// size has changed, in which case the request moves up to its container (and
+// so on). GetContext()->RequestLayout() forces a layout of everything.
 //
 // Event handlers are called against the "leaf" widgets first. Handlers return
 // a bool to indicate if the event was "handled" or not. If a widget has no
@@ -114,6 +118,9 @@ public:
 	// position relative to top container
 	Point GetAbsolutePosition() const;
 
+	// ask for this widget to be laid out again before the next draw
+	void RequestLayout();
+
 	// size control flags let a widget tell its container how it wants to be
 	// sized when it can't get its preferred size
 	Uint32 GetSizeControlFlags() const { return m_sizeControlFlags; }
@@ -391,6 +398,20 @@ private:
 	friend class Context;
 	void SetSize(const Point &size) { m_size = size; SetActiveArea(size); }
 
+	// true if the preferred size differs from the one seen at the last
+	// layout request, meaning the container has to do layout too
+	bool PreferredSizeChanged();
+
+	// Skin caches the geometry for the elements drawn by a widget, in the
+	// order they're drawn, and only rebuilds them when they change
+	friend class Skin;
+	struct SkinBatch {
+		const void *element;
+		Point pos;
+		Point size;
+		RefCountedPtr<Graphics::VertexBuffer> vertexBuffer;
+	};
+
 	Context *m_context;
 	Container *m_container;
 
@@ -417,6 +438,14 @@ private:
 
 	std::map< std::string,sigc::slot<void,PropertyMap &,const std::string &> > m_bindPoints;
 	std::map< std::string,sigc::connection > m_binds;
+
+	bool m_layoutQueued;
+	Point m_layoutPreferredSize;
+	Uint32 m_layoutGeneration;
+
+	std::vector<SkinBatch> m_skinBatches;
+	unsigned int m_skinBatchIndex;
+	bool m_skinBatchesChanged;
 };
 
 }
@@ -5,6 +5,7 @@
 
 #include "libs.h"
 #include "FileSystem.h"
+#include "FileSourceArchive.h"
 #include "TextUtils.h"
 #include "utils.h"
 #include <cassert>
@@ -241,4 +242,60 @@ namespace FileSystem {
 		const std::string fullpath = JoinPathBelow(GetRoot(), path);
 		return open_file_raw(fullpath, (flags & WRITE_TEXT) ? L"w" : L"wb");
 	}
+
+	// in seconds since 1970, as on other systems
+	static Uint64 unix_time(const FILETIME &ft)
+	{
+		const Uint64 EPOCH = 116444736000000000ULL; // 1970, in 100ns since 1601
+		const Uint64 t = (Uint64(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+		return (t > EPOCH) ? (t - EPOCH) / 10000000ULL : 0;
+	}
+
+	Uint64 NewestModTime(const std::string &path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attrs;
+		const std::wstring wpath = transcode_utf8_to_utf16(path);
+		if (!GetFileAttributesExW(wpath.c_str(), GetFileExInfoStandard, &attrs)) return 0;
+		Uint64 newest = unix_time(attrs.ftLastWriteTime);
+		if (!(attrs.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return newest;
+
+		WIN32_FIND_DATAW findinfo;
+		HANDLE dirhandle = FindFirstFileW((wpath + L"/*").c_str(), &findinfo);
+		if (dirhandle == INVALID_HANDLE_VALUE) return newest;
+		do {
+			const std::string fname = transcode_utf16_to_utf8(findinfo.cFileName, wcslen(findinfo.cFileName));
+			if (fname == "." || fname == "..") continue;
+			if (findinfo.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+				newest = std::max(newest, NewestModTime(JoinPath(path, fname)));
+			else
+				newest = std::max(newest, unix_time(findinfo.ftLastWriteTime));
+		} while (FindNextFileW(dirhandle, &findinfo));
+		FindClose(dirhandle);
+		return newest;
+	}
+
+	MappedFile *MappedFile::Open(const std::string &path)
+	{
+		const std::wstring wpath = transcode_utf8_to_utf16(path);
+		HANDLE file = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+		if (file == INVALID_HANDLE_VALUE) return 0;
+		LARGE_INTEGER size;
+		HANDLE mapping = 0;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+			mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+		CloseHandle(file); // the mapping keeps the file
+		if (!mapping) return 0;
+		const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!data) {
+			CloseHandle(mapping);
+			return 0;
+		}
+		return new MappedFile(static_cast<const char*>(data), size_t(size.QuadPart), mapping);
+	}
+
+	MappedFile::~MappedFile()
+	{
+		UnmapViewOfFile(m_data);
+		CloseHandle(static_cast<HANDLE>(m_handle));
+	}
 }